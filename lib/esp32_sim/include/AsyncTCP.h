@@ -0,0 +1,39 @@
+#pragma once
+// Подмена AsyncTCP: соединение HTTP-запроса. Опрос соединения (tcp_poll, раз в 500 мс)
+// повторяет заполнение ответа, вернувшего RESPONSE_TRY_AGAIN; вызов pcb()->poll из потока
+// tcpip (tcpip_try_callback) приводит к тому же досрочно.
+#include <atomic>
+#include "lwip/tcp.h"
+
+class AsyncClient
+{
+public:
+    AsyncClient()
+    {
+        _pcb.poll = _s_poll;
+        _pcb.callback_arg = this;
+    }
+    tcp_pcb *pcb() { return _connected ? &_pcb : nullptr; }
+    bool connected() const { return _connected; }
+    // Сервер обрывает соединение: симулятор прекращает выкачивать ответ
+    void close(bool now = false)
+    {
+        (void)now;
+        _closed = true;
+    }
+
+    // Внутреннее API симулятора.
+    std::atomic<bool> _connected{true};
+    std::atomic<bool> _polled{false};
+    std::atomic<bool> _closed{false};
+    // Ждать опроса соединения: досрочного или очередного по таймеру
+    void _simWaitPoll(uint32_t interval_ms);
+
+private:
+    static err_t _s_poll(void *arg, tcp_pcb *tpcb)
+    {
+        ((AsyncClient *)arg)->_polled = true;
+        return ERR_OK;
+    }
+    tcp_pcb _pcb;
+};
@@ -0,0 +1,466 @@
+#pragma once
+// Подмена ESPAsyncWebServer: HTTP-запросы подаются из консоли симулятора,
+// WebSocket-клиенты - виртуальные, с моделью пропускной способности канала.
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <deque>
+#include "Arduino.h"
+#include "AsyncTCP.h"
+#include "FS.h"
+
+typedef enum
+{
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+    HTTP_DELETE = 0b00000100,
+    HTTP_PUT = 0b00001000,
+    HTTP_PATCH = 0b00010000,
+    HTTP_HEAD = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServer;
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+class AsyncWebSocket;
+class AsyncWebSocketClient;
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data,
+                           size_t len, bool final)>
+    ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)>
+    ArBodyHandlerFunction;
+typedef std::function<void(void)> ArDisconnectHandler;
+typedef std::function<String(const String &)> AwsTemplateProcessor;
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+class AsyncWebHeader
+{
+public:
+    AsyncWebHeader(const String &name, const String &value) : _name(name), _value(value) {}
+    const String &name() const { return _name; }
+    const String &value() const { return _value; }
+
+private:
+    String _name;
+    String _value;
+};
+
+class AsyncWebParameter
+{
+public:
+    AsyncWebParameter(const String &name, const String &value, bool form = false)
+        : _name(name), _value(value), _isForm(form) {}
+    const String &name() const { return _name; }
+    const String &value() const { return _value; }
+    bool isPost() const { return _isForm; }
+    bool isFile() const { return false; }
+
+private:
+    String _name;
+    String _value;
+    bool _isForm;
+};
+
+// --- Ответы ---
+
+class AsyncWebServerResponse
+{
+public:
+    AsyncWebServerResponse() {}
+    virtual ~AsyncWebServerResponse() {}
+    void setCode(int code) { _code = code; }
+    void setContentLength(size_t len) { _contentLength = len; }
+    void setContentType(const String &type) { _contentType = type; }
+    void addHeader(const String &name, const String &value) { _headers.emplace_back(name, value); }
+
+    // Симулятор "отправляет" ответ, выкачивая его через _simFill до возврата 0.
+    virtual size_t _simFill(uint8_t *data, size_t maxLen, size_t index) = 0;
+
+    int _code = 200;
+    String _contentType;
+    size_t _contentLength = 0;
+    bool _chunked = false;
+    std::vector<AsyncWebHeader> _headers;
+};
+
+class AsyncBasicResponse : public AsyncWebServerResponse
+{
+public:
+    AsyncBasicResponse(int code, const String &contentType = String(), const String &content = String());
+    size_t _simFill(uint8_t *data, size_t maxLen, size_t index) override;
+
+private:
+    String _content;
+};
+
+class AsyncProgmemResponse : public AsyncWebServerResponse
+{
+public:
+    AsyncProgmemResponse(int code, const String &contentType, const uint8_t *content, size_t len);
+    size_t _simFill(uint8_t *data, size_t maxLen, size_t index) override;
+
+private:
+    const uint8_t *_content;
+};
+
+class AsyncCallbackResponse : public AsyncWebServerResponse
+{
+public:
+    AsyncCallbackResponse(const String &contentType, size_t len, AwsResponseFiller callback);
+    size_t _simFill(uint8_t *data, size_t maxLen, size_t index) override;
+
+private:
+    AwsResponseFiller _content;
+};
+
+class AsyncChunkedResponse : public AsyncWebServerResponse
+{
+public:
+    AsyncChunkedResponse(const String &contentType, AwsResponseFiller callback);
+    size_t _simFill(uint8_t *data, size_t maxLen, size_t index) override;
+
+private:
+    AwsResponseFiller _content;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print
+{
+public:
+    AsyncResponseStream(const String &contentType, size_t bufferSize);
+    size_t _simFill(uint8_t *data, size_t maxLen, size_t index) override;
+    size_t write(const uint8_t *data, size_t len) override;
+    size_t write(uint8_t data) override;
+    using Print::write;
+
+private:
+    std::string _content;
+};
+
+// --- Запрос ---
+
+class AsyncWebServerRequest
+{
+public:
+    AsyncWebServerRequest(WebRequestMethod method, const String &url);
+    ~AsyncWebServerRequest();
+
+    AsyncClient *client() { return &_client; }
+    WebRequestMethodComposite method() const { return _method; }
+    const String &url() const { return _url; }
+    const char *methodToString() const;
+
+    void send(AsyncWebServerResponse *response);
+    void send(int code, const String &contentType = String(), const String &content = String());
+    void send_P(int code, const String &contentType, const uint8_t *content, size_t len,
+                AwsTemplateProcessor callback = nullptr);
+    void send_P(int code, const String &contentType, const char *content, AwsTemplateProcessor callback = nullptr);
+
+    AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(),
+                                          const String &content = String());
+    AsyncWebServerResponse *beginResponse(const String &contentType, size_t len, AwsResponseFiller callback,
+                                          AwsTemplateProcessor templateCallback = nullptr);
+    AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller callback,
+                                                 AwsTemplateProcessor templateCallback = nullptr);
+    AsyncWebServerResponse *beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len,
+                                            AwsTemplateProcessor callback = nullptr);
+    AsyncResponseStream *beginResponseStream(const String &contentType, size_t bufferSize = 1460);
+
+    void onDisconnect(ArDisconnectHandler fn) { _onDisconnectfn = fn; }
+
+    // Симулятор хранит все заголовки запроса
+    void addInterestingHeader(const String &name) { (void)name; }
+    size_t headers() const { return _headers.size(); }
+    bool hasHeader(const String &name) const;
+    AsyncWebHeader *getHeader(const String &name) const;
+    size_t params() const { return _params.size(); }
+    bool hasParam(const String &name, bool post = false, bool file = false) const;
+    AsyncWebParameter *getParam(const String &name, bool post = false, bool file = false) const;
+    AsyncWebParameter *getParam(size_t num) const;
+    const String &arg(const String &name) const;
+    bool hasArg(const char *name) const;
+
+    void *_tempObject = nullptr;
+
+    // Внутреннее API симулятора.
+    std::vector<AsyncWebHeader *> _headers;
+    std::vector<AsyncWebParameter *> _params;
+    AsyncWebServerResponse *_response = nullptr;
+    ArDisconnectHandler _onDisconnectfn;
+    AsyncClient _client;
+
+private:
+    WebRequestMethod _method;
+    String _url;
+};
+
+// --- Обработчики ---
+
+class AsyncWebHandler
+{
+public:
+    virtual ~AsyncWebHandler() {}
+    virtual bool canHandle(AsyncWebServerRequest *request) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest *request) {}
+    virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {}
+    virtual bool isRequestHandlerTrivial() { return true; }
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler
+{
+public:
+    AsyncCallbackWebHandler(const String &uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                            ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody)
+        : _uri(uri), _method(method), _onRequest(onRequest), _onUpload(onUpload), _onBody(onBody) {}
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+    void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override;
+
+private:
+    String _uri;
+    WebRequestMethodComposite _method;
+    ArRequestHandlerFunction _onRequest;
+    ArUploadHandlerFunction _onUpload;
+    ArBodyHandlerFunction _onBody;
+};
+
+class AsyncStaticWebHandler : public AsyncWebHandler
+{
+public:
+    AsyncStaticWebHandler(const char *uri, fs::FS &fs, const char *path, const char *cache_control)
+        : _fs(fs), _uri(uri), _path(path), _cache_control(cache_control ? cache_control : "") {}
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+    AsyncStaticWebHandler &setDefaultFile(const char *filename)
+    {
+        _default_file = filename;
+        return *this;
+    }
+    AsyncStaticWebHandler &setCacheControl(const char *cache_control)
+    {
+        _cache_control = cache_control;
+        return *this;
+    }
+
+private:
+    fs::FS &_fs;
+    String _uri;
+    String _path;
+    String _default_file = "index.htm";
+    String _cache_control;
+};
+
+// --- WebSocket ---
+
+typedef enum
+{
+    WS_EVT_CONNECT,
+    WS_EVT_DISCONNECT,
+    WS_EVT_PONG,
+    WS_EVT_ERROR,
+    WS_EVT_DATA
+} AwsEventType;
+
+typedef enum
+{
+    WS_CONTINUATION,
+    WS_TEXT,
+    WS_BINARY,
+    WS_DISCONNECT = 0x08,
+    WS_PING,
+    WS_PONG
+} AwsFrameType;
+
+typedef enum
+{
+    WS_DISCONNECTED,
+    WS_CONNECTED,
+    WS_DISCONNECTING
+} AwsClientStatus;
+
+typedef struct
+{
+    uint8_t message_opcode;
+    uint32_t num;
+    uint8_t final;
+    uint8_t masked;
+    uint8_t opcode;
+    uint64_t len;
+    uint8_t mask[4];
+    uint64_t index;
+} AwsFrameInfo;
+
+#define WS_MAX_QUEUED_MESSAGES 32
+#define DEFAULT_MAX_WS_CLIENTS 8
+
+class AsyncWebSocketMessageBuffer
+{
+public:
+    AsyncWebSocketMessageBuffer(size_t size) : _data(size) {}
+    AsyncWebSocketMessageBuffer(uint8_t *data, size_t size) : _data(data, data + size) {}
+    void operator++(int) { _count++; }
+    void operator--(int)
+    {
+        if (_count > 0)
+            _count--;
+    }
+    void lock() { _lock = true; }
+    void unlock() { _lock = false; }
+    uint8_t *get() { return _data.data(); }
+    size_t length() { return _data.size(); }
+    uint32_t count() { return _count; }
+    bool canDelete() { return (!_count && !_lock); }
+
+private:
+    std::vector<uint8_t> _data;
+    bool _lock = false;
+    uint32_t _count = 0;
+};
+
+typedef std::function<void(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg,
+                           uint8_t *data, size_t len)>
+    AwsEventHandler;
+
+class AsyncWebSocketClient
+{
+public:
+    AsyncWebSocketClient(AsyncWebSocket *server, uint32_t id, uint32_t link_bytes_per_s);
+    ~AsyncWebSocketClient();
+
+    uint32_t id() const { return _clientId; }
+    AwsClientStatus status() const { return _status; }
+    IPAddress remoteIP() const { return IPAddress(192, 168, 4, (uint8_t)(1 + _clientId)); }
+    uint16_t remotePort() const { return 50000 + _clientId; }
+    AsyncWebSocket *server() { return _server; }
+
+    void close(uint16_t code = 0, const char *message = NULL);
+    void ping(uint8_t *data = NULL, size_t len = 0) {}
+    void keepAlivePeriod(uint16_t seconds) {}
+
+    size_t queueLen();
+    bool queueIsFull();
+    bool canSend();
+
+    void text(const char *message, size_t len);
+    void text(const char *message) { text(message, strlen(message)); }
+    void text(const String &message) { text(message.c_str(), message.length()); }
+    void text(AsyncWebSocketMessageBuffer *buffer);
+    void binary(const char *message, size_t len);
+    void binary(const uint8_t *message, size_t len) { binary((const char *)message, len); }
+    void binary(AsyncWebSocketMessageBuffer *buffer);
+
+    void *_tempObject = nullptr;
+
+    // Внутреннее API симулятора.
+    AwsClientStatus _status = WS_CONNECTED;
+    void _simQueue(size_t len, AsyncWebSocketMessageBuffer *buffer);
+    void _simDrain();
+
+private:
+    struct Pending
+    {
+        size_t remaining;
+        size_t length;
+        AsyncWebSocketMessageBuffer *buffer;
+    };
+    AsyncWebSocket *_server;
+    uint32_t _clientId;
+    uint32_t _rate;
+    unsigned long _last_drain_us;
+    std::deque<Pending> _queue;
+};
+
+class AsyncWebSocket : public AsyncWebHandler
+{
+public:
+    explicit AsyncWebSocket(const String &url);
+    ~AsyncWebSocket();
+
+    const char *url() const { return _url.c_str(); }
+    void onEvent(AwsEventHandler handler) { _eventHandler = handler; }
+
+    size_t count() const;
+    AsyncWebSocketClient *client(uint32_t id);
+    bool hasClient(uint32_t id) { return client(id) != NULL; }
+    std::list<AsyncWebSocketClient *> &getClients() { return _clients; }
+
+    void close(uint32_t id, uint16_t code = 0, const char *message = NULL);
+    void closeAll(uint16_t code = 0, const char *message = NULL);
+    void cleanupClients(uint16_t maxClients = DEFAULT_MAX_WS_CLIENTS);
+
+    bool availableForWrite(uint32_t id);
+    bool availableForWriteAll();
+
+    void text(uint32_t id, const char *message, size_t len);
+    void textAll(const char *message, size_t len);
+    void textAll(const char *message) { textAll(message, strlen(message)); }
+    void textAll(const String &message) { textAll(message.c_str(), message.length()); }
+    void textAll(AsyncWebSocketMessageBuffer *buffer);
+    void binary(uint32_t id, const char *message, size_t len);
+    void binaryAll(const char *message, size_t len);
+    void binaryAll(const uint8_t *message, size_t len) { binaryAll((const char *)message, len); }
+    void binaryAll(AsyncWebSocketMessageBuffer *buffer);
+
+    AsyncWebSocketMessageBuffer *makeBuffer(size_t size = 0);
+    AsyncWebSocketMessageBuffer *makeBuffer(uint8_t *data, size_t size);
+    void _cleanBuffers();
+
+    // Внутреннее API симулятора: подключение/отключение виртуальных клиентов и входящие сообщения.
+    AsyncWebSocketClient *_simConnect(uint32_t link_bytes_per_s);
+    void _simDisconnect(AsyncWebSocketClient *client);
+    void _simReceive(AsyncWebSocketClient *client, const uint8_t *data, size_t len, bool binary);
+    std::recursive_mutex _lock;
+
+private:
+    void _fanOut(const char *message, size_t len, bool binary);
+
+    String _url;
+    AwsEventHandler _eventHandler;
+    std::list<AsyncWebSocketClient *> _clients;
+    std::list<AsyncWebSocketMessageBuffer *> _buffers;
+    uint32_t _cNextId = 1;
+};
+
+// --- Сервер ---
+
+class AsyncWebServer
+{
+public:
+    explicit AsyncWebServer(uint16_t port);
+    ~AsyncWebServer();
+
+    void begin();
+    void end() {}
+
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler);
+    bool removeHandler(AsyncWebHandler *handler);
+
+    AsyncCallbackWebHandler &on(const char *uri, ArRequestHandlerFunction onRequest);
+    AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+    AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction onUpload);
+    AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody);
+
+    AsyncStaticWebHandler &serveStatic(const char *uri, fs::FS &fs, const char *path,
+                                       const char *cache_control = NULL);
+
+    void onNotFound(ArRequestHandlerFunction fn) { _notFound = fn; }
+
+    // Внутреннее API симулятора: выполнить запрос и вывести ответ.
+    void _simRequest(WebRequestMethod method, const String &url, const String &body,
+                     const std::vector<AsyncWebHeader> &headers = std::vector<AsyncWebHeader>());
+
+private:
+    uint16_t _port;
+    std::list<AsyncWebHandler *> _handlers;
+    ArRequestHandlerFunction _notFound;
+};
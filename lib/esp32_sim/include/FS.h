@@ -0,0 +1,69 @@
+#pragma once
+// Файловая система хранится в обычном каталоге хоста (SIM_FS_DIR, по умолчанию sim/fs).
+#include <memory>
+#include "Arduino.h"
+
+namespace fs
+{
+    enum SeekMode
+    {
+        SeekSet = 0,
+        SeekCur = 1,
+        SeekEnd = 2
+    };
+
+    struct FileImpl;
+
+    class File : public Stream
+    {
+    public:
+        File() {}
+        explicit File(std::shared_ptr<FileImpl> impl) : impl_(impl) {}
+
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t *buf, size_t size) override;
+        using Print::write;
+        int available() override;
+        int read() override;
+        int peek() override;
+        void flush() override;
+        size_t read(uint8_t *buf, size_t size);
+        size_t readBytes(char *buffer, size_t length) override { return read((uint8_t *)buffer, length); }
+        bool seek(uint32_t pos, SeekMode mode = SeekSet);
+        size_t position() const;
+        size_t size() const;
+        void close();
+        operator bool() const;
+        const char *name() const;
+        const char *path() const;
+        bool isDirectory(void);
+
+    private:
+        std::shared_ptr<FileImpl> impl_;
+    };
+
+    class FS
+    {
+    public:
+        File open(const char *path, const char *mode = "r", const bool create = false);
+        File open(const String &path, const char *mode = "r", const bool create = false)
+        {
+            return open(path.c_str(), mode, create);
+        }
+        bool exists(const char *path);
+        bool exists(const String &path) { return exists(path.c_str()); }
+        bool remove(const char *path);
+        bool remove(const String &path) { return remove(path.c_str()); }
+        bool rename(const char *pathFrom, const char *pathTo);
+        bool rename(const String &pathFrom, const String &pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+        bool mkdir(const char *path);
+        bool rmdir(const char *path);
+    };
+}
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
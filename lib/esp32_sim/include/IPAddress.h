@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include "Print.h"
+
+class IPAddress : public Printable
+{
+public:
+    IPAddress() : addr_{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr_{a, b, c, d} {}
+
+    uint8_t operator[](int index) const { return addr_[index]; }
+    operator uint32_t() const
+    {
+        return (uint32_t)addr_[0] | ((uint32_t)addr_[1] << 8) | ((uint32_t)addr_[2] << 16) | ((uint32_t)addr_[3] << 24);
+    }
+
+    String toString() const
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", addr_[0], addr_[1], addr_[2], addr_[3]);
+        return String(buf);
+    }
+
+    size_t printTo(Print &p) const override { return p.print(toString()); }
+
+private:
+    uint8_t addr_[4];
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Arduino String поверх std::string - только то, что используется прошивкой и ArduinoJson.
+class String
+{
+public:
+    String() {}
+    String(const char *cstr) : s_(cstr ? cstr : "") {}
+    String(const char *cstr, size_t len) : s_(cstr ? std::string(cstr, len) : std::string()) {}
+    String(const std::string &str) : s_(str) {}
+    String(const String &other) = default;
+    String(String &&other) = default;
+    explicit String(char c) : s_(1, c) {}
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimalPlaces = 2);
+    explicit String(double value, unsigned int decimalPlaces = 2);
+
+    String &operator=(const String &rhs) = default;
+    String &operator=(String &&rhs) = default;
+    String &operator=(const char *cstr)
+    {
+        s_ = cstr ? cstr : "";
+        return *this;
+    }
+
+    bool reserve(unsigned int size)
+    {
+        s_.reserve(size);
+        return true;
+    }
+    unsigned int length() const { return (unsigned int)s_.size(); }
+    bool isEmpty() const { return s_.empty(); }
+    const char *c_str() const { return s_.c_str(); }
+    char *begin() { return &s_[0]; }
+    char *end() { return &s_[0] + s_.size(); }
+
+    bool concat(const String &str)
+    {
+        s_ += str.s_;
+        return true;
+    }
+    bool concat(const char *cstr)
+    {
+        if (!cstr)
+            return false;
+        s_ += cstr;
+        return true;
+    }
+    bool concat(const char *cstr, unsigned int length)
+    {
+        if (!cstr)
+            return false;
+        s_.append(cstr, length);
+        return true;
+    }
+    bool concat(char c)
+    {
+        s_ += c;
+        return true;
+    }
+    bool concat(int num) { return concat(String(num)); }
+    bool concat(unsigned int num) { return concat(String(num)); }
+    bool concat(long num) { return concat(String(num)); }
+    bool concat(unsigned long num) { return concat(String(num)); }
+    bool concat(double num) { return concat(String(num)); }
+
+    template <typename T>
+    String &operator+=(const T &rhs)
+    {
+        concat(rhs);
+        return *this;
+    }
+
+    friend String operator+(const String &lhs, const String &rhs) { return String(lhs.s_ + rhs.s_); }
+    friend String operator+(const String &lhs, const char *rhs) { return String(lhs.s_ + (rhs ? rhs : "")); }
+    friend String operator+(const char *lhs, const String &rhs) { return String((lhs ? lhs : "") + rhs.s_); }
+
+    bool equals(const String &s) const { return s_ == s.s_; }
+    bool equals(const char *cstr) const { return s_ == (cstr ? cstr : ""); }
+    bool operator==(const String &rhs) const { return equals(rhs); }
+    bool operator==(const char *cstr) const { return equals(cstr); }
+    bool operator!=(const String &rhs) const { return !equals(rhs); }
+    bool operator!=(const char *cstr) const { return !equals(cstr); }
+    bool operator<(const String &rhs) const { return s_ < rhs.s_; }
+    bool equalsIgnoreCase(const String &s) const;
+    bool startsWith(const String &prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+    bool endsWith(const String &suffix) const
+    {
+        return s_.size() >= suffix.s_.size() &&
+               s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0;
+    }
+
+    char charAt(unsigned int index) const { return index < s_.size() ? s_[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char &operator[](unsigned int index) { return s_[index]; }
+
+    int indexOf(char ch, unsigned int fromIndex = 0) const
+    {
+        size_t pos = s_.find(ch, fromIndex);
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+    int indexOf(const String &str, unsigned int fromIndex = 0) const
+    {
+        size_t pos = s_.find(str.s_, fromIndex);
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+    int lastIndexOf(char ch) const
+    {
+        size_t pos = s_.rfind(ch);
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+    String substring(unsigned int beginIndex) const
+    {
+        return beginIndex < s_.size() ? String(s_.substr(beginIndex)) : String();
+    }
+    String substring(unsigned int beginIndex, unsigned int endIndex) const
+    {
+        if (beginIndex >= s_.size() || endIndex <= beginIndex)
+            return String();
+        return String(s_.substr(beginIndex, endIndex - beginIndex));
+    }
+
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+    long toInt() const;
+    float toFloat() const;
+
+private:
+    std::string s_;
+};
+
+class __FlashStringHelper;
+#define F(string_literal) (string_literal)
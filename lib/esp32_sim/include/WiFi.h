@@ -0,0 +1,48 @@
+#pragma once
+#include "Arduino.h"
+
+typedef enum
+{
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+#define WIFI_AP WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
+
+typedef enum
+{
+    ARDUINO_EVENT_WIFI_AP_STACONNECTED,
+    ARDUINO_EVENT_WIFI_AP_STADISCONNECTED,
+    ARDUINO_EVENT_MAX,
+} arduino_event_id_t;
+
+typedef void (*WiFiEventCb)(arduino_event_id_t event);
+typedef size_t wifi_event_id_t;
+
+class WiFiClass
+{
+public:
+    bool mode(wifi_mode_t m);
+    wifi_mode_t getMode() { return mode_; }
+    bool softAP(const char *ssid, const char *passphrase = NULL, int channel = 1, int ssid_hidden = 0,
+                int max_connection = 4);
+    bool softAPdisconnect(bool wifioff = false);
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+    uint8_t softAPgetStationNum() { return stations_; }
+    // event = ARDUINO_EVENT_MAX - все события
+    wifi_event_id_t onEvent(WiFiEventCb cbEvent, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+
+    // Симуляция: подключение и отключение станций точки доступа
+    void _simSetStations(int count);
+
+private:
+    wifi_mode_t mode_ = WIFI_MODE_NULL;
+    uint8_t stations_ = 0;
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,68 @@
+#pragma once
+// Подмена legacy-драйвера MCPWM (IDF 4.4): только захват фронтов. Модель - в sim_gpio.cpp,
+// значение захвата берётся из расписания эха, а не из момента вызова ISR.
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef enum
+{
+    MCPWM_UNIT_0 = 0,
+    MCPWM_UNIT_1,
+    MCPWM_UNIT_MAX,
+} mcpwm_unit_t;
+
+typedef enum
+{
+    MCPWM0A = 0,
+    MCPWM0B,
+    MCPWM1A,
+    MCPWM1B,
+    MCPWM2A,
+    MCPWM2B,
+    MCPWM_SYNC_0,
+    MCPWM_SYNC_1,
+    MCPWM_SYNC_2,
+    MCPWM_FAULT_0,
+    MCPWM_FAULT_1,
+    MCPWM_FAULT_2,
+    MCPWM_CAP_0 = 84,
+    MCPWM_CAP_1,
+    MCPWM_CAP_2,
+} mcpwm_io_signals_t;
+
+typedef enum
+{
+    MCPWM_SELECT_CAP0 = 0,
+    MCPWM_SELECT_CAP1,
+    MCPWM_SELECT_CAP2,
+} mcpwm_capture_channel_id_t;
+
+typedef enum
+{
+    MCPWM_NEG_EDGE = (1 << 0),
+    MCPWM_POS_EDGE = (1 << 1),
+    MCPWM_BOTH_EDGE = (1 << 1) | (1 << 0),
+} mcpwm_capture_on_edge_t;
+
+typedef struct
+{
+    mcpwm_capture_on_edge_t cap_edge;
+    uint32_t cap_value; // Такты APB (80 МГц)
+} cap_event_data_t;
+
+typedef bool (*cap_isr_cb_t)(mcpwm_unit_t mcpwm, mcpwm_capture_channel_id_t cap_channel, const cap_event_data_t *edata,
+                             void *user_data);
+
+typedef struct
+{
+    mcpwm_capture_on_edge_t cap_edge;
+    uint32_t cap_prescale;
+    cap_isr_cb_t capture_cb;
+    void *user_data;
+} mcpwm_capture_config_t;
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t mcpwm_num, mcpwm_io_signals_t io_signal, int gpio_num);
+esp_err_t mcpwm_capture_enable_channel(mcpwm_unit_t mcpwm_num, mcpwm_capture_channel_id_t cap_channel,
+                                       const mcpwm_capture_config_t *cap_conf);
+esp_err_t mcpwm_capture_disable_channel(mcpwm_unit_t mcpwm_num, mcpwm_capture_channel_id_t cap_channel);
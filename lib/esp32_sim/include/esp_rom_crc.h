@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// CRC32 (полином 0xEDB88320) как в ROM ESP32: esp_rom_crc32_le(0, buf, len) - стандартный CRC-32.
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+// Микросекунды от запуска.
+int64_t esp_timer_get_time(void);
+
+// Программные таймеры: обратные вызовы выполняются по очереди в одном потоке "esp_timer",
+// как в задаче esp_timer ESP-IDF (ESP_TIMER_TASK).
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum
+{
+    ESP_TIMER_TASK,
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle);
+// ESP_ERR_INVALID_STATE - таймер уже запущен
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period);
+// ESP_ERR_INVALID_STATE - таймер не запущен. Уже начатый обратный вызов не ждёт.
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
@@ -0,0 +1,16 @@
+#pragma once
+// Подмена lwIP: из PCB соединения нужен только обработчик опроса, который AsyncTCP
+// регистрирует через tcp_poll().
+#include <stdint.h>
+
+typedef int8_t err_t;
+#define ERR_OK 0
+
+struct tcp_pcb;
+typedef err_t (*tcp_poll_fn)(void *arg, struct tcp_pcb *tpcb);
+
+struct tcp_pcb
+{
+    tcp_poll_fn poll;
+    void *callback_arg;
+};
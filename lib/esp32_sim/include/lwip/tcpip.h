@@ -0,0 +1,8 @@
+#pragma once
+// Подмена lwIP: потока tcpip в симуляторе нет, функция выполняется сразу,
+// по одной за раз - как в потоке tcpip.
+#include "lwip/tcp.h"
+
+typedef void (*tcpip_callback_fn)(void *ctx);
+
+err_t tcpip_try_callback(tcpip_callback_fn function, void *ctx);
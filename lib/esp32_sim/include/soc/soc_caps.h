@@ -0,0 +1,5 @@
+#pragma once
+// Возможности ESP32-S3, которые проверяет прошивка.
+#define SOC_MCPWM_SUPPORTED 1
+#define SOC_MCPWM_GROUPS 2
+#define SOC_MCPWM_CAPTURE_CHANNELS_PER_TIMER 3
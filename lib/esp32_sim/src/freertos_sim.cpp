@@ -0,0 +1,670 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "sim_internal.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --- Задачи ---
+
+struct tskTaskControlBlock
+{
+    std::string name;
+    UBaseType_t priority;
+    BaseType_t core;
+    uint32_t stack_depth;
+    TaskFunction_t fn;
+    void *param;
+    UBaseType_t number;
+    pthread_t thread;
+    bool running = false; // Поток запущен и ещё не завершился (под g_tasks_mutex)
+
+    std::mutex notify_mutex;
+    std::condition_variable notify_cv;
+    uint32_t notify_value = 0;
+    bool notify_pending = false;
+};
+
+namespace
+{
+    struct TaskExit
+    {
+    };
+
+    thread_local tskTaskControlBlock *t_current_task = nullptr;
+
+    std::mutex g_tasks_mutex;
+    std::vector<tskTaskControlBlock *> g_tasks;
+    UBaseType_t g_task_number = 0;
+
+    // Ожидание с таймаутом в тиках; portMAX_DELAY - бесконечно.
+    template <typename Lock, typename Pred>
+    bool wait_ticks(std::condition_variable &cv, Lock &lock, TickType_t ticks, Pred pred)
+    {
+        if (ticks == portMAX_DELAY)
+        {
+            cv.wait(lock, pred);
+            return true;
+        }
+        return cv.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pred);
+    }
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *const pcName, const uint32_t usStackDepth,
+                                   void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pvCreatedTask,
+                                   const BaseType_t xCoreID)
+{
+    tskTaskControlBlock *tcb = new tskTaskControlBlock();
+    tcb->name = pcName ? pcName : "";
+    tcb->priority = uxPriority;
+    tcb->core = xCoreID;
+    tcb->stack_depth = usStackDepth;
+    tcb->fn = pvTaskCode;
+    tcb->param = pvParameters;
+
+    {
+        std::lock_guard<std::mutex> lock(g_tasks_mutex);
+        tcb->number = ++g_task_number;
+        g_tasks.push_back(tcb);
+    }
+    if (pvCreatedTask)
+    {
+        *pvCreatedTask = tcb;
+    }
+
+    std::thread([tcb]() {
+        t_current_task = tcb;
+        sim_set_thread_name(tcb->name.c_str());
+        {
+            std::lock_guard<std::mutex> lock(g_tasks_mutex);
+            tcb->thread = pthread_self();
+            tcb->running = true;
+        }
+        try
+        {
+            tcb->fn(tcb->param);
+        }
+        catch (const TaskExit &)
+        {
+        }
+        std::lock_guard<std::mutex> lock(g_tasks_mutex);
+        tcb->running = false;
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *const pcName, const uint32_t usStackDepth,
+                       void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pvCreatedTask)
+{
+    return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pvCreatedTask,
+                                   tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    // Поток хоста нельзя безопасно убить снаружи, поддерживается только удаление самого себя.
+    if (xTaskToDelete == NULL || xTaskToDelete == t_current_task)
+    {
+        throw TaskExit();
+    }
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    SimCacheGate gate;
+    std::this_thread::sleep_for(std::chrono::milliseconds(xTicksToDelay * portTICK_PERIOD_MS));
+}
+
+void vTaskDelayUntil(TickType_t *const pxPreviousWakeTime, const TickType_t xTimeIncrement)
+{
+    TickType_t wake = *pxPreviousWakeTime + xTimeIncrement;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(wake - now) > 0)
+    {
+        vTaskDelay(wake - now);
+    }
+    *pxPreviousWakeTime = wake;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(sim_micros() / 1000);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return t_current_task;
+}
+
+char *pcTaskGetName(TaskHandle_t xTaskToQuery)
+{
+    tskTaskControlBlock *tcb = xTaskToQuery ? xTaskToQuery : t_current_task;
+    static char main_name[] = "main";
+    return tcb ? &tcb->name[0] : main_name;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask)
+{
+    tskTaskControlBlock *tcb = xTask ? xTask : t_current_task;
+    return tcb ? tcb->priority : 1;
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t xTask)
+{
+    tskTaskControlBlock *tcb = xTask ? xTask : t_current_task;
+    return tcb ? tcb->core : tskNO_AFFINITY;
+}
+
+void taskYIELD(void)
+{
+    std::this_thread::yield();
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    std::lock_guard<std::mutex> lock(g_tasks_mutex);
+    UBaseType_t n = 0;
+    for (tskTaskControlBlock *tcb : g_tasks)
+    {
+        n += tcb->running ? 1 : 0;
+    }
+    return n;
+}
+
+// Время задачи - процессорное время её потока хоста. Глубина стека в симуляции не
+// измеряется: запас всегда равен выделенному размеру.
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *const pxTaskStatusArray, const UBaseType_t uxArraySize,
+                                 uint32_t *const pulTotalRunTime)
+{
+    std::lock_guard<std::mutex> lock(g_tasks_mutex);
+    UBaseType_t n = 0;
+    for (tskTaskControlBlock *tcb : g_tasks)
+    {
+        if (!tcb->running)
+        {
+            continue;
+        }
+        if (n == uxArraySize)
+        {
+            return 0; // Как в FreeRTOS: массив мал - ничего не заполняется
+        }
+        uint64_t cpu_us = 0;
+        clockid_t clock;
+        struct timespec ts;
+        if (pthread_getcpuclockid(tcb->thread, &clock) == 0 && clock_gettime(clock, &ts) == 0)
+        {
+            cpu_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+        }
+        TaskStatus_t &st = pxTaskStatusArray[n++];
+        st.xHandle = tcb;
+        st.pcTaskName = tcb->name.c_str();
+        st.xTaskNumber = tcb->number;
+        st.eCurrentState = tcb == t_current_task ? eRunning : eBlocked;
+        st.uxCurrentPriority = tcb->priority;
+        st.uxBasePriority = tcb->priority;
+        st.ulRunTimeCounter = (uint32_t)cpu_us;
+        st.pxStackBase = NULL;
+        st.usStackHighWaterMark = tcb->stack_depth;
+        st.xCoreID = tcb->core;
+    }
+    if (pulTotalRunTime)
+    {
+        *pulTotalRunTime = (uint32_t)sim_micros();
+    }
+    return n;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+    tskTaskControlBlock *tcb = xTask ? xTask : t_current_task;
+    return tcb ? tcb->stack_depth : 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    SimCacheGate gate;
+    tskTaskControlBlock *tcb = t_current_task;
+    if (!tcb)
+    {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(tcb->notify_mutex);
+    wait_ticks(tcb->notify_cv, lock, xTicksToWait, [tcb] { return tcb->notify_value != 0; });
+    uint32_t value = tcb->notify_value;
+    if (value != 0)
+    {
+        tcb->notify_value = xClearCountOnExit ? 0 : value - 1;
+    }
+    tcb->notify_pending = false;
+    return value;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction)
+{
+    if (!xTaskToNotify)
+    {
+        return pdFAIL;
+    }
+    std::lock_guard<std::mutex> lock(xTaskToNotify->notify_mutex);
+    switch (eAction)
+    {
+    case eSetBits:
+        xTaskToNotify->notify_value |= ulValue;
+        break;
+    case eIncrement:
+        xTaskToNotify->notify_value++;
+        break;
+    case eSetValueWithOverwrite:
+        xTaskToNotify->notify_value = ulValue;
+        break;
+    case eSetValueWithoutOverwrite:
+        if (xTaskToNotify->notify_pending)
+        {
+            return pdFAIL;
+        }
+        xTaskToNotify->notify_value = ulValue;
+        break;
+    case eNoAction:
+        break;
+    }
+    xTaskToNotify->notify_pending = true;
+    xTaskToNotify->notify_cv.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    return xTaskNotify(xTaskToNotify, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    xTaskNotify(xTaskToNotify, 0, eIncrement);
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction,
+                              BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+    return xTaskNotify(xTaskToNotify, ulValue, eAction);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t *pulNotificationValue,
+                           TickType_t xTicksToWait)
+{
+    SimCacheGate gate;
+    tskTaskControlBlock *tcb = t_current_task;
+    if (!tcb)
+    {
+        return pdFAIL;
+    }
+    std::unique_lock<std::mutex> lock(tcb->notify_mutex);
+    if (!tcb->notify_pending)
+    {
+        tcb->notify_value &= ~ulBitsToClearOnEntry;
+    }
+    bool got = wait_ticks(tcb->notify_cv, lock, xTicksToWait, [tcb] { return tcb->notify_pending; });
+    if (pulNotificationValue)
+    {
+        *pulNotificationValue = tcb->notify_value;
+    }
+    if (!got)
+    {
+        return pdFAIL;
+    }
+    tcb->notify_value &= ~ulBitsToClearOnExit;
+    tcb->notify_pending = false;
+    return pdPASS;
+}
+
+// --- Очереди и семафоры ---
+
+struct QueueDefinition
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    std::deque<std::vector<uint8_t>> items;
+
+    // Рекурсивный мьютекс: владелец и глубина захвата.
+    tskTaskControlBlock *owner = nullptr;
+    std::thread::id owner_thread;
+    UBaseType_t recursion = 0;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    QueueDefinition *q = new QueueDefinition();
+    q->length = uxQueueLength;
+    q->item_size = uxItemSize;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    delete xQueue;
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+    SimCacheGate gate;
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!wait_ticks(q->cv, lock, ticks, [q] { return q->items.size() < q->length; }))
+    {
+        return errQUEUE_FULL;
+    }
+    std::vector<uint8_t> data(q->item_size);
+    if (q->item_size && item)
+    {
+        memcpy(data.data(), item, q->item_size);
+    }
+    if (front)
+    {
+        q->items.push_front(std::move(data));
+    }
+    else
+    {
+        q->items.push_back(std::move(data));
+    }
+    q->cv.notify_all();
+    return pdPASS;
+}
+
+static BaseType_t queue_receive(QueueHandle_t q, void *buffer, TickType_t ticks, bool peek)
+{
+    SimCacheGate gate;
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!wait_ticks(q->cv, lock, ticks, [q] { return !q->items.empty(); }))
+    {
+        return errQUEUE_EMPTY;
+    }
+    if (q->item_size && buffer)
+    {
+        memcpy(buffer, q->items.front().data(), q->item_size);
+    }
+    if (!peek)
+    {
+        q->items.pop_front();
+        q->cv.notify_all();
+    }
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return queue_send(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return queue_send(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    return queue_send(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+    return queue_send(xQueue, pvItemToQueue, 0, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void *pvItemToQueue)
+{
+    {
+        std::lock_guard<std::mutex> lock(xQueue->mutex);
+        xQueue->items.clear();
+    }
+    return queue_send(xQueue, pvItemToQueue, 0, false);
+}
+
+BaseType_t xQueueOverwriteFromISR(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+    return xQueueOverwrite(xQueue, pvItemToQueue);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return queue_receive(xQueue, pvBuffer, xTicksToWait, false);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void *pvBuffer, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return queue_receive(xQueue, pvBuffer, 0, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return queue_receive(xQueue, pvBuffer, xTicksToWait, true);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    std::lock_guard<std::mutex> lock(xQueue->mutex);
+    return xQueue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue)
+{
+    std::lock_guard<std::mutex> lock(xQueue->mutex);
+    return xQueue->length - xQueue->items.size();
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue)
+{
+    std::lock_guard<std::mutex> lock(xQueue->mutex);
+    xQueue->items.clear();
+    xQueue->cv.notify_all();
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t s = xQueueCreate(1, 0);
+    xSemaphoreGive(s);
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    SemaphoreHandle_t s = xQueueCreate(uxMaxCount, 0);
+    for (UBaseType_t i = 0; i < uxInitialCount; ++i)
+    {
+        xSemaphoreGive(s);
+    }
+    return s;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+    vQueueDelete(xSemaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    return queue_receive(xSemaphore, NULL, xBlockTime, false);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    return queue_send(xSemaphore, NULL, 0, false);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t xMutex, TickType_t xBlockTime)
+{
+    {
+        std::lock_guard<std::mutex> lock(xMutex->mutex);
+        if (xMutex->recursion > 0 && xMutex->owner_thread == std::this_thread::get_id())
+        {
+            xMutex->recursion++;
+            return pdPASS;
+        }
+    }
+    if (xSemaphoreTake(xMutex, xBlockTime) != pdPASS)
+    {
+        return pdFAIL;
+    }
+    std::lock_guard<std::mutex> lock(xMutex->mutex);
+    xMutex->owner = t_current_task;
+    xMutex->owner_thread = std::this_thread::get_id();
+    xMutex->recursion = 1;
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t xMutex)
+{
+    {
+        std::lock_guard<std::mutex> lock(xMutex->mutex);
+        if (xMutex->recursion == 0 || xMutex->owner_thread != std::this_thread::get_id())
+        {
+            return pdFAIL;
+        }
+        if (--xMutex->recursion > 0)
+        {
+            return pdPASS;
+        }
+        xMutex->owner = nullptr;
+    }
+    return xSemaphoreGive(xMutex);
+}
+
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return xSemaphoreTake(xSemaphore, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+    return xSemaphoreGive(xSemaphore);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t xSemaphore)
+{
+    return uxQueueMessagesWaiting(xSemaphore);
+}
+
+// --- Группы событий ---
+
+struct EventGroupDef_t
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return new EventGroupDef_t();
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+    delete xEventGroup;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits,
+                                TickType_t xTicksToWait)
+{
+    SimCacheGate gate;
+    std::unique_lock<std::mutex> lock(xEventGroup->mutex);
+    auto satisfied = [&] {
+        EventBits_t match = xEventGroup->bits & uxBitsToWaitFor;
+        return xWaitForAllBits ? (match == uxBitsToWaitFor) : (match != 0);
+    };
+    bool ok = wait_ticks(xEventGroup->cv, lock, xTicksToWait, satisfied);
+    EventBits_t result = xEventGroup->bits;
+    if (ok && xClearOnExit)
+    {
+        xEventGroup->bits &= ~uxBitsToWaitFor;
+    }
+    return result;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+    std::lock_guard<std::mutex> lock(xEventGroup->mutex);
+    xEventGroup->bits |= uxBitsToSet;
+    xEventGroup->cv.notify_all();
+    return xEventGroup->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+    std::lock_guard<std::mutex> lock(xEventGroup->mutex);
+    EventBits_t before = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    return before;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet,
+                                     BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+    xEventGroupSetBits(xEventGroup, uxBitsToSet);
+    return pdPASS;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup)
+{
+    std::lock_guard<std::mutex> lock(xEventGroup->mutex);
+    return xEventGroup->bits;
+}
@@ -0,0 +1,436 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "sim_internal.h"
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdarg>
+#include <malloc.h>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+
+// --- Время ---
+
+static std::atomic<uint32_t> g_cpu_mhz(240);
+
+bool setCpuFrequencyMhz(uint32_t cpu_freq_mhz)
+{
+    g_cpu_mhz = cpu_freq_mhz;
+    return true;
+}
+
+uint32_t getCpuFrequencyMhz()
+{
+    return g_cpu_mhz;
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(sim_micros() / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)sim_micros();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)sim_micros();
+}
+
+uint32_t getApbFrequency()
+{
+    return 80000000;
+}
+
+namespace
+{
+    const size_t SIM_HEAP_INTERNAL = 320 * 1024;
+    const size_t SIM_HEAP_PSRAM = 8 * 1024 * 1024;
+
+    std::mutex g_heap_mutex;
+    size_t g_heap_base = 0;
+    size_t g_heap_min_free = SIM_HEAP_INTERNAL;
+
+    size_t sim_internal_free()
+    {
+        std::lock_guard<std::mutex> lock(g_heap_mutex);
+        size_t used = mallinfo2().uordblks;
+        if (g_heap_base == 0 || used < g_heap_base)
+        {
+            g_heap_base = used;
+        }
+        size_t grown = used - g_heap_base;
+        size_t free_size = grown < SIM_HEAP_INTERNAL ? SIM_HEAP_INTERNAL - grown : 0;
+        if (free_size < g_heap_min_free)
+        {
+            g_heap_min_free = free_size;
+        }
+        return free_size;
+    }
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_total_size(uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? SIM_HEAP_PSRAM : SIM_HEAP_INTERNAL;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? SIM_HEAP_PSRAM : sim_internal_free();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    if (caps & MALLOC_CAP_SPIRAM)
+    {
+        return SIM_HEAP_PSRAM;
+    }
+    sim_internal_free();
+    std::lock_guard<std::mutex> lock(g_heap_mutex);
+    return g_heap_min_free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+esp_err_t heap_caps_register_failed_alloc_callback(esp_alloc_failed_hook_t callback)
+{
+    // Выделения в симуляции не отказывают, обработчик никогда не вызывается
+    return callback ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        crc ^= buf[i];
+        for (int k = 0; k < 8; ++k)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+void delay(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    // Короткие задержки (импульс триггера) - активное ожидание, как на железе.
+    uint64_t end = sim_micros() + us;
+    while (sim_micros() < end)
+    {
+    }
+}
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    const long dividend = out_max - out_min;
+    const long divisor = in_max - in_min;
+    const long delta = x - in_min;
+    if (divisor == 0)
+    {
+        return -1;
+    }
+    return (delta * dividend + (divisor / 2)) / divisor + out_min;
+}
+
+static std::mt19937 &rng()
+{
+    static thread_local std::mt19937 gen((unsigned)sim_env_int("SIM_SEED", 1));
+    return gen;
+}
+
+long random(long howbig)
+{
+    return howbig <= 0 ? 0 : (long)(rng()() % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig)
+{
+    return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+// --- WiFi ---
+
+bool WiFiClass::mode(wifi_mode_t m)
+{
+    mode_ = m;
+    return true;
+}
+
+bool WiFiClass::softAP(const char *ssid, const char *passphrase, int channel, int ssid_hidden, int max_connection)
+{
+    (void)ssid_hidden;
+    (void)max_connection;
+    sim_log("[Sim] softAP '%s' (pass '%s'), channel %d\n", ssid, passphrase ? passphrase : "", channel);
+    return true;
+}
+
+namespace
+{
+    struct WiFiEventHandler
+    {
+        WiFiEventCb cb;
+        arduino_event_id_t event;
+    };
+    std::mutex g_wifi_events_mutex;
+    std::vector<WiFiEventHandler> g_wifi_events;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventCb cbEvent, arduino_event_id_t event)
+{
+    std::lock_guard<std::mutex> lock(g_wifi_events_mutex);
+    g_wifi_events.push_back({cbEvent, event});
+    return g_wifi_events.size();
+}
+
+void WiFiClass::_simSetStations(int count)
+{
+    count = count < 0 ? 0 : count;
+    while (stations_ != count)
+    {
+        arduino_event_id_t event =
+            stations_ < count ? ARDUINO_EVENT_WIFI_AP_STACONNECTED : ARDUINO_EVENT_WIFI_AP_STADISCONNECTED;
+        stations_ += stations_ < count ? 1 : -1;
+        std::vector<WiFiEventHandler> handlers;
+        {
+            std::lock_guard<std::mutex> lock(g_wifi_events_mutex);
+            handlers = g_wifi_events;
+        }
+        for (const WiFiEventHandler &h : handlers)
+        {
+            if (h.event == event || h.event == ARDUINO_EVENT_MAX)
+            {
+                h.cb(event);
+            }
+        }
+    }
+}
+
+bool WiFiClass::softAPdisconnect(bool wifioff)
+{
+    if (wifioff)
+    {
+        mode_ = WIFI_MODE_NULL;
+    }
+    return true;
+}
+
+// --- String ---
+
+static std::string format_integer(unsigned long long value, bool negative, unsigned char base)
+{
+    if (base < 2 || base > 36)
+    {
+        base = 10;
+    }
+    char buf[72];
+    int pos = sizeof(buf) - 1;
+    buf[pos] = '\0';
+    do
+    {
+        int digit = (int)(value % base);
+        buf[--pos] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value);
+    if (negative)
+    {
+        buf[--pos] = '-';
+    }
+    return std::string(&buf[pos]);
+}
+
+static std::string format_signed(long long value, unsigned char base)
+{
+    if (base == 10 && value < 0)
+    {
+        return format_integer((unsigned long long)(-(value + 1)) + 1, true, base);
+    }
+    return format_integer((unsigned long long)value, false, base);
+}
+
+static std::string format_float(double value, unsigned int decimals)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, value);
+    return std::string(buf);
+}
+
+String::String(int value, unsigned char base) : s_(format_signed(value, base)) {}
+String::String(unsigned int value, unsigned char base) : s_(format_integer(value, false, base)) {}
+String::String(long value, unsigned char base) : s_(format_signed(value, base)) {}
+String::String(unsigned long value, unsigned char base) : s_(format_integer(value, false, base)) {}
+String::String(long long value, unsigned char base) : s_(format_signed(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : s_(format_integer(value, false, base)) {}
+String::String(float value, unsigned int decimalPlaces) : s_(format_float(value, decimalPlaces)) {}
+String::String(double value, unsigned int decimalPlaces) : s_(format_float(value, decimalPlaces)) {}
+
+bool String::equalsIgnoreCase(const String &s) const
+{
+    if (s_.size() != s.s_.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < s_.size(); ++i)
+    {
+        if (tolower((unsigned char)s_[i]) != tolower((unsigned char)s.s_[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void String::toLowerCase()
+{
+    for (char &c : s_)
+    {
+        c = (char)tolower((unsigned char)c);
+    }
+}
+
+void String::toUpperCase()
+{
+    for (char &c : s_)
+    {
+        c = (char)toupper((unsigned char)c);
+    }
+}
+
+void String::trim()
+{
+    size_t begin = s_.find_first_not_of(" \t\r\n");
+    size_t end = s_.find_last_not_of(" \t\r\n");
+    s_ = (begin == std::string::npos) ? std::string() : s_.substr(begin, end - begin + 1);
+}
+
+long String::toInt() const
+{
+    return strtol(s_.c_str(), NULL, 10);
+}
+
+float String::toFloat() const
+{
+    return strtof(s_.c_str(), NULL);
+}
+
+// --- Print ---
+
+size_t Print::printf(const char *format, ...)
+{
+    char loc_buf[128];
+    va_list arg;
+    va_start(arg, format);
+    int len = vsnprintf(loc_buf, sizeof(loc_buf), format, arg);
+    va_end(arg);
+    if (len < 0)
+    {
+        return 0;
+    }
+    if ((size_t)len < sizeof(loc_buf))
+    {
+        return write((const uint8_t *)loc_buf, len);
+    }
+    std::string big(len + 1, '\0');
+    va_start(arg, format);
+    vsnprintf(&big[0], big.size(), format, arg);
+    va_end(arg);
+    return write((const uint8_t *)big.data(), len);
+}
+
+size_t Print::print(long n, int base)
+{
+    return print(String(n, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    return print(String(n, (unsigned char)base));
+}
+
+size_t Print::print(long long n, int base)
+{
+    return print(String(n, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long long n, int base)
+{
+    return print(String(n, (unsigned char)base));
+}
+
+size_t Print::print(double n, int digits)
+{
+    return print(String(n, (unsigned int)digits));
+}
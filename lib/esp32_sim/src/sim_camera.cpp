@@ -0,0 +1,321 @@
+// Сценарный OV5640.
+//
+// SIM_CAMERA_DIR     - каталог с *.jpg; кадры отдаются по кругу в алфавитном порядке.
+//                      Без каталога генерируются синтетические JPEG, размер которых
+//                      растёт с разрешением и падает с номером качества, как у OV5640.
+// SIM_CAMERA_FPS     - частота кадров сенсора (по умолчанию 20).
+// SIM_CAMERA_INIT_MS - длительность esp_camera_init (по умолчанию 600 мс).
+// SIM_CAMERA_WAKE_MS - первый кадр после выхода из power down (0x3008, по умолчанию 100 мс).
+#include "esp_camera.h"
+#include "sim_internal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+const resolution_info_t resolution[FRAMESIZE_INVALID] = {
+    {96, 96, 0},     {160, 120, 0},   {176, 144, 0},   {240, 176, 0},   {240, 240, 0},   {320, 240, 0},
+    {400, 296, 0},   {480, 320, 0},   {640, 480, 0},   {800, 600, 0},   {1024, 768, 0},  {1280, 720, 0},
+    {1280, 1024, 0}, {1600, 1200, 0}, {1920, 1080, 0}, {720, 1280, 0},  {864, 1536, 0},  {2048, 1536, 0},
+    {2560, 1440, 0}, {2560, 1600, 0}, {1080, 1920, 0}, {2560, 1920, 0},
+};
+
+namespace
+{
+    const uint32_t FB_GET_TIMEOUT_MS = 4000;
+
+    struct SimFrameBuffer
+    {
+        camera_fb_t fb;
+        std::vector<uint8_t> data;
+        bool in_use = false;
+    };
+
+    std::mutex g_mutex;
+    std::condition_variable g_cv;
+    bool g_initialized = false;
+    std::vector<SimFrameBuffer> g_buffers;
+    std::vector<std::vector<uint8_t>> g_files;
+    size_t g_next_file = 0;
+    uint64_t g_next_frame_us = 0;
+    uint32_t g_frame_period_us = 50000;
+    std::mt19937 g_rng(7);
+    sensor_t g_sensor;
+    bool g_power_down = false; // OV5640 0x3008 бит 6: кадров нет, регистры сохранены
+
+    size_t synthetic_size()
+    {
+        // Грубая модель JPEG OV5640: ~1.8 бита/пиксель при q=0, убывает как 1/(q+4).
+        const resolution_info_t &r = resolution[g_sensor.status.framesize];
+        double base = (double)r.width * r.height * 1.8 / (g_sensor.status.quality + 4);
+        std::normal_distribution<double> scene(1.0, 0.15);
+        double k = std::max(0.4, scene(g_rng));
+        return std::max<size_t>(512, (size_t)(base * k));
+    }
+
+    void fill_frame(SimFrameBuffer &b)
+    {
+        const resolution_info_t &r = resolution[g_sensor.status.framesize];
+        if (!g_files.empty())
+        {
+            b.data = g_files[g_next_file];
+            g_next_file = (g_next_file + 1) % g_files.size();
+        }
+        else
+        {
+            size_t len = synthetic_size();
+            b.data.assign(len, 0x55);
+            b.data[0] = 0xFF;
+            b.data[1] = 0xD8;
+            b.data[len - 2] = 0xFF;
+            b.data[len - 1] = 0xD9;
+        }
+        b.fb.buf = b.data.data();
+        b.fb.len = b.data.size();
+        b.fb.width = r.width;
+        b.fb.height = r.height;
+        b.fb.format = PIXFORMAT_JPEG;
+        // Как в cam_hal: метка по esp_timer_get_time()
+        uint64_t us = sim_micros();
+        b.fb.timestamp.tv_sec = (time_t)(us / 1000000);
+        b.fb.timestamp.tv_usec = (suseconds_t)(us % 1000000);
+    }
+
+    void load_directory(const char *dir)
+    {
+        DIR *d = opendir(dir);
+        if (!d)
+        {
+            sim_log("[Sim] Camera directory '%s' not found, using synthetic frames\n", dir);
+            return;
+        }
+        std::vector<std::string> names;
+        while (struct dirent *e = readdir(d))
+        {
+            std::string name = e->d_name;
+            if (name.size() > 4 && (name.compare(name.size() - 4, 4, ".jpg") == 0 ||
+                                    name.compare(name.size() - 4, 4, ".JPG") == 0))
+            {
+                names.push_back(std::string(dir) + "/" + name);
+            }
+        }
+        closedir(d);
+        std::sort(names.begin(), names.end());
+        for (const std::string &path : names)
+        {
+            std::ifstream f(path, std::ios::binary);
+            g_files.emplace_back(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        }
+        sim_log("[Sim] Camera: %u JPEG frames from '%s'\n", (unsigned)g_files.size(), dir);
+    }
+
+    int sim_set_framesize(sensor_t *s, framesize_t framesize)
+    {
+        if (framesize >= FRAMESIZE_INVALID)
+        {
+            return -1;
+        }
+        std::lock_guard<std::mutex> lock(g_mutex);
+        s->status.framesize = framesize;
+        return 0;
+    }
+
+    int sim_set_quality(sensor_t *s, int quality)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        s->status.quality = (uint8_t)quality;
+        return 0;
+    }
+
+    int sim_set_hmirror(sensor_t *s, int enable)
+    {
+        s->status.hmirror = enable ? 1 : 0;
+        return 0;
+    }
+
+    int sim_set_vflip(sensor_t *s, int enable)
+    {
+        s->status.vflip = enable ? 1 : 0;
+        return 0;
+    }
+
+    int sim_get_reg(sensor_t *s, int reg, int mask)
+    {
+        (void)s;
+        (void)reg;
+        (void)mask;
+        return 0;
+    }
+
+    int sim_set_reg(sensor_t *s, int reg, int mask, int value)
+    {
+        (void)s;
+        if (reg == 0x3008 && (mask & 0x40))
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            bool power_down = (value & 0x40) != 0;
+            if (g_power_down && !power_down)
+            {
+                g_next_frame_us = sim_micros() + sim_env_int("SIM_CAMERA_WAKE_MS", 100) * 1000;
+            }
+            g_power_down = power_down;
+            g_cv.notify_all();
+        }
+        return 0;
+    }
+
+    int sim_set_xclk(sensor_t *s, int timer, int xclk)
+    {
+        (void)timer;
+        s->xclk_freq_hz = xclk * 1000000;
+        return 0;
+    }
+}
+
+esp_err_t esp_camera_init(const camera_config_t *config)
+{
+    if (config->pixel_format != PIXFORMAT_JPEG || config->frame_size >= FRAMESIZE_INVALID || config->fb_count == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Проба сенсора по SCCB и выделение буферов занимают заметное время.
+    std::this_thread::sleep_for(std::chrono::milliseconds(sim_env_int("SIM_CAMERA_INIT_MS", 600)));
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_initialized)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (g_files.empty())
+    {
+        const char *dir = sim_env_str("SIM_CAMERA_DIR", NULL);
+        if (dir)
+        {
+            load_directory(dir);
+        }
+    }
+
+    memset(&g_sensor, 0, sizeof(g_sensor));
+    g_sensor.slv_addr = 0x3C;
+    g_sensor.pixformat = config->pixel_format;
+    g_sensor.xclk_freq_hz = config->xclk_freq_hz;
+    g_sensor.status.framesize = config->frame_size;
+    g_sensor.status.quality = (uint8_t)config->jpeg_quality;
+    g_sensor.set_framesize = sim_set_framesize;
+    g_sensor.set_quality = sim_set_quality;
+    g_sensor.set_hmirror = sim_set_hmirror;
+    g_sensor.set_vflip = sim_set_vflip;
+    g_sensor.get_reg = sim_get_reg;
+    g_sensor.set_reg = sim_set_reg;
+    g_sensor.set_xclk = sim_set_xclk;
+
+    g_power_down = false;
+    g_buffers = std::vector<SimFrameBuffer>(config->fb_count);
+    long fps = sim_env_int("SIM_CAMERA_FPS", 20);
+    g_frame_period_us = (uint32_t)(1000000 / (fps > 0 ? fps : 1));
+    g_next_frame_us = sim_micros() + g_frame_period_us;
+    g_initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!g_initialized)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_initialized = false;
+    g_buffers.clear();
+    g_cv.notify_all();
+    return ESP_OK;
+}
+
+camera_fb_t *esp_camera_fb_get()
+{
+    uint64_t start = sim_micros();
+    std::unique_lock<std::mutex> lock(g_mutex);
+    if (!g_initialized)
+    {
+        return NULL;
+    }
+
+    // Ждём свободный буфер, как драйвер при исчерпании fb_count.
+    auto free_buffer = [] {
+        return !g_initialized || std::any_of(g_buffers.begin(), g_buffers.end(),
+                                             [](const SimFrameBuffer &b) { return !b.in_use; });
+    };
+    if (!g_cv.wait_for(lock, std::chrono::milliseconds(FB_GET_TIMEOUT_MS), free_buffer) || !g_initialized)
+    {
+        sim_log("[Sim] cam_hal: Failed to get the frame on time!\n");
+        return NULL;
+    }
+
+    // В power down сенсор не выдаёт кадров: драйвер ждёт VSYNC до таймаута.
+    if (g_power_down)
+    {
+        if (!g_cv.wait_for(lock, std::chrono::milliseconds(FB_GET_TIMEOUT_MS), [] { return !g_power_down || !g_initialized; }) ||
+            !g_initialized)
+        {
+            sim_log("[Sim] cam_hal: Failed to get the frame on time!\n");
+            return NULL;
+        }
+    }
+
+    // Следующий кадр готов не раньше очередного периода сенсора.
+    uint64_t now = sim_micros();
+    if (g_next_frame_us > now)
+    {
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::microseconds(g_next_frame_us - now));
+        lock.lock();
+        if (!g_initialized)
+        {
+            return NULL;
+        }
+        now = sim_micros();
+    }
+    g_next_frame_us = std::max(g_next_frame_us + g_frame_period_us, now);
+
+    for (SimFrameBuffer &b : g_buffers)
+    {
+        if (!b.in_use)
+        {
+            b.in_use = true;
+            fill_frame(b);
+            sim_stats_frame(b.fb.len, sim_micros() - start);
+            return &b.fb;
+        }
+    }
+    return NULL;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (SimFrameBuffer &b : g_buffers)
+    {
+        if (&b.fb == fb)
+        {
+            b.in_use = false;
+            g_cv.notify_all();
+            return;
+        }
+    }
+}
+
+sensor_t *esp_camera_sensor_get()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_initialized ? &g_sensor : NULL;
+}
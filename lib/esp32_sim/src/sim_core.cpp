@@ -0,0 +1,431 @@
+// Ядро симулятора: время, переменные окружения, консоль управления и периодический отчёт.
+//
+// Консольные команды (stdin):
+//   r [0|1]              - переключить/задать заднюю передачу
+//   d <l> <c> <r>        - зафиксировать расстояния, см (отрицательное - эхо не пришло)
+//   d script             - вернуться к сценарию SIM_DISTANCE_SCRIPT
+//   ws <n> / stream <n>  - число виртуальных клиентов на /ws и /ws_stream
+//   send <url>[#id] <text> - текстовое сообщение от клиентов WebSocket (или от одного клиента)
+//   get <url>            - HTTP GET
+//   post <url> <body>    - HTTP POST
+//   stats                - отчёт немедленно
+//   q                    - выход
+#include "sim_internal.h"
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <pthread.h>
+
+namespace
+{
+    const auto g_start = std::chrono::steady_clock::now();
+    std::mutex g_out_mutex;
+
+    struct WsStats
+    {
+        uint64_t messages = 0;
+        uint64_t bytes = 0;
+        uint64_t deliveries = 0;
+        uint64_t drops = 0;
+        uint64_t fanout_us_sum = 0;
+        uint64_t fanout_us_max = 0;
+        size_t clients = 0;
+        // Полностью отправленные сообщения по клиентам: id -> {сообщений, байт}
+        std::map<uint32_t, std::pair<uint64_t, uint64_t>> completed;
+    };
+
+    struct Stats
+    {
+        uint64_t window_start_us = 0;
+
+        uint64_t last_cycle_us = 0;
+        uint64_t cycle_sum_us = 0;
+        uint64_t cycle_min_us = UINT64_MAX;
+        uint64_t cycle_max_us = 0;
+        uint32_t cycles = 0;
+        uint32_t triggers[8] = {0};
+        uint32_t echoes[8] = {0};
+
+        uint32_t frames = 0;
+        uint64_t frame_bytes = 0;
+        uint64_t frame_wait_us = 0;
+
+        std::map<std::string, WsStats> ws;
+        uint32_t beeps = 0;
+        // Опоздание срабатывания esp_timer (фронты зуммера) относительно срока
+        uint32_t timer_callbacks = 0;
+        uint64_t timer_late_sum_us = 0;
+        uint64_t timer_late_max_us = 0;
+
+        uint32_t flash_erases = 0;
+        uint32_t flash_writes = 0;
+        uint64_t cache_off_us = 0;
+        uint64_t cache_off_max_us = 0;
+    };
+
+    std::mutex g_stats_mutex;
+    Stats g_stats;
+
+#ifndef PIO_UNIT_TESTING
+    void console_loop()
+    {
+        std::string line;
+        while (std::getline(std::cin, line))
+        {
+            char cmd[16] = {0};
+            char arg[256] = {0};
+            if (sscanf(line.c_str(), "%15s %255[^\n]", cmd, arg) < 1)
+            {
+                continue;
+            }
+
+            if (strcmp(cmd, "r") == 0)
+            {
+                int engaged = arg[0] ? atoi(arg) : !sim_gpio_reverse();
+                sim_gpio_set_reverse(engaged);
+                sim_log("[Sim] Reverse gear %s\n", engaged ? "ENGAGED" : "released");
+            }
+            else if (strcmp(cmd, "d") == 0)
+            {
+                float d[3];
+                if (strcmp(arg, "script") == 0)
+                {
+                    sim_sonar_use_script();
+                }
+                else if (sscanf(arg, "%f %f %f", &d[0], &d[1], &d[2]) == 3)
+                {
+                    sim_sonar_override(d, 3);
+                }
+            }
+            else if (strcmp(cmd, "ws") == 0)
+            {
+                sim_web_set_clients("/ws", atoi(arg));
+            }
+            else if (strcmp(cmd, "sta") == 0)
+            {
+                WiFi._simSetStations(atoi(arg));
+            }
+            else if (strcmp(cmd, "stream") == 0)
+            {
+                sim_web_set_clients("/ws_stream", atoi(arg));
+            }
+            else if (strcmp(cmd, "send") == 0)
+            {
+                char url[64] = {0};
+                char text[192] = {0};
+                if (sscanf(arg, "%63s %191[^\n]", url, text) == 2)
+                {
+                    sim_web_send_text(url, text);
+                }
+            }
+            else if (strcmp(cmd, "get") == 0)
+            {
+                sim_web_http("GET", arg, "");
+            }
+            else if (strcmp(cmd, "post") == 0)
+            {
+                char url[128] = {0};
+                char body[128] = {0};
+                sscanf(arg, "%127s %127[^\n]", url, body);
+                sim_web_http("POST", url, body);
+            }
+            else if (strcmp(cmd, "stats") == 0)
+            {
+                sim_stats_report();
+            }
+            else if (strcmp(cmd, "q") == 0)
+            {
+                sim_stats_report();
+                // Задачи прошивки не завершаются, статические деструкторы вызывать нельзя.
+                fflush(stdout);
+                std::_Exit(0);
+            }
+            else
+            {
+                sim_log("[Sim] Unknown command '%s'\n", cmd);
+            }
+        }
+    }
+
+    void stats_loop(long period_ms)
+    {
+        sim_set_thread_name("sim_stats");
+        for (;;)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(period_ms));
+            sim_stats_report();
+        }
+    }
+#endif
+}
+
+uint64_t sim_micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_start).count();
+}
+
+void sim_set_thread_name(const char *name)
+{
+    char buf[16];
+    strncpy(buf, name, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    pthread_setname_np(pthread_self(), buf);
+}
+
+long sim_env_int(const char *name, long def)
+{
+    const char *v = getenv(name);
+    return (v && *v) ? strtol(v, NULL, 0) : def;
+}
+
+const char *sim_env_str(const char *name, const char *def)
+{
+    const char *v = getenv(name);
+    return (v && *v) ? v : def;
+}
+
+void sim_log(const char *fmt, ...)
+{
+    std::lock_guard<std::mutex> lock(g_out_mutex);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stdout, fmt, args);
+    va_end(args);
+    fflush(stdout);
+}
+
+void HardwareSerial::flush()
+{
+    std::lock_guard<std::mutex> lock(g_out_mutex);
+    fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    std::lock_guard<std::mutex> lock(g_out_mutex);
+    fputc(c, stdout);
+    if (c == '\n')
+    {
+        fflush(stdout);
+    }
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    std::lock_guard<std::mutex> lock(g_out_mutex);
+    size_t n = fwrite(buffer, 1, size, stdout);
+    fflush(stdout);
+    return n;
+}
+
+// --- Статистика ---
+
+void sim_stats_trigger(int sensor, uint64_t t_us)
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    if (sensor < 0 || sensor >= 8)
+    {
+        return;
+    }
+    g_stats.triggers[sensor]++;
+    // Цикл опроса измеряется по повторному запуску датчика 0.
+    if (sensor == 0)
+    {
+        if (g_stats.last_cycle_us != 0)
+        {
+            uint64_t dt = t_us - g_stats.last_cycle_us;
+            g_stats.cycle_sum_us += dt;
+            g_stats.cycle_min_us = std::min(g_stats.cycle_min_us, dt);
+            g_stats.cycle_max_us = std::max(g_stats.cycle_max_us, dt);
+            g_stats.cycles++;
+        }
+        g_stats.last_cycle_us = t_us;
+    }
+}
+
+void sim_stats_echo(int sensor)
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    if (sensor >= 0 && sensor < 8)
+    {
+        g_stats.echoes[sensor]++;
+    }
+}
+
+void sim_stats_frame(size_t len, uint64_t wait_us)
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    g_stats.frames++;
+    g_stats.frame_bytes += len;
+    g_stats.frame_wait_us += wait_us;
+}
+
+void sim_stats_ws(const char *url, size_t len, size_t clients, uint64_t fanout_us)
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    WsStats &s = g_stats.ws[url];
+    s.messages++;
+    s.bytes += len;
+    s.deliveries += clients;
+    s.clients = clients;
+    s.fanout_us_sum += fanout_us;
+    s.fanout_us_max = std::max(s.fanout_us_max, fanout_us);
+}
+
+void sim_stats_ws_drop(const char *url)
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    g_stats.ws[url].drops++;
+}
+
+void sim_stats_ws_client(const char *url, uint32_t id, size_t len)
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    auto &c = g_stats.ws[url].completed[id];
+    c.first++;
+    c.second += len;
+}
+
+void sim_stats_beep()
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    g_stats.beeps++;
+}
+
+void sim_stats_timer(uint64_t late_us)
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    g_stats.timer_callbacks++;
+    g_stats.timer_late_sum_us += late_us;
+    g_stats.timer_late_max_us = std::max(g_stats.timer_late_max_us, late_us);
+}
+
+void sim_stats_flash(bool erase, uint64_t cache_off_us)
+{
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    (erase ? g_stats.flash_erases : g_stats.flash_writes)++;
+    g_stats.cache_off_us += cache_off_us;
+    g_stats.cache_off_max_us = std::max(g_stats.cache_off_max_us, cache_off_us);
+}
+
+void sim_stats_report()
+{
+    Stats s;
+    uint64_t now = sim_micros();
+    {
+        std::lock_guard<std::mutex> lock(g_stats_mutex);
+        s = g_stats;
+        uint64_t last_cycle = g_stats.last_cycle_us;
+        g_stats = Stats();
+        g_stats.window_start_us = now;
+        g_stats.last_cycle_us = last_cycle;
+    }
+    double window_s = (now - s.window_start_us) / 1e6;
+    if (window_s < 0.1)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_out_mutex);
+    printf("[Sim] ---- %.1f s window ----\n", window_s);
+    if (s.cycles)
+    {
+        printf("[Sim] sensors: cycle avg %.1f ms (min %.1f, max %.1f), %.2f Hz; trig/echo",
+               s.cycle_sum_us / 1000.0 / s.cycles, s.cycle_min_us / 1000.0, s.cycle_max_us / 1000.0,
+               s.cycles / window_s);
+        for (int i = 0; i < 8 && (s.triggers[i] || s.echoes[i]); ++i)
+        {
+            printf(" %u/%u", s.triggers[i], s.echoes[i]);
+        }
+        printf("\n");
+    }
+    else
+    {
+        printf("[Sim] sensors: idle\n");
+    }
+    if (s.frames)
+    {
+        printf("[Sim] camera: %.1f fps, avg frame %.1f KB, avg fb_get wait %.1f ms\n", s.frames / window_s,
+               s.frame_bytes / 1024.0 / s.frames, s.frame_wait_us / 1000.0 / s.frames);
+    }
+    for (const auto &kv : s.ws)
+    {
+        const WsStats &w = kv.second;
+        if (!w.messages && !w.drops && w.completed.empty())
+        {
+            continue;
+        }
+        if (w.messages || w.drops)
+        {
+            printf("[Sim] %s: %.1f msg/s, %.1f KB/s out, %llu deliveries, %llu drops, fan-out avg %.1f us max %llu us (%u clients)\n",
+                   kv.first.c_str(), w.messages / window_s, w.bytes * w.clients / 1024.0 / window_s,
+                   (unsigned long long)w.deliveries, (unsigned long long)w.drops,
+                   w.messages ? (double)w.fanout_us_sum / w.messages : 0.0, (unsigned long long)w.fanout_us_max,
+                   (unsigned)w.clients);
+        }
+        else
+        {
+            printf("[Sim] %s:\n", kv.first.c_str());
+        }
+        for (const auto &c : w.completed)
+        {
+            printf("[Sim]   client #%u: %.1f msg/s delivered, %.1f KB/s\n", c.first, c.second.first / window_s,
+                   c.second.second / 1024.0 / window_s);
+        }
+    }
+    if (s.beeps)
+    {
+        printf("[Sim] buzzer: %u beeps (%.1f/min)\n", s.beeps, s.beeps * 60.0 / window_s);
+    }
+    if (s.timer_callbacks)
+    {
+        printf("[Sim] esp_timer: %u callbacks, late avg %.2f ms, max %.1f ms\n", s.timer_callbacks,
+               s.timer_late_sum_us / 1000.0 / s.timer_callbacks, s.timer_late_max_us / 1000.0);
+    }
+    if (s.flash_erases || s.flash_writes)
+    {
+        printf("[Sim] flash: %u sector erases, %u writes, cache off %.1f ms (%.1f%%), longest %.1f ms\n",
+               s.flash_erases, s.flash_writes, s.cache_off_us / 1000.0, s.cache_off_us / 10.0 / window_s / 1000.0,
+               s.cache_off_max_us / 1000.0);
+    }
+    fflush(stdout);
+}
+
+// В сборке тестов (pio test -e native) main() - у теста, прошивка только линкуется
+#ifndef PIO_UNIT_TESTING
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    sim_set_thread_name("loopTask");
+
+    sim_gpio_start();
+
+    long stats_ms = sim_env_int("SIM_STATS_MS", 5000);
+    if (stats_ms > 0)
+    {
+        std::thread(stats_loop, stats_ms).detach();
+    }
+
+    setup();
+    // Консоль запускается после setup(): команды используют объекты синхронизации прошивки.
+    std::thread(console_loop).detach();
+    for (;;)
+    {
+        loop();
+    }
+}
+#endif
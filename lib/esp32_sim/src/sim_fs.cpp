@@ -0,0 +1,238 @@
+// LittleFS поверх каталога хоста SIM_FS_DIR (по умолчанию sim/fs).
+#include <LittleFS.h>
+#include "sim_internal.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fs::LittleFSFS LittleFS;
+
+namespace fs
+{
+    struct FileImpl
+    {
+        FILE *f = nullptr;
+        std::string path;
+        std::string name;
+        bool is_dir = false;
+
+        ~FileImpl()
+        {
+            if (f)
+            {
+                fclose(f);
+            }
+        }
+    };
+}
+
+namespace
+{
+    std::string root()
+    {
+        return sim_env_str("SIM_FS_DIR", "sim/fs");
+    }
+
+    std::string host_path(const char *path)
+    {
+        std::string p = path ? path : "/";
+        if (p.empty() || p[0] != '/')
+        {
+            p = "/" + p;
+        }
+        return root() + p;
+    }
+
+    void make_dirs(const std::string &path)
+    {
+        for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+        {
+            ::mkdir(path.substr(0, pos).c_str(), 0755);
+        }
+        ::mkdir(path.c_str(), 0755);
+    }
+}
+
+namespace fs
+{
+    size_t File::write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+
+    size_t File::write(const uint8_t *buf, size_t size)
+    {
+        return (impl_ && impl_->f) ? fwrite(buf, 1, size, impl_->f) : 0;
+    }
+
+    int File::available()
+    {
+        if (!impl_ || !impl_->f)
+        {
+            return 0;
+        }
+        long pos = ftell(impl_->f);
+        return (int)(size() - (size_t)pos);
+    }
+
+    int File::read()
+    {
+        return (impl_ && impl_->f) ? fgetc(impl_->f) : -1;
+    }
+
+    int File::peek()
+    {
+        if (!impl_ || !impl_->f)
+        {
+            return -1;
+        }
+        int c = fgetc(impl_->f);
+        if (c != EOF)
+        {
+            ungetc(c, impl_->f);
+        }
+        return c;
+    }
+
+    void File::flush()
+    {
+        if (impl_ && impl_->f)
+        {
+            fflush(impl_->f);
+        }
+    }
+
+    size_t File::read(uint8_t *buf, size_t size)
+    {
+        return (impl_ && impl_->f) ? fread(buf, 1, size, impl_->f) : 0;
+    }
+
+    bool File::seek(uint32_t pos, SeekMode mode)
+    {
+        int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+        return impl_ && impl_->f && fseek(impl_->f, (long)pos, whence) == 0;
+    }
+
+    size_t File::position() const
+    {
+        return (impl_ && impl_->f) ? (size_t)ftell(impl_->f) : 0;
+    }
+
+    size_t File::size() const
+    {
+        if (!impl_)
+        {
+            return 0;
+        }
+        if (impl_->f)
+        {
+            fflush(impl_->f);
+        }
+        struct stat st;
+        return stat(impl_->path.c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+    }
+
+    void File::close()
+    {
+        impl_.reset();
+    }
+
+    File::operator bool() const
+    {
+        return impl_ && (impl_->f || impl_->is_dir);
+    }
+
+    const char *File::name() const
+    {
+        return impl_ ? impl_->name.c_str() : "";
+    }
+
+    const char *File::path() const
+    {
+        return impl_ ? impl_->path.c_str() : "";
+    }
+
+    bool File::isDirectory(void)
+    {
+        return impl_ && impl_->is_dir;
+    }
+
+    File FS::open(const char *path, const char *mode, const bool create)
+    {
+        std::string hp = host_path(path);
+        if (create)
+        {
+            make_dirs(hp.substr(0, hp.rfind('/')));
+        }
+        auto impl = std::make_shared<FileImpl>();
+        impl->path = hp;
+        impl->name = hp.substr(hp.rfind('/') + 1);
+        struct stat st;
+        if (stat(hp.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            impl->is_dir = true;
+            return File(impl);
+        }
+        std::string m = mode ? mode : "r";
+        if (m.find('b') == std::string::npos)
+        {
+            m += "b";
+        }
+        impl->f = fopen(hp.c_str(), m.c_str());
+        return impl->f ? File(impl) : File();
+    }
+
+    bool FS::exists(const char *path)
+    {
+        struct stat st;
+        return stat(host_path(path).c_str(), &st) == 0;
+    }
+
+    bool FS::remove(const char *path)
+    {
+        return ::remove(host_path(path).c_str()) == 0;
+    }
+
+    bool FS::rename(const char *pathFrom, const char *pathTo)
+    {
+        return ::rename(host_path(pathFrom).c_str(), host_path(pathTo).c_str()) == 0;
+    }
+
+    bool FS::mkdir(const char *path)
+    {
+        return ::mkdir(host_path(path).c_str(), 0755) == 0 || errno == EEXIST;
+    }
+
+    bool FS::rmdir(const char *path)
+    {
+        return ::rmdir(host_path(path).c_str()) == 0;
+    }
+
+    bool LittleFSFS::begin(bool formatOnFail, const char *basePath, uint8_t maxOpenFiles, const char *partitionLabel)
+    {
+        (void)formatOnFail;
+        (void)basePath;
+        (void)maxOpenFiles;
+        (void)partitionLabel;
+        make_dirs(root());
+        return true;
+    }
+
+    bool LittleFSFS::format()
+    {
+        return true;
+    }
+
+    size_t LittleFSFS::totalBytes()
+    {
+        return 1536 * 1024;
+    }
+
+    size_t LittleFSFS::usedBytes()
+    {
+        return 0;
+    }
+}
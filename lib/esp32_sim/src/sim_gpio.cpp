@@ -0,0 +1,582 @@
+// GPIO-модель: эхо-импульсы AJ-SR04M по сценарию расстояний (GPIO-прерывания и захват MCPWM),
+// пин задней передачи и LEDC зуммера.
+//
+// SIM_DISTANCE_SCRIPT - файл со строками "<t_ms> <left> <center> <right>" (см, "-" - нет эха);
+//                       между точками расстояние интерполируется, сценарий повторяется по кругу.
+// SIM_SONAR_JITTER_US - разброс длительности эха (по умолчанию 30 мкс).
+// SIM_SONAR_DROP_PCT  - вероятность пропуска эха, %.
+// SIM_SONAR_CROSSTALK_PCT - вероятность, что датчик услышит импульс соседа, запущенного
+//                       в пределах его окна приёма, раньше своего эха, %.
+// SIM_REVERSE         - 1: задняя передача включена при старте.
+#include <Arduino.h>
+#include "config.h"
+#include "driver/mcpwm.h"
+#include "sim_internal.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int MAX_PINS = 64;
+    const float NO_ECHO = -1.0f;
+    const uint32_t ECHO_DELAY_US = 450; // От спада триггера до фронта эха
+    const uint32_t NO_ECHO_WIDTH_US = 38000; // Эха нет: датчик держит выход до своего таймаута
+
+    struct PinState
+    {
+        uint8_t mode = 0;
+        uint8_t level = LOW;
+        uint64_t high_since_us = 0;
+        void (*isr)(void) = nullptr;
+        int isr_mode = 0;
+    };
+
+    struct EchoEvent
+    {
+        uint64_t t_us;
+        uint8_t pin;
+        uint8_t level;
+        int sensor;
+        uint32_t gen; // Спад эха отменяется, если датчик услышал чужой импульс раньше
+        bool operator>(const EchoEvent &o) const { return t_us > o.t_us; }
+    };
+
+    struct ScriptPoint
+    {
+        uint32_t t_ms;
+        float d[NUM_SENSORS];
+    };
+
+    std::recursive_mutex g_pin_mutex;
+    PinState g_pins[MAX_PINS];
+
+    std::mutex g_event_mutex;
+    std::condition_variable g_event_cv;
+    std::priority_queue<EchoEvent, std::vector<EchoEvent>, std::greater<EchoEvent>> g_events;
+
+    std::mutex g_script_mutex;
+    std::vector<ScriptPoint> g_script;
+    bool g_override = false;
+    float g_override_d[NUM_SENSORS];
+
+    std::atomic<int> g_reverse{0};
+    long g_jitter_us = 30;
+    long g_drop_pct = 0;
+    long g_crosstalk_pct = 0;
+
+    // Текущее измерение датчика, под g_script_mutex
+    struct SonarState
+    {
+        uint64_t trig_us = 0;
+        uint64_t rise_us = 0;
+        uint64_t fall_us = 0;
+        float d = NO_ECHO;
+        uint32_t gen = 0;
+    };
+    SonarState g_sonar[NUM_SENSORS];
+    std::mt19937 g_rng(1);
+
+    struct LedcChannel
+    {
+        double freq = 0;
+        uint32_t duty = 0;
+        int pin = -1;
+    };
+    LedcChannel g_ledc[16];
+
+    // Каналы захвата MCPWM: фронт на пине защёлкивает время события в тактах APB.
+    struct CaptureChannel
+    {
+        int pin = -1;
+        bool enabled = false;
+        mcpwm_capture_on_edge_t edge = MCPWM_BOTH_EDGE;
+        cap_isr_cb_t cb = nullptr;
+        void *user_data = nullptr;
+    };
+    CaptureChannel g_capture[MCPWM_UNIT_MAX][3];
+    const uint64_t APB_TICKS_PER_US = 80;
+
+    bool parse_distance(const std::string &token, float &out)
+    {
+        if (token == "-")
+        {
+            out = NO_ECHO;
+            return true;
+        }
+        char *end = nullptr;
+        out = strtof(token.c_str(), &end);
+        return end && *end == '\0';
+    }
+
+    void load_script(const char *path)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            sim_log("[Sim] Cannot open distance script '%s'\n", path);
+            return;
+        }
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::istringstream ss(line);
+            ScriptPoint p;
+            std::string tok;
+            if (!(ss >> p.t_ms))
+            {
+                continue;
+            }
+            bool ok = true;
+            for (int i = 0; i < NUM_SENSORS && ok; ++i)
+            {
+                ok = (ss >> tok) && parse_distance(tok, p.d[i]);
+            }
+            if (ok)
+            {
+                g_script.push_back(p);
+            }
+        }
+        sim_log("[Sim] Distance script '%s': %u points\n", path, (unsigned)g_script.size());
+    }
+
+    float distance_at(int sensor, uint64_t t_us)
+    {
+        std::lock_guard<std::mutex> lock(g_script_mutex);
+        if (g_override)
+        {
+            return g_override_d[sensor];
+        }
+        if (g_script.empty())
+        {
+            return 150.0f;
+        }
+        uint32_t span = g_script.back().t_ms;
+        uint32_t t = span ? (uint32_t)((t_us / 1000) % (span + 1)) : 0;
+        for (size_t i = 1; i < g_script.size(); ++i)
+        {
+            const ScriptPoint &a = g_script[i - 1];
+            const ScriptPoint &b = g_script[i];
+            if (t <= b.t_ms)
+            {
+                if (a.d[sensor] < 0 || b.d[sensor] < 0 || b.t_ms == a.t_ms)
+                {
+                    return a.d[sensor];
+                }
+                float k = (float)(t - a.t_ms) / (float)(b.t_ms - a.t_ms);
+                return a.d[sensor] + (b.d[sensor] - a.d[sensor]) * k;
+            }
+        }
+        return g_script.back().d[sensor];
+    }
+
+    void set_level(uint8_t pin, uint8_t level, uint64_t t_us)
+    {
+        void (*isr)(void) = nullptr;
+        struct PendingCapture
+        {
+            CaptureChannel ch;
+            int unit;
+            int channel;
+        } captures[MCPWM_UNIT_MAX * 3];
+        int capture_count = 0;
+        {
+            std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+            PinState &p = g_pins[pin];
+            if (p.level == level)
+            {
+                return;
+            }
+            p.level = level;
+            bool fire = (p.isr_mode == CHANGE) || (p.isr_mode == RISING && level == HIGH) ||
+                        (p.isr_mode == FALLING && level == LOW);
+            if (fire)
+            {
+                isr = p.isr;
+            }
+            mcpwm_capture_on_edge_t edge = level ? MCPWM_POS_EDGE : MCPWM_NEG_EDGE;
+            for (int u = 0; u < MCPWM_UNIT_MAX; ++u)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    const CaptureChannel &ch = g_capture[u][c];
+                    if (ch.enabled && ch.pin == pin && (ch.edge & edge) && ch.cb)
+                    {
+                        captures[capture_count++] = {ch, u, c};
+                    }
+                }
+            }
+        }
+        // Прерывание не в IRAM: вызывается после операции с flash, фронт MCPWM уже защёлкнут
+        if (isr || capture_count)
+        {
+            sim_flash_cache_wait();
+        }
+        if (isr)
+        {
+            isr();
+        }
+        for (int i = 0; i < capture_count; ++i)
+        {
+            cap_event_data_t edata = {level ? MCPWM_POS_EDGE : MCPWM_NEG_EDGE, (uint32_t)(t_us * APB_TICKS_PER_US)};
+            captures[i].ch.cb((mcpwm_unit_t)captures[i].unit, (mcpwm_capture_channel_id_t)captures[i].channel, &edata,
+                              captures[i].ch.user_data);
+        }
+    }
+
+    void schedule(const EchoEvent &e)
+    {
+        std::lock_guard<std::mutex> lock(g_event_mutex);
+        g_events.push(e);
+        g_event_cv.notify_all();
+    }
+
+    // Поток "прерываний": выставляет уровни на пинах эха в нужный момент и вызывает ISR.
+    void event_loop()
+    {
+        sim_set_thread_name("sim_gpio_isr");
+        std::unique_lock<std::mutex> lock(g_event_mutex);
+        for (;;)
+        {
+            if (g_events.empty())
+            {
+                g_event_cv.wait(lock);
+                continue;
+            }
+            EchoEvent next = g_events.top();
+            uint64_t now = sim_micros();
+            if (next.t_us > now)
+            {
+                uint64_t wait = next.t_us - now;
+                // Последние сотни микросекунд дожидаемся активно: sleep на хосте слишком грубый.
+                if (wait > 300)
+                {
+                    g_event_cv.wait_for(lock, std::chrono::microseconds(wait - 200));
+                }
+                else
+                {
+                    lock.unlock();
+                    while (sim_micros() < next.t_us)
+                    {
+                    }
+                    lock.lock();
+                }
+                continue;
+            }
+            g_events.pop();
+            lock.unlock();
+            if (next.level == LOW)
+            {
+                std::lock_guard<std::mutex> script_lock(g_script_mutex);
+                if (next.gen != g_sonar[next.sensor].gen)
+                {
+                    lock.lock();
+                    continue;
+                }
+            }
+            set_level(next.pin, next.level, next.t_us);
+            if (next.level == LOW)
+            {
+                sim_stats_echo(next.sensor);
+            }
+            lock.lock();
+        }
+    }
+
+    // Путь импульса от датчика a через препятствия к датчику b, мкс
+    uint64_t crosstalk_path_us(int a, int b)
+    {
+        float da = g_sonar[a].d;
+        float db = g_sonar[b].d;
+        float d = (da < 0) ? db : (db < 0) ? da : (da + db) / 2.0f;
+        return d < 0 ? 0 : (uint64_t)(d * 58.0f);
+    }
+
+    // Датчик listener услышал импульс source: выход гаснет раньше собственного эха.
+    void maybe_crosstalk(int listener, int source)
+    {
+        SonarState &l = g_sonar[listener];
+        uint64_t path = crosstalk_path_us(listener, source);
+        if (path == 0)
+        {
+            return;
+        }
+        uint64_t arrival = g_sonar[source].trig_us + ECHO_DELAY_US + path;
+        std::uniform_int_distribution<int> pct(0, 99);
+        if (arrival <= l.rise_us || arrival >= l.fall_us || pct(g_rng) >= g_crosstalk_pct)
+        {
+            return;
+        }
+        l.fall_us = arrival;
+        l.gen++;
+        schedule({arrival, SENSOR_PINS[listener].echo, LOW, listener, l.gen});
+    }
+
+    void on_trigger(int sensor, uint64_t now)
+    {
+        sim_stats_trigger(sensor, now);
+        float d = distance_at(sensor, now);
+        std::uniform_int_distribution<int> pct(0, 99);
+        std::normal_distribution<double> jitter(0.0, (double)g_jitter_us);
+        uint64_t rise = now + ECHO_DELAY_US;
+        double width = NO_ECHO_WIDTH_US;
+
+        std::lock_guard<std::mutex> lock(g_script_mutex);
+        if (d >= 0 && d <= 600.0f && pct(g_rng) >= g_drop_pct)
+        {
+            width = d * 58.0 + jitter(g_rng);
+            if (width < 10)
+            {
+                width = 10;
+            }
+        }
+        SonarState &s = g_sonar[sensor];
+        s.trig_us = now;
+        s.rise_us = rise;
+        s.fall_us = rise + (uint64_t)width;
+        s.d = (width < NO_ECHO_WIDTH_US) ? d : NO_ECHO;
+        s.gen++;
+        schedule({rise, SENSOR_PINS[sensor].echo, HIGH, sensor, s.gen});
+        schedule({s.fall_us, SENSOR_PINS[sensor].echo, LOW, sensor, s.gen});
+
+        if (g_crosstalk_pct <= 0)
+        {
+            return;
+        }
+        for (int other = 0; other < NUM_SENSORS; ++other)
+        {
+            if (other == sensor || now - g_sonar[other].trig_us > NO_ECHO_WIDTH_US)
+            {
+                continue;
+            }
+            maybe_crosstalk(other, sensor);
+            maybe_crosstalk(sensor, other);
+        }
+    }
+}
+
+void sim_gpio_start()
+{
+    g_jitter_us = sim_env_int("SIM_SONAR_JITTER_US", 30);
+    g_drop_pct = sim_env_int("SIM_SONAR_DROP_PCT", 0);
+    g_crosstalk_pct = sim_env_int("SIM_SONAR_CROSSTALK_PCT", 0);
+    g_rng.seed((unsigned)sim_env_int("SIM_SEED", 1));
+    const char *script = sim_env_str("SIM_DISTANCE_SCRIPT", NULL);
+    if (script)
+    {
+        load_script(script);
+    }
+    g_pins[REVERSE_GEAR_PIN].level = HIGH;
+    sim_gpio_set_reverse((int)sim_env_int("SIM_REVERSE", 0));
+    std::thread(event_loop).detach();
+}
+
+void sim_gpio_set_reverse(int engaged)
+{
+    g_reverse = engaged ? 1 : 0;
+    // Активный уровень задней передачи - LOW (вход с подтяжкой).
+    set_level(REVERSE_GEAR_PIN, engaged ? LOW : HIGH, sim_micros());
+}
+
+int sim_gpio_reverse()
+{
+    return g_reverse;
+}
+
+void sim_sonar_override(const float *distances_cm, int count)
+{
+    std::lock_guard<std::mutex> lock(g_script_mutex);
+    g_override = true;
+    for (int i = 0; i < NUM_SENSORS; ++i)
+    {
+        g_override_d[i] = i < count ? distances_cm[i] : NO_ECHO;
+    }
+}
+
+void sim_sonar_use_script()
+{
+    std::lock_guard<std::mutex> lock(g_script_mutex);
+    g_override = false;
+}
+
+// --- Arduino GPIO API ---
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if (pin >= MAX_PINS)
+    {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+    g_pins[pin].mode = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    if (pin >= MAX_PINS)
+    {
+        return;
+    }
+    uint64_t now = sim_micros();
+    int triggered = -1;
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+        PinState &p = g_pins[pin];
+        if (p.level == LOW && val == HIGH)
+        {
+            p.high_since_us = now;
+        }
+        else if (p.level == HIGH && val == LOW && now - p.high_since_us >= 8)
+        {
+            // Импульс триггера не короче 8 мкс (даташит: 10 мкс) запускает измерение.
+            for (int i = 0; i < NUM_SENSORS; ++i)
+            {
+                if (SENSOR_PINS[i].trig == pin)
+                {
+                    triggered = i;
+                }
+            }
+        }
+        p.level = val ? HIGH : LOW;
+    }
+    if (triggered >= 0)
+    {
+        on_trigger(triggered, now);
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    if (pin >= MAX_PINS)
+    {
+        return LOW;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+    return g_pins[pin].level;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode)
+{
+    if (pin >= MAX_PINS)
+    {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+    g_pins[pin].isr = isr;
+    g_pins[pin].isr_mode = mode;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    if (pin >= MAX_PINS)
+    {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+    g_pins[pin].isr = nullptr;
+    g_pins[pin].isr_mode = 0;
+}
+
+// --- LEDC ---
+
+double ledcSetup(uint8_t chan, double freq, uint8_t bit_num)
+{
+    (void)bit_num;
+    if (chan >= 16)
+    {
+        return 0;
+    }
+    g_ledc[chan].freq = freq;
+    return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t chan)
+{
+    if (chan < 16)
+    {
+        g_ledc[chan].pin = pin;
+    }
+}
+
+void ledcDetachPin(uint8_t pin)
+{
+    for (LedcChannel &c : g_ledc)
+    {
+        if (c.pin == pin)
+        {
+            c.pin = -1;
+        }
+    }
+}
+
+void ledcWrite(uint8_t chan, uint32_t duty)
+{
+    if (chan >= 16)
+    {
+        return;
+    }
+    LedcChannel &c = g_ledc[chan];
+    if (c.pin == BUZZER_PIN && c.duty == 0 && duty > 0)
+    {
+        sim_stats_beep();
+    }
+    c.duty = duty;
+}
+
+double ledcChangeFrequency(uint8_t chan, double freq, uint8_t bit_num)
+{
+    return ledcSetup(chan, freq, bit_num);
+}
+
+// --- MCPWM capture ---
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t mcpwm_num, mcpwm_io_signals_t io_signal, int gpio_num)
+{
+    int channel = (int)io_signal - (int)MCPWM_CAP_0;
+    if (mcpwm_num >= MCPWM_UNIT_MAX || channel < 0 || channel > 2 || gpio_num < 0 || gpio_num >= MAX_PINS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+    g_capture[mcpwm_num][channel].pin = gpio_num;
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_capture_enable_channel(mcpwm_unit_t mcpwm_num, mcpwm_capture_channel_id_t cap_channel,
+                                       const mcpwm_capture_config_t *cap_conf)
+{
+    if (mcpwm_num >= MCPWM_UNIT_MAX || cap_channel > MCPWM_SELECT_CAP2 || !cap_conf)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+    CaptureChannel &ch = g_capture[mcpwm_num][cap_channel];
+    ch.edge = cap_conf->cap_edge;
+    ch.cb = cap_conf->capture_cb;
+    ch.user_data = cap_conf->user_data;
+    ch.enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_capture_disable_channel(mcpwm_unit_t mcpwm_num, mcpwm_capture_channel_id_t cap_channel)
+{
+    if (mcpwm_num >= MCPWM_UNIT_MAX || cap_channel > MCPWM_SELECT_CAP2)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::recursive_mutex> lock(g_pin_mutex);
+    g_capture[mcpwm_num][cap_channel].enabled = false;
+    return ESP_OK;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+class AsyncWebServer;
+class AsyncWebSocket;
+
+// Время симуляции в микросекундах от запуска процесса.
+uint64_t sim_micros();
+void sim_set_thread_name(const char *name);
+
+long sim_env_int(const char *name, long def);
+const char *sim_env_str(const char *name, const char *def);
+
+// Последовательный вывод: консоль и задачи пишут в stdout без перемешивания строк.
+void sim_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// GPIO-модель: ультразвуковые датчики и задняя передача.
+void sim_gpio_start();
+void sim_gpio_set_reverse(int engaged);
+int sim_gpio_reverse();
+void sim_sonar_override(const float *distances_cm, int count);
+void sim_sonar_use_script();
+
+// Реестр веб-объектов для консольных команд.
+void sim_web_register_server(AsyncWebServer *server);
+void sim_web_register_socket(AsyncWebSocket *socket);
+void sim_web_set_clients(const char *url, int count);
+void sim_web_send_text(const char *url, const char *text);
+void sim_web_http(const char *method, const char *url, const char *body);
+
+// Модель отключения кэша flash (sim_partition.cpp): пока идёт стирание или запись раздела,
+// код прошивки из flash на обоих ядрах стоит. Задачи, esp_timer и прерывания ждут здесь.
+void sim_flash_cache_wait();
+struct SimCacheGate
+{
+    ~SimCacheGate()
+    {
+        sim_flash_cache_wait();
+    }
+};
+
+// Счётчики для периодического отчёта.
+void sim_stats_trigger(int sensor, uint64_t t_us);
+void sim_stats_echo(int sensor);
+void sim_stats_frame(size_t len, uint64_t wait_us);
+void sim_stats_ws(const char *url, size_t len, size_t clients, uint64_t fanout_us);
+void sim_stats_ws_drop(const char *url);
+void sim_stats_ws_client(const char *url, uint32_t id, size_t len);
+void sim_stats_beep();
+void sim_stats_timer(uint64_t late_us);
+void sim_stats_flash(bool erase, uint64_t cache_off_us);
+void sim_stats_report();
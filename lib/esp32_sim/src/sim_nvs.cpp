@@ -0,0 +1,109 @@
+// NVS поверх каталога хоста SIM_NVS_DIR: запись пишется во временный файл и переименовывается.
+#include "nvs.h"
+#include "sim_internal.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::mutex g_nvs_mutex;
+    std::vector<std::string> g_namespaces; // handle - индекс + 1
+
+    std::string record_path(nvs_handle_t handle, const char *key)
+    {
+        std::string dir = sim_env_str("SIM_NVS_DIR", "sim/nvs");
+        ::mkdir(dir.c_str(), 0755);
+        return dir + "/" + g_namespaces[handle - 1] + "." + key;
+    }
+
+    bool valid(nvs_handle_t handle)
+    {
+        return handle > 0 && handle <= g_namespaces.size();
+    }
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    (void)open_mode;
+    if (!name || !out_handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(g_nvs_mutex);
+    g_namespaces.push_back(name);
+    *out_handle = (nvs_handle_t)g_namespaces.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    std::lock_guard<std::mutex> lock(g_nvs_mutex);
+    if (!valid(handle) || !key || !length)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    FILE *f = fopen(record_path(handle, key).c_str(), "rb");
+    if (!f)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    if (!out_value)
+    {
+        *length = data.size();
+        return ESP_OK;
+    }
+    if (*length < data.size())
+    {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, data.data(), data.size());
+    *length = data.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    std::lock_guard<std::mutex> lock(g_nvs_mutex);
+    if (!valid(handle) || !key || (!value && length))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::string path = record_path(handle, key);
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+    {
+        return ESP_FAIL;
+    }
+    bool ok = fwrite(value, 1, length, f) == length;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(g_nvs_mutex);
+    return valid(handle) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
@@ -0,0 +1,163 @@
+// Раздел "rec" поверх файла хоста с семантикой NOR-flash.
+//
+// Стирание и запись, как spi_flash в ESP-IDF 4.4, идут с отключённым кэшем: задачи на обоих
+// ядрах, esp_timer и прерывания не в IRAM стоят до конца операции (sim_flash_cache_wait).
+// SIM_FLASH_ERASE_MS - стирание сектора 4 КБ (по умолчанию 45: типовое tSE W25Q/GD25Q, макс. 400).
+// SIM_FLASH_PAGE_US  - запись страницы 256 байт (по умолчанию 700: типовое tPP).
+#include "esp_partition.h"
+#include "sim_internal.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const uint32_t SECTOR_SIZE = 4096;
+    const esp_partition_subtype_t REC_SUBTYPE = 0x40;
+
+    const uint32_t PAGE_SIZE = 256;
+
+    std::mutex g_flash_mutex;
+    esp_partition_t g_rec;
+    FILE *g_file = nullptr;
+
+    // Кэш отключён, пока g_cache_mutex захвачен потоком, выполняющим операцию
+    std::mutex g_cache_mutex;
+    std::atomic<bool> g_cache_off{false};
+
+    void cache_off(bool erase, uint64_t duration_us)
+    {
+        std::lock_guard<std::mutex> lock(g_cache_mutex);
+        g_cache_off = true;
+        std::this_thread::sleep_for(std::chrono::microseconds(duration_us));
+        g_cache_off = false;
+        sim_stats_flash(erase, duration_us);
+    }
+
+    bool open_rec()
+    {
+        if (g_file)
+        {
+            return true;
+        }
+        std::string dir = sim_env_str("SIM_FLASH_DIR", "sim/flash");
+        ::mkdir(dir.c_str(), 0755);
+        std::string path = dir + "/rec.bin";
+        uint32_t size = (uint32_t)sim_env_int("SIM_REC_PARTITION_KB", 8192) * 1024;
+
+        g_file = fopen(path.c_str(), "r+b");
+        if (!g_file)
+        {
+            g_file = fopen(path.c_str(), "w+b");
+        }
+        if (!g_file)
+        {
+            return false;
+        }
+        // Новый или укороченный образ дополняется стёртыми байтами
+        fseek(g_file, 0, SEEK_END);
+        long have = ftell(g_file);
+        if (have < (long)size)
+        {
+            std::vector<uint8_t> erased(size - have, 0xFF);
+            fwrite(erased.data(), 1, erased.size(), g_file);
+            fflush(g_file);
+        }
+        g_rec.type = ESP_PARTITION_TYPE_DATA;
+        g_rec.subtype = REC_SUBTYPE;
+        g_rec.address = 0x400000;
+        g_rec.size = size;
+        strcpy(g_rec.label, "rec");
+        g_rec.encrypted = false;
+        return true;
+    }
+
+    bool in_range(const esp_partition_t *p, size_t offset, size_t size)
+    {
+        return p == &g_rec && offset <= p->size && size <= p->size - offset;
+    }
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    std::lock_guard<std::mutex> lock(g_flash_mutex);
+    if (type != ESP_PARTITION_TYPE_DATA || (subtype != REC_SUBTYPE && subtype != ESP_PARTITION_SUBTYPE_ANY) ||
+        (label && strcmp(label, "rec") != 0) || !open_rec())
+    {
+        return nullptr;
+    }
+    return &g_rec;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    std::lock_guard<std::mutex> lock(g_flash_mutex);
+    if (!in_range(partition, src_offset, size) || !dst)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    fseek(g_file, (long)src_offset, SEEK_SET);
+    return fread(dst, 1, size, g_file) == size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    std::lock_guard<std::mutex> lock(g_flash_mutex);
+    if (!in_range(partition, dst_offset, size) || !src)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::vector<uint8_t> cur(size);
+    fseek(g_file, (long)dst_offset, SEEK_SET);
+    if (fread(cur.data(), 1, size, g_file) != size)
+    {
+        return ESP_FAIL;
+    }
+    const uint8_t *in = (const uint8_t *)src;
+    for (size_t i = 0; i < size; ++i)
+    {
+        cur[i] &= in[i];
+    }
+    fseek(g_file, (long)dst_offset, SEEK_SET);
+    bool ok = fwrite(cur.data(), 1, size, g_file) == size;
+    fflush(g_file);
+    uint32_t pages = (dst_offset % PAGE_SIZE + size + PAGE_SIZE - 1) / PAGE_SIZE;
+    cache_off(false, (uint64_t)pages * sim_env_int("SIM_FLASH_PAGE_US", 700));
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    std::lock_guard<std::mutex> lock(g_flash_mutex);
+    if (!in_range(partition, offset, size) || offset % SECTOR_SIZE || size % SECTOR_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::vector<uint8_t> erased(size, 0xFF);
+    fseek(g_file, (long)offset, SEEK_SET);
+    bool ok = fwrite(erased.data(), 1, size, g_file) == size;
+    fflush(g_file);
+    // Между секторами кэш включается (CONFIG_SPI_FLASH_YIELD_DURING_ERASE)
+    for (size_t i = 0; i < size / SECTOR_SIZE; ++i)
+    {
+        cache_off(true, (uint64_t)sim_env_int("SIM_FLASH_ERASE_MS", 45) * 1000);
+    }
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+void sim_flash_cache_wait()
+{
+    if (!g_cache_off)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_cache_mutex);
+}
@@ -0,0 +1,255 @@
+// esp_timer: один поток-диспетчер с очередью сроков, как задача esp_timer в ESP-IDF.
+#include "esp_timer.h"
+#include "sim_internal.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    bool armed = false;
+    uint64_t deadline_us = 0;
+    uint64_t period_us = 0; // 0 - однократный
+};
+
+namespace
+{
+    // Не разрушаются при выходе: диспетчер ждёт на них до конца процесса (выход из main() теста)
+    std::mutex &g_timer_mutex = *new std::mutex;
+    std::condition_variable &g_timer_cv = *new std::condition_variable;
+    std::vector<esp_timer *> g_timers;
+    bool g_dispatcher_started = false;
+
+    void dispatcher_loop()
+    {
+        sim_set_thread_name("esp_timer");
+        std::unique_lock<std::mutex> lock(g_timer_mutex);
+        for (;;)
+        {
+            esp_timer *next = nullptr;
+            for (esp_timer *t : g_timers)
+            {
+                if (t->armed && (!next || t->deadline_us < next->deadline_us))
+                {
+                    next = t;
+                }
+            }
+            if (!next)
+            {
+                g_timer_cv.wait(lock);
+                continue;
+            }
+            uint64_t now = sim_micros();
+            if (next->deadline_us > now)
+            {
+                g_timer_cv.wait_for(lock, std::chrono::microseconds(next->deadline_us - now));
+                continue;
+            }
+            if (next->period_us)
+            {
+                next->deadline_us += next->period_us;
+            }
+            else
+            {
+                next->armed = false;
+            }
+            esp_timer_cb_t cb = next->callback;
+            void *arg = next->arg;
+            uint64_t due_us = next->period_us ? next->deadline_us - next->period_us : next->deadline_us;
+            lock.unlock();
+            sim_flash_cache_wait();
+            sim_stats_timer(sim_micros() - due_us);
+            cb(arg);
+            lock.lock();
+        }
+    }
+
+    esp_err_t arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+    {
+        if (!timer)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+        std::lock_guard<std::mutex> lock(g_timer_mutex);
+        if (timer->armed)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+        timer->armed = true;
+        timer->deadline_us = sim_micros() + timeout_us;
+        timer->period_us = period_us;
+        g_timer_cv.notify_one();
+        return ESP_OK;
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !create_args->callback || !out_handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_timer *timer = new esp_timer();
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+
+    std::lock_guard<std::mutex> lock(g_timer_mutex);
+    g_timers.push_back(timer);
+    if (!g_dispatcher_started)
+    {
+        g_dispatcher_started = true;
+        std::thread(dispatcher_loop).detach();
+    }
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return arm(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return arm(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(g_timer_mutex);
+    if (!timer->armed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    g_timer_cv.notify_one();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(g_timer_mutex);
+    if (timer->armed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (size_t i = 0; i < g_timers.size(); ++i)
+    {
+        if (g_timers[i] == timer)
+        {
+            g_timers.erase(g_timers.begin() + i);
+            break;
+        }
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::mutex> lock(g_timer_mutex);
+    return timer && timer->armed;
+}
+
+// Программные таймеры FreeRTOS поверх того же диспетчера
+#include "freertos/timers.h"
+
+struct tmrTimerControl
+{
+    esp_timer_handle_t timer;
+    TimerCallbackFunction_t callback;
+    void *id;
+    uint64_t period_us;
+    bool auto_reload;
+};
+
+static void freertos_timer_trampoline(void *arg)
+{
+    TimerHandle_t t = (TimerHandle_t)arg;
+    t->callback(t);
+}
+
+TimerHandle_t xTimerCreate(const char *pcTimerName, TickType_t xTimerPeriodInTicks, UBaseType_t uxAutoReload,
+                           void *pvTimerID, TimerCallbackFunction_t pxCallbackFunction)
+{
+    if (!pxCallbackFunction || xTimerPeriodInTicks == 0)
+    {
+        return nullptr;
+    }
+    tmrTimerControl *t = new tmrTimerControl();
+    t->callback = pxCallbackFunction;
+    t->id = pvTimerID;
+    t->period_us = (uint64_t)xTimerPeriodInTicks * portTICK_PERIOD_MS * 1000;
+    t->auto_reload = uxAutoReload != 0;
+    esp_timer_create_args_t args = {};
+    args.callback = freertos_timer_trampoline;
+    args.arg = t;
+    args.name = pcTimerName;
+    if (esp_timer_create(&args, &t->timer) != ESP_OK)
+    {
+        delete t;
+        return nullptr;
+    }
+    return t;
+}
+
+BaseType_t xTimerStart(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    return xTimerReset(xTimer, xTicksToWait);
+}
+
+BaseType_t xTimerStop(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    (void)xTicksToWait;
+    if (!xTimer)
+    {
+        return pdFAIL;
+    }
+    esp_timer_stop(xTimer->timer);
+    return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t xTimer, TickType_t xTicksToWait)
+{
+    (void)xTicksToWait;
+    if (!xTimer)
+    {
+        return pdFAIL;
+    }
+    esp_timer_stop(xTimer->timer);
+    esp_err_t err = xTimer->auto_reload ? esp_timer_start_periodic(xTimer->timer, xTimer->period_us)
+                                        : esp_timer_start_once(xTimer->timer, xTimer->period_us);
+    return err == ESP_OK ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTimerResetFromISR(TimerHandle_t xTimer, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return xTimerReset(xTimer, 0);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t xTimer)
+{
+    return xTimer && esp_timer_is_active(xTimer->timer) ? pdTRUE : pdFALSE;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t xTimer)
+{
+    return xTimer ? xTimer->id : nullptr;
+}
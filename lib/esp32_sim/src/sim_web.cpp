@@ -0,0 +1,1049 @@
+// Веб-сервер и WebSocket без сети.
+//
+// SIM_WS_CLIENTS / SIM_STREAM_CLIENTS - число клиентов /ws и /ws_stream после server.begin().
+// SIM_CLIENT_KBPS                     - скорость канала клиентов, кбит/с, через запятую
+//                                       (i-й клиент берёт i-е значение, остальные - последнее).
+// SIM_HTTP_KBPS                       - скорость выгрузки HTTP-ответов, кбит/с (0 - без ограничения).
+#include <ESPAsyncWebServer.h>
+#include "lwip/tcpip.h"
+#include "sim_internal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Серверы и сокеты - глобальные объекты прошивки, регистрируются при статической инициализации.
+    std::vector<AsyncWebServer *> &servers()
+    {
+        static std::vector<AsyncWebServer *> list;
+        return list;
+    }
+
+    std::vector<AsyncWebSocket *> &sockets()
+    {
+        static std::vector<AsyncWebSocket *> list;
+        return list;
+    }
+
+    std::vector<uint32_t> g_link_rates;
+    uint32_t g_connected_total = 0;
+
+    AsyncWebSocket *find_socket(const char *url)
+    {
+        for (AsyncWebSocket *s : sockets())
+        {
+            if (strcmp(s->url(), url) == 0)
+            {
+                return s;
+            }
+        }
+        return nullptr;
+    }
+
+    uint32_t next_link_rate()
+    {
+        if (g_link_rates.empty())
+        {
+            std::stringstream ss(sim_env_str("SIM_CLIENT_KBPS", "8000"));
+            std::string item;
+            while (std::getline(ss, item, ','))
+            {
+                g_link_rates.push_back((uint32_t)std::max(1L, strtol(item.c_str(), NULL, 10)) * 1000 / 8);
+            }
+        }
+        size_t idx = std::min<size_t>(g_connected_total++, g_link_rates.size() - 1);
+        return g_link_rates[idx];
+    }
+
+    bool uri_matches(const String &pattern, const String &url)
+    {
+        String path = url;
+        int q = path.indexOf('?');
+        if (q >= 0)
+        {
+            path = path.substring(0, q);
+        }
+        if (pattern.endsWith("*"))
+        {
+            return path.startsWith(pattern.substring(0, pattern.length() - 1));
+        }
+        return path == pattern;
+    }
+}
+
+// --- Ответы ---
+
+AsyncBasicResponse::AsyncBasicResponse(int code, const String &contentType, const String &content)
+    : _content(content)
+{
+    _code = code;
+    _contentType = contentType;
+    _contentLength = content.length();
+}
+
+size_t AsyncBasicResponse::_simFill(uint8_t *data, size_t maxLen, size_t index)
+{
+    size_t n = std::min(maxLen, _contentLength - std::min(index, _contentLength));
+    memcpy(data, _content.c_str() + index, n);
+    return n;
+}
+
+AsyncProgmemResponse::AsyncProgmemResponse(int code, const String &contentType, const uint8_t *content, size_t len)
+    : _content(content)
+{
+    _code = code;
+    _contentType = contentType;
+    _contentLength = len;
+}
+
+size_t AsyncProgmemResponse::_simFill(uint8_t *data, size_t maxLen, size_t index)
+{
+    size_t n = std::min(maxLen, _contentLength - std::min(index, _contentLength));
+    memcpy(data, _content + index, n);
+    return n;
+}
+
+AsyncCallbackResponse::AsyncCallbackResponse(const String &contentType, size_t len, AwsResponseFiller callback)
+    : _content(callback)
+{
+    _contentType = contentType;
+    _contentLength = len;
+}
+
+size_t AsyncCallbackResponse::_simFill(uint8_t *data, size_t maxLen, size_t index)
+{
+    if (index >= _contentLength)
+    {
+        return 0;
+    }
+    return _content(data, std::min(maxLen, _contentLength - index), index);
+}
+
+AsyncChunkedResponse::AsyncChunkedResponse(const String &contentType, AwsResponseFiller callback)
+    : _content(callback)
+{
+    _contentType = contentType;
+    _chunked = true;
+}
+
+size_t AsyncChunkedResponse::_simFill(uint8_t *data, size_t maxLen, size_t index)
+{
+    return _content(data, maxLen, index);
+}
+
+AsyncResponseStream::AsyncResponseStream(const String &contentType, size_t bufferSize)
+{
+    _contentType = contentType;
+    _content.reserve(bufferSize);
+}
+
+size_t AsyncResponseStream::_simFill(uint8_t *data, size_t maxLen, size_t index)
+{
+    if (index >= _content.size())
+    {
+        return 0;
+    }
+    size_t n = std::min(maxLen, _content.size() - index);
+    memcpy(data, _content.data() + index, n);
+    return n;
+}
+
+size_t AsyncResponseStream::write(const uint8_t *data, size_t len)
+{
+    _content.append((const char *)data, len);
+    _contentLength = _content.size();
+    return len;
+}
+
+size_t AsyncResponseStream::write(uint8_t data)
+{
+    return write(&data, 1);
+}
+
+// --- Запрос ---
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethod method, const String &url) : _method(method), _url(url)
+{
+    int q = url.indexOf('?');
+    if (q < 0)
+    {
+        return;
+    }
+    _url = url.substring(0, q);
+    std::stringstream ss(url.substring(q + 1).c_str());
+    std::string pair;
+    while (std::getline(ss, pair, '&'))
+    {
+        size_t eq = pair.find('=');
+        String name = pair.substr(0, eq).c_str();
+        String value = eq == std::string::npos ? String() : String(pair.substr(eq + 1).c_str());
+        _params.push_back(new AsyncWebParameter(name, value));
+    }
+}
+
+AsyncWebServerRequest::~AsyncWebServerRequest()
+{
+    _client._connected = false;
+    if (_onDisconnectfn)
+    {
+        _onDisconnectfn();
+    }
+    for (AsyncWebHeader *h : _headers)
+    {
+        delete h;
+    }
+    for (AsyncWebParameter *p : _params)
+    {
+        delete p;
+    }
+    delete _response;
+    if (_tempObject)
+    {
+        free(_tempObject);
+    }
+}
+
+const char *AsyncWebServerRequest::methodToString() const
+{
+    return _method == HTTP_POST ? "POST" : "GET";
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response)
+{
+    if (_response)
+    {
+        delete response;
+        return;
+    }
+    _response = response;
+}
+
+void AsyncWebServerRequest::send(int code, const String &contentType, const String &content)
+{
+    send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send_P(int code, const String &contentType, const uint8_t *content, size_t len,
+                                   AwsTemplateProcessor callback)
+{
+    send(beginResponse_P(code, contentType, content, len, callback));
+}
+
+void AsyncWebServerRequest::send_P(int code, const String &contentType, const char *content,
+                                   AwsTemplateProcessor callback)
+{
+    send(beginResponse_P(code, contentType, (const uint8_t *)content, strlen(content), callback));
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const String &contentType,
+                                                             const String &content)
+{
+    return new AsyncBasicResponse(code, contentType, content);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(const String &contentType, size_t len,
+                                                             AwsResponseFiller callback,
+                                                             AwsTemplateProcessor templateCallback)
+{
+    (void)templateCallback;
+    return new AsyncCallbackResponse(contentType, len, callback);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginChunkedResponse(const String &contentType,
+                                                                    AwsResponseFiller callback,
+                                                                    AwsTemplateProcessor templateCallback)
+{
+    (void)templateCallback;
+    return new AsyncChunkedResponse(contentType, callback);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse_P(int code, const String &contentType,
+                                                               const uint8_t *content, size_t len,
+                                                               AwsTemplateProcessor callback)
+{
+    (void)callback;
+    return new AsyncProgmemResponse(code, contentType, content, len);
+}
+
+AsyncResponseStream *AsyncWebServerRequest::beginResponseStream(const String &contentType, size_t bufferSize)
+{
+    return new AsyncResponseStream(contentType, bufferSize);
+}
+
+bool AsyncWebServerRequest::hasHeader(const String &name) const
+{
+    return getHeader(name) != NULL;
+}
+
+AsyncWebHeader *AsyncWebServerRequest::getHeader(const String &name) const
+{
+    for (AsyncWebHeader *h : _headers)
+    {
+        if (h->name().equalsIgnoreCase(name))
+        {
+            return h;
+        }
+    }
+    return NULL;
+}
+
+bool AsyncWebServerRequest::hasParam(const String &name, bool post, bool file) const
+{
+    return getParam(name, post, file) != NULL;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(const String &name, bool post, bool file) const
+{
+    (void)file;
+    for (AsyncWebParameter *p : _params)
+    {
+        if (p->name() == name && p->isPost() == post)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(size_t num) const
+{
+    return num < _params.size() ? _params[num] : NULL;
+}
+
+const String &AsyncWebServerRequest::arg(const String &name) const
+{
+    static const String empty;
+    for (AsyncWebParameter *p : _params)
+    {
+        if (p->name() == name)
+        {
+            return p->value();
+        }
+    }
+    return empty;
+}
+
+bool AsyncWebServerRequest::hasArg(const char *name) const
+{
+    for (AsyncWebParameter *p : _params)
+    {
+        if (p->name() == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- Обработчики ---
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest *request)
+{
+    return (_method & request->method()) && uri_matches(_uri, request->url());
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest *request)
+{
+    if (_onRequest)
+    {
+        _onRequest(request);
+    }
+    else
+    {
+        request->send(500);
+    }
+}
+
+void AsyncCallbackWebHandler::handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index,
+                                         size_t total)
+{
+    if (_onBody)
+    {
+        _onBody(request, data, len, index, total);
+    }
+}
+
+bool AsyncStaticWebHandler::canHandle(AsyncWebServerRequest *request)
+{
+    return request->method() == HTTP_GET && request->url().startsWith(_uri);
+}
+
+void AsyncStaticWebHandler::handleRequest(AsyncWebServerRequest *request)
+{
+    String path = _path + request->url().substring(_uri.length());
+    if (path.endsWith("/"))
+    {
+        path += _default_file;
+    }
+    File f = _fs.open(path, "r");
+    if (!f || f.isDirectory())
+    {
+        request->send(404);
+        return;
+    }
+    std::string content;
+    uint8_t buf[512];
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) > 0)
+    {
+        content.append((const char *)buf, n);
+    }
+    AsyncWebServerResponse *response = request->beginResponse(200, "application/octet-stream", content.c_str());
+    if (_cache_control.length())
+    {
+        response->addHeader("Cache-Control", _cache_control);
+    }
+    request->send(response);
+}
+
+// --- WebSocket ---
+
+AsyncWebSocketClient::AsyncWebSocketClient(AsyncWebSocket *server, uint32_t id, uint32_t link_bytes_per_s)
+    : _server(server), _clientId(id), _rate(link_bytes_per_s), _last_drain_us(micros())
+{
+}
+
+AsyncWebSocketClient::~AsyncWebSocketClient()
+{
+    for (Pending &p : _queue)
+    {
+        if (p.buffer)
+        {
+            (*p.buffer)--;
+        }
+    }
+}
+
+void AsyncWebSocketClient::close(uint16_t code, const char *message)
+{
+    (void)code;
+    (void)message;
+    _status = WS_DISCONNECTING;
+}
+
+// Канал клиента "выкачивает" очередь со скоростью _rate байт/с.
+void AsyncWebSocketClient::_simDrain()
+{
+    unsigned long now = micros();
+    uint64_t budget = (uint64_t)(now - _last_drain_us) * _rate / 1000000;
+    if (budget == 0)
+    {
+        return;
+    }
+    _last_drain_us = now;
+    while (!_queue.empty() && budget > 0)
+    {
+        Pending &p = _queue.front();
+        size_t n = (size_t)std::min<uint64_t>(budget, p.remaining);
+        p.remaining -= n;
+        budget -= n;
+        if (p.remaining == 0)
+        {
+            sim_stats_ws_client(_server->url(), _clientId, p.length);
+            if (p.buffer)
+            {
+                (*p.buffer)--;
+            }
+            _queue.pop_front();
+        }
+    }
+    if (_queue.empty())
+    {
+        _last_drain_us = now;
+    }
+}
+
+void AsyncWebSocketClient::_simQueue(size_t len, AsyncWebSocketMessageBuffer *buffer)
+{
+    _simDrain();
+    if (_queue.empty())
+    {
+        _last_drain_us = micros();
+    }
+    if (buffer)
+    {
+        (*buffer)++;
+    }
+    _queue.push_back({len + 4, len, buffer});
+}
+
+size_t AsyncWebSocketClient::queueLen()
+{
+    std::lock_guard<std::recursive_mutex> lock(_server->_lock);
+    _simDrain();
+    return _queue.size();
+}
+
+bool AsyncWebSocketClient::queueIsFull()
+{
+    return queueLen() >= WS_MAX_QUEUED_MESSAGES || _status != WS_CONNECTED;
+}
+
+bool AsyncWebSocketClient::canSend()
+{
+    return queueLen() < WS_MAX_QUEUED_MESSAGES;
+}
+
+void AsyncWebSocketClient::text(const char *message, size_t len)
+{
+    std::lock_guard<std::recursive_mutex> lock(_server->_lock);
+    if (_status == WS_CONNECTED && !queueIsFull())
+    {
+        _simQueue(len, nullptr);
+        // Рассылки идут общими буферами; отдельное сообщение клиенту - ответ, показываем его
+        sim_log("[Sim] %s#%u <- %.*s\n", _server->url(), _clientId, (int)std::min<size_t>(len, 120),
+                message);
+    }
+}
+
+void AsyncWebSocketClient::text(AsyncWebSocketMessageBuffer *buffer)
+{
+    std::lock_guard<std::recursive_mutex> lock(_server->_lock);
+    if (buffer && _status == WS_CONNECTED && !queueIsFull())
+    {
+        _simQueue(buffer->length(), buffer);
+    }
+}
+
+void AsyncWebSocketClient::binary(const char *message, size_t len)
+{
+    std::lock_guard<std::recursive_mutex> lock(_server->_lock);
+    if (_status == WS_CONNECTED && !queueIsFull())
+    {
+        _simQueue(len, nullptr);
+    }
+}
+
+void AsyncWebSocketClient::binary(AsyncWebSocketMessageBuffer *buffer)
+{
+    text(buffer);
+}
+
+AsyncWebSocket::AsyncWebSocket(const String &url) : _url(url)
+{
+    sim_web_register_socket(this);
+}
+
+AsyncWebSocket::~AsyncWebSocket()
+{
+    for (AsyncWebSocketClient *c : _clients)
+    {
+        delete c;
+    }
+}
+
+size_t AsyncWebSocket::count() const
+{
+    std::lock_guard<std::recursive_mutex> lock(const_cast<AsyncWebSocket *>(this)->_lock);
+    return std::count_if(_clients.begin(), _clients.end(),
+                         [](AsyncWebSocketClient *c) { return c->status() == WS_CONNECTED; });
+}
+
+AsyncWebSocketClient *AsyncWebSocket::client(uint32_t id)
+{
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    for (AsyncWebSocketClient *c : _clients)
+    {
+        if (c->id() == id && c->status() == WS_CONNECTED)
+        {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+void AsyncWebSocket::close(uint32_t id, uint16_t code, const char *message)
+{
+    AsyncWebSocketClient *c = client(id);
+    if (c)
+    {
+        c->close(code, message);
+    }
+}
+
+void AsyncWebSocket::closeAll(uint16_t code, const char *message)
+{
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    for (AsyncWebSocketClient *c : _clients)
+    {
+        c->close(code, message);
+    }
+}
+
+void AsyncWebSocket::cleanupClients(uint16_t maxClients)
+{
+    (void)maxClients;
+}
+
+bool AsyncWebSocket::availableForWrite(uint32_t id)
+{
+    AsyncWebSocketClient *c = client(id);
+    return c && !c->queueIsFull();
+}
+
+bool AsyncWebSocket::availableForWriteAll()
+{
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    for (AsyncWebSocketClient *c : _clients)
+    {
+        if (c->queueIsFull())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AsyncWebSocket::_fanOut(const char *message, size_t len, bool binary)
+{
+    uint64_t start = sim_micros();
+    size_t delivered = 0;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_lock);
+        // Как в библиотеке: одна общая копия сообщения и постановка в очередь каждого клиента.
+        AsyncWebSocketMessageBuffer *buffer = makeBuffer((uint8_t *)message, len);
+        buffer->lock();
+        for (AsyncWebSocketClient *c : _clients)
+        {
+            if (c->status() != WS_CONNECTED)
+            {
+                continue;
+            }
+            if (c->queueIsFull())
+            {
+                sim_stats_ws_drop(url());
+                continue;
+            }
+            binary ? c->binary(buffer) : c->text(buffer);
+            delivered++;
+        }
+        buffer->unlock();
+        _cleanBuffers();
+    }
+    sim_stats_ws(url(), len, delivered, sim_micros() - start);
+}
+
+void AsyncWebSocket::text(uint32_t id, const char *message, size_t len)
+{
+    AsyncWebSocketClient *c = client(id);
+    if (c)
+    {
+        c->text(message, len);
+    }
+}
+
+void AsyncWebSocket::textAll(const char *message, size_t len)
+{
+    _fanOut(message, len, false);
+}
+
+void AsyncWebSocket::textAll(AsyncWebSocketMessageBuffer *buffer)
+{
+    if (buffer)
+    {
+        _fanOut((const char *)buffer->get(), buffer->length(), false);
+    }
+}
+
+void AsyncWebSocket::binary(uint32_t id, const char *message, size_t len)
+{
+    AsyncWebSocketClient *c = client(id);
+    if (c)
+    {
+        c->binary(message, len);
+    }
+}
+
+void AsyncWebSocket::binaryAll(const char *message, size_t len)
+{
+    _fanOut(message, len, true);
+}
+
+void AsyncWebSocket::binaryAll(AsyncWebSocketMessageBuffer *buffer)
+{
+    if (buffer)
+    {
+        _fanOut((const char *)buffer->get(), buffer->length(), true);
+    }
+}
+
+AsyncWebSocketMessageBuffer *AsyncWebSocket::makeBuffer(size_t size)
+{
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    AsyncWebSocketMessageBuffer *buffer = new AsyncWebSocketMessageBuffer(size);
+    _buffers.push_back(buffer);
+    return buffer;
+}
+
+AsyncWebSocketMessageBuffer *AsyncWebSocket::makeBuffer(uint8_t *data, size_t size)
+{
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    AsyncWebSocketMessageBuffer *buffer = new AsyncWebSocketMessageBuffer(data, size);
+    _buffers.push_back(buffer);
+    return buffer;
+}
+
+void AsyncWebSocket::_cleanBuffers()
+{
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    for (AsyncWebSocketClient *c : _clients)
+    {
+        c->_simDrain();
+    }
+    _buffers.remove_if([](AsyncWebSocketMessageBuffer *b) {
+        if (b->canDelete())
+        {
+            delete b;
+            return true;
+        }
+        return false;
+    });
+}
+
+AsyncWebSocketClient *AsyncWebSocket::_simConnect(uint32_t link_bytes_per_s)
+{
+    AsyncWebSocketClient *c;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_lock);
+        c = new AsyncWebSocketClient(this, _cNextId++, link_bytes_per_s);
+        _clients.push_back(c);
+    }
+    if (_eventHandler)
+    {
+        _eventHandler(this, c, WS_EVT_CONNECT, NULL, NULL, 0);
+    }
+    return c;
+}
+
+void AsyncWebSocket::_simDisconnect(AsyncWebSocketClient *client)
+{
+    {
+        std::lock_guard<std::recursive_mutex> lock(_lock);
+        client->_status = WS_DISCONNECTED;
+    }
+    if (_eventHandler)
+    {
+        _eventHandler(this, client, WS_EVT_DISCONNECT, NULL, NULL, 0);
+    }
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    _clients.remove(client);
+    delete client;
+}
+
+void AsyncWebSocket::_simReceive(AsyncWebSocketClient *client, const uint8_t *data, size_t len, bool binary)
+{
+    if (!_eventHandler)
+    {
+        return;
+    }
+    AwsFrameInfo info = {};
+    info.message_opcode = binary ? WS_BINARY : WS_TEXT;
+    info.opcode = info.message_opcode;
+    info.final = 1;
+    info.len = len;
+    std::vector<uint8_t> copy(data, data + len);
+    _eventHandler(this, client, WS_EVT_DATA, &info, copy.data(), len);
+}
+
+// --- Сервер ---
+
+AsyncWebServer::AsyncWebServer(uint16_t port) : _port(port)
+{
+    sim_web_register_server(this);
+}
+
+AsyncWebServer::~AsyncWebServer()
+{
+}
+
+void AsyncWebServer::begin()
+{
+    sim_log("[Sim] HTTP server on virtual port %u\n", _port);
+    sim_web_set_clients("/ws", (int)sim_env_int("SIM_WS_CLIENTS", -1));
+    sim_web_set_clients("/ws_stream", (int)sim_env_int("SIM_STREAM_CLIENTS", -1));
+}
+
+AsyncWebHandler &AsyncWebServer::addHandler(AsyncWebHandler *handler)
+{
+    _handlers.push_back(handler);
+    return *handler;
+}
+
+bool AsyncWebServer::removeHandler(AsyncWebHandler *handler)
+{
+    _handlers.remove(handler);
+    return true;
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, ArRequestHandlerFunction onRequest)
+{
+    return on(uri, HTTP_ANY, onRequest, nullptr, nullptr);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest)
+{
+    return on(uri, method, onRequest, nullptr, nullptr);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload)
+{
+    return on(uri, method, onRequest, onUpload, nullptr);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload,
+                                            ArBodyHandlerFunction onBody)
+{
+    AsyncCallbackWebHandler *handler = new AsyncCallbackWebHandler(uri, method, onRequest, onUpload, onBody);
+    addHandler(handler);
+    return *handler;
+}
+
+AsyncStaticWebHandler &AsyncWebServer::serveStatic(const char *uri, fs::FS &fs, const char *path,
+                                                   const char *cache_control)
+{
+    AsyncStaticWebHandler *handler = new AsyncStaticWebHandler(uri, fs, path, cache_control);
+    addHandler(handler);
+    return *handler;
+}
+
+void AsyncWebServer::_simRequest(WebRequestMethod method, const String &url, const String &body,
+                                 const std::vector<AsyncWebHeader> &headers)
+{
+    AsyncWebServerRequest *request = new AsyncWebServerRequest(method, url);
+    for (const AsyncWebHeader &h : headers)
+    {
+        request->_headers.push_back(new AsyncWebHeader(h));
+    }
+    AsyncWebHandler *target = nullptr;
+    for (AsyncWebHandler *h : _handlers)
+    {
+        if (h->canHandle(request))
+        {
+            target = h;
+            break;
+        }
+    }
+
+    uint64_t start = sim_micros();
+    if (!target)
+    {
+        if (_notFound)
+        {
+            _notFound(request);
+        }
+    }
+    else
+    {
+        if (body.length())
+        {
+            // SIM_BODY_CHUNK=n - тело приходит кусками по n байт, как TCP-сегменты
+            const char *chunk_env = getenv("SIM_BODY_CHUNK");
+            size_t chunk = chunk_env ? strtoul(chunk_env, NULL, 10) : 0;
+            if (chunk == 0)
+            {
+                chunk = body.length();
+            }
+            for (size_t index = 0; index < body.length(); index += chunk)
+            {
+                size_t len = std::min(chunk, (size_t)body.length() - index);
+                target->handleBody(request, (uint8_t *)body.c_str() + index, len, index, body.length());
+            }
+        }
+        target->handleRequest(request);
+    }
+    uint64_t handled = sim_micros();
+
+    AsyncWebServerResponse *response = request->_response;
+    if (!response)
+    {
+        sim_log("[Sim] %s %s -> no response\n", request->methodToString(), url.c_str());
+        delete request;
+        return;
+    }
+
+    // Ответ выкачивается порциями по размеру TCP-окна, как это делает AsyncTCP.
+    // Бесконечный ответ (поток) обрывается через SIM_HTTP_STREAM_MS - клиент отключается.
+    std::string out;
+    uint8_t chunk[1460];
+    size_t index = 0;
+    uint64_t stream_limit_us = (uint64_t)sim_env_int("SIM_HTTP_STREAM_MS", 3000) * 1000;
+    uint64_t http_bytes_per_s = (uint64_t)sim_env_int("SIM_HTTP_KBPS", 0) * 1000 / 8;
+    for (;;)
+    {
+        if (sim_micros() - handled > stream_limit_us)
+        {
+            sim_log("[Sim] %s %s: client closed the connection after %.1f s\n", request->methodToString(),
+                    url.c_str(), (sim_micros() - handled) / 1e6);
+            break;
+        }
+        size_t n = response->_simFill(chunk, sizeof(chunk), index);
+        if (request->client()->_closed)
+        {
+            sim_log("[Sim] %s %s: connection closed by the server after %u bytes\n", request->methodToString(),
+                    url.c_str(), (unsigned)index);
+            break;
+        }
+        if (n == RESPONSE_TRY_AGAIN)
+        {
+            request->client()->_simWaitPoll(500);
+            continue;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        out.append((const char *)chunk, n);
+        index += n;
+        if (http_bytes_per_s)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(n * 1000000 / http_bytes_per_s));
+        }
+    }
+    uint64_t sent = sim_micros();
+
+    bool printable = response->_contentType.startsWith("text/") ||
+                     response->_contentType.startsWith("application/json");
+    sim_log("[Sim] %s %s -> %d %s, %u bytes, handler %.2f ms, send %.2f ms\n", request->methodToString(), url.c_str(),
+            response->_code, response->_contentType.c_str(), (unsigned)out.size(), (handled - start) / 1000.0,
+            (sent - handled) / 1000.0);
+    for (const AsyncWebHeader &h : response->_headers)
+    {
+        sim_log("[Sim]   %s: %s\n", h.name().c_str(), h.value().c_str());
+    }
+    if (printable && !out.empty())
+    {
+        sim_log("%s\n", out.c_str());
+    }
+    // Тело последнего ответа в файл - для проверки бинарных выгрузок
+    std::string save_path = sim_env_str("SIM_HTTP_SAVE", "");
+    if (!save_path.empty())
+    {
+        FILE *f = fopen(save_path.c_str(), "wb");
+        if (f)
+        {
+            fwrite(out.data(), 1, out.size(), f);
+            fclose(f);
+        }
+    }
+    delete request;
+}
+
+void AsyncClient::_simWaitPoll(uint32_t interval_ms)
+{
+    uint64_t start = sim_micros();
+    while (!_polled && sim_micros() - start < (uint64_t)interval_ms * 1000)
+    {
+        vTaskDelay(1);
+    }
+    _polled = false;
+}
+
+err_t tcpip_try_callback(tcpip_callback_fn function, void *ctx)
+{
+    static std::mutex tcpip_mutex;
+    std::lock_guard<std::mutex> lock(tcpip_mutex);
+    function(ctx);
+    return ERR_OK;
+}
+
+// --- Консольные команды ---
+
+void sim_web_register_server(AsyncWebServer *server)
+{
+    servers().push_back(server);
+}
+
+void sim_web_register_socket(AsyncWebSocket *socket)
+{
+    sockets().push_back(socket);
+}
+
+void sim_web_set_clients(const char *url, int count)
+{
+    AsyncWebSocket *s = find_socket(url);
+    if (!s || count < 0)
+    {
+        return;
+    }
+    while ((int)s->count() < count)
+    {
+        s->_simConnect(next_link_rate());
+    }
+    while ((int)s->count() > count)
+    {
+        AsyncWebSocketClient *victim;
+        {
+            std::lock_guard<std::recursive_mutex> lock(s->_lock);
+            victim = s->getClients().back();
+        }
+        s->_simDisconnect(victim);
+    }
+}
+
+void sim_web_send_text(const char *url, const char *text)
+{
+    // url#id - сообщение только от одного клиента
+    std::string path(url);
+    uint32_t only_id = 0;
+    size_t hash = path.find('#');
+    if (hash != std::string::npos)
+    {
+        only_id = (uint32_t)strtoul(path.c_str() + hash + 1, NULL, 10);
+        path.resize(hash);
+    }
+    AsyncWebSocket *s = find_socket(path.c_str());
+    if (!s)
+    {
+        return;
+    }
+    std::vector<AsyncWebSocketClient *> clients;
+    {
+        std::lock_guard<std::recursive_mutex> lock(s->_lock);
+        clients.assign(s->getClients().begin(), s->getClients().end());
+    }
+    for (AsyncWebSocketClient *c : clients)
+    {
+        if (only_id == 0 || c->id() == only_id)
+        {
+            s->_simReceive(c, (const uint8_t *)text, strlen(text), false);
+        }
+    }
+}
+
+void sim_web_http(const char *method, const char *url, const char *body)
+{
+    if (servers().empty())
+    {
+        return;
+    }
+    WebRequestMethod m = strcmp(method, "POST") == 0 ? HTTP_POST : HTTP_GET;
+    if (m == HTTP_POST)
+    {
+        servers().front()->_simRequest(m, url, body);
+        return;
+    }
+
+    // GET: "<url> [Name:value ...]" - заголовки запроса через пробел
+    std::istringstream in(url);
+    std::string path, token;
+    in >> path;
+    std::vector<AsyncWebHeader> headers;
+    while (in >> token)
+    {
+        size_t colon = token.find(':');
+        if (colon != std::string::npos)
+        {
+            headers.emplace_back(String(token.substr(0, colon).c_str()), String(token.substr(colon + 1).c_str()));
+        }
+    }
+    servers().front()->_simRequest(m, path.c_str(), body, headers);
+}
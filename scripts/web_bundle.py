@@ -0,0 +1,190 @@
+"""Сборка веб-интерфейса из data/ в бандл внутри прошивки.
+
+Каждый файл UI сжимается gzip (если это даёт выигрыш) и кладётся массивом в заголовок
+web_bundle_data.h. Массивы попадают в .rodata, то есть во flash, отображённую в адресное
+пространство: сервер отдаёт их без LittleFS и без копии в RAM (src/web/web_assets.cpp).
+
+Кроме html, каждый файл доступен и под именем с хэшем содержимого (app.3f2a9c1e.js).
+Ссылки в html/css/js переписываются на эти имена, поэтому их можно кэшировать навсегда
+(immutable). Страницы html отдаются с no-cache и проверяются по ETag.
+
+PlatformIO: extra_scripts = pre:scripts/web_bundle.py (заголовок - в $BUILD_DIR/web_bundle).
+Вручную:    python3 scripts/web_bundle.py data out_dir
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+MIME_TYPES = {
+    ".html": "text/html",
+    ".htm": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".mjs": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".jpeg": "image/jpeg",
+    ".gif": "image/gif",
+    ".webp": "image/webp",
+    ".ico": "image/x-icon",
+    ".woff": "font/woff",
+    ".woff2": "font/woff2",
+    ".txt": "text/plain",
+}
+
+# Файлы с текстовыми ссылками на другие ресурсы
+REWRITE_EXTENSIONS = (".html", ".htm", ".css", ".js", ".mjs")
+
+# Настройки в data/ (settings.json, settings_*.bin) - не часть UI
+SKIP_PATTERN = re.compile(r"^settings[._]")
+
+HEADER_NAME = "web_bundle_data.h"
+
+
+def collect_files(data_dir):
+    files = {}
+    for root, _, names in os.walk(data_dir):
+        for name in sorted(names):
+            ext = os.path.splitext(name)[1].lower()
+            if ext not in MIME_TYPES or SKIP_PATTERN.match(name):
+                continue
+            path = os.path.join(root, name)
+            rel = os.path.relpath(path, data_dir).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                files[rel] = f.read()
+    return files
+
+
+def hashed_name(rel, digest):
+    base, ext = os.path.splitext(rel)
+    return "%s.%s%s" % (base, digest[:8], ext)
+
+
+def rewrite_references(content, renames):
+    text = content.decode("utf-8")
+    for rel, new_rel in renames.items():
+        # "app.js", './app.js', url(/img/logo.png), "app.js?v=1"
+        pattern = r"(?<=[\"'(/])" + re.escape(rel) + r"(?=[\"')?#])"
+        text = re.sub(pattern, new_rel, text)
+    return text.encode("utf-8")
+
+
+def is_page(rel):
+    return rel.endswith((".html", ".htm"))
+
+
+def build_bundle(data_dir):
+    files = collect_files(data_dir) if os.path.isdir(data_dir) else {}
+
+    # Сначала ресурсы без ссылок, затем css/js, html - последними: хэш файла считается
+    # после замены ссылок внутри него.
+    def order(rel):
+        if is_page(rel):
+            return 2
+        return 1 if rel.endswith(REWRITE_EXTENSIONS) else 0
+
+    renames = {}
+    assets = []
+    for rel in sorted(files, key=lambda r: (order(r), r)):
+        content = files[rel]
+        if rel.endswith(REWRITE_EXTENSIONS) and renames:
+            content = rewrite_references(content, renames)
+        digest = hashlib.sha256(content).hexdigest()
+        compressed = gzip.compress(content, 9, mtime=0)
+        use_gzip = len(compressed) < len(content) * 0.9
+        assets.append({
+            "path": "/" + rel,
+            "type": MIME_TYPES[os.path.splitext(rel)[1].lower()],
+            "data": compressed if use_gzip else content,
+            "raw_len": len(content),
+            "gzip": use_gzip,
+            "etag": digest[:16],
+            "hashed": None if is_page(rel) else "/" + hashed_name(rel, digest),
+        })
+        if not is_page(rel):
+            renames[rel] = hashed_name(rel, digest)
+    return assets
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def render_header(assets):
+    lines = [
+        "// Сгенерировано scripts/web_bundle.py из data/, не редактировать.",
+        "#pragma once",
+        "",
+    ]
+    bundle_hash = hashlib.sha256("".join(a["etag"] for a in assets).encode()).hexdigest()[:16]
+    lines.append("#define WEB_BUNDLE_HASH %s" % c_string(bundle_hash))
+    lines.append("")
+
+    for i, a in enumerate(assets):
+        lines.append("// %s: %u -> %u bytes%s" % (a["path"], a["raw_len"], len(a["data"]), ", gzip" if a["gzip"] else ""))
+        lines.append("static const uint8_t WEB_ASSET_%d[] PROGMEM = {" % i)
+        data = a["data"]
+        for off in range(0, len(data), 16):
+            lines.append("    " + ", ".join("0x%02x" % b for b in data[off:off + 16]) + ",")
+        lines.append("};")
+    lines.append("")
+
+    entries = []
+    for i, a in enumerate(assets):
+        etag = c_string('"%s"' % a["etag"])
+        for path, immutable in ((a["path"], False), (a["hashed"], True)):
+            if path is None:
+                continue
+            entries.append("    {%s, %s, WEB_ASSET_%d, sizeof(WEB_ASSET_%d), %s, %s, %s}," % (
+                c_string(path), c_string(a["type"]), i, i, etag,
+                "true" if a["gzip"] else "false", "true" if immutable else "false"))
+    if not entries:
+        # Пустой массив недопустим: одна пустая запись, счётчик - 0
+        lines.append("static const WebAsset WEB_BUNDLE[] = {{NULL, NULL, NULL, 0, NULL, false, false}};")
+        lines.append("static const size_t WEB_BUNDLE_COUNT = 0;")
+    else:
+        lines.append("static const WebAsset WEB_BUNDLE[] = {")
+        lines.extend(entries)
+        lines.append("};")
+        lines.append("static const size_t WEB_BUNDLE_COUNT = sizeof(WEB_BUNDLE) / sizeof(WEB_BUNDLE[0]);")
+    lines.append("")
+    return "\n".join(lines)
+
+
+def generate(data_dir, out_dir):
+    assets = build_bundle(data_dir)
+    text = render_header(assets)
+    os.makedirs(out_dir, exist_ok=True)
+    out_path = os.path.join(out_dir, HEADER_NAME)
+    # Без изменений не трогаем файл, чтобы не пересобирать web_assets.cpp
+    if os.path.exists(out_path):
+        with open(out_path, "r", encoding="utf-8") as f:
+            if f.read() == text:
+                return assets
+    with open(out_path, "w", encoding="utf-8") as f:
+        f.write(text)
+    raw = sum(a["raw_len"] for a in assets)
+    packed = sum(len(a["data"]) for a in assets)
+    print("web_bundle: %d assets, %u -> %u bytes -> %s" % (len(assets), raw, packed, out_path))
+    return assets
+
+
+try:
+    Import("env")  # noqa: F821 - определено PlatformIO (SCons)
+except NameError:
+    env = None
+
+if env is not None:
+    out_dir = os.path.join(env.subst("$BUILD_DIR"), "web_bundle")
+    generate(env.subst("$PROJECT_DATA_DIR"), out_dir)
+    env.Append(CPPPATH=[out_dir])
+elif __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print("usage: web_bundle.py <data_dir> <out_dir>")
+        sys.exit(1)
+    generate(sys.argv[1], sys.argv[2])
@@ -0,0 +1,72 @@
+#include "activation_fsm.h"
+
+static ActivationActions transition(ActivationFsm *fsm, ActivationState next)
+{
+    ActivationActions a = {};
+    ActivationState prev = fsm->state;
+    if (next == prev)
+    {
+        return a;
+    }
+    fsm->state = next;
+    a.activate = !activation_state_active(prev) && activation_state_active(next);
+    a.deactivate = activation_state_active(prev) && !activation_state_active(next);
+    a.prewarm = next == ACT_REVERSE;
+    // Иначе камера так и будет снимать до ухода последнего клиента вместо дежурного режима
+    a.unprewarm = prev == ACT_REVERSE && !a.deactivate;
+    a.start_grace = next == ACT_GRACE;
+    a.stop_grace = prev == ACT_GRACE && next == ACT_REVERSE;
+    return a;
+}
+
+void activation_fsm_init(ActivationFsm *fsm)
+{
+    fsm->state = ACT_IDLE;
+    fsm->in.reverse = false;
+    fsm->in.clients = false;
+    fsm->in.auto_start = false;
+}
+
+ActivationActions activation_fsm_update(ActivationFsm *fsm, const ActivationInputs &in)
+{
+    fsm->in = in;
+    if (in.reverse && in.auto_start)
+    {
+        return transition(fsm, ACT_REVERSE);
+    }
+    switch (fsm->state)
+    {
+    case ACT_REVERSE:
+        // Снятие передачи (или отключение auto_start на ходу) - всегда через паузу
+        return transition(fsm, ACT_GRACE);
+    case ACT_GRACE:
+        // Клиенты на паузу не влияют: после неё решают они
+        return ActivationActions();
+    default:
+        return transition(fsm, in.clients ? ACT_CLIENT : ACT_IDLE);
+    }
+}
+
+ActivationActions activation_fsm_grace_expired(ActivationFsm *fsm)
+{
+    if (fsm->state != ACT_GRACE)
+    {
+        return ActivationActions();
+    }
+    return transition(fsm, fsm->in.clients ? ACT_CLIENT : ACT_IDLE);
+}
+
+const char *activation_state_name(ActivationState s)
+{
+    switch (s)
+    {
+    case ACT_REVERSE:
+        return "reverse";
+    case ACT_GRACE:
+        return "grace";
+    case ACT_CLIENT:
+        return "client";
+    default:
+        return "idle";
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+
+// Автомат включения парктроника. Чистая логика без Arduino/FreeRTOS: задача-менеджер
+// передаёт ему входы (задняя передача после антидребезга, есть ли клиенты /ws, auto_start)
+// и окончание паузы, а сама выполняет действия - питание датчиков, биты событий, таймер паузы.
+//
+//   IDLE --(передача и auto_start)--> REVERSE --(передача снята)--> GRACE --(пауза истекла)--> IDLE/CLIENT
+//   IDLE --(есть клиенты)--> CLIENT --(клиентов нет)--> IDLE
+//   CLIENT/GRACE --(передача и auto_start)--> REVERSE
+
+enum ActivationState
+{
+    ACT_IDLE = 0,
+    ACT_REVERSE = 1, // Включена задняя передача
+    ACT_GRACE = 2,   // Передача снята, парктроник ещё работает GRACE_PERIOD_MS
+    ACT_CLIENT = 3,  // Только клиенты /ws
+};
+
+struct ActivationInputs
+{
+    bool reverse;
+    bool clients;
+    bool auto_start;
+};
+
+struct ActivationFsm
+{
+    ActivationState state;
+    ActivationInputs in;
+};
+
+// Что сделать после перехода
+struct ActivationActions
+{
+    bool activate;    // Включить парктроник (был выключен)
+    bool deactivate;  // Выключить парктроник и снять прогрев камеры
+    bool prewarm;     // Прогреть камеру (вход в REVERSE)
+    bool unprewarm;   // Снять прогрев без выключения (выход из REVERSE в GRACE/CLIENT)
+    bool start_grace; // Запустить однократный таймер паузы
+    bool stop_grace;  // Остановить таймер паузы
+};
+
+void activation_fsm_init(ActivationFsm *fsm);
+
+// Новые значения входов (можно передавать и неизменившиеся).
+ActivationActions activation_fsm_update(ActivationFsm *fsm, const ActivationInputs &in);
+
+// Таймер паузы истёк. Вне GRACE (таймер уже остановлен) игнорируется.
+ActivationActions activation_fsm_grace_expired(ActivationFsm *fsm);
+
+inline bool activation_state_active(ActivationState s)
+{
+    return s != ACT_IDLE;
+}
+
+const char *activation_state_name(ActivationState s);
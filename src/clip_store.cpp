@@ -0,0 +1,523 @@
+#include "clip_store.h"
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "sensor_snapshot.h"
+#include "flash_guard.h"
+
+// Раздел "rec": data, подтип 0x40 (partitions.csv)
+const esp_partition_subtype_t CLIP_PARTITION_SUBTYPE = (esp_partition_subtype_t)0x40;
+const uint32_t SECTOR_MAGIC = 0x53434552; // "RECS"
+const uint32_t SECTOR_SIZE = 4096;
+const uint32_t NO_RECORD = 0xFFFFFFFF;
+
+// Заголовок сектора. first_record - смещение первой записи, начинающейся в секторе
+// (NO_RECORD - сектор целиком занят продолжением предыдущей записи).
+struct SectorHeader
+{
+    uint32_t magic;
+    uint32_t seq; // Номер стирания, растёт по кольцу; по нему находится голова
+    uint32_t first_record;
+    uint32_t crc;
+};
+
+const uint32_t SECTOR_DATA = SECTOR_SIZE - sizeof(SectorHeader);
+
+static const esp_partition_t *s_part = NULL;
+static uint32_t s_sectors = 0;
+static uint32_t s_ring = 0; // Логический объём: s_sectors * SECTOR_DATA
+
+// Защищает список клипов и согласует стирание сектора с чтением выгрузки
+static SemaphoreHandle_t s_store_mutex = NULL;
+static ClipInfo s_clips[CLIP_STORE_MAX_CLIPS];
+static int s_clip_count = 0;
+
+// Состояние писателя
+static uint32_t s_head = 0;      // Логическое смещение следующего байта
+static uint32_t s_seq = 0;       // seq последнего стёртого сектора
+static uint32_t s_rec_start = 0; // Записываемая запись: для first_record нового сектора
+static uint32_t s_rec_end = 0;
+static uint32_t s_next_id = 1;
+static bool s_clip_open = false;
+static ClipIndexHeader s_index;
+static ClipIndexEntry s_entries[CLIP_MAX_ENTRIES];
+// Запись во flash идёт из внутренней RAM: данные из PSRAM копируются порциями
+static uint8_t s_bounce[512];
+
+static uint32_t align4(uint32_t n)
+{
+    return (n + 3) & ~3u;
+}
+
+static uint32_t ring_dist(uint32_t from, uint32_t to)
+{
+    return (to + s_ring - from) % s_ring;
+}
+
+static uint32_t sector_crc(const SectorHeader &h)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&h, offsetof(SectorHeader, crc));
+}
+
+static uint32_t record_crc(const ClipRecordHeader &h)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&h, offsetof(ClipRecordHeader, crc));
+}
+
+// Чтение по логическому смещению с переходом через заголовки секторов и конец кольца
+static bool ring_read(uint32_t pos, void *dst, uint32_t len)
+{
+    uint8_t *out = (uint8_t *)dst;
+    while (len)
+    {
+        uint32_t sector = pos / SECTOR_DATA;
+        uint32_t in = pos % SECTOR_DATA;
+        uint32_t n = min(len, SECTOR_DATA - in);
+        if (esp_partition_read(s_part, sector * SECTOR_SIZE + sizeof(SectorHeader) + in, out, n) != ESP_OK)
+        {
+            return false;
+        }
+        out += n;
+        len -= n;
+        pos = (pos + n) % s_ring;
+    }
+    return true;
+}
+
+static bool read_record_header(uint32_t pos, ClipRecordHeader *h)
+{
+    return ring_read(pos, h, sizeof(*h)) && h->magic == CLIP_RECORD_MAGIC && h->crc == record_crc(*h) &&
+           h->len <= s_ring / 2;
+}
+
+// Клип пересекается с сектором, который сейчас будет стёрт
+static bool clip_overlaps(const ClipInfo &c, uint32_t sector_start)
+{
+    uint32_t clip_len = ring_dist(c.start_offset, c.end_offset);
+    return ring_dist(c.start_offset, sector_start) < clip_len || ring_dist(sector_start, c.start_offset) < SECTOR_DATA;
+}
+
+// Вход в сектор: клипы, которые он затрёт, убираются из списка до стирания
+static bool enter_sector(uint32_t sector)
+{
+    uint32_t sector_start = sector * SECTOR_DATA;
+    xSemaphoreTake(s_store_mutex, portMAX_DELAY);
+    int kept = 0;
+    for (int i = 0; i < s_clip_count; ++i)
+    {
+        if (clip_overlaps(s_clips[i], sector_start))
+        {
+            Serial.printf("[Rec] Clip #%u overwritten\n", (unsigned)s_clips[i].id);
+            continue;
+        }
+        s_clips[kept++] = s_clips[i];
+    }
+    s_clip_count = kept;
+    flash_guard_take();
+    esp_err_t err = esp_partition_erase_range(s_part, sector * SECTOR_SIZE, SECTOR_SIZE);
+    flash_guard_give();
+    xSemaphoreGive(s_store_mutex);
+    if (err != ESP_OK)
+    {
+        return false;
+    }
+
+    SectorHeader h;
+    h.magic = SECTOR_MAGIC;
+    h.seq = ++s_seq;
+    if (s_rec_start == sector_start)
+    {
+        h.first_record = 0;
+    }
+    else
+    {
+        uint32_t rest = ring_dist(sector_start, s_rec_end);
+        h.first_record = rest < SECTOR_DATA ? rest : NO_RECORD;
+    }
+    h.crc = sector_crc(h);
+    flash_guard_take();
+    err = esp_partition_write(s_part, sector * SECTOR_SIZE, &h, sizeof(h));
+    flash_guard_give();
+    return err == ESP_OK;
+}
+
+static bool ring_write(const uint8_t *src, uint32_t len)
+{
+    while (len)
+    {
+        uint32_t in = s_head % SECTOR_DATA;
+        if (in == 0 && !enter_sector(s_head / SECTOR_DATA))
+        {
+            return false;
+        }
+        uint32_t n = min(min(len, SECTOR_DATA - in), (uint32_t)sizeof(s_bounce));
+        memcpy(s_bounce, src, n);
+        uint32_t addr = (s_head / SECTOR_DATA) * SECTOR_SIZE + sizeof(SectorHeader) + in;
+        flash_guard_take();
+        esp_err_t err = esp_partition_write(s_part, addr, s_bounce, n);
+        flash_guard_give();
+        if (err != ESP_OK)
+        {
+            return false;
+        }
+        src += n;
+        len -= n;
+        s_head = (s_head + n) % s_ring;
+    }
+    return true;
+}
+
+// Запись целиком: заголовок, данные, выравнивание. Выравнивание не пишется - байты уже стёрты,
+// и оно не пересекает границу сектора (SECTOR_DATA и начала записей кратны 4).
+static bool write_record(uint8_t type, uint32_t t_ms, const uint8_t *data, uint32_t len, uint32_t *offset)
+{
+    ClipRecordHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = CLIP_RECORD_MAGIC;
+    h.type = type;
+    h.len = len;
+    h.clip_id = s_index.clip_id;
+    h.t_ms = t_ms;
+    h.crc = record_crc(h);
+
+    *offset = s_head;
+    s_rec_start = s_head;
+    s_rec_end = (s_head + align4(sizeof(h) + len)) % s_ring;
+    if (!ring_write((const uint8_t *)&h, sizeof(h)) || !ring_write(data, len))
+    {
+        return false;
+    }
+    s_head = s_rec_end;
+    return true;
+}
+
+static void add_clip(const ClipInfo &clip)
+{
+    xSemaphoreTake(s_store_mutex, portMAX_DELAY);
+    if (s_clip_count == CLIP_STORE_MAX_CLIPS)
+    {
+        memmove(&s_clips[0], &s_clips[1], sizeof(ClipInfo) * (CLIP_STORE_MAX_CLIPS - 1));
+        s_clip_count--;
+    }
+    s_clips[s_clip_count++] = clip;
+    xSemaphoreGive(s_store_mutex);
+}
+
+static ClipInfo clip_from_index(const ClipIndexHeader &idx, uint32_t index_offset, uint32_t index_len)
+{
+    ClipInfo c;
+    c.id = idx.clip_id;
+    c.reason = idx.reason;
+    c.trigger_ms = idx.trigger_ms;
+    c.start_ms = idx.start_ms;
+    c.end_ms = idx.end_ms;
+    c.entry_count = idx.entry_count;
+    c.frames = idx.frames;
+    c.samples = idx.samples;
+    c.bytes = index_len + idx.bytes;
+    c.start_offset = idx.start_offset;
+    c.index_offset = index_offset;
+    c.end_offset = (index_offset + align4(index_len)) % s_ring;
+    return c;
+}
+
+// Восстановление после перезагрузки. Голова - сектор с наибольшим seq; от неё назад по
+// непрерывным seq до самого старого сектора, затем проход по записям вперёд со сбором
+// индексов. Недописанный хвост (сброс во время записи) отбрасывается: у клипа без индекса
+// нет записи в списке, а запись продолжится со следующего сектора.
+static void scan()
+{
+    uint32_t *seqs = (uint32_t *)heap_caps_malloc(s_sectors * sizeof(uint32_t) * 2, MALLOC_CAP_SPIRAM);
+    if (!seqs)
+    {
+        seqs = (uint32_t *)malloc(s_sectors * sizeof(uint32_t) * 2);
+    }
+    if (!seqs)
+    {
+        return;
+    }
+    uint32_t *firsts = seqs + s_sectors;
+
+    uint32_t head = 0;
+    bool any = false;
+    for (uint32_t i = 0; i < s_sectors; ++i)
+    {
+        SectorHeader h;
+        seqs[i] = 0;
+        if (esp_partition_read(s_part, i * SECTOR_SIZE, &h, sizeof(h)) == ESP_OK && h.magic == SECTOR_MAGIC &&
+            h.crc == sector_crc(h))
+        {
+            seqs[i] = h.seq;
+            firsts[i] = h.first_record;
+            if (!any || h.seq > seqs[head])
+            {
+                head = i;
+                any = true;
+            }
+        }
+    }
+    if (!any)
+    {
+        heap_caps_free(seqs);
+        return;
+    }
+
+    uint32_t oldest = head;
+    for (uint32_t n = 1; n < s_sectors; ++n)
+    {
+        uint32_t prev = (oldest + s_sectors - 1) % s_sectors;
+        if (seqs[prev] == 0 || seqs[prev] + 1 != seqs[oldest])
+        {
+            break;
+        }
+        oldest = prev;
+    }
+    uint32_t valid_sectors = (head + s_sectors - oldest) % s_sectors + 1;
+    uint32_t base = oldest * SECTOR_DATA;
+    uint32_t valid_len = valid_sectors * SECTOR_DATA;
+
+    uint32_t k = 0;
+    while (k < valid_sectors)
+    {
+        uint32_t sector = (oldest + k) % s_sectors;
+        if (firsts[sector] == NO_RECORD || firsts[sector] >= SECTOR_DATA)
+        {
+            k++;
+            continue;
+        }
+        uint32_t pos = sector * SECTOR_DATA + firsts[sector];
+        ClipRecordHeader h;
+        while (ring_dist(base, pos) + sizeof(h) <= valid_len && read_record_header(pos, &h))
+        {
+            uint32_t rec_len = sizeof(h) + h.len;
+            if (ring_dist(base, pos) + rec_len > valid_len)
+            {
+                break;
+            }
+            ClipIndexHeader idx;
+            if (h.type == CLIP_REC_INDEX && h.len >= sizeof(idx) &&
+                ring_read((pos + sizeof(h)) % s_ring, &idx, sizeof(idx)) && idx.clip_id == h.clip_id &&
+                ring_dist(base, idx.start_offset) <= ring_dist(base, pos))
+            {
+                add_clip(clip_from_index(idx, pos, rec_len));
+                s_next_id = max(s_next_id, idx.clip_id + 1);
+            }
+            pos = (pos + align4(rec_len)) % s_ring;
+            if (ring_dist(base, pos) == 0)
+            {
+                break; // Обошли всё кольцо
+            }
+        }
+        // Мусор или конец записей: дальше - со следующего сектора
+        k = max(k + 1, ring_dist(base, pos) / SECTOR_DATA + 1);
+    }
+
+    s_seq = seqs[head];
+    s_head = ((head + 1) % s_sectors) * SECTOR_DATA;
+    heap_caps_free(seqs);
+}
+
+bool clip_store_init()
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, CLIP_PARTITION_SUBTYPE, "rec");
+    if (!s_store_mutex)
+    {
+        s_store_mutex = xSemaphoreCreateMutex();
+    }
+    s_clip_count = 0;
+    s_head = 0;
+    s_seq = 0;
+    s_next_id = 1;
+    s_clip_open = false;
+    if (!s_part || !s_store_mutex || s_part->size < SECTOR_SIZE * 16)
+    {
+        Serial.println("[Rec] No 'rec' partition, recorder disabled");
+        s_part = NULL;
+        return false;
+    }
+    s_sectors = s_part->size / SECTOR_SIZE;
+    s_ring = s_sectors * SECTOR_DATA;
+    scan();
+    Serial.printf("[Rec] Partition %u KB, %d clips, next #%u\n", (unsigned)(s_part->size / 1024), s_clip_count,
+                  (unsigned)s_next_id);
+    return true;
+}
+
+uint32_t clip_store_capacity()
+{
+    return s_ring;
+}
+
+bool clip_store_begin(uint8_t reason, uint32_t trigger_ms, uint32_t *clip_id)
+{
+    if (!s_part || s_clip_open)
+    {
+        return false;
+    }
+    memset(&s_index, 0, sizeof(s_index));
+    s_index.clip_id = s_next_id++;
+    s_index.trigger_ms = trigger_ms;
+    s_index.reason = reason;
+    s_index.start_offset = s_head;
+    s_clip_open = true;
+    *clip_id = s_index.clip_id;
+    return true;
+}
+
+bool clip_store_append(uint8_t type, uint32_t t_ms, const uint8_t *data, uint32_t len)
+{
+    uint32_t rec_len = sizeof(ClipRecordHeader) + len;
+    // Половина кольца на клип: запись не догонит начало собственного клипа
+    if (!s_clip_open || s_index.entry_count == CLIP_MAX_ENTRIES || s_index.bytes + align4(rec_len) > s_ring / 2)
+    {
+        return false;
+    }
+    ClipIndexEntry &e = s_entries[s_index.entry_count];
+    if (!write_record(type, t_ms, data, len, &e.offset))
+    {
+        Serial.println("[Rec] Flash write failed");
+        return false;
+    }
+    e.len = rec_len;
+    e.t_ms = t_ms;
+    e.type = type;
+    memset(e.reserved, 0, sizeof(e.reserved));
+    s_index.entry_count++;
+    s_index.bytes += rec_len;
+    if (type == CLIP_REC_FRAME)
+    {
+        s_index.frames++;
+    }
+    else if (type == CLIP_REC_SAMPLES)
+    {
+        s_index.samples += len / sizeof(SensorSample);
+    }
+    return true;
+}
+
+bool clip_store_finish(uint32_t start_ms, uint32_t end_ms)
+{
+    if (!s_clip_open)
+    {
+        return false;
+    }
+    s_clip_open = false;
+    s_index.start_ms = start_ms;
+    s_index.end_ms = end_ms;
+    if (s_index.entry_count == 0)
+    {
+        return false;
+    }
+
+    // Индекс собирается во внутреннем буфере: заголовок и смещения одной записью
+    uint32_t len = sizeof(ClipIndexHeader) + s_index.entry_count * sizeof(ClipIndexEntry);
+    uint8_t *buf = (uint8_t *)malloc(len);
+    if (!buf)
+    {
+        return false;
+    }
+    memcpy(buf, &s_index, sizeof(s_index));
+    memcpy(buf + sizeof(s_index), s_entries, s_index.entry_count * sizeof(ClipIndexEntry));
+    uint32_t offset;
+    bool ok = write_record(CLIP_REC_INDEX, end_ms, buf, len, &offset);
+    free(buf);
+    if (!ok)
+    {
+        return false;
+    }
+    ClipInfo clip = clip_from_index(s_index, offset, sizeof(ClipRecordHeader) + len);
+    add_clip(clip);
+    Serial.printf("[Rec] Clip #%u saved: %u frames, %u samples, %u bytes\n", (unsigned)clip.id,
+                  (unsigned)clip.frames, (unsigned)clip.samples, (unsigned)clip.bytes);
+    return true;
+}
+
+int clip_store_list(ClipInfo *out, int max_count)
+{
+    if (!s_part)
+    {
+        return 0;
+    }
+    xSemaphoreTake(s_store_mutex, portMAX_DELAY);
+    int n = min(s_clip_count, max_count);
+    memcpy(out, s_clips, n * sizeof(ClipInfo));
+    xSemaphoreGive(s_store_mutex);
+    return n;
+}
+
+// Под s_store_mutex
+static bool clip_valid(uint32_t clip_id)
+{
+    for (int i = 0; i < s_clip_count; ++i)
+    {
+        if (s_clips[i].id == clip_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool clip_reader_open(ClipReader *r, uint32_t clip_id)
+{
+    if (!s_part)
+    {
+        return false;
+    }
+    bool found = false;
+    xSemaphoreTake(s_store_mutex, portMAX_DELAY);
+    for (int i = 0; i < s_clip_count; ++i)
+    {
+        if (s_clips[i].id == clip_id)
+        {
+            r->clip = s_clips[i];
+            found = true;
+        }
+    }
+    xSemaphoreGive(s_store_mutex);
+    r->entry = -1;
+    r->rec_offset = r->clip.index_offset;
+    r->rec_len = sizeof(ClipRecordHeader) + sizeof(ClipIndexHeader) + r->clip.entry_count * sizeof(ClipIndexEntry);
+    r->rec_start = 0;
+    return found;
+}
+
+size_t clip_reader_read(ClipReader *r, size_t index, uint8_t *buf, size_t max_len)
+{
+    xSemaphoreTake(s_store_mutex, portMAX_DELAY);
+    size_t n = 0;
+    while (clip_valid(r->clip.id))
+    {
+        if (index < r->rec_start + r->rec_len)
+        {
+            size_t in = index - r->rec_start;
+            n = min(max_len, r->rec_len - in);
+            if (!ring_read((r->rec_offset + in) % s_ring, buf, n))
+            {
+                n = 0;
+            }
+            break;
+        }
+        // Следующая запись - по смещению из индекса на flash
+        if (r->entry + 1 >= (int)r->clip.entry_count)
+        {
+            break;
+        }
+        r->entry++;
+        ClipIndexEntry e;
+        uint32_t pos = r->clip.index_offset + sizeof(ClipRecordHeader) + sizeof(ClipIndexHeader) +
+                       r->entry * sizeof(ClipIndexEntry);
+        if (!ring_read(pos % s_ring, &e, sizeof(e)))
+        {
+            break;
+        }
+        r->rec_start += r->rec_len;
+        r->rec_offset = e.offset;
+        r->rec_len = e.len;
+    }
+    xSemaphoreGive(s_store_mutex);
+    return n;
+}
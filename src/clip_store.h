@@ -0,0 +1,111 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Хранилище клипов регистратора в разделе flash "rec" (partitions.csv). Раздел - кольцо
+// секторов по 4 КБ, запись только дописыванием: сектор стирается непосредственно перед
+// записью в него, поэтому все секторы изнашиваются равномерно, а при переполнении
+// теряются самые старые клипы. В начале сектора - заголовок с порядковым номером и смещением
+// первой записи, по ним после перезагрузки находятся голова кольца и клипы.
+//
+// Клип - последовательность записей (кадр JPEG, пачка измерений датчиков), за которыми идёт
+// запись-индекс со списком смещений. Клип читается по индексу кусками, без загрузки в RAM.
+
+enum ClipRecordType
+{
+    CLIP_REC_FRAME = 1,   // JPEG
+    CLIP_REC_SAMPLES = 2, // SensorSample[]
+    CLIP_REC_INDEX = 3,   // ClipIndexHeader + ClipIndexEntry[entry_count]
+};
+
+enum ClipTrigger
+{
+    CLIP_TRIGGER_DISTANCE = 1, // Расстояние меньше thresh_red
+    CLIP_TRIGGER_MANUAL = 2,   // POST /api/recorder/trigger
+};
+
+const uint32_t CLIP_RECORD_MAGIC = 0x44434552; // "RECD"
+// Записей в одном клипе, не считая индекса
+const int CLIP_MAX_ENTRIES = 160;
+// Клипов в списке: старые вытесняются и из списка, даже если их данные ещё не затёрты
+const int CLIP_STORE_MAX_CLIPS = 32;
+
+// Заголовок каждой записи на flash, за ним len байт данных и выравнивание до 4 байт.
+struct ClipRecordHeader
+{
+    uint32_t magic;
+    uint8_t type; // ClipRecordType
+    uint8_t reserved[3];
+    uint32_t len;
+    uint32_t clip_id;
+    uint32_t t_ms; // millis() на момент данных
+    uint32_t crc;  // CRC32 предыдущих полей
+};
+
+struct ClipIndexHeader
+{
+    uint32_t clip_id;
+    uint32_t trigger_ms;
+    uint32_t start_ms;
+    uint32_t end_ms;
+    uint32_t start_offset; // Логическое смещение первой записи клипа в кольце
+    uint16_t entry_count;
+    uint16_t frames;
+    uint32_t samples;
+    uint32_t bytes; // Сумма длин записей клипа (с заголовками)
+    uint8_t reason; // ClipTrigger
+    uint8_t reserved[3];
+};
+
+struct ClipIndexEntry
+{
+    uint32_t offset; // Логическое смещение заголовка записи
+    uint32_t len;    // Заголовок + данные, без выравнивания
+    uint32_t t_ms;
+    uint8_t type;
+    uint8_t reserved[3];
+};
+
+struct ClipInfo
+{
+    uint32_t id;
+    uint8_t reason;
+    uint32_t trigger_ms;
+    uint32_t start_ms;
+    uint32_t end_ms;
+    uint16_t entry_count;
+    uint16_t frames;
+    uint32_t samples;
+    uint32_t bytes;        // Размер выгрузки: индекс и все записи
+    uint32_t start_offset; // Диапазон клипа в кольце: от первой записи до конца индекса
+    uint32_t index_offset;
+    uint32_t end_offset;
+};
+
+// Поиск раздела и восстановление списка клипов. Вызывается до запуска регистратора;
+// повторный вызов заново читает раздел, как после перезагрузки.
+bool clip_store_init();
+// Ёмкость кольца, байт (0 - раздела нет).
+uint32_t clip_store_capacity();
+
+// Запись клипа - только из одной задачи. append: false - клип заполнен или ошибка flash
+// (клип можно завершить с уже записанным). data может лежать в PSRAM.
+bool clip_store_begin(uint8_t reason, uint32_t trigger_ms, uint32_t *clip_id);
+bool clip_store_append(uint8_t type, uint32_t t_ms, const uint8_t *data, uint32_t len);
+bool clip_store_finish(uint32_t start_ms, uint32_t end_ms);
+
+// Список клипов от старых к новым.
+int clip_store_list(ClipInfo *out, int max_count);
+
+// Выгрузка клипа: запись-индекс, затем записи в порядке индекса, каждая с заголовком.
+struct ClipReader
+{
+    ClipInfo clip;
+    int entry;         // -1 - индекс
+    uint32_t rec_offset;
+    uint32_t rec_len;
+    size_t rec_start;  // Смещение текущей записи в выгрузке
+};
+bool clip_reader_open(ClipReader *r, uint32_t clip_id);
+// Следующая порция начиная с index (чтение последовательное). 0 - конец или клип затёрт.
+size_t clip_reader_read(ClipReader *r, size_t index, uint8_t *buf, size_t max_len);
@@ -41,6 +41,9 @@ const SensorConfig SENSOR_PINS[NUM_SENSORS] = {
 #define CAM_PIN_HREF 7
 #define CAM_PIN_PCLK 13
 
+// Буферов кадра в PSRAM: один заполняет драйвер, остальные могут держать читатели пула.
+#define CAM_FB_COUNT 3
+
 // --- Структура настроек (соответствует клиенту) ---
 struct AppSettings
 {
@@ -51,6 +54,11 @@ struct AppSettings
   int bpm_min;
   int bpm_max;
   bool auto_start;
+  float ws_deadband_cm; // Зона нечувствительности рассылки расстояний в /ws
+  int filter_type;     // DistanceFilterType
+  int filter_median;   // Окно медианы: 1, 3 или 5
+  float filter_alpha;
+  float filter_beta;
   // Camera
   bool show_grid;
   int cam_angle;
@@ -0,0 +1,38 @@
+#include "crosstalk_filter.h"
+#include <math.h>
+#include <string.h>
+
+void crosstalk_reset(CrosstalkState *st, float initial_cm)
+{
+    memset(st, 0, sizeof(*st));
+    st->accepted_cm = initial_cm;
+}
+
+float crosstalk_accept(CrosstalkState *st, float raw_cm, int phase)
+{
+    bool confirmed = false;
+    int other = 1 - phase;
+    uint32_t n = st->raw_count[other] < (uint32_t)CROSSTALK_HISTORY ? st->raw_count[other] : CROSSTALK_HISTORY;
+    for (uint32_t k = 0; k < n; ++k)
+    {
+        if (fabsf(raw_cm - st->last_raw_cm[other][k]) <= CONFIRM_TOLERANCE_CM)
+        {
+            confirmed = true;
+            break;
+        }
+    }
+
+    if (confirmed || st->unconfirmed >= MAX_UNCONFIRMED)
+    {
+        st->accepted_cm = raw_cm;
+        st->unconfirmed = 0;
+    }
+    else
+    {
+        st->unconfirmed++;
+        st->rejected++;
+    }
+    st->last_raw_cm[phase][st->raw_count[phase] % CROSSTALK_HISTORY] = raw_cm;
+    st->raw_count[phase]++;
+    return st->accepted_cm;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+
+// Отбраковка перекрёстного эха датчика в группе одновременного запуска. Эхо соседа
+// сдвигается вместе со сдвигом запуска (3 мс ~ 50 см), настоящее - нет. Поэтому новое
+// значение принимается, только если его подтвердило измерение из другой фазы сдвига.
+// Подтверждение из своей фазы не годится - перекрёстное эхо в ней повторяется.
+
+const float CONFIRM_TOLERANCE_CM = 15.0f;
+const int MAX_UNCONFIRMED = 10; // Дольше старое значение не держим
+const int CROSSTALK_HISTORY = 3;
+
+struct CrosstalkState
+{
+    float accepted_cm;
+    float last_raw_cm[2][CROSSTALK_HISTORY]; // Последние сырые значения в каждой фазе сдвига
+    uint32_t raw_count[2];
+    int unconfirmed;
+    uint32_t rejected;
+};
+
+void crosstalk_reset(CrosstalkState *st, float initial_cm);
+
+// Новое сырое значение в фазе сдвига phase (0 или 1), возвращает принятое значение.
+float crosstalk_accept(CrosstalkState *st, float raw_cm, int phase);
@@ -0,0 +1,265 @@
+#include "diagnostics.h"
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+const int DIAG_MAX_TASKS = 24;
+const int DIAG_TASK_NAME_LEN = 16;
+const uint32_t DIAG_LOG_EVERY = 60000 / DIAG_SAMPLE_PERIOD_MS;
+
+struct DiagTask
+{
+    char name[DIAG_TASK_NAME_LEN];
+    int8_t core;
+    uint8_t prio;
+    int16_t cpu_permille; // -1 - неизвестно
+    uint32_t stack_free;  // Минимум за всё время работы задачи, байт
+};
+
+struct DiagHeap
+{
+    uint32_t total;
+    uint32_t free;
+    uint32_t min_free;
+    uint32_t largest;
+};
+
+struct DiagSnapshot
+{
+    uint32_t uptime_ms;
+    uint32_t window_ms;
+    uint8_t task_count;
+    DiagTask tasks[DIAG_MAX_TASKS];
+    DiagHeap internal;
+    DiagHeap psram;
+};
+
+static SemaphoreHandle_t s_diag_mutex = NULL;
+static DiagSnapshot s_snapshot;
+
+// Отказы выделения: обработчик вызывается из контекста неудачного malloc
+static std::atomic<uint32_t> s_alloc_failures(0);
+static std::atomic<uint32_t> s_last_failed_size(0);
+static std::atomic<uint32_t> s_last_failed_caps(0);
+
+static void on_alloc_failed(size_t size, uint32_t caps, const char *function_name)
+{
+    (void)function_name;
+    s_alloc_failures.fetch_add(1, std::memory_order_relaxed);
+    s_last_failed_size.store(size, std::memory_order_relaxed);
+    s_last_failed_caps.store(caps, std::memory_order_relaxed);
+}
+
+static const char *const BOOT_MILESTONE_NAMES[BOOT_MILESTONE_COUNT] = {
+    "safety_tasks", "first_measurement", "first_beep", "fs_ready", "wifi_ready", "web_ready",
+};
+static std::atomic<uint32_t> s_boot_us[BOOT_MILESTONE_COUNT];
+
+void diagnostics_boot_mark(BootMilestone m)
+{
+    if (s_boot_us[m].load(std::memory_order_relaxed) != 0)
+    {
+        return;
+    }
+    uint32_t expected = 0;
+    uint32_t now_us = max((uint32_t)esp_timer_get_time(), (uint32_t)1);
+    if (s_boot_us[m].compare_exchange_strong(expected, now_us, std::memory_order_relaxed))
+    {
+        Serial.printf("[Boot] %s at %u.%u ms\n", BOOT_MILESTONE_NAMES[m], (unsigned)(now_us / 1000),
+                      (unsigned)(now_us % 1000 / 100));
+    }
+}
+
+bool diagnostics_init()
+{
+    s_diag_mutex = xSemaphoreCreateMutex();
+    if (!s_diag_mutex)
+    {
+        return false;
+    }
+    heap_caps_register_failed_alloc_callback(on_alloc_failed);
+    return true;
+}
+
+static void read_heap(uint32_t caps, DiagHeap *heap)
+{
+    heap->total = heap_caps_get_total_size(caps);
+    heap->free = heap_caps_get_free_size(caps);
+    heap->min_free = heap_caps_get_minimum_free_size(caps);
+    heap->largest = heap_caps_get_largest_free_block(caps);
+}
+
+// Доля свободной памяти, недоступной одним блоком, %
+static unsigned heap_frag_pct(const DiagHeap &heap)
+{
+    return heap.free ? 100 - (unsigned)((uint64_t)heap.largest * 100 / heap.free) : 0;
+}
+
+#if configUSE_TRACE_FACILITY
+// Состояние задач - статические буферы сборщика, на стеке им не место
+static TaskStatus_t s_status[DIAG_MAX_TASKS];
+struct RunTimeMark
+{
+    TaskHandle_t handle;
+    uint32_t run_time;
+};
+static RunTimeMark s_prev[DIAG_MAX_TASKS];
+static int s_prev_count = 0;
+static uint32_t s_prev_total = 0;
+
+static uint32_t prev_run_time(TaskHandle_t handle, bool *found)
+{
+    for (int i = 0; i < s_prev_count; ++i)
+    {
+        if (s_prev[i].handle == handle)
+        {
+            *found = true;
+            return s_prev[i].run_time;
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+static void sample_tasks(DiagSnapshot *snap)
+{
+    uint32_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(s_status, DIAG_MAX_TASKS, &total);
+    // Счётчики 32-битные (мкс), разность без знака переживает одно переполнение
+    uint32_t window = total - s_prev_total;
+
+    snap->task_count = n;
+    for (UBaseType_t i = 0; i < n; ++i)
+    {
+        const TaskStatus_t &st = s_status[i];
+        DiagTask &task = snap->tasks[i];
+        strlcpy(task.name, st.pcTaskName, sizeof(task.name));
+        BaseType_t core = xTaskGetAffinity(st.xHandle);
+        task.core = core == tskNO_AFFINITY ? -1 : (int8_t)core;
+        task.prio = st.uxCurrentPriority;
+        task.stack_free = st.usStackHighWaterMark;
+        task.cpu_permille = -1;
+#if configGENERATE_RUN_TIME_STATS
+        bool found;
+        uint32_t prev = prev_run_time(st.xHandle, &found);
+        if (found && s_prev_total != 0 && window > 0)
+        {
+            task.cpu_permille = (int16_t)((uint64_t)(st.ulRunTimeCounter - prev) * 1000 / window);
+        }
+#endif
+    }
+
+    for (UBaseType_t i = 0; i < n; ++i)
+    {
+        s_prev[i].handle = s_status[i].xHandle;
+        s_prev[i].run_time = s_status[i].ulRunTimeCounter;
+    }
+    s_prev_count = n;
+    s_prev_total = total;
+}
+#else
+static void sample_tasks(DiagSnapshot *snap)
+{
+    snap->task_count = 0;
+}
+#endif
+
+static void log_summary(const DiagSnapshot &snap)
+{
+    uint32_t failures = s_alloc_failures.load(std::memory_order_relaxed);
+    Serial.printf("[Diag] Internal heap: free %u (min %u), largest %u, frag %u%%; PSRAM free %u, largest %u; "
+                  "alloc failures %u\n",
+                  (unsigned)snap.internal.free, (unsigned)snap.internal.min_free, (unsigned)snap.internal.largest,
+                  heap_frag_pct(snap.internal), (unsigned)snap.psram.free, (unsigned)snap.psram.largest,
+                  (unsigned)failures);
+    for (int i = 0; i < snap.task_count; ++i)
+    {
+        if (snap.tasks[i].stack_free < DIAG_STACK_WARN_BYTES)
+        {
+            Serial.printf("[Diag] WARNING: %s has only %u bytes of stack left\n", snap.tasks[i].name,
+                          (unsigned)snap.tasks[i].stack_free);
+        }
+    }
+}
+
+void diagnostics_task(void *pvParameters)
+{
+    (void)pvParameters;
+    // Снимок собирается в локальной копии: мьютекс держится только на время копирования
+    static DiagSnapshot sample;
+    uint32_t last_ms = millis();
+    uint32_t samples = 0;
+
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(DIAG_SAMPLE_PERIOD_MS));
+
+        uint32_t now_ms = millis();
+        sample.uptime_ms = now_ms;
+        sample.window_ms = now_ms - last_ms;
+        last_ms = now_ms;
+        sample_tasks(&sample);
+        read_heap(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, &sample.internal);
+        read_heap(MALLOC_CAP_SPIRAM, &sample.psram);
+
+        xSemaphoreTake(s_diag_mutex, portMAX_DELAY);
+        s_snapshot = sample;
+        xSemaphoreGive(s_diag_mutex);
+
+        if (++samples % DIAG_LOG_EVERY == 0)
+        {
+            log_summary(sample);
+        }
+    }
+}
+
+static void write_heap_json(Print &out, const char *name, const DiagHeap &heap)
+{
+    out.printf("\"%s\":{\"total\":%u,\"free\":%u,\"min_free\":%u,\"largest\":%u,\"frag\":%u}", name,
+               (unsigned)heap.total, (unsigned)heap.free, (unsigned)heap.min_free, (unsigned)heap.largest,
+               heap_frag_pct(heap));
+}
+
+void diagnostics_write_json(Print &out)
+{
+    // Вызывается только из задачи веб-сервера; копия статическая, чтобы не занимать её стек
+    static DiagSnapshot snap;
+    xSemaphoreTake(s_diag_mutex, portMAX_DELAY);
+    snap = s_snapshot;
+    xSemaphoreGive(s_diag_mutex);
+
+    out.printf("{\"uptime_ms\":%u,\"window_ms\":%u,\"tasks\":[", (unsigned)snap.uptime_ms, (unsigned)snap.window_ms);
+    for (int i = 0; i < snap.task_count; ++i)
+    {
+        const DiagTask &task = snap.tasks[i];
+        out.printf("%s{\"name\":\"%s\",\"core\":%d,\"prio\":%u,", i ? "," : "", task.name, task.core,
+                   (unsigned)task.prio);
+        if (task.cpu_permille >= 0)
+        {
+            out.printf("\"cpu\":%d.%d,", task.cpu_permille / 10, task.cpu_permille % 10);
+        }
+        else
+        {
+            out.print("\"cpu\":-1,");
+        }
+        out.printf("\"stack_free\":%u}", (unsigned)task.stack_free);
+    }
+    out.print("],\"heap\":{");
+    write_heap_json(out, "internal", snap.internal);
+    out.print(',');
+    write_heap_json(out, "psram", snap.psram);
+    out.printf("},\"alloc_failures\":{\"count\":%u,\"last_size\":%u,\"last_caps\":%u},\"boot_us\":{",
+               (unsigned)s_alloc_failures.load(std::memory_order_relaxed),
+               (unsigned)s_last_failed_size.load(std::memory_order_relaxed),
+               (unsigned)s_last_failed_caps.load(std::memory_order_relaxed));
+    for (int i = 0; i < BOOT_MILESTONE_COUNT; ++i)
+    {
+        out.printf("%s\"%s\":%u", i ? "," : "", BOOT_MILESTONE_NAMES[i],
+                   (unsigned)s_boot_us[i].load(std::memory_order_relaxed));
+    }
+    out.print("}}");
+}
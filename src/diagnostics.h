@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+
+class Print;
+
+// Диагностика ресурсов: доля CPU и запас стека каждой задачи FreeRTOS, свободная память
+// внутренней кучи и PSRAM с наибольшим блоком (фрагментация), число отказов выделения.
+// Задача-сборщик снимает состояние раз в DIAG_SAMPLE_PERIOD_MS; CPU - доля от времени
+// одного ядра за последний интервал.
+
+const uint32_t DIAG_SAMPLE_PERIOD_MS = 5000;
+// Запас стека меньше этого - предупреждение в логе
+const uint32_t DIAG_STACK_WARN_BYTES = 512;
+
+// Регистрация обработчика отказов выделения, вызывается в начале setup().
+bool diagnostics_init();
+
+// Сборщик (ядро 0, низкий приоритет). Раз в минуту пишет сводку в Serial.
+void diagnostics_task(void *pvParameters);
+
+// Этапы поэтапной загрузки. Время от запуска фиксируется при первом достижении этапа
+// и пишется в лог; повторные вызовы ничего не стоят.
+enum BootMilestone
+{
+    BOOT_SAFETY_TASKS,      // Датчики, зуммер и менеджер запущены
+    BOOT_FIRST_MEASUREMENT, // Первое опубликованное измерение
+    BOOT_FIRST_BEEP,        // Первый сигнал зуммера
+    BOOT_FS_READY,          // LittleFS смонтирована, настройки прочитаны
+    BOOT_WIFI_READY,        // Точка доступа поднята
+    BOOT_WEB_READY,         // Веб-сервер и остальные задачи запущены
+    BOOT_MILESTONE_COUNT,
+};
+void diagnostics_boot_mark(BootMilestone m);
+
+// Последний снимок в JSON:
+// {"uptime_ms","window_ms","tasks":[{"name","core","prio","cpu","stack_free"}],
+//  "heap":{"internal":{"total","free","min_free","largest","frag"},"psram":{...}},
+//  "alloc_failures":{"count","last_size","last_caps"},
+//  "boot_us":{"safety_tasks","first_measurement","first_beep","fs_ready","wifi_ready","web_ready"}}
+// cpu - проценты (-1, если FreeRTOS собран без счётчиков времени), core -1 - без привязки,
+// этап загрузки 0 - ещё не достигнут.
+void diagnostics_write_json(Print &out);
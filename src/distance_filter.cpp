@@ -0,0 +1,96 @@
+#include "distance_filter.h"
+#include <math.h>
+#include <string.h>
+
+static const float MAX_DISTANCE_CM = 400.0f;
+// Быстрее этого машина у препятствия не движется; ограничивает скорость после скачка
+static const float MAX_VELOCITY_CMS = 500.0f;
+// Скачок больше этого после медианы - новое препятствие, а не движение: захватываем заново
+static const float REACQUIRE_CM = 50.0f;
+
+DistanceFilterConfig distance_filter_default_config()
+{
+    DistanceFilterConfig cfg;
+    cfg.type = FILTER_MEDIAN_AB;
+    cfg.median_len = FILTER_DEFAULT_MEDIAN;
+    cfg.alpha = FILTER_DEFAULT_ALPHA;
+    cfg.beta = FILTER_DEFAULT_BETA;
+    return cfg;
+}
+
+bool distance_filter_config_valid(const DistanceFilterConfig &cfg)
+{
+    if (cfg.type > FILTER_MEDIAN_AB)
+    {
+        return false;
+    }
+    if (cfg.median_len != 1 && cfg.median_len != 3 && cfg.median_len != 5)
+    {
+        return false;
+    }
+    return cfg.alpha > 0.0f && cfg.alpha <= 1.0f && cfg.beta >= 0.0f && cfg.beta < 1.0f;
+}
+
+void distance_filter_reset(DistanceFilterState *st)
+{
+    memset(st, 0, sizeof(*st));
+}
+
+// Медиана не более чем из 5 значений: сортировка вставками копии окна
+static float median(const DistanceFilterState *st, int len)
+{
+    float v[FILTER_MEDIAN_MAX];
+    int n = (st->count < len) ? st->count : len;
+    for (int i = 0; i < n; ++i)
+    {
+        float x = st->window[(st->head + FILTER_MEDIAN_MAX - 1 - i) % FILTER_MEDIAN_MAX];
+        int j = i;
+        while (j > 0 && v[j - 1] > x)
+        {
+            v[j] = v[j - 1];
+            j--;
+        }
+        v[j] = x;
+    }
+    // При чётном числе значений берём меньшее: ближнее препятствие важнее
+    return v[(n - 1) / 2];
+}
+
+float distance_filter_update(DistanceFilterState *st, const DistanceFilterConfig &cfg, float raw_cm, float dt_s)
+{
+    st->window[st->head] = raw_cm;
+    st->head = (st->head + 1) % FILTER_MEDIAN_MAX;
+    if (st->count < FILTER_MEDIAN_MAX)
+    {
+        st->count++;
+    }
+
+    float z = (cfg.type == FILTER_RAW) ? raw_cm : median(st, cfg.median_len);
+
+    if (cfg.type != FILTER_MEDIAN_AB || st->count == 1 || dt_s <= 0.0f)
+    {
+        st->distance_cm = z;
+        st->velocity_cms = 0.0f;
+        return z;
+    }
+
+    float predicted = st->distance_cm + st->velocity_cms * dt_s;
+    float residual = z - predicted;
+    if (fabsf(residual) > REACQUIRE_CM)
+    {
+        st->distance_cm = z;
+        st->velocity_cms = 0.0f;
+        return z;
+    }
+    float x = predicted + cfg.alpha * residual;
+    float v = st->velocity_cms + cfg.beta * residual / dt_s;
+
+    if (v > MAX_VELOCITY_CMS) v = MAX_VELOCITY_CMS;
+    if (v < -MAX_VELOCITY_CMS) v = -MAX_VELOCITY_CMS;
+    if (x < 0.0f) x = 0.0f;
+    if (x > MAX_DISTANCE_CM) x = MAX_DISTANCE_CM;
+
+    st->distance_cm = x;
+    st->velocity_cms = v;
+    return x;
+}
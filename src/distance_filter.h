@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+
+// Цепочка фильтров расстояния одного датчика: медиана по короткому окну убирает одиночные
+// выбросы (пропущенное эхо = 400 см), альфа-бета фильтр следит за расстоянием и скоростью
+// без запаздывания скользящего среднего. Обновление O(1), состояние - одна структура на датчик.
+
+enum DistanceFilterType
+{
+    FILTER_RAW = 0,       // Без фильтрации
+    FILTER_MEDIAN = 1,    // Только медиана
+    FILTER_MEDIAN_AB = 2, // Медиана + альфа-бета
+};
+
+const int FILTER_MEDIAN_MAX = 5;
+
+// Настройки по умолчанию: медиана из 5 + альфа-бета 0.5 / 0.1
+constexpr int FILTER_DEFAULT_MEDIAN = 5;
+constexpr float FILTER_DEFAULT_ALPHA = 0.5f;
+constexpr float FILTER_DEFAULT_BETA = 0.1f;
+
+struct DistanceFilterConfig
+{
+    uint8_t type;       // DistanceFilterType
+    uint8_t median_len; // 1, 3 или 5
+    float alpha;        // Доверие к измерению расстояния, (0, 1]
+    float beta;         // Доверие к измерению скорости, [0, 1)
+};
+
+struct DistanceFilterState
+{
+    float window[FILTER_MEDIAN_MAX];
+    uint8_t head;
+    uint8_t count;
+    float distance_cm;
+    float velocity_cms; // < 0 - препятствие приближается
+};
+
+DistanceFilterConfig distance_filter_default_config();
+
+// false - параметры вне допустимых пределов.
+bool distance_filter_config_valid(const DistanceFilterConfig &cfg);
+
+void distance_filter_reset(DistanceFilterState *st);
+
+// Новое сырое значение, dt_s - время с предыдущего измерения этого датчика.
+float distance_filter_update(DistanceFilterState *st, const DistanceFilterConfig &cfg, float raw_cm, float dt_s);
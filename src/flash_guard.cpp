@@ -0,0 +1,17 @@
+#include "flash_guard.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Мьютекс с наследованием приоритета: flush_task регистратора (приоритет 1) не задерживает
+// sensors_task дольше одной операции с flash
+static SemaphoreHandle_t s_flash_mutex = xSemaphoreCreateMutex();
+
+void flash_guard_take()
+{
+    xSemaphoreTake(s_flash_mutex, portMAX_DELAY);
+}
+
+void flash_guard_give()
+{
+    xSemaphoreGive(s_flash_mutex);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Запись во flash (стирание сектора до 45-400 мс, страница ~0.7 мс) отключает кэш на обоих ядрах,
+// и прерывания не из IRAM (захват MCPWM, esp_timer) ждут её окончания. Эхо, захваченное в это
+// время, приходит в sensors_task с опозданием и отбрасывается как "нет препятствий".
+// sensors_task держит охрану от триггера до сбора эха, clip_store - на время каждой операции
+// с разделом "rec": запись клипа попадает в паузы между группами датчиков.
+// Редкие записи (настройки в NVS, OTA) охрану не берут.
+void flash_guard_take();
+void flash_guard_give();
@@ -0,0 +1,197 @@
+#include "frame_pool.h"
+#include <Arduino.h>
+#include "freertos/semphr.h"
+#include "config.h"
+#include "esp_timer.h"
+
+const int MAX_FRAME_SUBSCRIBERS = 4;
+
+static SemaphoreHandle_t xFramePoolMutex = NULL;
+static SemaphoreHandle_t xFrameSlots = NULL;
+static frame_t s_frames[CAM_FB_COUNT];
+static frame_t *s_latest = NULL;
+static uint32_t s_seq = 0;
+static bool s_open = false;
+static int64_t s_open_us = 0;
+static TaskHandle_t s_subscribers[MAX_FRAME_SUBSCRIBERS] = {NULL};
+static frame_publish_hook_t s_publish_hook = NULL;
+
+bool frame_pool_init()
+{
+    xFramePoolMutex = xSemaphoreCreateMutex();
+    xFrameSlots = xSemaphoreCreateCounting(CAM_FB_COUNT, CAM_FB_COUNT);
+    return xFramePoolMutex && xFrameSlots;
+}
+
+// Возврат буфера драйверу. Вызывается без xFramePoolMutex.
+// xCameraMutex не нужен: пока слот занят, frame_pool_close() не пустит к esp_camera_deinit().
+static void return_to_driver(camera_fb_t *fb)
+{
+    esp_camera_fb_return(fb);
+    xSemaphoreGive(xFrameSlots);
+}
+
+void frame_pool_open()
+{
+    xSemaphoreTake(xFramePoolMutex, portMAX_DELAY);
+    s_open = true;
+    s_open_us = esp_timer_get_time();
+    xSemaphoreGive(xFramePoolMutex);
+}
+
+void frame_pool_close()
+{
+    xSemaphoreTake(xFramePoolMutex, portMAX_DELAY);
+    s_open = false;
+    frame_t *last = s_latest;
+    s_latest = NULL;
+    xSemaphoreGive(xFramePoolMutex);
+
+    if (last)
+    {
+        frame_release(last);
+    }
+
+    // Читатели (например, медленная HTTP-отдача снимка) ещё могут держать буферы.
+    unsigned long start = millis();
+    bool warned = false;
+    while (uxSemaphoreGetCount(xFrameSlots) < CAM_FB_COUNT)
+    {
+        if (!warned && millis() - start > 2000)
+        {
+            Serial.println("[FramePool] Waiting for readers to release frames...");
+            warned = true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+bool frame_pool_reserve(TickType_t timeout)
+{
+    return xSemaphoreTake(xFrameSlots, timeout) == pdTRUE;
+}
+
+void frame_pool_unreserve()
+{
+    xSemaphoreGive(xFrameSlots);
+}
+
+void frame_pool_publish(camera_fb_t *fb)
+{
+    frame_t *previous = NULL;
+    bool published = false;
+
+    // Метка кадра - esp_timer_get_time() драйвера. Кадр, снятый до open(), остался
+    // в очереди драйвера с прошлого включения (standby) и не публикуется.
+    int64_t captured_us = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+
+    xSemaphoreTake(xFramePoolMutex, portMAX_DELAY);
+    if (s_open && captured_us >= s_open_us)
+    {
+        for (int i = 0; i < CAM_FB_COUNT; ++i)
+        {
+            if (s_frames[i].refs == 0)
+            {
+                s_frames[i].fb = fb;
+                s_frames[i].seq = ++s_seq;
+                s_frames[i].refs = 1; // Ссылка пула
+                previous = s_latest;
+                s_latest = &s_frames[i];
+                published = true;
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(xFramePoolMutex);
+
+    if (!published)
+    {
+        return_to_driver(fb);
+        return;
+    }
+    if (previous)
+    {
+        frame_release(previous);
+    }
+    for (int i = 0; i < MAX_FRAME_SUBSCRIBERS; ++i)
+    {
+        if (s_subscribers[i])
+        {
+            xTaskNotifyGive(s_subscribers[i]);
+        }
+    }
+    if (s_publish_hook)
+    {
+        s_publish_hook();
+    }
+}
+
+frame_t *frame_pool_acquire_latest()
+{
+    frame_t *frame = NULL;
+    xSemaphoreTake(xFramePoolMutex, portMAX_DELAY);
+    if (s_latest)
+    {
+        frame = s_latest;
+        frame->refs++;
+    }
+    xSemaphoreGive(xFramePoolMutex);
+    return frame;
+}
+
+void frame_release(frame_t *frame)
+{
+    if (!frame)
+    {
+        return;
+    }
+    camera_fb_t *to_return = NULL;
+    xSemaphoreTake(xFramePoolMutex, portMAX_DELAY);
+    if (--frame->refs == 0)
+    {
+        to_return = frame->fb;
+        frame->fb = NULL;
+    }
+    xSemaphoreGive(xFramePoolMutex);
+
+    if (to_return)
+    {
+        return_to_driver(to_return);
+    }
+}
+
+frame_t *frame_addref(frame_t *frame)
+{
+    xSemaphoreTake(xFramePoolMutex, portMAX_DELAY);
+    frame->refs++;
+    xSemaphoreGive(xFramePoolMutex);
+    return frame;
+}
+
+uint32_t frame_pool_last_seq()
+{
+    xSemaphoreTake(xFramePoolMutex, portMAX_DELAY);
+    uint32_t seq = s_latest ? s_latest->seq : 0;
+    xSemaphoreGive(xFramePoolMutex);
+    return seq;
+}
+
+void frame_pool_on_publish(frame_publish_hook_t hook)
+{
+    s_publish_hook = hook;
+}
+
+void frame_pool_subscribe()
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    xSemaphoreTake(xFramePoolMutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_FRAME_SUBSCRIBERS; ++i)
+    {
+        if (s_subscribers[i] == NULL || s_subscribers[i] == self)
+        {
+            s_subscribers[i] = self;
+            break;
+        }
+    }
+    xSemaphoreGive(xFramePoolMutex);
+}
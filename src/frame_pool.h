@@ -0,0 +1,48 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "esp_camera.h"
+
+// Кадр камеры со счётчиком ссылок. Буфер драйвера возвращается (esp_camera_fb_return),
+// только когда последний читатель отпустил ссылку.
+struct frame_t
+{
+    camera_fb_t *fb;
+    uint32_t seq; // Сквозной номер публикации, растёт и между включениями камеры
+    int refs;
+};
+
+// Создание объектов синхронизации пула, вызывается один раз из setup().
+bool frame_pool_init();
+
+// Разрешить/запретить публикацию. Кадры, снятые до open(), отбрасываются.
+// close() отпускает последний кадр и ждёт,
+// пока читатели вернут все буферы - только после этого можно делать esp_camera_deinit().
+void frame_pool_open();
+void frame_pool_close();
+
+// Захват слота под кадр драйвера: не больше CAM_FB_COUNT буферов одновременно на руках,
+// иначе esp_camera_fb_get() заблокируется в драйвере. Слот берётся до esp_camera_fb_get(),
+// поэтому frame_pool_close() дожидается и идущего захвата.
+bool frame_pool_reserve(TickType_t timeout);
+void frame_pool_unreserve();
+
+// Публикация нового кадра (frame_grab_task). Предыдущий кадр теряет ссылку пула.
+void frame_pool_publish(camera_fb_t *fb);
+
+// Ссылка на последний опубликованный кадр или NULL. Парный вызов - frame_release().
+frame_t *frame_pool_acquire_latest();
+void frame_release(frame_t *frame);
+
+// Ещё одна ссылка на кадр, который вызывающий уже держит. Парный вызов - frame_release().
+frame_t *frame_addref(frame_t *frame);
+
+// Номер последней публикации (0 - кадров ещё не было).
+uint32_t frame_pool_last_seq();
+
+// Текущая задача получает xTaskNotifyGive() при каждой публикации.
+void frame_pool_subscribe();
+
+// Функция вызывается после каждой публикации в контексте frame_grab_task - для тех,
+// кто ждёт кадры не в своей задаче (HTTP-ответы в async_tcp). Не должна блокироваться.
+typedef void (*frame_publish_hook_t)();
+void frame_pool_on_publish(frame_publish_hook_t hook);
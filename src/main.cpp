@@ -6,6 +6,11 @@
 #include "tasks/camera_task.h"
 #include "tasks/sensors_task.h"
 #include "tasks/stream_task.h"
+#include "tasks/frame_grab_task.h"
+#include "frame_pool.h"
+#include "diagnostics.h"
+#include "power_manager.h"
+#include "recorder.h"
 #include "web/web_server.h"
 #include "web/websocket_manager.h"
 #include "settings_manager.h"
@@ -17,20 +22,11 @@ SemaphoreHandle_t xStateMutex = NULL;
 EventGroupHandle_t xAppEventGroup = NULL;
 SemaphoreHandle_t xCameraMutex = NULL;
 
-void setup()
+// Этап 2 (ядро 0): файловая система, точка доступа, веб-сервер и видео поднимаются
+// параллельно с уже работающими датчиками и зуммером.
+static void boot_services_task(void *pvParameters)
 {
-    Serial.begin(115200);
-    delay(1000);
-    Serial.println("Booting up...");
-
-    xStateMutex = xSemaphoreCreateMutex();
-    xAppEventGroup = xEventGroupCreate();
-    xCameraMutex = xSemaphoreCreateMutex();
-    if (!xStateMutex || !xAppEventGroup || !xCameraMutex)
-    {
-        Serial.println("CRITICAL: Failed to create sync objects!");
-        while (1) vTaskDelay(1000);
-    }
+    (void)pvParameters;
 
     if (!LittleFS.begin(true))
     {
@@ -38,20 +34,23 @@ void setup()
         while (1) vTaskDelay(1000);
     }
 
+    // Настройки из LittleFS - основной источник; заменяют кэш, если он устарел
     settings_init();
+    parktronic_manager_notify_settings();
+    diagnostics_boot_mark(BOOT_FS_READY);
 
-    for (int i = 0; i < NUM_SENSORS; ++i)
-    {
-        g_app_state.sensor_distances[i] = 999.0;
-    }
-    g_app_state.is_camera_initialized = false;
-    g_app_state.is_parktronic_active = false;
-    g_app_state.is_muted = false;
+    char ssid[sizeof(g_app_state.settings.wifi_ssid)];
+    char pass[sizeof(g_app_state.settings.wifi_pass)];
+    xSemaphoreTake(xStateMutex, portMAX_DELAY);
+    memcpy(ssid, g_app_state.settings.wifi_ssid, sizeof(ssid));
+    memcpy(pass, g_app_state.settings.wifi_pass, sizeof(pass));
+    xSemaphoreGive(xStateMutex);
 
     WiFi.mode(WIFI_AP);
-    WiFi.softAP(g_app_state.settings.wifi_ssid, g_app_state.settings.wifi_pass);
+    WiFi.softAP(ssid, pass);
     Serial.print("AP IP address: ");
     Serial.println(WiFi.softAPIP());
+    diagnostics_boot_mark(BOOT_WIFI_READY);
 
     init_web_server();
 
@@ -66,15 +65,31 @@ void setup()
         while (1) vTaskDelay(1000);
     }
 
-    // --- Ядро 1 ---
     task_creation_result = xTaskCreatePinnedToCore(
-        sensors_task, "SensorsTask", 2048, NULL, 5, NULL, 1);
+        frame_grab_task, "FrameGrabTask", 2048, NULL, 5, NULL, 0);
     if (task_creation_result != pdPASS)
     {
-        Serial.println("CRITICAL: Failed to create SensorsTask!");
+        Serial.println("CRITICAL: Failed to create FrameGrabTask!");
+        while (1) vTaskDelay(1000);
+    }
+
+    task_creation_result = xTaskCreatePinnedToCore(
+        settings_flush_task, "SettingsTask", 3072, NULL, 1, NULL, 0);
+    if (task_creation_result != pdPASS)
+    {
+        Serial.println("CRITICAL: Failed to create SettingsTask!");
+        while (1) vTaskDelay(1000);
+    }
+
+    task_creation_result = xTaskCreatePinnedToCore(
+        diagnostics_task, "DiagTask", 3072, NULL, 1, NULL, 0);
+    if (task_creation_result != pdPASS)
+    {
+        Serial.println("CRITICAL: Failed to create DiagTask!");
         while (1) vTaskDelay(1000);
     }
 
+    // --- Ядро 1 ---
     task_creation_result = xTaskCreatePinnedToCore(
         stream_task, "StreamTask", 4096, NULL, 4, NULL, 1);
     if (task_creation_result != pdPASS)
@@ -82,7 +97,75 @@ void setup()
         Serial.println("CRITICAL: Failed to create StreamTask!");
         while (1) vTaskDelay(1000);
     }
-    
+
+    task_creation_result = xTaskCreatePinnedToCore(
+        broadcast_sensors_task, "WsSensorsTask", 2048, NULL, 2, NULL, 1);
+    if (task_creation_result != pdPASS)
+    {
+        Serial.println("CRITICAL: Failed to create WsSensorsTask!");
+        while (1) vTaskDelay(1000);
+    }
+
+    // Регистратор необязателен: без раздела "rec" или PSRAM остальное работает как прежде
+    if (recorder_init())
+    {
+        task_creation_result = xTaskCreatePinnedToCore(
+            recorder_flush_task, "RecFlushTask", 3072, NULL, 1, NULL, 0);
+        if (task_creation_result != pdPASS)
+        {
+            Serial.println("CRITICAL: Failed to create RecFlushTask!");
+            while (1) vTaskDelay(1000);
+        }
+
+        task_creation_result = xTaskCreatePinnedToCore(
+            recorder_capture_task, "RecCaptureTask", 3072, NULL, 2, NULL, 1);
+        if (task_creation_result != pdPASS)
+        {
+            Serial.println("CRITICAL: Failed to create RecCaptureTask!");
+            while (1) vTaskDelay(1000);
+        }
+    }
+
+    diagnostics_boot_mark(BOOT_WEB_READY);
+    Serial.println("Setup complete. All tasks are running.");
+    vTaskDelete(NULL);
+}
+
+void setup()
+{
+    // Без паузы после Serial.begin: ранние сообщения могут не дойти до монитора, зато
+    // датчики и зуммер запускаются сразу после включения зажигания
+    Serial.begin(115200);
+    Serial.println("Booting up...");
+
+    xStateMutex = xSemaphoreCreateMutex();
+    xAppEventGroup = xEventGroupCreate();
+    xCameraMutex = xSemaphoreCreateMutex();
+    if (!xStateMutex || !xAppEventGroup || !xCameraMutex || !frame_pool_init() || !diagnostics_init() || !power_init())
+    {
+        Serial.println("CRITICAL: Failed to create sync objects!");
+        while (1) vTaskDelay(1000);
+    }
+
+    // Этап 1: настройки из RTC/NVS без монтирования LittleFS, затем задачи, от которых
+    // зависит звуковая подсказка
+    settings_load_cached();
+
+    g_app_state.is_camera_initialized = false;
+    g_app_state.is_parktronic_active = false;
+    g_app_state.is_muted = false;
+
+    BaseType_t task_creation_result;
+
+    // --- Ядро 1 ---
+    task_creation_result = xTaskCreatePinnedToCore(
+        sensors_task, "SensorsTask", 3072, NULL, 5, NULL, 1);
+    if (task_creation_result != pdPASS)
+    {
+        Serial.println("CRITICAL: Failed to create SensorsTask!");
+        while (1) vTaskDelay(1000);
+    }
+
     task_creation_result = xTaskCreatePinnedToCore(
         buzzer_task, "BuzzerTask", 2048, NULL, 4, NULL, 1);
     if (task_creation_result != pdPASS)
@@ -98,16 +181,16 @@ void setup()
         Serial.println("CRITICAL: Failed to create ParktronicManager!");
         while (1) vTaskDelay(1000);
     }
+    diagnostics_boot_mark(BOOT_SAFETY_TASKS);
 
+    // --- Ядро 0 ---
     task_creation_result = xTaskCreatePinnedToCore(
-        broadcast_sensors_task, "WsSensorsTask", 2048, NULL, 2, NULL, 1);
+        boot_services_task, "BootTask", 4096, NULL, 3, NULL, 0);
     if (task_creation_result != pdPASS)
     {
-        Serial.println("CRITICAL: Failed to create WsSensorsTask!");
+        Serial.println("CRITICAL: Failed to create BootTask!");
         while (1) vTaskDelay(1000);
     }
-
-    Serial.println("Setup complete. All tasks are running.");
 }
 
 void loop()
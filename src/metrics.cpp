@@ -0,0 +1,192 @@
+#include "metrics.h"
+#include <Arduino.h>
+
+// Границы корзин под ожидаемые диапазоны: эхо ждёт второй датчик группы (до ~30 мс),
+// цикл опроса ~40-80 мс, кадр XGA до 100 КБ, зуммер перестраивается в пределах миллисекунд.
+static const uint32_t ECHO_LATENCY_BOUNDS[] = {50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000};
+static const uint32_t SWEEP_PERIOD_BOUNDS[] = {20000, 30000, 40000, 50000, 60000, 80000, 100000, 150000, 200000, 300000};
+static const uint32_t FB_GET_WAIT_BOUNDS[] = {100, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000};
+static const uint32_t FRAME_SIZE_BOUNDS[] = {8192, 16384, 24576, 32768, 49152, 65536, 81920, 102400, 153600};
+static const uint32_t BROADCAST_BOUNDS[] = {50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000};
+static const uint32_t BUZZER_REACTION_BOUNDS[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+// Включает антидребезг 20 мс
+static const uint32_t WAKE_TO_ACTIVE_BOUNDS[] = {20500, 21000, 22000, 25000, 30000, 40000, 50000, 100000, 200000, 500000};
+
+#define BOUNDS(b) b, (uint8_t)(sizeof(b) / sizeof(b[0]))
+
+static_assert(NUM_SENSORS == 3, "g_metric_echo_latency_us labels");
+Histogram g_metric_echo_latency_us[NUM_SENSORS] = {
+    {"parktronic_echo_publish_latency_us", "Echo falling edge to snapshot publish", "sensor", "left", BOUNDS(ECHO_LATENCY_BOUNDS)},
+    {"parktronic_echo_publish_latency_us", "Echo falling edge to snapshot publish", "sensor", "center", BOUNDS(ECHO_LATENCY_BOUNDS)},
+    {"parktronic_echo_publish_latency_us", "Echo falling edge to snapshot publish", "sensor", "right", BOUNDS(ECHO_LATENCY_BOUNDS)},
+};
+Histogram g_metric_sweep_period_us = {"parktronic_sensor_sweep_period_us", "Full sensor sweep period", NULL, NULL,
+                                      BOUNDS(SWEEP_PERIOD_BOUNDS)};
+Histogram g_metric_fb_get_wait_us = {"parktronic_camera_fb_get_wait_us", "Time blocked in esp_camera_fb_get", NULL, NULL,
+                                     BOUNDS(FB_GET_WAIT_BOUNDS)};
+Histogram g_metric_frame_size_bytes = {"parktronic_camera_frame_size_bytes", "JPEG frame size", NULL, NULL,
+                                       BOUNDS(FRAME_SIZE_BOUNDS)};
+Histogram g_metric_ws_stream_broadcast_us = {"parktronic_ws_stream_broadcast_us", "broadcast_ws_stream duration", NULL,
+                                             NULL, BOUNDS(BROADCAST_BOUNDS)};
+Histogram g_metric_buzzer_reaction_ms = {"parktronic_buzzer_reaction_ms",
+                                         "Sensor sample publish to buzzer zone change", NULL, NULL,
+                                         BOUNDS(BUZZER_REACTION_BOUNDS)};
+Histogram g_metric_wake_to_active_us = {"parktronic_wake_to_active_us", "Reverse gear edge to parktronic activation",
+                                        NULL, NULL, BOUNDS(WAKE_TO_ACTIVE_BOUNDS)};
+
+Counter g_metric_frames_captured = {"parktronic_camera_frames_captured_total", "Frames returned by esp_camera_fb_get",
+                                    NULL, NULL};
+Counter g_metric_frames_sent = {"parktronic_stream_frames_sent_total", "Frames queued to /ws_stream and /stream.mjpg clients", NULL, NULL};
+Counter g_metric_frames_dropped_queue = {"parktronic_stream_frames_dropped_total", "Frames not sent to a client",
+                                         "reason", "queue_full"};
+Counter g_metric_frames_dropped_oversize = {"parktronic_stream_frames_dropped_total", "Frames not sent to a client",
+                                            "reason", "oversize"};
+
+static Histogram *const HISTOGRAMS[] = {
+    &g_metric_echo_latency_us[0],
+    &g_metric_echo_latency_us[1],
+    &g_metric_echo_latency_us[2],
+    &g_metric_sweep_period_us,
+    &g_metric_fb_get_wait_us,
+    &g_metric_frame_size_bytes,
+    &g_metric_ws_stream_broadcast_us,
+    &g_metric_buzzer_reaction_ms,
+    &g_metric_wake_to_active_us,
+};
+
+static Counter *const COUNTERS[] = {
+    &g_metric_frames_captured,
+    &g_metric_frames_sent,
+    &g_metric_frames_dropped_queue,
+    &g_metric_frames_dropped_oversize,
+};
+
+void histogram_record(Histogram &h, uint32_t value)
+{
+    uint8_t i = 0;
+    while (i < h.bound_count && value > h.bounds[i])
+    {
+        ++i;
+    }
+    h.buckets[i].fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+// Снимок ряда для вывода: корзины читаются по одной, поэтому count берётся как их сумма
+struct HistogramView
+{
+    uint32_t buckets[HISTOGRAM_MAX_BUCKETS + 1];
+    uint32_t count;
+    uint64_t sum;
+};
+
+static HistogramView read_histogram(const Histogram &h)
+{
+    HistogramView v;
+    v.count = 0;
+    for (uint8_t i = 0; i <= h.bound_count; ++i)
+    {
+        v.buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+        v.count += v.buckets[i];
+    }
+    v.sum = h.sum.load(std::memory_order_relaxed);
+    return v;
+}
+
+static void write_family_header(Print &out, const char *name, const char *help, const char *type, const char **last)
+{
+    // Ряды одного семейства (разные метки) идут подряд, HELP/TYPE - один раз
+    if (*last && strcmp(*last, name) == 0)
+    {
+        return;
+    }
+    *last = name;
+    out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_write_prometheus(Print &out)
+{
+    const char *last = NULL;
+    for (const Histogram *h : HISTOGRAMS)
+    {
+        write_family_header(out, h->name, h->help, "histogram", &last);
+        HistogramView v = read_histogram(*h);
+        char label[32] = "";
+        if (h->label_key)
+        {
+            snprintf(label, sizeof(label), "%s=\"%s\",", h->label_key, h->label_value);
+        }
+        uint32_t cumulative = 0;
+        for (uint8_t i = 0; i < h->bound_count; ++i)
+        {
+            cumulative += v.buckets[i];
+            out.printf("%s_bucket{%sle=\"%u\"} %u\n", h->name, label, (unsigned)h->bounds[i], (unsigned)cumulative);
+        }
+        out.printf("%s_bucket{%sle=\"+Inf\"} %u\n", h->name, label, (unsigned)v.count);
+        if (h->label_key)
+        {
+            label[strlen(label) - 1] = '\0'; // Без завершающей запятой
+            out.printf("%s_sum{%s} %llu\n%s_count{%s} %u\n", h->name, label, (unsigned long long)v.sum, h->name, label,
+                       (unsigned)v.count);
+        }
+        else
+        {
+            out.printf("%s_sum %llu\n%s_count %u\n", h->name, (unsigned long long)v.sum, h->name, (unsigned)v.count);
+        }
+    }
+
+    for (const Counter *c : COUNTERS)
+    {
+        write_family_header(out, c->name, c->help, "counter", &last);
+        unsigned value = c->value.load(std::memory_order_relaxed);
+        if (c->label_key)
+        {
+            out.printf("%s{%s=\"%s\"} %u\n", c->name, c->label_key, c->label_value, value);
+        }
+        else
+        {
+            out.printf("%s %u\n", c->name, value);
+        }
+    }
+}
+
+void metrics_write_json(Print &out)
+{
+    out.print("{\"histograms\":[");
+    bool first = true;
+    for (const Histogram *h : HISTOGRAMS)
+    {
+        HistogramView v = read_histogram(*h);
+        out.printf("%s{\"name\":\"%s\"", first ? "" : ",", h->name);
+        first = false;
+        if (h->label_key)
+        {
+            out.printf(",\"%s\":\"%s\"", h->label_key, h->label_value);
+        }
+        out.print(",\"le\":[");
+        for (uint8_t i = 0; i < h->bound_count; ++i)
+        {
+            out.printf(i ? ",%u" : "%u", (unsigned)h->bounds[i]);
+        }
+        out.print("],\"counts\":[");
+        for (uint8_t i = 0; i <= h->bound_count; ++i)
+        {
+            out.printf(i ? ",%u" : "%u", (unsigned)v.buckets[i]);
+        }
+        out.printf("],\"sum\":%llu,\"count\":%u}", (unsigned long long)v.sum, (unsigned)v.count);
+    }
+
+    out.print("],\"counters\":[");
+    first = true;
+    for (const Counter *c : COUNTERS)
+    {
+        out.printf("%s{\"name\":\"%s\"", first ? "" : ",", c->name);
+        first = false;
+        if (c->label_key)
+        {
+            out.printf(",\"%s\":\"%s\"", c->label_key, c->label_value);
+        }
+        out.printf(",\"value\":%u}", (unsigned)c->value.load(std::memory_order_relaxed));
+    }
+    out.print("]}");
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+
+class Print;
+
+// Метрики конвейеров датчиков и видео для /api/metrics. Запись дешёвая (поиск корзины по
+// нескольким границам и пара атомарных сложений без блокировок) и остаётся включённой всегда.
+
+const int HISTOGRAM_MAX_BUCKETS = 12;
+
+// Гистограмма с фиксированными корзинами. У каждой один писатель - задача, которая измеряет;
+// читатель (HTTP) может увидеть sum на одну запись новее, чем сумма корзин.
+// sum 64-битный: на Xtensa нет 64-битных атомарных инструкций, и std::atomic<uint64_t>
+// выполняется в короткой критической секции (stdatomic IDF) - половины не читаются вразнобой.
+struct Histogram
+{
+    const char *name;
+    const char *help;
+    const char *label_key;   // Метка ряда ("sensor") или NULL
+    const char *label_value;
+    const uint32_t *bounds;  // Верхние границы корзин (включительно), по возрастанию
+    uint8_t bound_count;
+    std::atomic<uint32_t> buckets[HISTOGRAM_MAX_BUCKETS + 1]{}; // Последняя - выше всех границ
+    std::atomic<uint64_t> sum{0};
+};
+
+struct Counter
+{
+    const char *name;
+    const char *help;
+    const char *label_key;
+    const char *label_value;
+    std::atomic<uint32_t> value{0};
+};
+
+void histogram_record(Histogram &h, uint32_t value);
+
+inline void counter_add(Counter &c, uint32_t n = 1)
+{
+    c.value.fetch_add(n, std::memory_order_relaxed);
+}
+
+// Датчики
+extern Histogram g_metric_echo_latency_us[NUM_SENSORS]; // Спад эха -> публикация измерения
+extern Histogram g_metric_sweep_period_us;
+// Камера и стрим
+extern Histogram g_metric_fb_get_wait_us;
+extern Histogram g_metric_frame_size_bytes;
+extern Histogram g_metric_ws_stream_broadcast_us;
+extern Counter g_metric_frames_captured;
+extern Counter g_metric_frames_sent;             // Кадр поставлен в очередь клиента /ws_stream или /stream.mjpg
+extern Counter g_metric_frames_dropped_queue;    // Очередь клиента полна
+extern Counter g_metric_frames_dropped_oversize; // Больше MAX_FRAME_SIZE_BYTES
+// Зуммер
+extern Histogram g_metric_buzzer_reaction_ms;
+// Питание: фронт задней передачи (в том числе пробуждение) -> включение парктроника
+extern Histogram g_metric_wake_to_active_us;
+
+// Экспорт: текстовый формат Prometheus и компактный JSON
+// {"histograms":[{"name","<метка>","le":[...],"counts":[... +Inf],"sum","count"}],"counters":[...]}.
+void metrics_write_prometheus(Print &out);
+void metrics_write_json(Print &out);
@@ -0,0 +1,224 @@
+#include "power_manager.h"
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "metrics.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+
+#if defined(CONFIG_PM_ENABLE) && CONFIG_PM_ENABLE
+#define POWER_ESP_PM 1
+#include "esp_pm.h"
+#else
+#define POWER_ESP_PM 0
+#endif
+// Автоматический light sleep требует ещё и tickless idle
+#if POWER_ESP_PM && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE) && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+#define POWER_LIGHT_SLEEP 1
+#else
+#define POWER_LIGHT_SLEEP 0
+#endif
+#if POWER_LIGHT_SLEEP
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#include "hal/gpio_ll.h"
+#endif
+
+static const char *const POWER_STATE_NAMES[POWER_STATE_COUNT] = {"active", "idle_clients", "idle"};
+
+// Оценка среднего тока, мА (типовые значения, не измерения):
+//   ACTIVE       - CPU 240 МГц и точка доступа ~100, OV5640 ~120, три датчика ~45;
+//   IDLE_CLIENTS - CPU 80 МГц и точка доступа ~70, датчики обесточены, камера в power-down;
+//   IDLE         - как IDLE_CLIENTS; с light sleep - сон между маяками точки доступа ~30.
+static const uint16_t POWER_EST_MA[POWER_STATE_COUNT] = {265, 70, POWER_LIGHT_SLEEP ? 30 : 70};
+
+static SemaphoreHandle_t s_power_mutex = NULL;
+static PowerState s_state = POWER_ACTIVE;
+static int64_t s_state_since_us = 0;
+static uint64_t s_state_time_us[POWER_STATE_COUNT];
+
+// Фронт задней передачи, с которого отсчитывается задержка активации; 0 - нет
+static std::atomic<int64_t> s_edge_us(0);
+static std::atomic<uint32_t> s_last_wake_to_active_us(0);
+static std::atomic<uint32_t> s_wake_to_active_count(0);
+
+#if POWER_ESP_PM
+static esp_pm_lock_handle_t s_cpu_max_lock = NULL;
+static esp_pm_lock_handle_t s_no_sleep_lock = NULL;
+#endif
+#if POWER_LIGHT_SLEEP
+static volatile bool s_wakeup_armed = false;
+#endif
+
+static void apply_clock(PowerState prev, PowerState next)
+{
+#if POWER_ESP_PM
+    // Блокировки берутся до освобождения старых, чтобы не проскочить через сон
+    bool prev_max = prev == POWER_ACTIVE, next_max = next == POWER_ACTIVE;
+    bool prev_awake = prev != POWER_IDLE, next_awake = next != POWER_IDLE;
+    if (next_max && !prev_max)
+    {
+        esp_pm_lock_acquire(s_cpu_max_lock);
+    }
+    if (next_awake && !prev_awake)
+    {
+        esp_pm_lock_acquire(s_no_sleep_lock);
+    }
+    if (prev_max && !next_max)
+    {
+        esp_pm_lock_release(s_cpu_max_lock);
+    }
+    if (prev_awake && !next_awake)
+    {
+        esp_pm_lock_release(s_no_sleep_lock);
+    }
+#else
+    (void)prev;
+    uint32_t mhz = next == POWER_ACTIVE ? POWER_MAX_CPU_MHZ : POWER_MIN_CPU_MHZ;
+    if (getCpuFrequencyMhz() != mhz)
+    {
+        setCpuFrequencyMhz(mhz);
+    }
+#endif
+}
+
+#if POWER_LIGHT_SLEEP
+static void arm_wakeup(bool reverse)
+{
+    // Пробуждение по уровню: GPIO-прерывание по фронту в light sleep теряется
+    s_wakeup_armed = true;
+    gpio_wakeup_enable((gpio_num_t)REVERSE_GEAR_PIN, reverse ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+}
+
+static void disarm_wakeup()
+{
+    s_wakeup_armed = false;
+    gpio_wakeup_disable((gpio_num_t)REVERSE_GEAR_PIN);
+    gpio_set_intr_type((gpio_num_t)REVERSE_GEAR_PIN, GPIO_INTR_ANYEDGE);
+}
+#endif
+
+bool power_init()
+{
+    s_power_mutex = xSemaphoreCreateMutex();
+    if (!s_power_mutex)
+    {
+        return false;
+    }
+    s_state_since_us = esp_timer_get_time();
+
+#if POWER_ESP_PM
+    esp_pm_config_esp32s3_t cfg;
+    cfg.max_freq_mhz = POWER_MAX_CPU_MHZ;
+    cfg.min_freq_mhz = POWER_MIN_CPU_MHZ;
+    cfg.light_sleep_enable = POWER_LIGHT_SLEEP;
+    if (esp_pm_configure(&cfg) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "parktronic", &s_cpu_max_lock) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "clients", &s_no_sleep_lock) != ESP_OK)
+    {
+        Serial.println("[Power] esp_pm configuration failed");
+        return false;
+    }
+    // Старт в ACTIVE: загрузка на полной частоте
+    esp_pm_lock_acquire(s_cpu_max_lock);
+    esp_pm_lock_acquire(s_no_sleep_lock);
+#endif
+#if POWER_LIGHT_SLEEP
+    esp_sleep_enable_gpio_wakeup();
+#endif
+    Serial.printf("[Power] %s, CPU %u-%u MHz, light sleep %s\n", POWER_ESP_PM ? "esp_pm" : "setCpuFrequencyMhz",
+                  (unsigned)POWER_MIN_CPU_MHZ, (unsigned)POWER_MAX_CPU_MHZ, POWER_LIGHT_SLEEP ? "on" : "off");
+    return true;
+}
+
+void power_set_state(PowerState state, bool reverse)
+{
+#if POWER_LIGHT_SLEEP
+    // Пробуждение могло сработать и сняться в ISR: в IDLE взводится заново
+    if (state == POWER_IDLE && !s_wakeup_armed)
+    {
+        arm_wakeup(reverse);
+    }
+    else if (state != POWER_IDLE && s_wakeup_armed)
+    {
+        disarm_wakeup();
+    }
+#else
+    (void)reverse;
+#endif
+    if (state == s_state)
+    {
+        return;
+    }
+
+    PowerState prev = s_state;
+    apply_clock(prev, state);
+
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_power_mutex, portMAX_DELAY);
+    s_state_time_us[prev] += now - s_state_since_us;
+    s_state_since_us = now;
+    s_state = state;
+    xSemaphoreGive(s_power_mutex);
+
+    Serial.printf("[Power] %s -> %s, CPU %u MHz\n", POWER_STATE_NAMES[prev], POWER_STATE_NAMES[state],
+                  (unsigned)getCpuFrequencyMhz());
+}
+
+void IRAM_ATTR power_on_reverse_edge_isr()
+{
+    int64_t expected = 0;
+    s_edge_us.compare_exchange_strong(expected, esp_timer_get_time(), std::memory_order_relaxed);
+#if POWER_LIGHT_SLEEP
+    // Прерывание по уровню повторялось бы, пока уровень держится: назад на фронты.
+    // gpio_ll - встраиваемые функции, безопасны в IRAM ISR.
+    if (s_wakeup_armed)
+    {
+        s_wakeup_armed = false;
+        gpio_ll_wakeup_disable(&GPIO, (gpio_num_t)REVERSE_GEAR_PIN);
+        gpio_ll_set_intr_type(&GPIO, (gpio_num_t)REVERSE_GEAR_PIN, GPIO_INTR_ANYEDGE);
+    }
+#endif
+}
+
+void power_reverse_settled(bool activated)
+{
+    int64_t edge_us = s_edge_us.exchange(0, std::memory_order_relaxed);
+    if (!activated || edge_us == 0)
+    {
+        return;
+    }
+    uint32_t latency_us = (uint32_t)(esp_timer_get_time() - edge_us);
+    s_last_wake_to_active_us.store(latency_us, std::memory_order_relaxed);
+    s_wake_to_active_count.fetch_add(1, std::memory_order_relaxed);
+    histogram_record(g_metric_wake_to_active_us, latency_us);
+}
+
+void power_write_json(Print &out)
+{
+    uint64_t time_us[POWER_STATE_COUNT];
+    xSemaphoreTake(s_power_mutex, portMAX_DELAY);
+    PowerState state = s_state;
+    for (int i = 0; i < POWER_STATE_COUNT; ++i)
+    {
+        time_us[i] = s_state_time_us[i];
+    }
+    time_us[state] += esp_timer_get_time() - s_state_since_us;
+    xSemaphoreGive(s_power_mutex);
+
+    out.printf("{\"state\":\"%s\",\"cpu_mhz\":%u,\"light_sleep\":%s,\"states\":[", POWER_STATE_NAMES[state],
+               (unsigned)getCpuFrequencyMhz(), POWER_LIGHT_SLEEP ? "true" : "false");
+    uint64_t total_us = 0;
+    uint64_t charge = 0; // мА * мкс
+    for (int i = 0; i < POWER_STATE_COUNT; ++i)
+    {
+        out.printf("%s{\"name\":\"%s\",\"time_ms\":%llu,\"est_ma\":%u}", i ? "," : "", POWER_STATE_NAMES[i],
+                   (unsigned long long)(time_us[i] / 1000), (unsigned)POWER_EST_MA[i]);
+        total_us += time_us[i];
+        charge += time_us[i] * POWER_EST_MA[i];
+    }
+    out.printf("],\"avg_ma_est\":%u,\"wake_to_active_us\":{\"last\":%u,\"count\":%u}}",
+               (unsigned)(total_us ? charge / total_us : POWER_EST_MA[state]),
+               (unsigned)s_last_wake_to_active_us.load(std::memory_order_relaxed),
+               (unsigned)s_wake_to_active_count.load(std::memory_order_relaxed));
+}
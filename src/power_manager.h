@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+
+class Print;
+
+// Политика питания. Состояние выбирает parktronic_manager_task:
+//   ACTIVE       - измерение или видео: CPU на максимальной частоте;
+//   IDLE_CLIENTS - неактивен, но есть клиенты (станции точки доступа, WebSocket, MJPEG): минимальная частота;
+//   IDLE         - никого нет: минимальная частота, при сборке с автоматическим light sleep - сон
+//                  с пробуждением по фронту REVERSE_GEAR_PIN.
+// С CONFIG_PM_ENABLE частотой управляет esp_pm (блокировки держатся только в ACTIVE/IDLE_CLIENTS),
+// без него (сборка Arduino по умолчанию) - setCpuFrequencyMhz.
+
+const uint32_t POWER_MAX_CPU_MHZ = 240;
+const uint32_t POWER_MIN_CPU_MHZ = 80; // Меньше нельзя при работающем Wi-Fi
+
+enum PowerState
+{
+    POWER_ACTIVE = 0,
+    POWER_IDLE_CLIENTS = 1,
+    POWER_IDLE = 2,
+    POWER_STATE_COUNT,
+};
+
+// Вызывается в setup() до запуска задач. false - esp_pm не принял конфигурацию.
+bool power_init();
+
+// Только из parktronic_manager_task. reverse - уровень задней передачи после антидребезга:
+// в IDLE пробуждение настраивается на противоположный уровень.
+void power_set_state(PowerState state, bool reverse);
+
+// Из ISR задней передачи: отметка фронта для задержки пробуждение -> активация; в IDLE снимает
+// пробуждение по уровню и возвращает прерывание по фронтам.
+void power_on_reverse_edge_isr();
+
+// Антидребезг задней передачи завершён: activated - парктроник включился по передаче
+// (задержка от фронта пишется в метрику), иначе отметка фронта сбрасывается.
+void power_reverse_settled(bool activated);
+
+// {"state","cpu_mhz","light_sleep","states":[{"name","time_ms","est_ma"}],"avg_ma_est",
+//  "wake_to_active_us":{"last","count"}}. Токи - оценки по типовым значениям из документации.
+void power_write_json(Print &out);
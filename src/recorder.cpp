@@ -0,0 +1,415 @@
+#include "recorder.h"
+#include <Arduino.h>
+#include "state.h"
+#include "clip_store.h"
+#include "frame_pool.h"
+#include "sensor_snapshot.h"
+#include "stream_controller.h"
+#include "esp_heap_caps.h"
+
+// Окно в PSRAM: RECORDER_PRE_MS кадров и измерений с запасом на то, что flash пишется
+// медленнее, чем идёт захват после срабатывания.
+const uint32_t RECORDER_BUFFER_BYTES = 2 * 1024 * 1024;
+const int RECORDER_MAX_ENTRIES = 128;
+// Измерения пишутся пачками: перед каждым кадром или по заполнении
+const int RECORDER_SAMPLE_BATCH = 16;
+const uint32_t RECORDER_IDLE_POLL_MS = 100;
+
+enum RecorderState
+{
+    REC_IDLE,
+    REC_CAPTURE, // Идёт окно после срабатывания
+    REC_DRAIN,   // Окно закончилось, запись во flash догоняет
+};
+
+// Элемент окна: байты лежат в s_buf[offset, offset + len), без перехода через конец буфера
+struct BufferedEntry
+{
+    uint32_t offset;
+    uint32_t len;
+    uint32_t t_ms;
+    uint8_t type; // ClipRecordType
+};
+
+static bool s_enabled = false;
+static uint8_t *s_buf = NULL;
+static TaskHandle_t s_flush_task = NULL;
+
+// Окно - очередь элементов [s_tail_id, s_head_id) с монотонными номерами. Пишет и вытесняет
+// только recorder_capture_task; recorder_flush_task читает элементы начиная с s_flush_id,
+// которые при записи клипа не вытесняются.
+static SemaphoreHandle_t s_rec_mutex = NULL;
+static BufferedEntry s_entries[RECORDER_MAX_ENTRIES];
+static uint32_t s_tail_id = 0;
+static uint32_t s_head_id = 0;
+static uint32_t s_write_off = 0;
+static uint32_t s_flush_id = 0;
+static uint32_t s_end_id = 0; // Конец клипа в REC_DRAIN
+static RecorderState s_state = REC_IDLE;
+static uint8_t s_reason = 0;
+static uint32_t s_trigger_ms = 0;
+static uint32_t s_dropped = 0;
+
+static const char *state_name(RecorderState state)
+{
+    switch (state)
+    {
+    case REC_CAPTURE:
+        return "capture";
+    case REC_DRAIN:
+        return "drain";
+    default:
+        return "idle";
+    }
+}
+
+bool recorder_init()
+{
+    s_rec_mutex = xSemaphoreCreateMutex();
+    if (!s_rec_mutex || !clip_store_init())
+    {
+        return false;
+    }
+    s_buf = (uint8_t *)heap_caps_malloc(RECORDER_BUFFER_BYTES, MALLOC_CAP_SPIRAM);
+    if (!s_buf)
+    {
+        Serial.println("[Rec] No PSRAM for pre-trigger buffer, recorder disabled");
+        return false;
+    }
+    s_enabled = true;
+    return true;
+}
+
+// Под s_rec_mutex. Место под len байт; при нехватке вытесняются старые элементы, кроме ещё
+// не записанных во flash. false - места нет, элемент отбрасывается.
+static bool reserve(uint32_t len, uint32_t *offset)
+{
+    for (;;)
+    {
+        if (s_head_id == s_tail_id)
+        {
+            *offset = 0;
+            return len <= RECORDER_BUFFER_BYTES;
+        }
+        if (s_head_id - s_tail_id < (uint32_t)RECORDER_MAX_ENTRIES)
+        {
+            uint32_t tail_off = s_entries[s_tail_id % RECORDER_MAX_ENTRIES].offset;
+            if (s_write_off >= tail_off)
+            {
+                if (RECORDER_BUFFER_BYTES - s_write_off >= len)
+                {
+                    *offset = s_write_off;
+                    return true;
+                }
+                if (len < tail_off)
+                {
+                    *offset = 0;
+                    return true;
+                }
+            }
+            else if (tail_off - s_write_off > len)
+            {
+                *offset = s_write_off;
+                return true;
+            }
+        }
+        if (s_state != REC_IDLE && s_tail_id == s_flush_id)
+        {
+            return false;
+        }
+        s_tail_id++;
+    }
+}
+
+// Копия в окно. Копирование - вне мьютекса: место зарезервировано, и элемент виден
+// recorder_flush_task только после увеличения s_head_id.
+static void push_entry(uint8_t type, uint32_t t_ms, const uint8_t *data, uint32_t len)
+{
+    uint32_t offset;
+    xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+    bool ok = reserve(len, &offset);
+    if (!ok)
+    {
+        s_dropped++;
+    }
+    xSemaphoreGive(s_rec_mutex);
+    if (!ok)
+    {
+        return;
+    }
+
+    memcpy(s_buf + offset, data, len);
+
+    xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+    BufferedEntry &e = s_entries[s_head_id % RECORDER_MAX_ENTRIES];
+    e.offset = offset;
+    e.len = len;
+    e.t_ms = t_ms;
+    e.type = type;
+    s_write_off = offset + len;
+    s_head_id++;
+    bool recording = s_state != REC_IDLE;
+    xSemaphoreGive(s_rec_mutex);
+    if (recording && s_flush_task)
+    {
+        xTaskNotifyGive(s_flush_task);
+    }
+}
+
+static void push_samples(SensorSample *batch, int *count)
+{
+    if (*count)
+    {
+        push_entry(CLIP_REC_SAMPLES, batch[0].timestamp_ms, (const uint8_t *)batch, *count * sizeof(SensorSample));
+        *count = 0;
+    }
+}
+
+static RecorderTriggerResult start_clip(uint8_t reason)
+{
+    if (!s_enabled)
+    {
+        return RECORDER_DISABLED;
+    }
+    xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+    RecorderTriggerResult result = RECORDER_BUSY;
+    if (s_state == REC_IDLE)
+    {
+        // Клип начинается с самого старого элемента окна
+        s_state = REC_CAPTURE;
+        s_flush_id = s_tail_id;
+        s_reason = reason;
+        s_trigger_ms = millis();
+        result = RECORDER_TRIGGERED;
+    }
+    xSemaphoreGive(s_rec_mutex);
+    if (result == RECORDER_TRIGGERED)
+    {
+        Serial.printf("[Rec] Triggered (%s)\n", reason == CLIP_TRIGGER_MANUAL ? "manual" : "distance");
+        if (s_flush_task)
+        {
+            xTaskNotifyGive(s_flush_task);
+        }
+    }
+    return result;
+}
+
+RecorderTriggerResult recorder_trigger()
+{
+    return start_clip(CLIP_TRIGGER_MANUAL);
+}
+
+// Конец окна после срабатывания; без записи - вытеснение по возрасту
+static void update_window(uint32_t now)
+{
+    xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+    bool ended = false;
+    if (s_state == REC_CAPTURE && now - s_trigger_ms >= RECORDER_POST_MS)
+    {
+        s_state = REC_DRAIN;
+        s_end_id = s_head_id;
+        ended = true;
+    }
+    else if (s_state == REC_IDLE)
+    {
+        while (s_tail_id != s_head_id && now - s_entries[s_tail_id % RECORDER_MAX_ENTRIES].t_ms > RECORDER_PRE_MS)
+        {
+            s_tail_id++;
+        }
+    }
+    xSemaphoreGive(s_rec_mutex);
+    if (ended && s_flush_task)
+    {
+        xTaskNotifyGive(s_flush_task);
+    }
+}
+
+void recorder_capture_task(void *pvParameters)
+{
+    (void)pvParameters;
+
+    frame_pool_subscribe();
+    sensor_snapshot_subscribe();
+    Serial.println("Recorder task started");
+
+    SensorSample batch[RECORDER_SAMPLE_BATCH];
+    int batch_count = 0;
+    uint32_t last_sample_seq = 0;
+    uint32_t last_frame_seq = 0;
+    uint32_t last_frame_ms = 0;
+    int thresh_red = 50;
+    bool armed = true; // Срабатывание по расстоянию - один раз на заход в красную зону
+
+    for (;;)
+    {
+        // Просыпаемся на каждый кадр и каждое измерение
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RECORDER_IDLE_POLL_MS));
+        uint32_t now = millis();
+
+        if (xSemaphoreTake(xStateMutex, 0) == pdTRUE)
+        {
+            thresh_red = g_app_state.settings.thresh_red;
+            xSemaphoreGive(xStateMutex);
+        }
+        EventBits_t bits = xEventGroupGetBits(xAppEventGroup);
+
+        SensorSample sample;
+        if (sensor_snapshot_read(&sample) && sample.seq != last_sample_seq)
+        {
+            last_sample_seq = sample.seq;
+            batch[batch_count++] = sample;
+            float min_dist = sample.distances[0];
+            for (int i = 1; i < NUM_SENSORS; i++)
+            {
+                min_dist = min(min_dist, sample.distances[i]);
+            }
+            if (!(bits & PARKTRONIC_ACTIVE_BIT) || min_dist >= thresh_red)
+            {
+                armed = true;
+            }
+            else if (armed)
+            {
+                armed = false;
+                start_clip(CLIP_TRIGGER_DISTANCE);
+            }
+        }
+
+        if ((bits & CAM_INITIALIZED_BIT) && frame_pool_last_seq() != last_frame_seq &&
+            now - last_frame_ms >= 1000 / RECORDER_FPS)
+        {
+            frame_t *frame = frame_pool_acquire_latest();
+            if (frame)
+            {
+                last_frame_seq = frame->seq;
+                last_frame_ms = now;
+                push_samples(batch, &batch_count);
+                if (frame->fb->len <= MAX_FRAME_SIZE_BYTES)
+                {
+                    push_entry(CLIP_REC_FRAME, now, frame->fb->buf, frame->fb->len);
+                }
+                frame_release(frame);
+            }
+        }
+        if (batch_count == RECORDER_SAMPLE_BATCH)
+        {
+            push_samples(batch, &batch_count);
+        }
+
+        update_window(now);
+    }
+}
+
+void recorder_flush_task(void *pvParameters)
+{
+    (void)pvParameters;
+
+    s_flush_task = xTaskGetCurrentTaskHandle();
+    bool clip_open = false;
+    bool clip_full = false;
+    uint32_t start_ms = 0;
+    uint32_t end_ms = 0;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RECORDER_IDLE_POLL_MS * 2));
+
+        xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+        RecorderState state = s_state;
+        uint8_t reason = s_reason;
+        uint32_t trigger_ms = s_trigger_ms;
+        xSemaphoreGive(s_rec_mutex);
+        if (state == REC_IDLE)
+        {
+            continue;
+        }
+        if (!clip_open)
+        {
+            uint32_t clip_id;
+            clip_open = clip_store_begin(reason, trigger_ms, &clip_id);
+            clip_full = !clip_open;
+            start_ms = end_ms = trigger_ms;
+        }
+
+        // Элементы пишутся по одному; мьютекс не держится во время записи во flash
+        bool done = false;
+        for (;;)
+        {
+            xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+            uint32_t limit = s_state == REC_DRAIN ? s_end_id : s_head_id;
+            if (s_flush_id == limit)
+            {
+                done = s_state == REC_DRAIN;
+                xSemaphoreGive(s_rec_mutex);
+                break;
+            }
+            BufferedEntry e = s_entries[s_flush_id % RECORDER_MAX_ENTRIES];
+            xSemaphoreGive(s_rec_mutex);
+
+            if (!clip_full)
+            {
+                clip_full = !clip_store_append(e.type, e.t_ms, s_buf + e.offset, e.len);
+                if (!clip_full)
+                {
+                    start_ms = min(start_ms, e.t_ms);
+                    end_ms = max(end_ms, e.t_ms);
+                }
+            }
+
+            xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+            s_flush_id++;
+            xSemaphoreGive(s_rec_mutex);
+        }
+
+        if (done)
+        {
+            if (clip_open)
+            {
+                clip_store_finish(start_ms, end_ms);
+            }
+            clip_open = false;
+            xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+            s_state = REC_IDLE;
+            xSemaphoreGive(s_rec_mutex);
+        }
+    }
+}
+
+void recorder_write_json(Print &out)
+{
+    if (!s_enabled)
+    {
+        out.print("{\"enabled\":false,\"clips\":[]}");
+        return;
+    }
+
+    xSemaphoreTake(s_rec_mutex, portMAX_DELAY);
+    RecorderState state = s_state;
+    uint32_t entries = s_head_id - s_tail_id;
+    uint32_t bytes = 0;
+    for (uint32_t id = s_tail_id; id != s_head_id; ++id)
+    {
+        bytes += s_entries[id % RECORDER_MAX_ENTRIES].len;
+    }
+    uint32_t dropped = s_dropped;
+    xSemaphoreGive(s_rec_mutex);
+
+    out.printf("{\"enabled\":true,\"state\":\"%s\",\"capacity\":%u,"
+               "\"buffer\":{\"entries\":%u,\"bytes\":%u,\"dropped\":%u},\"clips\":[",
+               state_name(state), (unsigned)clip_store_capacity(), (unsigned)entries, (unsigned)bytes,
+               (unsigned)dropped);
+
+    // Копия списка в куче: обработчик работает на стеке задачи async_tcp
+    ClipInfo *clips = (ClipInfo *)malloc(sizeof(ClipInfo) * CLIP_STORE_MAX_CLIPS);
+    int total = clips ? clip_store_list(clips, CLIP_STORE_MAX_CLIPS) : 0;
+    for (int i = 0; i < total; ++i)
+    {
+        const ClipInfo &c = clips[i];
+        out.printf("%s{\"id\":%u,\"reason\":\"%s\",\"trigger_ms\":%u,\"start_ms\":%u,\"end_ms\":%u,"
+                   "\"frames\":%u,\"samples\":%u,\"bytes\":%u}",
+                   i ? "," : "", (unsigned)c.id, c.reason == CLIP_TRIGGER_MANUAL ? "manual" : "distance",
+                   (unsigned)c.trigger_ms, (unsigned)c.start_ms, (unsigned)c.end_ms, (unsigned)c.frames,
+                   (unsigned)c.samples, (unsigned)c.bytes);
+    }
+    free(clips);
+    out.print("]}");
+}
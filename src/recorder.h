@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+
+class Print;
+
+// Регистратор событий. recorder_capture_task держит в PSRAM скользящее окно последних кадров
+// (RECORDER_FPS) и измерений датчиков за RECORDER_PRE_MS. По срабатыванию (расстояние меньше
+// thresh_red при активном парктронике или POST /api/recorder/trigger) окно и следующие
+// RECORDER_POST_MS уходят в кольцо на flash (clip_store). Во flash пишет отдельная задача
+// низкого приоритета на ядре 0: захват только копирует кадр из пула, stream_task не ждёт flash.
+
+const uint32_t RECORDER_PRE_MS = 5000;
+const uint32_t RECORDER_POST_MS = 5000;
+const uint32_t RECORDER_FPS = 5;
+
+enum RecorderTriggerResult
+{
+    RECORDER_TRIGGERED,
+    RECORDER_BUSY,     // Клип уже записывается
+    RECORDER_DISABLED, // Нет раздела "rec" или PSRAM
+};
+
+// Раздел, список клипов, буфер в PSRAM. Из boot_services_task до запуска задач;
+// false - регистратор выключен, задачи не запускаются.
+bool recorder_init();
+
+void recorder_capture_task(void *pvParameters);
+void recorder_flush_task(void *pvParameters);
+
+// Ручное срабатывание (HTTP).
+RecorderTriggerResult recorder_trigger();
+
+// {"enabled","state","capacity","buffer":{"entries","bytes","dropped"},
+//  "clips":[{"id","reason","trigger_ms","start_ms","end_ms","frames","samples","bytes"}]}
+void recorder_write_json(Print &out);
@@ -0,0 +1,126 @@
+#include "sensor_snapshot.h"
+#include <Arduino.h>
+#include <atomic>
+
+// Нечётное значение - идёт запись. Номер измерения = s_seq / 2.
+static std::atomic<uint32_t> s_seq(0);
+// Последние измерения по кругу: измерение n лежит в s_history[n % SENSOR_HISTORY]
+static SensorSample s_history[SENSOR_HISTORY];
+
+// Подписчики без мьютекса: писатель не должен ждать
+const int MAX_SNAPSHOT_SUBSCRIBERS = 3;
+static std::atomic<TaskHandle_t> s_subscribers[MAX_SNAPSHOT_SUBSCRIBERS];
+
+void sensor_snapshot_publish(const float *distances)
+{
+    uint32_t seq = s_seq.load(std::memory_order_relaxed);
+    s_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint32_t n = seq / 2 + 1;
+    SensorSample &slot = s_history[n % SENSOR_HISTORY];
+    for (int i = 0; i < NUM_SENSORS; ++i)
+    {
+        slot.distances[i] = distances[i];
+    }
+    slot.seq = n;
+    slot.timestamp_ms = millis();
+
+    s_seq.store(seq + 2, std::memory_order_release);
+
+    for (int i = 0; i < MAX_SNAPSHOT_SUBSCRIBERS; ++i)
+    {
+        TaskHandle_t task = s_subscribers[i].load(std::memory_order_acquire);
+        if (task)
+        {
+            xTaskNotifyGive(task);
+        }
+    }
+}
+
+void sensor_snapshot_subscribe()
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < MAX_SNAPSHOT_SUBSCRIBERS; ++i)
+    {
+        TaskHandle_t expected = NULL;
+        if (s_subscribers[i].load() == self || s_subscribers[i].compare_exchange_strong(expected, self))
+        {
+            return;
+        }
+    }
+}
+
+static void fill_no_sample(SensorSample *out)
+{
+    for (int i = 0; i < NUM_SENSORS; ++i)
+    {
+        out->distances[i] = 999.0;
+    }
+    out->seq = 0;
+    out->timestamp_ms = 0;
+}
+
+bool sensor_snapshot_read(SensorSample *out)
+{
+    uint32_t before, after;
+    do
+    {
+        before = s_seq.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+        *out = s_history[(before / 2) % SENSOR_HISTORY];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = s_seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    if (before == 0)
+    {
+        fill_no_sample(out);
+        return false;
+    }
+    return true;
+}
+
+bool sensor_snapshot_read_at(uint32_t time_ms, SensorSample *out)
+{
+    SensorSample history[SENSOR_HISTORY];
+    uint32_t before, after;
+    do
+    {
+        before = s_seq.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+        for (int i = 0; i < SENSOR_HISTORY; ++i)
+        {
+            history[i] = s_history[i];
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = s_seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    uint32_t last = before / 2;
+    if (last == 0)
+    {
+        fill_no_sample(out);
+        return false;
+    }
+    // От нового к старому: первое измерение не позже time_ms
+    uint32_t oldest = last > SENSOR_HISTORY ? last - SENSOR_HISTORY + 1 : 1;
+    for (uint32_t n = last; n >= oldest; --n)
+    {
+        const SensorSample &sample = history[n % SENSOR_HISTORY];
+        if ((int32_t)(time_ms - sample.timestamp_ms) >= 0)
+        {
+            *out = sample;
+            return true;
+        }
+    }
+    // Все сохранённые измерения новее: момент раньше истории (или до первого измерения)
+    *out = history[oldest % SENSOR_HISTORY];
+    return false;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+// Последнее измерение датчиков. Публикуется одним писателем (sensors_task) через seqlock:
+// писатель никогда не ждёт читателей, читатель повторяет копирование, если попал на запись.
+struct SensorSample {
+    float distances[NUM_SENSORS];
+    uint32_t seq;          // Номер измерения, 0 - измерений ещё не было
+    uint32_t timestamp_ms; // millis() момента публикации
+};
+
+// Сколько последних измерений хранится для sensor_snapshot_read_at (~100-160 мс).
+const int SENSOR_HISTORY = 4;
+
+// Только из sensors_task.
+void sensor_snapshot_publish(const float *distances);
+
+// Текущая задача получает xTaskNotifyGive() при каждой публикации.
+void sensor_snapshot_subscribe();
+
+// Копия последнего измерения. false - измерений ещё не было (out заполняется "нет препятствий").
+bool sensor_snapshot_read(SensorSample *out);
+
+// Измерение, действовавшее в момент time_ms (millis()): последнее опубликованное не позже него.
+// false - такого нет в истории; out - самое старое из сохранённых (или "нет препятствий").
+bool sensor_snapshot_read_at(uint32_t time_ms, SensorSample *out);
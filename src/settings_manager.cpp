@@ -1,141 +1,318 @@
 #include "settings_manager.h"
 #include <LittleFS.h>
-#include <ArduinoJson.h>
 #include "state.h"
 #include "config.h"
-#include "esp_camera.h"
+#include "settings_schema.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
 
 void load_default_settings()
 {
-    g_app_state.settings.thresh_yellow = 200;
-    g_app_state.settings.thresh_orange = 100;
-    g_app_state.settings.thresh_red = 50;
-    g_app_state.settings.bpm_min = 0;
-    g_app_state.settings.bpm_max = 300;
-    g_app_state.settings.auto_start = true;
-    g_app_state.settings.show_grid = true;
-    g_app_state.settings.cam_angle = 45;
-    g_app_state.settings.grid_opacity = 80;
-    g_app_state.settings.grid_offset_x = 0;
-    g_app_state.settings.grid_offset_y = 0;
-    g_app_state.settings.grid_offset_z = 0;
-    strlcpy(g_app_state.settings.resolution, "XGA", sizeof(g_app_state.settings.resolution));
-    g_app_state.settings.jpeg_quality = 20;
-    g_app_state.settings.flip_h = true;
-    g_app_state.settings.flip_v = false;
-    g_app_state.settings.volume = 100;
-    g_app_state.settings.beep_freq = 1760; 
-    g_app_state.settings.rotation = 90;
-    g_app_state.settings.xclk_freq = 22;
-    strncpy(g_app_state.settings.wifi_ssid, WIFI_AP_SSID, sizeof(g_app_state.settings.wifi_ssid));
-    strncpy(g_app_state.settings.wifi_pass, WIFI_AP_PASS, sizeof(g_app_state.settings.wifi_pass));
+    settings_load_defaults(&g_app_state.settings);
+}
+
+// Настройки хранятся бинарной записью в двух слотах A/B. Запись идёт в слот со старшим
+// поколением не-актуальной копии, поэтому обрыв питания во время записи портит только её.
+const uint32_t SETTINGS_MAGIC = 0x53505041; // "APPS"
+const uint16_t SETTINGS_VERSION = 1;        // Увеличивать при любом изменении AppSettings
+const char *const SETTINGS_SLOTS[2] = {"/settings_a.bin", "/settings_b.bin"};
+const char *const SETTINGS_JSON_PATH = "/settings.json";
+
+// Серия изменений (ползунки UI) записывается одним разом после паузы,
+// но не позже максимальной задержки от первого изменения.
+const uint32_t SETTINGS_QUIET_MS = 1000;
+const uint32_t SETTINGS_MAX_DELAY_MS = 5000;
+
+struct SettingsRecord
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; // sizeof(AppSettings)
+    uint32_t generation;
+    AppSettings settings;
+    uint32_t crc; // CRC32 всех предыдущих полей
+};
+
+// Копия последней записи для быстрой загрузки без LittleFS: в RTC-памяти (переживает
+// перезагрузку и просадку питания при пуске двигателя) и в NVS (переживает отключение питания).
+const char *const SETTINGS_NVS_NAMESPACE = "parktronic";
+const char *const SETTINGS_NVS_KEY = "settings";
+
+static uint32_t s_generation = 0;
+static int s_next_slot = 0;
+static TaskHandle_t s_flush_task = NULL;
+RTC_NOINIT_ATTR static SettingsRecord s_rtc_cache;
+static uint32_t s_nvs_cache_crc = 0; // CRC записи в NVS, 0 - нет или не читалась
+
+static uint32_t record_crc(const SettingsRecord &rec)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&rec, offsetof(SettingsRecord, crc));
+}
+
+static bool record_valid(const SettingsRecord &rec)
+{
+    return rec.magic == SETTINGS_MAGIC && rec.version == SETTINGS_VERSION && rec.size == sizeof(AppSettings) &&
+           rec.crc == record_crc(rec);
+}
+
+static bool read_slot(int slot, SettingsRecord *rec)
+{
+    File file = LittleFS.open(SETTINGS_SLOTS[slot], "r");
+    if (!file)
+    {
+        return false;
+    }
+    size_t n = file.read((uint8_t *)rec, sizeof(*rec));
+    file.close();
+    return n == sizeof(*rec) && record_valid(*rec);
+}
+
+static bool read_nvs_cache(SettingsRecord *rec)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return false;
+    }
+    size_t len = sizeof(*rec);
+    esp_err_t err = nvs_get_blob(nvs, SETTINGS_NVS_KEY, rec, &len);
+    nvs_close(nvs);
+    return err == ESP_OK && len == sizeof(*rec) && record_valid(*rec);
+}
+
+// NVS перезаписывается, только если там другая запись
+static void update_cache(const SettingsRecord &rec)
+{
+    s_rtc_cache = rec;
+    if (rec.crc == s_nvs_cache_crc)
+    {
+        return;
+    }
+    nvs_handle_t nvs;
+    if (nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        Serial.println("[Settings] Failed to open NVS for the settings cache");
+        return;
+    }
+    if (nvs_set_blob(nvs, SETTINGS_NVS_KEY, &rec, sizeof(rec)) == ESP_OK && nvs_commit(nvs) == ESP_OK)
+    {
+        s_nvs_cache_crc = rec.crc;
+    }
+    else
+    {
+        Serial.println("[Settings] Failed to write the settings cache to NVS");
+    }
+    nvs_close(nvs);
+}
+
+// Загрузка из старого settings.json (первая загрузка после обновления прошивки).
+// Отсутствующие поля - по умолчанию, значения проверяются как в POST /api/settings.
+// Старые версии не проверяли большинство полей: неверное значение приводится к диапазону
+// или заменяется значением по умолчанию, остальные поля (в том числе Wi-Fi) сохраняются.
+static bool migrate_json_settings(AppSettings *out)
+{
+    File file = LittleFS.open(SETTINGS_JSON_PATH, "r");
+    if (!file)
+    {
+        return false;
+    }
+    SettingsParser parser;
+    settings_parser_begin_lenient(&parser);
+    char chunk[64];
+    bool ok = true;
+    while (ok && file.available())
+    {
+        size_t n = file.read((uint8_t *)chunk, sizeof(chunk));
+        if (n == 0)
+        {
+            break;
+        }
+        ok = settings_parser_feed(&parser, chunk, n);
+    }
+    file.close();
+
+    if (!ok || !settings_parser_finish(&parser))
+    {
+        Serial.printf("Failed to parse settings.json (%s), loading defaults.\n", parser.error);
+        return false;
+    }
+    AppSettings settings;
+    settings_load_defaults(&settings);
+    settings_merge(&parser, &settings);
+    uint32_t adjusted = parser.adjusted | settings_repair(&settings);
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; ++i)
+    {
+        if (adjusted & (1UL << i))
+        {
+            Serial.printf("settings.json: invalid %s adjusted.\n", SETTINGS_SCHEMA[i].name);
+        }
+    }
+    *out = settings;
+    return true;
+}
+
+// Задачи могут уже работать с настройками из кэша
+static void set_current_settings(const AppSettings &settings)
+{
+    xSemaphoreTake(xStateMutex, portMAX_DELAY);
+    g_app_state.settings = settings;
+    xSemaphoreGive(xStateMutex);
+}
+
+bool settings_load_cached()
+{
+    SettingsRecord rec;
+    const char *source = NULL;
+    if (record_valid(s_rtc_cache))
+    {
+        rec = s_rtc_cache;
+        source = "RTC memory";
+    }
+    if (read_nvs_cache(&rec))
+    {
+        s_nvs_cache_crc = rec.crc;
+        // RTC-копия не старше NVS, если пережила перезагрузку
+        if (source && (int32_t)(s_rtc_cache.generation - rec.generation) >= 0)
+        {
+            rec = s_rtc_cache;
+        }
+        else
+        {
+            source = "NVS";
+        }
+    }
+    if (!source)
+    {
+        load_default_settings();
+        Serial.println("No cached settings, starting with defaults.");
+        return false;
+    }
+    g_app_state.settings = rec.settings;
+    Serial.printf("Settings loaded from %s cache (generation %u).\n", source, rec.generation);
+    return true;
 }
 
 void settings_init()
 {
-    if (LittleFS.exists("/settings.json"))
+    SettingsRecord rec[2];
+    bool valid[2] = {read_slot(0, &rec[0]), read_slot(1, &rec[1])};
+
+    if (valid[0] || valid[1])
+    {
+        int newest = (valid[0] && (!valid[1] || (int32_t)(rec[0].generation - rec[1].generation) > 0)) ? 0 : 1;
+        set_current_settings(rec[newest].settings);
+        s_generation = rec[newest].generation;
+        s_next_slot = 1 - newest;
+        update_cache(rec[newest]);
+        Serial.printf("Settings loaded from slot %c (generation %u).\n", 'A' + newest, s_generation);
+        return;
+    }
+
+    AppSettings settings;
+    if (LittleFS.exists(SETTINGS_JSON_PATH))
     {
-        File file = LittleFS.open("/settings.json", "r");
-        if (file)
+        if (migrate_json_settings(&settings))
         {
-            DynamicJsonDocument doc(2048);
-            DeserializationError error = deserializeJson(doc, file);
-            if (!error)
+            set_current_settings(settings);
+            Serial.println("Settings migrated from settings.json.");
+            if (settings_flush())
             {
-                g_app_state.settings.thresh_yellow = doc["thresh_yellow"] | 200;
-                g_app_state.settings.thresh_orange = doc["thresh_orange"] | 100;
-                g_app_state.settings.thresh_red = doc["thresh_red"] | 50;
-                g_app_state.settings.bpm_min = doc["bpm_min"] | 0;
-                g_app_state.settings.bpm_max = doc["bpm_max"] | 300;
-                g_app_state.settings.auto_start = doc["auto_start"] | true;
-                g_app_state.settings.show_grid = doc["show_grid"] | true;
-                g_app_state.settings.cam_angle = doc["cam_angle"] | 45;
-                g_app_state.settings.grid_opacity = doc["grid_opacity"] | 80;
-                g_app_state.settings.grid_offset_x = doc["grid_offset_x"] | 0;
-                g_app_state.settings.grid_offset_y = doc["grid_offset_y"] | 0;
-                g_app_state.settings.grid_offset_z = doc["grid_offset_z"] | 0;
-                strlcpy(g_app_state.settings.resolution, doc["resolution"] | "XGA", sizeof(g_app_state.settings.resolution));
-                g_app_state.settings.jpeg_quality = doc["jpeg_quality"] | 20;
-                g_app_state.settings.flip_h = doc["flip_h"] | true;
-                g_app_state.settings.flip_v = doc["flip_v"] | false;
-                g_app_state.settings.volume = doc["volume"] | 100;
-                g_app_state.settings.beep_freq = doc["beep_freq"] | 1760; 
-                g_app_state.settings.rotation = doc["rotation"] | 90;
-                g_app_state.settings.xclk_freq = doc["xclk_freq"] | 22;
-                strlcpy(g_app_state.settings.wifi_ssid, doc["wifi_ssid"] | WIFI_AP_SSID, sizeof(g_app_state.settings.wifi_ssid));
-                strlcpy(g_app_state.settings.wifi_pass, doc["wifi_pass"] | WIFI_AP_PASS, sizeof(g_app_state.settings.wifi_pass));
-                Serial.println("Settings loaded from file.");
+                LittleFS.remove(SETTINGS_JSON_PATH);
             }
-            else
-            {
-                Serial.println("Failed to parse settings.json, loading defaults.");
-                load_default_settings();
-            }
-            file.close();
+            return;
         }
     }
     else
     {
-        Serial.println("settings.json not found, loading defaults and creating file.");
-        load_default_settings();
-        settings_save(); // Сохраняем дефолтные настройки, чтобы файл создался
+        Serial.println("No saved settings, loading defaults.");
     }
+    settings_load_defaults(&settings);
+    set_current_settings(settings);
+    settings_flush();
 }
 
-bool settings_save()
+bool settings_flush()
 {
-    DynamicJsonDocument doc(2048);
+    SettingsRecord rec;
+    memset(&rec, 0, sizeof(rec));
 
     if (xSemaphoreTake(xStateMutex, pdMS_TO_TICKS(1000)) != pdTRUE)
     {
         Serial.println("Failed to take mutex for saving settings");
         return false;
     }
-
-    doc["thresh_yellow"] = g_app_state.settings.thresh_yellow;
-    doc["thresh_orange"] = g_app_state.settings.thresh_orange;
-    doc["thresh_red"] = g_app_state.settings.thresh_red;
-    doc["bpm_min"] = g_app_state.settings.bpm_min;
-    doc["bpm_max"] = g_app_state.settings.bpm_max;
-    doc["auto_start"] = g_app_state.settings.auto_start;
-    doc["show_grid"] = g_app_state.settings.show_grid;
-    doc["cam_angle"] = g_app_state.settings.cam_angle;
-    doc["grid_opacity"] = g_app_state.settings.grid_opacity;
-    doc["grid_offset_x"] = g_app_state.settings.grid_offset_x;
-    doc["grid_offset_y"] = g_app_state.settings.grid_offset_y;
-    doc["grid_offset_z"] = g_app_state.settings.grid_offset_z;
-    doc["resolution"] = g_app_state.settings.resolution;
-    doc["jpeg_quality"] = g_app_state.settings.jpeg_quality;
-    doc["flip_h"] = g_app_state.settings.flip_h;
-    doc["flip_v"] = g_app_state.settings.flip_v;
-    doc["volume"] = g_app_state.settings.volume;
-    doc["beep_freq"] = g_app_state.settings.beep_freq;
-    doc["rotation"] = g_app_state.settings.rotation;
-    doc["xclk_freq"] = g_app_state.settings.xclk_freq;
-    doc["wifi_ssid"] = g_app_state.settings.wifi_ssid;
-    doc["wifi_pass"] = g_app_state.settings.wifi_pass;
-
+    rec.settings = g_app_state.settings;
     xSemaphoreGive(xStateMutex);
 
-    File file = LittleFS.open("/settings.json", "w");
+    rec.magic = SETTINGS_MAGIC;
+    rec.version = SETTINGS_VERSION;
+    rec.size = sizeof(AppSettings);
+    rec.generation = s_generation + 1;
+    rec.crc = record_crc(rec);
+
+    const char *path = SETTINGS_SLOTS[s_next_slot];
+    File file = LittleFS.open(path, "w");
     if (!file)
     {
-        Serial.println("Failed to open settings.json for writing");
+        Serial.printf("Failed to open %s for writing\n", path);
         return false;
     }
-
-    if (serializeJson(doc, file) == 0)
+    size_t written = file.write((const uint8_t *)&rec, sizeof(rec));
+    file.close();
+    if (written != sizeof(rec))
     {
-        Serial.println("Failed to write to settings.json");
-        file.close();
+        Serial.printf("Failed to write %s\n", path);
         return false;
     }
 
-    file.close();
-    Serial.println("Settings saved successfully.");
+    s_generation = rec.generation;
+    s_next_slot = 1 - s_next_slot;
+    update_cache(rec);
+    Serial.printf("Settings saved to %s (generation %u).\n", path, s_generation);
+    return true;
+}
+
+bool settings_save()
+{
+    // До запуска задачи записи (загрузка) - сразу
+    if (!s_flush_task)
+    {
+        return settings_flush();
+    }
+    xTaskNotifyGive(s_flush_task);
     return true;
 }
 
+void settings_flush_task(void *pvParameters)
+{
+    (void)pvParameters;
+    s_flush_task = xTaskGetCurrentTaskHandle();
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        unsigned long first_ms = millis();
+        uint32_t changes = 1;
+        while (millis() - first_ms < SETTINGS_MAX_DELAY_MS &&
+               ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SETTINGS_QUIET_MS)) > 0)
+        {
+            changes++;
+        }
+
+        if (changes > 1)
+        {
+            Serial.printf("[Settings] %u changes coalesced into one write\n", changes);
+        }
+        if (!settings_flush())
+        {
+            // Повтор после паузы
+            vTaskDelay(pdMS_TO_TICKS(SETTINGS_QUIET_MS));
+            xTaskNotifyGive(s_flush_task);
+        }
+    }
+}
+
 void settings_reset_to_default()
 {
     Serial.println("Resetting settings to default values.");
@@ -149,7 +326,7 @@ void settings_reset_to_default()
 
         xSemaphoreGive(xStateMutex);
 
-        // Сохраняем новые (дефолтные) настройки в файл settings.json
+        // Сохраняем новые (дефолтные) настройки
         settings_save();
     }
     else
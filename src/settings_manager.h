@@ -1,10 +1,23 @@
 #pragma once
 
-// Инициализация настроек: загрузка из файла или установка значений по умолчанию.
+// Быстрая загрузка до монтирования LittleFS: копия последней записи из RTC-памяти или NVS,
+// иначе значения по умолчанию. false - кэша нет. Вызывается до запуска задач.
+bool settings_load_cached();
+
+// Инициализация настроек: загрузка из бинарной записи (слоты A/B), миграция из settings.json
+// или установка значений по умолчанию. Основной источник: заменяет настройки из кэша
+// (под xStateMutex) и обновляет кэш, если он устарел.
 void settings_init();
 
-// Сохранение текущих настроек из g_app_state в файл.
+// Запрос сохранения текущих настроек из g_app_state. Запись выполняет settings_flush_task
+// после паузы в изменениях; до запуска задачи - сразу.
 bool settings_save();
 
+// Немедленная запись настроек в следующий слот.
+bool settings_flush();
+
+// Задача отложенной записи: серия изменений сохраняется одной записью.
+void settings_flush_task(void *pvParameters);
+
 // Сброс настроек к значениям по умолчанию и их сохранение.
-void settings_reset_to_default(); 
\ No newline at end of file
+void settings_reset_to_default();
@@ -0,0 +1,794 @@
+#include "settings_schema.h"
+#include <Arduino.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "distance_filter.h"
+#include "tasks/camera_task.h"
+
+// Тип поля выводится из типа члена AppSettings, перепутать его в таблице нельзя
+template <typename T> struct SettingTypeOf;
+template <> struct SettingTypeOf<int> { static constexpr SettingType value = SETTING_INT; };
+template <> struct SettingTypeOf<bool> { static constexpr SettingType value = SETTING_BOOL; };
+template <> struct SettingTypeOf<float> { static constexpr SettingType value = SETTING_FLOAT; };
+template <size_t N> struct SettingTypeOf<char[N]> { static constexpr SettingType value = SETTING_STRING; };
+
+#define SETTING(name, def, lo, hi, flags) \
+    {#name, SettingTypeOf<decltype(AppSettings::name)>::value, flags, (uint16_t)offsetof(AppSettings, name), \
+     (uint16_t)sizeof(AppSettings::name), (float)(lo), (float)(hi), (float)(def), NULL}
+#define SETTING_STR(name, def, min_len, flags) \
+    {#name, SettingTypeOf<decltype(AppSettings::name)>::value, flags, (uint16_t)offsetof(AppSettings, name), \
+     (uint16_t)sizeof(AppSettings::name), (float)(min_len), (float)(sizeof(AppSettings::name) - 1), 0, def}
+
+// Порядок - как в AppSettings (проверяется ниже).
+constexpr SettingField SETTINGS_SCHEMA[] = {
+    // Parktronic
+    SETTING(thresh_yellow, 200, 0, 400, 0),
+    SETTING(thresh_orange, 100, 0, 400, 0),
+    SETTING(thresh_red, 50, 0, 400, 0),
+    SETTING(bpm_min, 0, 0, 600, 0),
+    SETTING(bpm_max, 300, 0, 600, 0),
+    SETTING(auto_start, true, 0, 1, 0),
+    SETTING(ws_deadband_cm, 1.0f, 0, 50, 0),
+    SETTING(filter_type, FILTER_MEDIAN_AB, FILTER_RAW, FILTER_MEDIAN_AB, 0),
+    SETTING(filter_median, FILTER_DEFAULT_MEDIAN, 1, FILTER_MEDIAN_MAX, 0),
+    SETTING(filter_alpha, FILTER_DEFAULT_ALPHA, 0, 1, 0),
+    SETTING(filter_beta, FILTER_DEFAULT_BETA, 0, 1, 0),
+    // Camera
+    SETTING(show_grid, true, 0, 1, 0),
+    SETTING(cam_angle, 45, 0, 90, 0),
+    SETTING(grid_opacity, 80, 0, 100, 0),
+    SETTING(grid_offset_x, 0, -1000, 1000, 0),
+    SETTING(grid_offset_y, 0, -1000, 1000, 0),
+    SETTING(grid_offset_z, 0, -1000, 1000, 0),
+    SETTING_STR(resolution, "XGA", 1, SETTING_APPLY_CAMERA),
+    SETTING(jpeg_quality, 20, 0, 63, SETTING_APPLY_CAMERA),
+    SETTING(flip_h, true, 0, 1, SETTING_APPLY_CAMERA),
+    SETTING(flip_v, false, 0, 1, SETTING_APPLY_CAMERA),
+    SETTING(rotation, 90, 0, 359, 0),
+    SETTING(xclk_freq, 22, 10, 24, SETTING_APPLY_CAMERA),
+    // System
+    SETTING(volume, 100, 0, 100, 0),
+    SETTING(beep_freq, 1760, 100, 10000, 0),
+    // WiFi
+    SETTING_STR(wifi_ssid, WIFI_AP_SSID, 1, 0),
+    SETTING_STR(wifi_pass, WIFI_AP_PASS, 8, SETTING_EMPTY_OK),
+};
+
+const size_t SETTINGS_FIELD_COUNT = sizeof(SETTINGS_SCHEMA) / sizeof(SETTINGS_SCHEMA[0]);
+
+// Поля идут подряд и покрывают всю структуру: пропущенное в таблице поле оставит дыру
+// больше выравнивания. Не ловит только пропущенный bool между bool-полями.
+constexpr size_t field_end(size_t i)
+{
+    return (size_t)SETTINGS_SCHEMA[i].offset + SETTINGS_SCHEMA[i].size;
+}
+constexpr bool schema_covers(size_t i)
+{
+    return i + 1 == sizeof(SETTINGS_SCHEMA) / sizeof(SETTINGS_SCHEMA[0])
+               ? sizeof(AppSettings) - field_end(i) < alignof(AppSettings)
+               : SETTINGS_SCHEMA[i + 1].offset >= field_end(i) &&
+                     SETTINGS_SCHEMA[i + 1].offset - field_end(i) < alignof(AppSettings) && schema_covers(i + 1);
+}
+static_assert(SETTINGS_SCHEMA[0].offset == 0 && schema_covers(0), "SETTINGS_SCHEMA does not match AppSettings");
+static_assert(sizeof(SETTINGS_SCHEMA) / sizeof(SETTINGS_SCHEMA[0]) <= 32, "SettingsParser::present holds 32 fields");
+
+static void *field_ptr(AppSettings *s, const SettingField &f)
+{
+    return (uint8_t *)s + f.offset;
+}
+
+static const void *field_ptr(const AppSettings *s, const SettingField &f)
+{
+    return (const uint8_t *)s + f.offset;
+}
+
+void settings_load_defaults(AppSettings *s)
+{
+    memset(s, 0, sizeof(*s));
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; ++i)
+    {
+        const SettingField &f = SETTINGS_SCHEMA[i];
+        void *v = field_ptr(s, f);
+        switch (f.type)
+        {
+        case SETTING_INT:
+            *(int *)v = (int)f.def;
+            break;
+        case SETTING_BOOL:
+            *(bool *)v = f.def != 0;
+            break;
+        case SETTING_FLOAT:
+            *(float *)v = f.def;
+            break;
+        case SETTING_STRING:
+            strlcpy((char *)v, f.def_str, f.size);
+            break;
+        }
+    }
+}
+
+// --- Сериализация ---
+
+static void write_json_string(Print &out, const char *str)
+{
+    out.write('"');
+    for (const char *c = str; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out.write('\\');
+            out.write(*c);
+        }
+        else if ((uint8_t)*c < 0x20)
+        {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", (uint8_t)*c);
+            out.write(esc);
+        }
+        else
+        {
+            out.write(*c);
+        }
+    }
+    out.write('"');
+}
+
+void settings_write_json_fields(Print &out, const AppSettings &s)
+{
+    char num[24];
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; ++i)
+    {
+        const SettingField &f = SETTINGS_SCHEMA[i];
+        const void *v = field_ptr(&s, f);
+        if (i > 0)
+        {
+            out.write(',');
+        }
+        out.write('"');
+        out.write(f.name);
+        out.write("\":");
+        switch (f.type)
+        {
+        case SETTING_INT:
+            snprintf(num, sizeof(num), "%d", *(const int *)v);
+            out.write(num);
+            break;
+        case SETTING_BOOL:
+            out.write(*(const bool *)v ? "true" : "false");
+            break;
+        case SETTING_FLOAT:
+            snprintf(num, sizeof(num), "%g", *(const float *)v);
+            out.write(num);
+            break;
+        case SETTING_STRING:
+            write_json_string(out, (const char *)v);
+            break;
+        }
+    }
+}
+
+// --- Разбор ---
+
+enum ParserState : uint8_t
+{
+    PS_START,      // До '{'
+    PS_KEY_OR_END, // После '{'
+    PS_KEY_START,  // После ','
+    PS_KEY,
+    PS_COLON,
+    PS_VALUE,
+    PS_STRING,
+    PS_LITERAL,    // Число, true, false, null
+    PS_SKIP,       // Вложенный объект/массив неизвестного ключа
+    PS_NEXT,       // ',' или '}'
+    PS_DONE,
+    PS_ERROR,
+};
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool fail(SettingsParser *p, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static bool fail(SettingsParser *p, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(p->error, sizeof(p->error), fmt, args);
+    va_end(args);
+    p->state = PS_ERROR;
+    return false;
+}
+
+static bool fail_range(SettingsParser *p, const SettingField &f)
+{
+    return fail(p, "Invalid %s: must be between %g and %g.", f.name, f.min, f.max);
+}
+
+// Неверное значение известного поля. При миграции поле пропускается, разбор продолжается.
+static bool fail_field(SettingsParser *p, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static bool fail_field(SettingsParser *p, const char *fmt, ...)
+{
+    if (p->lenient)
+    {
+        p->adjusted |= 1UL << p->field;
+        return true;
+    }
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(p->error, sizeof(p->error), fmt, args);
+    va_end(args);
+    p->state = PS_ERROR;
+    return false;
+}
+
+// Число вне диапазона: ошибка, при миграции - граница диапазона
+static bool clamp_range(SettingsParser *p, const SettingField &f, double *num)
+{
+    if (*num >= f.min && *num <= f.max)
+    {
+        return true;
+    }
+    if (!p->lenient)
+    {
+        return fail_range(p, f);
+    }
+    *num = *num < f.min ? f.min : f.max;
+    p->adjusted |= 1UL << p->field;
+    return true;
+}
+
+static void append(SettingsParser *p, char c)
+{
+    if (p->len < sizeof(p->token) - 1)
+    {
+        p->token[p->len++] = c;
+    }
+    else
+    {
+        p->overflow = true;
+    }
+}
+
+static void append_utf8(SettingsParser *p, uint32_t code)
+{
+    if (code < 0x80)
+    {
+        append(p, (char)code);
+    }
+    else if (code < 0x800)
+    {
+        append(p, (char)(0xC0 | (code >> 6)));
+        append(p, (char)(0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000)
+    {
+        append(p, (char)(0xE0 | (code >> 12)));
+        append(p, (char)(0x80 | ((code >> 6) & 0x3F)));
+        append(p, (char)(0x80 | (code & 0x3F)));
+    }
+    else
+    {
+        append(p, (char)(0xF0 | (code >> 18)));
+        append(p, (char)(0x80 | ((code >> 12) & 0x3F)));
+        append(p, (char)(0x80 | ((code >> 6) & 0x3F)));
+        append(p, (char)(0x80 | (code & 0x3F)));
+    }
+}
+
+static bool is_high_surrogate(uint16_t code)
+{
+    return code >= 0xD800 && code <= 0xDBFF;
+}
+
+static bool is_low_surrogate(uint16_t code)
+{
+    return code >= 0xDC00 && code <= 0xDFFF;
+}
+
+// Конец \uXXXX. Символ вне BMP приходит парой \uD83D\uDE97 и собирается в 4 байта UTF-8;
+// половина пары без второй и \u0000 (обрезал бы строку) - ошибка.
+static int unicode_done(SettingsParser *p)
+{
+    uint16_t code = p->code;
+    if (p->surrogate)
+    {
+        if (!is_low_surrogate(code))
+        {
+            return -1;
+        }
+        append_utf8(p, 0x10000 + ((uint32_t)(p->surrogate - 0xD800) << 10) + (code - 0xDC00));
+        p->surrogate = 0;
+        return 0;
+    }
+    if (is_high_surrogate(code))
+    {
+        p->surrogate = code;
+        return 0;
+    }
+    if (is_low_surrogate(code) || code == 0)
+    {
+        return -1;
+    }
+    append_utf8(p, code);
+    return 0;
+}
+
+// Символ внутри строки. 1 - строка закончилась, 0 - продолжается, -1 - ошибка.
+static int string_char(SettingsParser *p, char c)
+{
+    if (p->unicode)
+    {
+        int digit = isxdigit((uint8_t)c) ? (isdigit((uint8_t)c) ? c - '0' : (tolower(c) - 'a' + 10)) : -1;
+        if (digit < 0)
+        {
+            return -1;
+        }
+        p->code = (p->code << 4) | digit;
+        return --p->unicode == 0 ? unicode_done(p) : 0;
+    }
+    if (p->surrogate)
+    {
+        // После старшей половины пары сразу идёт \u с младшей
+        if (!p->escape)
+        {
+            if (c != '\\')
+            {
+                return -1;
+            }
+            p->escape = true;
+            return 0;
+        }
+        if (c != 'u')
+        {
+            return -1;
+        }
+        p->escape = false;
+        p->unicode = 4;
+        p->code = 0;
+        return 0;
+    }
+    if (p->escape)
+    {
+        p->escape = false;
+        switch (c)
+        {
+        case '"': append(p, '"'); break;
+        case '\\': append(p, '\\'); break;
+        case '/': append(p, '/'); break;
+        case 'b': append(p, '\b'); break;
+        case 'f': append(p, '\f'); break;
+        case 'n': append(p, '\n'); break;
+        case 'r': append(p, '\r'); break;
+        case 't': append(p, '\t'); break;
+        case 'u':
+            p->unicode = 4;
+            p->code = 0;
+            break;
+        default:
+            return -1;
+        }
+        return 0;
+    }
+    if (c == '\\')
+    {
+        p->escape = true;
+        return 0;
+    }
+    if (c == '"')
+    {
+        return 1;
+    }
+    if ((uint8_t)c < 0x20)
+    {
+        return -1;
+    }
+    append(p, c);
+    return 0;
+}
+
+static int find_field(const char *name)
+{
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; ++i)
+    {
+        if (strcmp(SETTINGS_SCHEMA[i].name, name) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool store_string(SettingsParser *p)
+{
+    if (p->field < 0)
+    {
+        return true;
+    }
+    const SettingField &f = SETTINGS_SCHEMA[p->field];
+    if (f.type != SETTING_STRING)
+    {
+        return fail_field(p, "Invalid %s: must be a %s.", f.name, f.type == SETTING_BOOL ? "boolean" : "number");
+    }
+    bool empty_ok = (f.flags & SETTING_EMPTY_OK) && p->len == 0;
+    if (p->overflow || p->len > f.max || (p->len < f.min && !empty_ok))
+    {
+        return fail_field(p, "Invalid %s: must be %s%d-%d chars long.", f.name, (f.flags & SETTING_EMPTY_OK) ? "empty or " : "",
+                    (int)f.min, (int)f.max);
+    }
+    memcpy(field_ptr(&p->values, f), p->token, p->len + 1);
+    p->present |= 1UL << p->field;
+    return true;
+}
+
+static bool store_literal(SettingsParser *p)
+{
+    if (p->overflow)
+    {
+        return fail(p, "Invalid JSON");
+    }
+    const char *tok = p->token;
+    bool is_bool = strcmp(tok, "true") == 0 || strcmp(tok, "false") == 0;
+    bool is_null = strcmp(tok, "null") == 0;
+    char *end = NULL;
+    double num = 0;
+    if (!is_bool && !is_null)
+    {
+        // strtod принимает и "nan"/"inf", JSON - нет
+        if (tok[0] != '-' && !isdigit((uint8_t)tok[0]))
+        {
+            return fail(p, "Invalid JSON");
+        }
+        num = strtod(tok, &end);
+        if (end != tok + p->len || !isfinite(num))
+        {
+            return fail(p, "Invalid JSON");
+        }
+    }
+    if (p->field < 0)
+    {
+        return true;
+    }
+
+    const SettingField &f = SETTINGS_SCHEMA[p->field];
+    void *v = field_ptr(&p->values, f);
+    switch (f.type)
+    {
+    case SETTING_BOOL:
+        // Число 0/1 - как раньше принимал ArduinoJson
+        if (is_null || (!is_bool && num != 0 && num != 1))
+        {
+            return fail_field(p, "Invalid %s: must be a boolean.", f.name);
+        }
+        *(bool *)v = is_bool ? tok[0] == 't' : num != 0;
+        break;
+    case SETTING_INT:
+        if (is_bool || is_null || num != floor(num))
+        {
+            return fail_field(p, "Invalid %s: must be an integer.", f.name);
+        }
+        if (!clamp_range(p, f, &num))
+        {
+            return false;
+        }
+        *(int *)v = (int)num;
+        break;
+    case SETTING_FLOAT:
+        if (is_bool || is_null)
+        {
+            return fail_field(p, "Invalid %s: must be a number.", f.name);
+        }
+        if (!clamp_range(p, f, &num))
+        {
+            return false;
+        }
+        *(float *)v = (float)num;
+        break;
+    case SETTING_STRING:
+        if (!is_null)
+        {
+            return fail_field(p, "Invalid %s: must be a string.", f.name);
+        }
+        // null - очистить, если пустая строка допустима
+        p->len = 0;
+        p->token[0] = '\0';
+        return store_string(p);
+    }
+    p->present |= 1UL << p->field;
+    return true;
+}
+
+void settings_parser_begin(SettingsParser *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->state = PS_START;
+    p->field = -1;
+}
+
+void settings_parser_begin_lenient(SettingsParser *p)
+{
+    settings_parser_begin(p);
+    p->lenient = true;
+}
+
+static bool parse_char(SettingsParser *p, char c)
+{
+    switch (p->state)
+    {
+    case PS_START:
+        if (is_space(c)) return true;
+        if (c != '{') return fail(p, "Invalid JSON");
+        p->state = PS_KEY_OR_END;
+        return true;
+
+    case PS_KEY_OR_END:
+    case PS_KEY_START:
+        if (is_space(c)) return true;
+        if (c == '}' && p->state == PS_KEY_OR_END)
+        {
+            p->state = PS_DONE;
+            return true;
+        }
+        if (c != '"') return fail(p, "Invalid JSON");
+        p->len = 0;
+        p->overflow = false;
+        p->state = PS_KEY;
+        return true;
+
+    case PS_KEY:
+    {
+        int r = string_char(p, c);
+        if (r < 0) return fail(p, "Invalid JSON");
+        if (r > 0)
+        {
+            p->token[p->len] = '\0';
+            p->field = p->overflow ? -1 : find_field(p->token);
+            p->state = PS_COLON;
+        }
+        return true;
+    }
+
+    case PS_COLON:
+        if (is_space(c)) return true;
+        if (c != ':') return fail(p, "Invalid JSON");
+        p->state = PS_VALUE;
+        return true;
+
+    case PS_VALUE:
+        if (is_space(c)) return true;
+        p->len = 0;
+        p->overflow = false;
+        if (c == '"')
+        {
+            p->state = PS_STRING;
+        }
+        else if (c == '{' || c == '[')
+        {
+            if (p->field >= 0 &&
+                !fail_field(p, "Invalid %s: unexpected %s.", SETTINGS_SCHEMA[p->field].name, c == '{' ? "object" : "array"))
+            {
+                return false;
+            }
+            p->depth = 1;
+            p->in_string = false;
+            p->state = PS_SKIP;
+        }
+        else if (c == '-' || isalnum((uint8_t)c))
+        {
+            append(p, c);
+            p->state = PS_LITERAL;
+        }
+        else
+        {
+            return fail(p, "Invalid JSON");
+        }
+        return true;
+
+    case PS_STRING:
+    {
+        int r = string_char(p, c);
+        if (r < 0) return fail(p, "Invalid JSON");
+        if (r > 0)
+        {
+            p->token[p->len] = '\0';
+            if (!store_string(p)) return false;
+            p->state = PS_NEXT;
+        }
+        return true;
+    }
+
+    case PS_LITERAL:
+        if (c == ',' || c == '}' || is_space(c))
+        {
+            p->token[p->len] = '\0';
+            if (!store_literal(p)) return false;
+            p->state = PS_NEXT;
+            return parse_char(p, c);
+        }
+        append(p, c);
+        return true;
+
+    case PS_SKIP:
+        if (p->in_string)
+        {
+            if (p->escape) p->escape = false;
+            else if (c == '\\') p->escape = true;
+            else if (c == '"') p->in_string = false;
+        }
+        else if (c == '"') p->in_string = true;
+        else if (c == '{' || c == '[') p->depth++;
+        else if ((c == '}' || c == ']') && --p->depth == 0) p->state = PS_NEXT;
+        return true;
+
+    case PS_NEXT:
+        if (is_space(c)) return true;
+        if (c == ',') p->state = PS_KEY_START;
+        else if (c == '}') p->state = PS_DONE;
+        else return fail(p, "Invalid JSON");
+        return true;
+
+    case PS_DONE:
+        if (is_space(c)) return true;
+        return fail(p, "Invalid JSON");
+
+    default:
+        return false;
+    }
+}
+
+bool settings_parser_feed(SettingsParser *p, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (!parse_char(p, data[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool settings_parser_finish(SettingsParser *p)
+{
+    if (p->state == PS_ERROR)
+    {
+        return false;
+    }
+    if (p->state != PS_DONE)
+    {
+        return fail(p, "Invalid JSON");
+    }
+    return true;
+}
+
+bool settings_parser_has_flag(const SettingsParser *p, uint8_t flag)
+{
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; ++i)
+    {
+        if ((p->present & (1UL << i)) && (SETTINGS_SCHEMA[i].flags & flag))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void settings_merge(const SettingsParser *p, AppSettings *settings)
+{
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; ++i)
+    {
+        if (p->present & (1UL << i))
+        {
+            const SettingField &f = SETTINGS_SCHEMA[i];
+            memcpy(field_ptr(settings, f), field_ptr(&p->values, f), f.size);
+        }
+    }
+}
+
+bool settings_apply(const SettingsParser *p, AppSettings *settings, char *err, size_t err_size)
+{
+    AppSettings merged = *settings;
+    settings_merge(p, &merged);
+
+    if (!(merged.thresh_red <= merged.thresh_orange && merged.thresh_orange <= merged.thresh_yellow))
+    {
+        snprintf(err, err_size, "Invalid thresholds: must be thresh_red <= thresh_orange <= thresh_yellow.");
+        return false;
+    }
+    if (merged.bpm_min > merged.bpm_max)
+    {
+        snprintf(err, err_size, "Invalid bpm: bpm_min must not exceed bpm_max.");
+        return false;
+    }
+    DistanceFilterConfig filter;
+    filter.type = merged.filter_type;
+    filter.median_len = merged.filter_median;
+    filter.alpha = merged.filter_alpha;
+    filter.beta = merged.filter_beta;
+    if (!distance_filter_config_valid(filter))
+    {
+        snprintf(err, err_size, "Invalid filter: type 0-2, median 1/3/5, alpha (0,1], beta [0,1).");
+        return false;
+    }
+    if (!camera_resolution_supported(merged.resolution))
+    {
+        snprintf(err, err_size, "Invalid resolution: must be QQVGA, QVGA, VGA, SVGA or XGA.");
+        return false;
+    }
+
+    *settings = merged;
+    return true;
+}
+
+static uint32_t field_bit(const char *name)
+{
+    return 1UL << find_field(name);
+}
+
+// Поле по умолчанию, если значение отличается
+static uint32_t reset_field(AppSettings *s, const char *name)
+{
+    const SettingField &f = SETTINGS_SCHEMA[find_field(name)];
+    AppSettings defaults;
+    settings_load_defaults(&defaults);
+    if (memcmp(field_ptr(s, f), field_ptr(&defaults, f), f.size) == 0)
+    {
+        return 0;
+    }
+    memcpy(field_ptr(s, f), field_ptr(&defaults, f), f.size);
+    return field_bit(name);
+}
+
+uint32_t settings_repair(AppSettings *s)
+{
+    uint32_t fixed = 0;
+    // Пороги по возрастанию: red <= orange <= yellow
+    int t[3] = {s->thresh_red, s->thresh_orange, s->thresh_yellow};
+    for (int i = 1; i < 3; ++i)
+    {
+        for (int j = i; j > 0 && t[j - 1] > t[j]; --j)
+        {
+            int tmp = t[j];
+            t[j] = t[j - 1];
+            t[j - 1] = tmp;
+        }
+    }
+    if (t[0] != s->thresh_red) fixed |= field_bit("thresh_red");
+    if (t[1] != s->thresh_orange) fixed |= field_bit("thresh_orange");
+    if (t[2] != s->thresh_yellow) fixed |= field_bit("thresh_yellow");
+    s->thresh_red = t[0];
+    s->thresh_orange = t[1];
+    s->thresh_yellow = t[2];
+
+    if (s->bpm_min > s->bpm_max)
+    {
+        int tmp = s->bpm_min;
+        s->bpm_min = s->bpm_max;
+        s->bpm_max = tmp;
+        fixed |= field_bit("bpm_min") | field_bit("bpm_max");
+    }
+
+    // Каждый параметр фильтра проверяется вместе с остальными по умолчанию
+    const DistanceFilterConfig def = distance_filter_default_config();
+    DistanceFilterConfig filter = def;
+    filter.type = s->filter_type;
+    if (!distance_filter_config_valid(filter)) fixed |= reset_field(s, "filter_type");
+    filter = def;
+    filter.median_len = s->filter_median;
+    if (!distance_filter_config_valid(filter)) fixed |= reset_field(s, "filter_median");
+    filter = def;
+    filter.alpha = s->filter_alpha;
+    if (!distance_filter_config_valid(filter)) fixed |= reset_field(s, "filter_alpha");
+    filter = def;
+    filter.beta = s->filter_beta;
+    if (!distance_filter_config_valid(filter)) fixed |= reset_field(s, "filter_beta");
+    if (!camera_resolution_supported(s->resolution))
+    {
+        fixed |= reset_field(s, "resolution");
+    }
+    return fixed;
+}
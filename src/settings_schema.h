@@ -0,0 +1,90 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+class Print;
+
+// Единая таблица полей AppSettings (settings_schema.cpp): имя в JSON, тип, значение по умолчанию,
+// допустимый диапазон и флаги. Значения по умолчанию, GET/POST /api/settings и миграция
+// settings.json строятся по ней, поле добавляется в одном месте.
+
+enum SettingType : uint8_t
+{
+    SETTING_INT,
+    SETTING_BOOL,
+    SETTING_FLOAT,
+    SETTING_STRING, // char[], min/max - длина
+};
+
+const uint8_t SETTING_APPLY_CAMERA = 1 << 0; // Применяет camera_task (на ходу или перезапуском драйвера)
+const uint8_t SETTING_EMPTY_OK = 1 << 1;     // Строка может быть пустой несмотря на min; null = ""
+
+struct SettingField
+{
+    const char *name;
+    SettingType type;
+    uint8_t flags;
+    uint16_t offset; // offsetof(AppSettings, ...)
+    uint16_t size;   // Размер поля, для строк - буфера с '\0'
+    float min;
+    float max;
+    float def;
+    const char *def_str;
+};
+
+extern const SettingField SETTINGS_SCHEMA[];
+extern const size_t SETTINGS_FIELD_COUNT;
+
+void settings_load_defaults(AppSettings *s);
+
+// Потоковая запись полей в JSON без фигурных скобок: "name":value,... Без выделения памяти.
+void settings_write_json_fields(Print &out, const AppSettings &s);
+
+// Инкрементальный разбор JSON-объекта настроек: тело может приходить любыми кусками.
+// Неизвестные ключи пропускаются, значения известных проверяются по типу и диапазону сразу.
+struct SettingsParser
+{
+    AppSettings values; // Разобранные значения, действительны только поля из present
+    uint32_t present;   // Бит i - поле SETTINGS_SCHEMA[i] есть в теле
+    uint8_t state;
+    uint8_t depth;      // Вложенность пропускаемого значения
+    bool escape;
+    bool in_string;
+    bool overflow;
+    int8_t field;       // Текущий ключ, -1 - неизвестный
+    uint8_t len;
+    uint8_t unicode;    // Осталось hex-цифр в \uXXXX
+    uint16_t code;
+    uint16_t surrogate; // Старшая половина суррогатной пары, ждём \uDC00-\uDFFF
+    bool lenient;       // Миграция settings.json: неверное значение поля - не ошибка, см. ниже
+    uint32_t adjusted;  // lenient: бит i - значение поля приведено к диапазону или отброшено
+    char token[72];
+    char error[96];
+};
+
+void settings_parser_begin(SettingsParser *p);
+// Разбор старого settings.json: число вне диапазона приводится к границе, значение неверного типа
+// или строка недопустимой длины отбрасывается (поле остаётся как было). Ошибка - только синтаксис.
+void settings_parser_begin_lenient(SettingsParser *p);
+
+// false - ошибка разбора или проверки, текст в p->error; дальнейшие куски игнорируются.
+bool settings_parser_feed(SettingsParser *p, const char *data, size_t len);
+
+// Тело закончилось: объект должен быть закрыт.
+bool settings_parser_finish(SettingsParser *p);
+
+// Есть ли среди разобранных полей поле с флагом.
+bool settings_parser_has_flag(const SettingsParser *p, uint8_t flag);
+
+// Перенос разобранных полей в settings и проверка связей между полями (пороги, фильтр, пароль).
+// При ошибке settings не меняется, текст - в err.
+bool settings_apply(const SettingsParser *p, AppSettings *settings, char *err, size_t err_size);
+
+// Перенос разобранных полей без проверки связей.
+void settings_merge(const SettingsParser *p, AppSettings *settings);
+
+// Миграция: связи, которые проверяет settings_apply, исправляются. Пороги упорядочиваются,
+// bpm_min и bpm_max меняются местами, неверный фильтр и разрешение - по умолчанию.
+// Возвращает биты исправленных полей (как SettingsParser::adjusted).
+uint32_t settings_repair(AppSettings *s);
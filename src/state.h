@@ -6,7 +6,6 @@
 
 struct AppState {
     AppSettings settings;
-    float sensor_distances[NUM_SENSORS];
     bool is_camera_initialized;
     bool is_parktronic_active;     
     bool is_muted;
@@ -18,4 +17,7 @@ extern EventGroupHandle_t xAppEventGroup;
 
 const EventBits_t CAM_STREAM_REQUEST_BIT = (1 << 0);
 const EventBits_t CAM_INITIALIZED_BIT    = (1 << 1);
-const EventBits_t PARKTRONIC_ACTIVE_BIT  = (1 << 2);
\ No newline at end of file
+const EventBits_t PARKTRONIC_ACTIVE_BIT  = (1 << 2);
+const EventBits_t CAM_PREWARM_BIT        = (1 << 3); // Задняя передача: камера включается до подключения клиента
+const EventBits_t CAM_RECONFIG_BIT       = (1 << 4); // Настройки камеры изменены, применить на ходу
+const EventBits_t CAM_SNAPSHOT_BIT       = (1 << 6); // Нужен кадр для /api/snapshot: одиночный снимок, если камера спит
\ No newline at end of file
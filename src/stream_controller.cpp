@@ -0,0 +1,235 @@
+#include "stream_controller.h"
+#include <Arduino.h>
+#include "web/websocket_manager.h"
+#include "web/mjpeg_stream.h"
+
+extern SemaphoreHandle_t xCameraMutex;
+
+const unsigned long WINDOW_MS = 1000;
+const unsigned long CHANGE_COOLDOWN_MS = 300; // В конвейере ещё есть кадры со старыми параметрами
+const int QUALITY_STEP_DOWN = 5;
+const int QUALITY_STEP_UP = 2;
+const int WORST_QUALITY = 40;
+const int HEADROOM_WINDOWS = 3;
+const int MAX_TRACKED_CLIENTS = MAX_STREAM_CLIENTS + MAX_MJPEG_CLIENTS;
+const uint32_t MJPEG_ID_FLAG = 0x80000000; // Номера соединений MJPEG не совпадают с клиентами /ws_stream
+
+// Лестница разрешений, как в настройках клиента
+static const framesize_t FRAMESIZE_STEPS[] = {FRAMESIZE_QQVGA, FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA};
+const int NUM_FRAMESIZE_STEPS = sizeof(FRAMESIZE_STEPS) / sizeof(FRAMESIZE_STEPS[0]);
+
+// Состояние меняют stream_task (кадры) и camera_task (сброс). Порядок захвата:
+// s_ctl_mutex, затем xCameraMutex или xWsMutex.
+static SemaphoreHandle_t s_ctl_mutex = xSemaphoreCreateMutex();
+
+static int max_step = 0;
+static int best_quality = 12;
+static int cur_step = 0;
+static int cur_quality = 12;
+
+static unsigned long window_start = 0;
+static unsigned long last_change = 0;
+static uint32_t window_frames = 0;
+static size_t window_max_len = 0;
+static int headroom_windows = 0;
+
+// Счётчики клиентов на начало окна
+static StreamClientStats prev_stats[MAX_TRACKED_CLIENTS];
+static int prev_count = 0;
+
+// Счётчики зрителей обоих транспортов
+static int collect_client_stats(StreamClientStats *out)
+{
+    int count = get_stream_client_stats(out, MAX_STREAM_CLIENTS);
+    MjpegClientStats mjpeg[MAX_MJPEG_CLIENTS];
+    int mjpeg_count = get_mjpeg_client_stats(mjpeg, MAX_MJPEG_CLIENTS);
+    for (int i = 0; i < mjpeg_count; ++i)
+    {
+        out[count].id = MJPEG_ID_FLAG | mjpeg[i].id;
+        out[count].delivered = mjpeg[i].frames;
+        out[count].dropped = mjpeg[i].dropped;
+        out[count].pending = 0; // Соединение отправляет не больше одного кадра
+        count++;
+    }
+    return count;
+}
+
+static int framesize_to_step(framesize_t fs)
+{
+    int step = 0;
+    for (int i = 0; i < NUM_FRAMESIZE_STEPS; ++i)
+    {
+        if (FRAMESIZE_STEPS[i] <= fs)
+        {
+            step = i;
+        }
+    }
+    return step;
+}
+
+// Под s_ctl_mutex
+static void apply(int step, int quality, const char *reason)
+{
+    sensor_t *s = NULL;
+    if (xSemaphoreTake(xCameraMutex, pdMS_TO_TICKS(100)) == pdTRUE)
+    {
+        s = esp_camera_sensor_get();
+        if (s)
+        {
+            if (step != cur_step)
+            {
+                s->set_framesize(s, FRAMESIZE_STEPS[step]);
+            }
+            if (quality != cur_quality)
+            {
+                s->set_quality(s, quality);
+            }
+        }
+        xSemaphoreGive(xCameraMutex);
+    }
+    if (!s)
+    {
+        return;
+    }
+
+    const resolution_info_t &res = resolution[FRAMESIZE_STEPS[step]];
+    Serial.printf("[StreamCtl] %s: quality %d -> %d, %ux%u\n", reason, cur_quality, quality, res.width, res.height);
+    cur_step = step;
+    cur_quality = quality;
+    last_change = millis();
+    headroom_windows = 0;
+}
+
+static void degrade(const char *reason)
+{
+    if (cur_quality < WORST_QUALITY)
+    {
+        apply(cur_step, min(cur_quality + QUALITY_STEP_DOWN, WORST_QUALITY), reason);
+    }
+    else if (cur_step > 0)
+    {
+        apply(cur_step - 1, cur_quality, reason);
+    }
+}
+
+static void improve()
+{
+    // Обратный порядок: сначала вернуть разрешение, затем качество
+    if (cur_step < max_step)
+    {
+        apply(cur_step + 1, cur_quality, "headroom");
+    }
+    else if (cur_quality > best_quality)
+    {
+        apply(cur_step, max(cur_quality - QUALITY_STEP_UP, best_quality), "headroom");
+    }
+}
+
+void stream_controller_reset(framesize_t max_framesize, int quality, bool write_sensor)
+{
+    xSemaphoreTake(s_ctl_mutex, portMAX_DELAY);
+    if (write_sensor && xSemaphoreTake(xCameraMutex, portMAX_DELAY) == pdTRUE)
+    {
+        sensor_t *s = esp_camera_sensor_get();
+        if (s)
+        {
+            s->set_framesize(s, max_framesize);
+            s->set_quality(s, quality);
+        }
+        xSemaphoreGive(xCameraMutex);
+    }
+    max_step = framesize_to_step(max_framesize);
+    best_quality = quality;
+    cur_step = max_step;
+    cur_quality = quality;
+    window_start = millis();
+    last_change = 0;
+    window_frames = 0;
+    window_max_len = 0;
+    headroom_windows = 0;
+    prev_count = collect_client_stats(prev_stats);
+    xSemaphoreGive(s_ctl_mutex);
+}
+
+void stream_controller_on_frame(size_t frame_len)
+{
+    xSemaphoreTake(s_ctl_mutex, portMAX_DELAY);
+    unsigned long now = millis();
+    window_frames++;
+    window_max_len = max(window_max_len, frame_len);
+
+    // Кадр уже не помещается - реагируем сразу, не дожидаясь конца окна
+    if (frame_len > MAX_FRAME_SIZE_BYTES && now - last_change > CHANGE_COOLDOWN_MS)
+    {
+        degrade("frame over cap");
+    }
+
+    if (now - window_start < WINDOW_MS)
+    {
+        xSemaphoreGive(s_ctl_mutex);
+        return;
+    }
+
+    // Доставка самому быстрому клиенту: медленные клиенты сами пропускают кадры
+    // и не должны снижать качество для всех.
+    StreamClientStats stats[MAX_TRACKED_CLIENTS];
+    int count = collect_client_stats(stats);
+    float best_fps = 0;
+    uint32_t best_dropped = 0;
+    uint32_t best_pending = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        uint32_t delivered = stats[i].delivered;
+        uint32_t dropped = stats[i].dropped;
+        for (int j = 0; j < prev_count; ++j)
+        {
+            if (prev_stats[j].id == stats[i].id)
+            {
+                delivered -= prev_stats[j].delivered;
+                dropped -= prev_stats[j].dropped;
+                break;
+            }
+        }
+        float fps = delivered * 1000.0f / (now - window_start);
+        if (fps > best_fps)
+        {
+            best_fps = fps;
+            best_dropped = dropped;
+            best_pending = stats[i].pending;
+        }
+    }
+    float camera_fps = window_frames * 1000.0f / (now - window_start);
+
+    bool near_cap = window_max_len > MAX_FRAME_SIZE_BYTES * 9 / 10;
+    // Камера успевает, а лучший клиент - нет: узкое место в канале
+    bool congested = count > 0 && camera_fps >= STREAM_TARGET_FPS * 0.8f && best_fps < STREAM_TARGET_FPS * 0.8f;
+    bool headroom = window_max_len < MAX_FRAME_SIZE_BYTES * 6 / 10 && best_dropped == 0 &&
+                    best_pending < 2 && best_fps >= min(camera_fps, (float)STREAM_TARGET_FPS) * 0.9f;
+
+    if (now - last_change > CHANGE_COOLDOWN_MS)
+    {
+        if (near_cap)
+        {
+            degrade("frames near cap");
+        }
+        else if (congested)
+        {
+            degrade("link congested");
+        }
+        else if (headroom && ++headroom_windows >= HEADROOM_WINDOWS)
+        {
+            improve();
+        }
+        else if (!headroom)
+        {
+            headroom_windows = 0;
+        }
+    }
+
+    window_start = now;
+    window_frames = 0;
+    window_max_len = 0;
+    memcpy(prev_stats, stats, sizeof(stats));
+    prev_count = count;
+    xSemaphoreGive(s_ctl_mutex);
+}
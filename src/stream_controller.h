@@ -0,0 +1,18 @@
+#pragma once
+#include "esp_camera.h"
+
+// Кадр больше этого размера не отправляется в /ws_stream.
+const size_t MAX_FRAME_SIZE_BYTES = 100 * 1024;
+// Частота кадров, которую регулятор старается удержать у самого быстрого клиента.
+const int STREAM_TARGET_FPS = 15;
+
+// Регулятор качества стрима: по размеру кадров и доставке клиентам меняет
+// jpeg_quality и разрешение OV5640 на лету, не выходя за пределы настроек пользователя.
+
+// Вызывается после инициализации камеры с настройками пользователя (потолок качества).
+// write_sensor - записать разрешение и качество в сенсор: при перенастройке на ходу в нём
+// могут стоять значения, сниженные регулятором.
+void stream_controller_reset(framesize_t max_framesize, int best_quality, bool write_sensor);
+
+// Вызывается stream_task для каждого нового кадра пула, есть ли зрители /ws_stream или нет.
+void stream_controller_on_frame(size_t frame_len);
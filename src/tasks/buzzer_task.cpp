@@ -2,74 +2,209 @@
 #include <Arduino.h>
 #include "state.h"
 #include "config.h"
+#include "sensor_snapshot.h"
+#include "metrics.h"
+#include "diagnostics.h"
+#include "esp_timer.h"
 
 const int BUZZER_LEDC_CHANNEL = 1;
+const uint32_t BUZZER_BEEP_MS = 100;
+// Пауза при bpm = 0 (как раньше: сигнал раз в 600 мс)
+const uint32_t BUZZER_DEFAULT_GAP_MS = 500;
+// Без новых измерений (парктроник выключен) задача проверяет состояние с этим периодом
+const uint32_t BUZZER_IDLE_POLL_MS = 100;
+// Верхняя граница thresh_yellow в схеме настроек
+const int BUZZER_LUT_MAX_CM = 400;
+
+enum BuzzerMode {
+    BUZZ_SILENT,
+    BUZZ_PULSE,      // BUZZER_BEEP_MS сигнала, gap_ms паузы
+    BUZZ_CONTINUOUS,
+};
+
+struct BuzzerCadence {
+    BuzzerMode mode;
+    uint32_t gap_ms;
+};
+
+// Генератор сигнала на esp_timer: задача только выбирает каденцию, фронты включения и
+// выключения LEDC ставит однократный таймер. Новая каденция применяется сразу, не
+// дожидаясь конца текущей паузы.
+static esp_timer_handle_t s_beep_timer = NULL;
+static SemaphoreHandle_t s_engine_mutex = NULL;
+static BuzzerCadence s_cadence = {BUZZ_SILENT, 0};
+static bool s_on = false;
+static int64_t s_phase_start_us = 0;
+static uint32_t s_duty = 0;
+
+// Пауза по расстоянию (см) в зоне прерывистого сигнала; пересчитывается при смене порогов или bpm
+static uint16_t s_gap_lut[BUZZER_LUT_MAX_CM + 1];
+
+static void set_output(bool on) {
+    s_on = on;
+    s_phase_start_us = esp_timer_get_time();
+    ledcWrite(BUZZER_LEDC_CHANNEL, on ? s_duty : 0);
+}
+
+static void arm_timer(uint32_t ms) {
+    esp_timer_stop(s_beep_timer);
+    esp_timer_start_once(s_beep_timer, (uint64_t)ms * 1000);
+}
+
+static void beep_timer_cb(void *arg) {
+    (void)arg;
+    xSemaphoreTake(s_engine_mutex, portMAX_DELAY);
+    if (s_cadence.mode == BUZZ_PULSE) {
+        set_output(!s_on);
+        arm_timer(s_on ? BUZZER_BEEP_MS : s_cadence.gap_ms);
+    }
+    xSemaphoreGive(s_engine_mutex);
+}
+
+// true - каденция изменилась
+static bool engine_set_cadence(const BuzzerCadence &next) {
+    xSemaphoreTake(s_engine_mutex, portMAX_DELAY);
+    bool changed = next.mode != s_cadence.mode || (next.mode == BUZZ_PULSE && next.gap_ms != s_cadence.gap_ms);
+    if (changed) {
+        BuzzerMode prev_mode = s_cadence.mode;
+        s_cadence = next;
+        if (next.mode != BUZZ_PULSE) {
+            esp_timer_stop(s_beep_timer);
+            set_output(next.mode == BUZZ_CONTINUOUS);
+        } else if (prev_mode != BUZZ_PULSE) {
+            // Из тишины или непрерывного сигнала - сразу начинаем сигнал
+            set_output(true);
+            arm_timer(BUZZER_BEEP_MS);
+        } else if (!s_on) {
+            // Пауза идёт: укороченная заканчивается сейчас, иначе дотягивается до новой длины.
+            // Текущий сигнал (s_on) дозвучит как есть, новая пауза начнётся после него.
+            uint32_t elapsed_ms = (esp_timer_get_time() - s_phase_start_us) / 1000;
+            if (elapsed_ms >= next.gap_ms) {
+                set_output(true);
+                arm_timer(BUZZER_BEEP_MS);
+            } else {
+                arm_timer(next.gap_ms - elapsed_ms);
+            }
+        }
+    }
+    xSemaphoreGive(s_engine_mutex);
+    return changed;
+}
+
+static void engine_set_tone(int tone, int vol) {
+    xSemaphoreTake(s_engine_mutex, portMAX_DELAY);
+    ledcChangeFrequency(BUZZER_LEDC_CHANNEL, tone, 8);
+    s_duty = map(vol, 0, 100, 0, 128);
+    if (s_on) {
+        ledcWrite(BUZZER_LEDC_CHANNEL, s_duty);
+    }
+    xSemaphoreGive(s_engine_mutex);
+}
+
+static void rebuild_gap_lut(int r, int y, int min_bpm, int max_bpm) {
+    for (int d = 0; d <= BUZZER_LUT_MAX_CM; ++d) {
+        uint32_t gap_ms = BUZZER_DEFAULT_GAP_MS;
+        if (d > r && d <= y) {
+            long bpm = constrain(map(d, y, r, min_bpm, max_bpm), min_bpm, max_bpm);
+            if (bpm > 0) {
+                long gap = 60000 / bpm - (long)BUZZER_BEEP_MS;
+                gap_ms = gap > 0 ? gap : 0;
+            }
+        }
+        s_gap_lut[d] = gap_ms;
+    }
+}
 
 void buzzer_task(void *pvParameters) {
     (void)pvParameters;
 
-    ledcSetup(BUZZER_LEDC_CHANNEL, 1000, 8); 
+    ledcSetup(BUZZER_LEDC_CHANNEL, 1000, 8);
     ledcAttachPin(BUZZER_PIN, BUZZER_LEDC_CHANNEL);
 
+    s_engine_mutex = xSemaphoreCreateMutex();
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = beep_timer_cb;
+    timer_args.dispatch_method = ESP_TIMER_TASK;
+    timer_args.name = "buzzer";
+    if (!s_engine_mutex || esp_timer_create(&timer_args, &s_beep_timer) != ESP_OK) {
+        Serial.println("[Buzzer] CRITICAL: Failed to create beep timer!");
+        vTaskDelete(NULL);
+    }
+
     Serial.println("Buzzer task started");
 
+    // Последние прочитанные настройки: если xStateMutex занят (например, сохранением настроек),
+    // работаем со старыми значениями, а не ждём.
+    bool is_muted = false;
+    int vol = 100, tone = 1760, r = 50, y = 200, min_bpm = 0, max_bpm = 300;
+    int lut_key[4] = {-1, -1, -1, -1};
+    int tone_key[2] = {-1, -1};
+    int last_zone = -1; // 0 - тишина, 1 - прерывистый сигнал, 2 - непрерывный
+    uint32_t last_seq = 0;
+
+    sensor_snapshot_subscribe();
+
     for (;;) {
-        xEventGroupWaitBits(xAppEventGroup, PARKTRONIC_ACTIVE_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-
-        while (xEventGroupGetBits(xAppEventGroup) & PARKTRONIC_ACTIVE_BIT) {
-            
-            float min_dist = 999.0;
-            bool is_muted = false;
-            int vol = 100, tone = 1760, r = 50, o = 100, y = 200, min_bpm = 0, max_bpm = 300;
-
-            if (xSemaphoreTake(xStateMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-                for (int i = 0; i < NUM_SENSORS; i++) {
-                    if (g_app_state.sensor_distances[i] < min_dist) {
-                        min_dist = g_app_state.sensor_distances[i];
-                    }
-                }
-                is_muted = g_app_state.is_muted;
-                vol = g_app_state.settings.volume;
-                tone = g_app_state.settings.beep_freq;
-                r = g_app_state.settings.thresh_red;
-                o = g_app_state.settings.thresh_orange;
-                y = g_app_state.settings.thresh_yellow;
-                min_bpm = g_app_state.settings.bpm_min;
-                max_bpm = g_app_state.settings.bpm_max;
-                xSemaphoreGive(xStateMutex);
-            }
+        // Просыпаемся на каждое новое измерение
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BUZZER_IDLE_POLL_MS));
 
-            if (is_muted || min_dist > y) {
-                ledcWrite(BUZZER_LEDC_CHANNEL, 0); 
-                vTaskDelay(pdMS_TO_TICKS(100)); 
-                continue;
-            }
+        if (xSemaphoreTake(xStateMutex, 0) == pdTRUE) {
+            is_muted = g_app_state.is_muted;
+            vol = g_app_state.settings.volume;
+            tone = g_app_state.settings.beep_freq;
+            r = g_app_state.settings.thresh_red;
+            y = min(g_app_state.settings.thresh_yellow, BUZZER_LUT_MAX_CM);
+            min_bpm = g_app_state.settings.bpm_min;
+            max_bpm = g_app_state.settings.bpm_max;
+            xSemaphoreGive(xStateMutex);
+        }
+        if (lut_key[0] != r || lut_key[1] != y || lut_key[2] != min_bpm || lut_key[3] != max_bpm) {
+            rebuild_gap_lut(r, y, min_bpm, max_bpm);
+            lut_key[0] = r;
+            lut_key[1] = y;
+            lut_key[2] = min_bpm;
+            lut_key[3] = max_bpm;
+        }
+        if (tone_key[0] != tone || tone_key[1] != vol) {
+            engine_set_tone(tone, vol);
+            tone_key[0] = tone;
+            tone_key[1] = vol;
+        }
+
+        if (!(xEventGroupGetBits(xAppEventGroup) & PARKTRONIC_ACTIVE_BIT)) {
+            engine_set_cadence({BUZZ_SILENT, 0});
+            last_zone = -1;
+            continue;
+        }
 
-            long delay_ms = 500;
-            long beep_duration_ms = 100;
-
-            if (min_dist <= r) { 
-                delay_ms = 0;
-                beep_duration_ms = 1000;
-            } else { 
-                long current_bpm = map(min_dist, y, r, min_bpm, max_bpm);
-                current_bpm = constrain(current_bpm, min_bpm, max_bpm);
-                if (current_bpm > 0) {
-                    delay_ms = 60000 / current_bpm - beep_duration_ms;
-                    if (delay_ms < 0) delay_ms = 0;
-                }
+        SensorSample sample;
+        sensor_snapshot_read(&sample);
+        float min_dist = 999.0;
+        for (int i = 0; i < NUM_SENSORS; i++) {
+            if (sample.distances[i] < min_dist) {
+                min_dist = sample.distances[i];
             }
+        }
 
-            int duty_cycle = map(vol, 0, 100, 0, 128); 
-            ledcChangeFrequency(BUZZER_LEDC_CHANNEL, tone, 8);
-            ledcWrite(BUZZER_LEDC_CHANNEL, duty_cycle);
-            vTaskDelay(pdMS_TO_TICKS(beep_duration_ms));
+        int zone = min_dist > y ? 0 : (min_dist <= r ? 2 : 1);
+        BuzzerCadence cadence = {BUZZ_SILENT, 0};
+        if (!is_muted && zone == 2) {
+            cadence.mode = BUZZ_CONTINUOUS;
+        } else if (!is_muted && zone == 1) {
+            cadence.gap_ms = s_gap_lut[(int)min_dist];
+            cadence.mode = cadence.gap_ms > 0 ? BUZZ_PULSE : BUZZ_CONTINUOUS;
+        }
+        if (engine_set_cadence(cadence) && cadence.mode != BUZZ_SILENT) {
+            diagnostics_boot_mark(BOOT_FIRST_BEEP);
+        }
 
-            ledcWrite(BUZZER_LEDC_CHANNEL, 0); 
-            if (delay_ms > 0) {
-                vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        // Реакция: от публикации измерения, сменившего зону, до перестройки сигнала
+        if (zone != last_zone) {
+            if (last_zone >= 0 && sample.seq != last_seq && sample.seq != 0 && !is_muted) {
+                histogram_record(g_metric_buzzer_reaction_ms, millis() - sample.timestamp_ms);
             }
+            last_zone = zone;
         }
-        ledcWrite(BUZZER_LEDC_CHANNEL, 0); 
+        last_seq = sample.seq;
     }
-}
\ No newline at end of file
+}
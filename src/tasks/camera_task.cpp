@@ -3,18 +3,161 @@
 #include "freertos/event_groups.h"
 #include "config.h"
 #include "state.h"
+#include "frame_pool.h"
+#include "stream_controller.h"
 
 extern SemaphoreHandle_t xCameraMutex; 
 
+// OV5640 SYSTEM CTROL0: бит 6 - программный power down, регистры сохраняются
+const int OV5640_SYSTEM_CTROL0 = 0x3008;
+const int OV5640_POWER_DOWN = 0x42;
+const int OV5640_WAKE = 0x02;
+
+const uint32_t FIRST_FRAME_TIMEOUT_MS = 2000;
+// Одиночный снимок: из standby ~100 мс, с полной инициализацией ~650 мс. Превышение - в лог.
+const uint32_t SNAPSHOT_BUDGET_MS = 1000;
+const uint32_t SNAPSHOT_TIMEOUT_MS = 3000;
+
+static CameraActivationStats s_activation_stats = {0, 0, false};
+static CameraReconfigStats s_reconfig_stats = {0, 0, false, false, false};
+static CameraSnapshotStats s_snapshot_stats = {0, 0, 0, 0, 0};
+
+// Результат одиночного снимка, под xSnapshotMutex. camera_task кладёт ссылку на кадр (NULL - сбой
+// камеры) и увеличивает поколение; ожидающие запросы берут по своей ссылке. Ссылка результата
+// отпускается, когда её забрал последний ожидающий: до этого frame_pool_close() в camera_task ждёт.
+// Поэтому новый запрос, пока результат не разобран, сразу получает этот кадр, а не ждёт следующего.
+static SemaphoreHandle_t xSnapshotMutex = xSemaphoreCreateMutex();
+static frame_t *s_snapshot_frame = NULL;
+static uint32_t s_snapshot_gen = 0;
+static int s_snapshot_waiters = 0;
+static bool s_snapshot_pending = false; // CAM_SNAPSHOT_BIT поднят или взят camera_task, результата ещё нет
+static void (*s_snapshot_hook)() = NULL;
+
+struct ResolutionName {
+    const char *name;
+    framesize_t size;
+};
+static const ResolutionName RESOLUTIONS[] = {
+    {"QQVGA", FRAMESIZE_QQVGA},
+    {"QVGA", FRAMESIZE_QVGA},
+    {"VGA", FRAMESIZE_VGA},
+    {"SVGA", FRAMESIZE_SVGA},
+    {"XGA", FRAMESIZE_XGA},
+};
+
 framesize_t string_to_framesize(const char* str) {
-    if (strcmp(str, "QQVGA") == 0) return FRAMESIZE_QQVGA;
-    if (strcmp(str, "QVGA") == 0) return FRAMESIZE_QVGA;
-    if (strcmp(str, "VGA") == 0) return FRAMESIZE_VGA;
-    if (strcmp(str, "SVGA") == 0) return FRAMESIZE_SVGA;
-    if (strcmp(str, "XGA") == 0) return FRAMESIZE_XGA;
+    for (const ResolutionName &r : RESOLUTIONS) {
+        if (strcmp(str, r.name) == 0) return r.size;
+    }
     return FRAMESIZE_VGA;
 }
 
+bool camera_resolution_supported(const char *name) {
+    for (const ResolutionName &r : RESOLUTIONS) {
+        if (strcmp(name, r.name) == 0) return true;
+    }
+    return false;
+}
+
+// Настройки камеры из g_app_state
+struct CameraSettings {
+    framesize_t frame_size;
+    int jpeg_quality;
+    int xclk_freq_hz;
+    bool flip_h;
+    bool flip_v;
+};
+
+static CameraSettings read_camera_settings() {
+    CameraSettings cs = {FRAMESIZE_VGA, 20, 22000000, false, false};
+    if (xSemaphoreTake(xStateMutex, portMAX_DELAY) == pdTRUE) {
+        cs.frame_size = string_to_framesize(g_app_state.settings.resolution);
+        cs.jpeg_quality = g_app_state.settings.jpeg_quality;
+        cs.xclk_freq_hz = g_app_state.settings.xclk_freq * 1000000;
+        cs.flip_h = g_app_state.settings.flip_h;
+        cs.flip_v = g_app_state.settings.flip_v;
+        xSemaphoreGive(xStateMutex);
+    }
+    return cs;
+}
+
+static void set_camera_initialized(bool initialized) {
+    if (xSemaphoreTake(xStateMutex, portMAX_DELAY) == pdTRUE) {
+        g_app_state.is_camera_initialized = initialized;
+        xSemaphoreGive(xStateMutex);
+    }
+}
+
+// Настройка сенсора без повторной инициализации драйвера. Вызывается под xCameraMutex.
+// prev - уже применённые настройки: переписываются только изменившиеся (смена разрешения
+// у OV5640 - длинная последовательность SCCB). NULL - всё, включая выход из power down.
+static void apply_sensor_settings(const CameraSettings &cs, const CameraSettings *prev) {
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s) {
+        return;
+    }
+    if (!prev) {
+        s->set_reg(s, OV5640_SYSTEM_CTROL0, 0xff, OV5640_WAKE);
+    }
+    if (!prev || prev->frame_size != cs.frame_size) {
+        s->set_framesize(s, cs.frame_size);
+    }
+    if (!prev || prev->jpeg_quality != cs.jpeg_quality) {
+        s->set_quality(s, cs.jpeg_quality);
+    }
+    if (!prev || prev->flip_h != cs.flip_h) {
+        s->set_hmirror(s, cs.flip_h ? 1 : 0);
+    }
+    if (!prev || prev->flip_v != cs.flip_v) {
+        s->set_vflip(s, cs.flip_v ? 1 : 0);
+    }
+}
+
+// Остановка публикации: после возврата читателями всех буферов драйвер можно усыпить или deinit.
+static void stop_capture() {
+    if (xSemaphoreTake(xCameraMutex, portMAX_DELAY) == pdTRUE) {
+        xEventGroupClearBits(xAppEventGroup, CAM_INITIALIZED_BIT);
+        xSemaphoreGive(xCameraMutex);
+    }
+    frame_pool_close();
+}
+
+static void start_capture(const CameraSettings &cs) {
+    set_camera_initialized(true);
+    stream_controller_reset(cs.frame_size, cs.jpeg_quality, false);
+    ulTaskNotifyTake(pdTRUE, 0);
+    frame_pool_open();
+    xEventGroupSetBits(xAppEventGroup, CAM_INITIALIZED_BIT);
+}
+
+// Ответ на запрос снимка: ссылка на последний кадр - результат для ожидающих /api/snapshot.
+// Пул не закроется, пока они её не разберут.
+// Запрос проверяется и снимается одной операцией: ушли все ожидающие - запрос снят ими
+// или результат никому не нужен.
+static void deliver_snapshot() {
+    if (!(xEventGroupClearBits(xAppEventGroup, CAM_SNAPSHOT_BIT) & CAM_SNAPSHOT_BIT)) {
+        return;
+    }
+    frame_t *previous = NULL;
+    xSemaphoreTake(xSnapshotMutex, portMAX_DELAY);
+    s_snapshot_pending = false;
+    if (s_snapshot_waiters > 0) {
+        previous = s_snapshot_frame;
+        s_snapshot_frame = frame_pool_acquire_latest();
+        s_snapshot_gen++;
+    }
+    xSemaphoreGive(xSnapshotMutex);
+    frame_release(previous);
+    if (s_snapshot_hook) {
+        s_snapshot_hook();
+    }
+}
+
+// Ожидание следующего опубликованного кадра (камера подписана на пул). false - таймаут.
+static bool wait_next_frame() {
+    return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FIRST_FRAME_TIMEOUT_MS)) > 0;
+}
+
 void camera_task(void *pvParameters) {
     (void)pvParameters;
 
@@ -40,77 +183,262 @@ void camera_task(void *pvParameters) {
     config.pixel_format = PIXFORMAT_JPEG;
     config.fb_location = CAMERA_FB_IN_PSRAM;
     config.grab_mode = CAMERA_GRAB_LATEST;
-    config.fb_count = 2;
-
-      for (;;) {
-        xEventGroupWaitBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-
-        bool flip_h, flip_v;
-        if (xSemaphoreTake(xStateMutex, portMAX_DELAY) == pdTRUE) {
-            config.frame_size = string_to_framesize(g_app_state.settings.resolution);
-            config.jpeg_quality = g_app_state.settings.jpeg_quality;
-            config.xclk_freq_hz = g_app_state.settings.xclk_freq * 1000000;
-            flip_h = g_app_state.settings.flip_h;
-            flip_v = g_app_state.settings.flip_v;
-            g_app_state.is_camera_initialized = false;
-            xSemaphoreGive(xStateMutex);
-        }
+    config.fb_count = CAM_FB_COUNT;
+
+    bool driver_ready = false; // Драйвер инициализирован, буферы выделены под config.frame_size
+    frame_pool_subscribe();
 
-        esp_err_t err;
+    // Новые настройки помещаются в выделенные буферы и не меняют XCLK - драйвер не трогаем
+    auto fits_driver = [&](const CameraSettings &cs) {
+        return driver_ready && cs.xclk_freq_hz == config.xclk_freq_hz && cs.frame_size <= config.frame_size;
+    };
 
+    // Полная инициализация под новые настройки (при необходимости с deinit).
+    auto init_driver = [&](const CameraSettings &cs) -> esp_err_t {
+        esp_err_t err = ESP_FAIL;
         if (xSemaphoreTake(xCameraMutex, portMAX_DELAY) == pdTRUE) {
+            if (driver_ready) {
+                esp_camera_deinit();
+                driver_ready = false;
+            }
+            config.frame_size = cs.frame_size;
+            config.jpeg_quality = cs.jpeg_quality;
+            config.xclk_freq_hz = cs.xclk_freq_hz;
             err = esp_camera_init(&config);
             if (err == ESP_OK) {
+                driver_ready = true;
                 sensor_t *s = esp_camera_sensor_get();
                 if (s) {
-                    s->set_hmirror(s, flip_h ? 1 : 0);
-                    s->set_vflip(s, flip_v ? 1 : 0);
+                    s->set_hmirror(s, cs.flip_h ? 1 : 0);
+                    s->set_vflip(s, cs.flip_v ? 1 : 0);
                 }
             }
             xSemaphoreGive(xCameraMutex);
         }
-
         if (err != ESP_OK) {
             Serial.printf("[CameraTask] CRITICAL: Camera init failed with error 0x%x (%s)\n", err, esp_err_to_name(err));
-            xEventGroupClearBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            continue;
         }
-        
-        if (xSemaphoreTake(xStateMutex, portMAX_DELAY) == pdTRUE) {
-            g_app_state.is_camera_initialized = true;
-            xSemaphoreGive(xStateMutex);
+        return err;
+    };
+
+    for (;;) {
+        xEventGroupWaitBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT | CAM_PREWARM_BIT | CAM_SNAPSHOT_BIT,
+                            pdFALSE, pdFALSE, portMAX_DELAY);
+        unsigned long requested_ms = millis();
+        // Только снимок: тот же путь включения, но после первого кадра камера сразу засыпает
+        bool single_shot = !(xEventGroupGetBits(xAppEventGroup) & (CAM_STREAM_REQUEST_BIT | CAM_PREWARM_BIT));
+        // Настройки этого включения уже прочитаны - запрос перенастройки не нужен
+        xEventGroupClearBits(xAppEventGroup, CAM_RECONFIG_BIT);
+        set_camera_initialized(false);
+
+        // Из standby без повторной инициализации, если позволяют настройки
+        CameraSettings cs = read_camera_settings();
+        bool warm = fits_driver(cs);
+        if (warm) {
+            if (xSemaphoreTake(xCameraMutex, portMAX_DELAY) == pdTRUE) {
+                apply_sensor_settings(cs, NULL);
+                xSemaphoreGive(xCameraMutex);
+            }
+        } else {
+            if (driver_ready) {
+                Serial.println("[CameraTask] Settings need new buffers or XCLK, re-initializing.");
+            }
+            if (init_driver(cs) != ESP_OK) {
+                deliver_snapshot();
+                xEventGroupClearBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT | CAM_PREWARM_BIT);
+                vTaskDelay(pdMS_TO_TICKS(2000));
+                continue;
+            }
+        }
+
+        start_capture(cs);
+        if (!single_shot) {
+            Serial.printf("[CameraTask] Camera %s. Signal sent.\n", warm ? "woken from standby" : "initialized");
+        }
+
+        // Время до первого кадра от запроса (задняя передача или клиент)
+        if (wait_next_frame()) {
+            uint32_t ttff_ms = millis() - requested_ms;
+            s_activation_stats.activations++;
+            s_activation_stats.last_ttff_ms = ttff_ms;
+            s_activation_stats.last_warm = warm;
+            Serial.printf("[CameraTask] First frame %lu ms after %s request (%s)\n", (unsigned long)ttff_ms,
+                          single_shot ? "snapshot" : "stream", warm ? "warm standby" : "cold init");
+        } else {
+            Serial.println("[CameraTask] No frame after activation!");
         }
+        deliver_snapshot();
+
+        while (xEventGroupGetBits(xAppEventGroup) & (CAM_STREAM_REQUEST_BIT | CAM_PREWARM_BIT)) {
+            EventBits_t bits = xEventGroupWaitBits(xAppEventGroup, CAM_RECONFIG_BIT | CAM_SNAPSHOT_BIT, pdFALSE, pdFALSE,
+                                                   pdMS_TO_TICKS(100));
+            // Снимок попал между перезапуском захвата и первым кадром
+            if (bits & CAM_SNAPSHOT_BIT) {
+                deliver_snapshot();
+            }
+            if (!(bits & CAM_RECONFIG_BIT)) {
+                continue;
+            }
+            s_reconfig_stats.in_progress = true;
+            xEventGroupClearBits(xAppEventGroup, CAM_RECONFIG_BIT);
+
+            // Перенастройка на ходу: сенсор через SCCB, драйвер - только если не хватает буферов или меняется XCLK
+            CameraSettings next = read_camera_settings();
+            unsigned long start_ms = millis();
+            bool live = fits_driver(next);
+            bool init_failed = false;
+            if (live) {
+                // Новый потолок для регулятора стрима. Разрешение и качество тогда пишет сам регулятор,
+                // оба и без сравнения с прежними настройками: в сенсоре могли стоять сниженные им значения.
+                bool reset_controller = next.frame_size != cs.frame_size || next.jpeg_quality != cs.jpeg_quality;
+                CameraSettings written = cs;
+                if (reset_controller) {
+                    written.frame_size = next.frame_size;
+                    written.jpeg_quality = next.jpeg_quality;
+                }
+                if (xSemaphoreTake(xCameraMutex, portMAX_DELAY) == pdTRUE) {
+                    apply_sensor_settings(next, &written);
+                    xSemaphoreGive(xCameraMutex);
+                }
+                if (reset_controller) {
+                    stream_controller_reset(next.frame_size, next.jpeg_quality, true);
+                }
+                ulTaskNotifyTake(pdTRUE, 0);
+            } else {
+                stop_capture();
+                init_failed = init_driver(next) != ESP_OK;
+                if (!init_failed) {
+                    start_capture(next);
+                }
+            }
+            cs = next;
+            bool ok = !init_failed && wait_next_frame();
 
-        xEventGroupSetBits(xAppEventGroup, CAM_INITIALIZED_BIT);
-        Serial.println("[CameraTask] Camera initialized. Signal sent.");
+            s_reconfig_stats.reconfigs++;
+            s_reconfig_stats.last_live = live;
+            s_reconfig_stats.last_ok = ok;
+            s_reconfig_stats.last_interruption_ms = millis() - start_ms;
+            s_reconfig_stats.in_progress = false;
+            Serial.printf("[CameraTask] Settings applied %s, stream interrupted %lu ms%s\n",
+                          live ? "live" : "by re-init", (unsigned long)s_reconfig_stats.last_interruption_ms,
+                          ok ? "" : " (FAILED)");
 
-        while (xEventGroupGetBits(xAppEventGroup) & CAM_STREAM_REQUEST_BIT) {
-            vTaskDelay(pdMS_TO_TICKS(100));
+            if (init_failed) {
+                // Камера не поднялась - снимаем запросы, следующее включение начнёт с полной инициализации
+                xEventGroupClearBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT | CAM_PREWARM_BIT);
+                break;
+            }
         }
 
-        if (xSemaphoreTake(xCameraMutex, portMAX_DELAY) == pdTRUE) 
-        {
-            xEventGroupClearBits(xAppEventGroup, CAM_INITIALIZED_BIT); 
+        stop_capture();
 
-            esp_camera_deinit();
+        // Standby: сенсор настроен, буферы остаются за драйвером, захват остановлен
+        if (driver_ready && xSemaphoreTake(xCameraMutex, portMAX_DELAY) == pdTRUE) {
+            sensor_t *s = esp_camera_sensor_get();
+            if (s) {
+                s->set_reg(s, OV5640_SYSTEM_CTROL0, 0xff, OV5640_POWER_DOWN);
+            }
             xSemaphoreGive(xCameraMutex);
         }
-        
-        if (xSemaphoreTake(xStateMutex, portMAX_DELAY) == pdTRUE) {
-            g_app_state.is_camera_initialized = false;
-            xSemaphoreGive(xStateMutex);
+
+        set_camera_initialized(false);
+        Serial.println("[CameraTask] Camera in standby.");
+    }
+}
+
+CameraActivationStats camera_get_activation_stats() {
+    return s_activation_stats;
+}
+
+CameraReconfigStats camera_get_reconfig_stats() {
+    return s_reconfig_stats;
+}
+
+// Запрос больше не ждёт, под xSnapshotMutex. Последний ушедший забирает ссылку результата
+// (отпустить после мьютекса) и снимает ещё не взятый камерой запрос.
+static frame_t *leave_snapshot_locked() {
+    if (--s_snapshot_waiters > 0) {
+        return NULL;
+    }
+    frame_t *frame = s_snapshot_frame;
+    s_snapshot_frame = NULL;
+    if (s_snapshot_pending && (xEventGroupClearBits(xAppEventGroup, CAM_SNAPSHOT_BIT) & CAM_SNAPSHOT_BIT)) {
+        s_snapshot_pending = false;
+    }
+    return frame;
+}
+
+SnapshotStatus camera_snapshot_start(SnapshotTicket *ticket, frame_t **frame) {
+    // Камера снимает - последний кадр из пула, без захвата и без xCameraMutex
+    *frame = frame_pool_acquire_latest();
+    if (!*frame) {
+        xSemaphoreTake(xSnapshotMutex, portMAX_DELAY);
+        if (s_snapshot_frame) {
+            *frame = frame_addref(s_snapshot_frame);
+        } else {
+            s_snapshot_waiters++;
+            ticket->gen = s_snapshot_gen;
+            if (!s_snapshot_pending) {
+                s_snapshot_pending = true;
+                xEventGroupSetBits(xAppEventGroup, CAM_SNAPSHOT_BIT);
+            }
         }
-        Serial.println("[CameraTask] Camera de-initialized.");
+        xSemaphoreGive(xSnapshotMutex);
+    }
+    if (*frame) {
+        s_snapshot_stats.cached++;
+        return SNAPSHOT_READY;
     }
+    ticket->start_ms = millis();
+    return SNAPSHOT_PENDING;
 }
 
-camera_fb_t* camera_get_one_frame() {
-    bool is_cam_init = false;
-    if (xSemaphoreTake(xStateMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        is_cam_init = g_app_state.is_camera_initialized;
-        xSemaphoreGive(xStateMutex);
+SnapshotStatus camera_snapshot_poll(SnapshotTicket *ticket, frame_t **frame) {
+    SnapshotStatus status = SNAPSHOT_PENDING;
+    frame_t *to_release = NULL;
+    uint32_t latency_ms = millis() - ticket->start_ms;
+    *frame = NULL;
+
+    xSemaphoreTake(xSnapshotMutex, portMAX_DELAY);
+    if (s_snapshot_gen != ticket->gen) {
+        *frame = s_snapshot_frame ? frame_addref(s_snapshot_frame) : NULL;
+        status = *frame ? SNAPSHOT_READY : SNAPSHOT_FAILED;
+        to_release = leave_snapshot_locked();
+    } else if (latency_ms > SNAPSHOT_TIMEOUT_MS) {
+        status = SNAPSHOT_FAILED;
+        to_release = leave_snapshot_locked();
     }
-    if (!is_cam_init) { return NULL; }
-    return esp_camera_fb_get();
-}
\ No newline at end of file
+    xSemaphoreGive(xSnapshotMutex);
+    frame_release(to_release);
+
+    if (status == SNAPSHOT_FAILED) {
+        s_snapshot_stats.failed++;
+        Serial.printf("[Snapshot] No frame after %lu ms\n", (unsigned long)latency_ms);
+    } else if (status == SNAPSHOT_READY) {
+        s_snapshot_stats.captured++;
+        s_snapshot_stats.last_capture_ms = latency_ms;
+        if (latency_ms > s_snapshot_stats.max_capture_ms) {
+            s_snapshot_stats.max_capture_ms = latency_ms;
+        }
+        if (latency_ms > SNAPSHOT_BUDGET_MS) {
+            Serial.printf("[Snapshot] Capture took %lu ms, budget %lu ms\n", (unsigned long)latency_ms,
+                          (unsigned long)SNAPSHOT_BUDGET_MS);
+        }
+    }
+    return status;
+}
+
+void camera_snapshot_cancel() {
+    xSemaphoreTake(xSnapshotMutex, portMAX_DELAY);
+    frame_t *to_release = leave_snapshot_locked();
+    xSemaphoreGive(xSnapshotMutex);
+    frame_release(to_release);
+}
+
+void camera_snapshot_on_ready(void (*hook)()) {
+    s_snapshot_hook = hook;
+}
+
+CameraSnapshotStats camera_get_snapshot_stats() {
+    return s_snapshot_stats;
+}
@@ -1,4 +1,63 @@
 #pragma once
 #include "esp_camera.h"
+#include "frame_pool.h"
 
-void camera_task(void *pvParameters);
\ No newline at end of file
+void camera_task(void *pvParameters);
+
+// Имя разрешения из настроек ("VGA", "XGA"...) известно камере.
+bool camera_resolution_supported(const char *name);
+
+// Включения камеры: время от запроса до первого кадра и путь (standby или полная инициализация).
+struct CameraActivationStats {
+    uint32_t activations;
+    uint32_t last_ttff_ms;
+    bool last_warm;
+};
+CameraActivationStats camera_get_activation_stats();
+
+// Перенастройка работающей камеры из POST /api/settings: live - через sensor_t без остановки драйвера,
+// иначе deinit/init. last_interruption_ms - от начала перенастройки до следующего кадра.
+// Отдаётся в GET /api/camera: POST не ждёт окончания перенастройки.
+struct CameraReconfigStats {
+    uint32_t reconfigs;
+    uint32_t last_interruption_ms;
+    bool last_live;
+    bool last_ok;
+    bool in_progress;
+};
+CameraReconfigStats camera_get_reconfig_stats();
+
+// Кадр для /api/snapshot без ожидания камеры. Если камера снимает - ссылка на последний кадр
+// пула сразу (SNAPSHOT_READY). Иначе запускается одиночный снимок (SNAPSHOT_PENDING): камера
+// просыпается, отдаёт первый свежий кадр и снова засыпает, а результат забирает
+// camera_snapshot_poll(). Несколько ожидающих запросов получают один и тот же кадр.
+// Парный вызов для кадра - frame_release(), для брошенного ожидания - camera_snapshot_cancel().
+// Вызывать из async_tcp.
+enum SnapshotStatus {
+    SNAPSHOT_READY,
+    SNAPSHOT_PENDING,
+    SNAPSHOT_FAILED, // Камера не ответила за 3 с
+};
+
+struct SnapshotTicket {
+    uint32_t gen;
+    unsigned long start_ms;
+};
+
+SnapshotStatus camera_snapshot_start(SnapshotTicket *ticket, frame_t **frame);
+SnapshotStatus camera_snapshot_poll(SnapshotTicket *ticket, frame_t **frame);
+void camera_snapshot_cancel();
+
+// Функция вызывается из camera_task, когда результат одиночного снимка готов. Не должна блокироваться.
+void camera_snapshot_on_ready(void (*hook)());
+
+// Снимки: cached - из кадра работающей камеры, captured - одиночным включением,
+// capture_ms - от запроса до кадра.
+struct CameraSnapshotStats {
+    uint32_t cached;
+    uint32_t captured;
+    uint32_t failed;
+    uint32_t last_capture_ms;
+    uint32_t max_capture_ms;
+};
+CameraSnapshotStats camera_get_snapshot_stats();
@@ -1,32 +1,41 @@
 #include "frame_grab_task.h"
 #include "state.h"
 #include "esp_camera.h"
-#include "freertos/queue.h"
+#include "frame_pool.h"
+#include "metrics.h"
+#include "esp_timer.h"
 
 extern EventGroupHandle_t xAppEventGroup;
-extern SemaphoreHandle_t xCameraMutex;
-extern QueueHandle_t xFrameQueue;
 
+// Единственный вызывающий esp_camera_fb_get(): кадр публикуется в пул,
+// потребители (стрим, снимок) берут на него ссылки.
 void frame_grab_task(void *pvParameters) {
     (void)pvParameters;
 
     for (;;) {
         xEventGroupWaitBits(xAppEventGroup, CAM_INITIALIZED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
 
-        camera_fb_t *fb = NULL;
+        // Все буферы на руках у читателей - ждём возврата, иначе fb_get заблокируется в драйвере
+        if (!frame_pool_reserve(pdMS_TO_TICKS(100))) {
+            continue;
+        }
 
-        if (xSemaphoreTake(xCameraMutex, portMAX_DELAY) == pdTRUE) {
-            if (xEventGroupGetBits(xAppEventGroup) & CAM_INITIALIZED_BIT) {
-                fb = esp_camera_fb_get();
-            }
-            xSemaphoreGive(xCameraMutex);
+        // Ожидание кадра (до периода кадра) идёт без xCameraMutex: иначе возврат буферов
+        // и настройка сенсора стоят в очереди за захватом. От deinit защищает занятый слот.
+        camera_fb_t *fb = NULL;
+        if (xEventGroupGetBits(xAppEventGroup) & CAM_INITIALIZED_BIT) {
+            int64_t wait_start_us = esp_timer_get_time();
+            fb = esp_camera_fb_get();
+            histogram_record(g_metric_fb_get_wait_us, (uint32_t)(esp_timer_get_time() - wait_start_us));
         }
 
         if (fb) {
-  
-            xQueueOverwrite(xFrameQueue, &fb);
+            counter_add(g_metric_frames_captured);
+            histogram_record(g_metric_frame_size_bytes, fb->len);
+            frame_pool_publish(fb);
         } else {
+            frame_pool_unreserve();
             vTaskDelay(pdMS_TO_TICKS(10));
         }
     }
-}
\ No newline at end of file
+}
@@ -1,10 +1,106 @@
 #include "parktronic_manager_task.h"
 #include <Arduino.h>
+#include <WiFi.h>
+#include "freertos/timers.h"
 #include "state.h"
 #include "config.h"
+#include "activation_fsm.h"
+#include "power_manager.h"
 #include "web/websocket_manager.h"
+#include "web/mjpeg_stream.h"
 
-const unsigned long GRACE_PERIOD_MS = 15000; 
+const unsigned long GRACE_PERIOD_MS = 15000;
+// Уровень на входе задней передачи должен продержаться столько без фронтов
+const unsigned long REVERSE_DEBOUNCE_MS = 20;
+
+// Биты уведомления задачи
+const uint32_t PM_NOTIFY_REVERSE  = (1 << 0); // Антидребезг завершён
+const uint32_t PM_NOTIFY_CLIENTS  = (1 << 1);
+const uint32_t PM_NOTIFY_SETTINGS = (1 << 2);
+const uint32_t PM_NOTIFY_GRACE    = (1 << 3);
+
+static TaskHandle_t s_task = NULL;
+static TimerHandle_t s_debounce_timer = NULL;
+static TimerHandle_t s_grace_timer = NULL;
+static volatile bool s_reverse_stable = false;
+
+static void notify(uint32_t bits) {
+    if (s_task) {
+        xTaskNotify(s_task, bits, eSetBits);
+    }
+}
+
+// Любой фронт перезапускает таймер антидребезга: пока контакт дребезжит, таймер не истекает
+static void IRAM_ATTR reverse_gear_isr() {
+    power_on_reverse_edge_isr();
+    BaseType_t woken = pdFALSE;
+    xTimerResetFromISR(s_debounce_timer, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Уведомляет и без смены уровня: дребезг без переключения тоже снимает пробуждение в ISR,
+// и задача должна взвести его заново
+static void debounce_timer_cb(TimerHandle_t timer) {
+    (void)timer;
+    s_reverse_stable = digitalRead(REVERSE_GEAR_PIN) == LOW;
+    notify(PM_NOTIFY_REVERSE);
+}
+
+static void grace_timer_cb(TimerHandle_t timer) {
+    (void)timer;
+    notify(PM_NOTIFY_GRACE);
+}
+
+static void on_ap_station_event(arduino_event_id_t event) {
+    (void)event;
+    notify(PM_NOTIFY_CLIENTS);
+}
+
+void parktronic_manager_notify_clients() {
+    notify(PM_NOTIFY_CLIENTS);
+}
+
+void parktronic_manager_notify_settings() {
+    notify(PM_NOTIFY_SETTINGS);
+}
+
+static void apply_actions(const ActivationActions &a, ActivationState prev, ActivationState next) {
+    if (prev != next) {
+        Serial.printf("[Parktronic] %s -> %s\n", activation_state_name(prev), activation_state_name(next));
+    }
+    if (a.stop_grace) {
+        xTimerStop(s_grace_timer, portMAX_DELAY);
+    }
+    if (a.start_grace) {
+        xTimerReset(s_grace_timer, portMAX_DELAY);
+    }
+    if (a.prewarm) {
+        // Камера стартует сразу, не дожидаясь клиента /ws_stream
+        xEventGroupSetBits(xAppEventGroup, CAM_PREWARM_BIT);
+    }
+    if (a.unprewarm) {
+        // Камера остаётся включённой, только пока её смотрят клиенты (CAM_STREAM_REQUEST_BIT)
+        xEventGroupClearBits(xAppEventGroup, CAM_PREWARM_BIT);
+    }
+    if (!a.activate && !a.deactivate) {
+        return;
+    }
+
+    if (xSemaphoreTake(xStateMutex, portMAX_DELAY) == pdTRUE) {
+        g_app_state.is_parktronic_active = a.activate;
+        xSemaphoreGive(xStateMutex);
+    }
+
+    if (a.activate) {
+        Serial.println("[Parktronic] Activating...");
+        digitalWrite(SENSORS_POWER_PIN, HIGH);
+        xEventGroupSetBits(xAppEventGroup, PARKTRONIC_ACTIVE_BIT);
+    } else {
+        Serial.println("[Parktronic] Deactivating...");
+        digitalWrite(SENSORS_POWER_PIN, LOW);
+        xEventGroupClearBits(xAppEventGroup, PARKTRONIC_ACTIVE_BIT | CAM_PREWARM_BIT);
+    }
+}
 
 void parktronic_manager_task(void *pvParameters) {
     (void)pvParameters;
@@ -13,48 +109,65 @@ void parktronic_manager_task(void *pvParameters) {
     pinMode(SENSORS_POWER_PIN, OUTPUT);
     digitalWrite(SENSORS_POWER_PIN, LOW);
 
-    unsigned long last_reverse_active_time = 0;
-    bool current_state_is_active = false;
+    s_debounce_timer = xTimerCreate("reverse_db", pdMS_TO_TICKS(REVERSE_DEBOUNCE_MS), pdFALSE, NULL, debounce_timer_cb);
+    s_grace_timer = xTimerCreate("grace", pdMS_TO_TICKS(GRACE_PERIOD_MS), pdFALSE, NULL, grace_timer_cb);
+    if (!s_debounce_timer || !s_grace_timer) {
+        Serial.println("[Parktronic] CRITICAL: Failed to create timers!");
+        vTaskDelete(NULL);
+    }
+
+    s_task = xTaskGetCurrentTaskHandle();
+    attachInterrupt(digitalPinToInterrupt(REVERSE_GEAR_PIN), reverse_gear_isr, CHANGE);
+    s_reverse_stable = digitalRead(REVERSE_GEAR_PIN) == LOW;
+    // Телефон в сети точки доступа не даёт уснуть, даже если страница ещё не открыта
+    WiFi.onEvent(on_ap_station_event, ARDUINO_EVENT_WIFI_AP_STACONNECTED);
+    WiFi.onEvent(on_ap_station_event, ARDUINO_EVENT_WIFI_AP_STADISCONNECTED);
+
+    ActivationFsm fsm;
+    activation_fsm_init(&fsm);
+    bool auto_start = false;
 
     Serial.println("Parktronic Manager task started");
 
+    // Без событий задача спит: первый проход оценивает состояние на старте
+    uint32_t events = PM_NOTIFY_SETTINGS;
     for (;;) {
-        bool is_reverse_gear_on = (digitalRead(REVERSE_GEAR_PIN) == LOW);
-        bool is_client_listening = (get_ws_clients_count() > 0);
-        bool auto_start_enabled = false;
-        
-        if (xSemaphoreTake(xStateMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-            auto_start_enabled = g_app_state.settings.auto_start;
-            xSemaphoreGive(xStateMutex);
+        if (events & PM_NOTIFY_SETTINGS) {
+            if (xSemaphoreTake(xStateMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
+                auto_start = g_app_state.settings.auto_start;
+                xSemaphoreGive(xStateMutex);
+            }
         }
 
-        bool should_be_active_now = (is_reverse_gear_on && auto_start_enabled) || is_client_listening;
+        ActivationInputs in;
+        in.reverse = s_reverse_stable;
+        in.clients = get_ws_clients_count() > 0;
+        in.auto_start = auto_start;
 
-        if (is_reverse_gear_on) {
-            last_reverse_active_time = millis();
+        ActivationState prev = fsm.state;
+        ActivationActions actions = activation_fsm_update(&fsm, in);
+        apply_actions(actions, prev, fsm.state);
+        if (events & PM_NOTIFY_REVERSE) {
+            power_reverse_settled(actions.prewarm);
         }
 
-        bool final_decision_is_active = should_be_active_now || (millis() - last_reverse_active_time < GRACE_PERIOD_MS);
-
-        if (final_decision_is_active != current_state_is_active) {
-            current_state_is_active = final_decision_is_active;
-
-            if (xSemaphoreTake(xStateMutex, portMAX_DELAY) == pdTRUE) {
-                g_app_state.is_parktronic_active = current_state_is_active;
-                xSemaphoreGive(xStateMutex);
-            }
+        // Таймер мог быть перезапущен после срабатывания: тогда уведомление устарело
+        if ((events & PM_NOTIFY_GRACE) && !xTimerIsTimerActive(s_grace_timer)) {
+            prev = fsm.state;
+            actions = activation_fsm_grace_expired(&fsm);
+            apply_actions(actions, prev, fsm.state);
+        }
 
-            if (current_state_is_active) {
-                Serial.println("[Parktronic] Activating...");
-                digitalWrite(SENSORS_POWER_PIN, HIGH);
-                xEventGroupSetBits(xAppEventGroup, PARKTRONIC_ACTIVE_BIT);
-            } else {
-                Serial.println("[Parktronic] Deactivating...");
-                digitalWrite(SENSORS_POWER_PIN, LOW);
-                xEventGroupClearBits(xAppEventGroup, PARKTRONIC_ACTIVE_BIT);
-            }
+        // Полная частота - пока идёт измерение или видео; без клиентов - сон
+        bool streaming = xEventGroupGetBits(xAppEventGroup) & CAM_STREAM_REQUEST_BIT;
+        bool has_clients = in.clients || get_stream_clients_count() > 0 || get_mjpeg_clients_count() > 0 ||
+                           WiFi.softAPgetStationNum() > 0;
+        if (activation_state_active(fsm.state) || streaming) {
+            power_set_state(POWER_ACTIVE, in.reverse);
+        } else {
+            power_set_state(has_clients ? POWER_IDLE_CLIENTS : POWER_IDLE, in.reverse);
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(50));
+
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
     }
-}
\ No newline at end of file
+}
@@ -1,2 +1,7 @@
 #pragma once
-void parktronic_manager_task(void *pvParameters);
\ No newline at end of file
+void parktronic_manager_task(void *pvParameters);
+
+// Изменилось число клиентов /ws, /ws_stream или /stream.mjpg.
+void parktronic_manager_notify_clients();
+// Изменились настройки (auto_start).
+void parktronic_manager_notify_settings();
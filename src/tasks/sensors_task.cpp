@@ -2,47 +2,108 @@
 #include <Arduino.h>
 #include "config.h"
 #include "state.h"
+#include "sensor_snapshot.h"
+#include "distance_filter.h"
+#include "crosstalk_filter.h"
+#include "metrics.h"
+#include "diagnostics.h"
+#include "flash_guard.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+#if SOC_MCPWM_SUPPORTED
+#include "driver/mcpwm.h"
+#endif
 
-volatile unsigned long t_rise[NUM_SENSORS] = {0};
-volatile unsigned long t_fall[NUM_SENSORS] = {0};
-volatile bool have_rise[NUM_SENSORS] = {false};
-volatile bool have_pulse[NUM_SENSORS] = {false};
-
-const int SMOOTH_LEN = 6;
-float smoothBuf[NUM_SENSORS][SMOOTH_LEN];
-int smoothIdx[NUM_SENSORS] = {0};
-bool initialFilled[NUM_SENSORS] = {false};
-
-void IRAM_ATTR echoChange0() {
-  if (digitalRead(SENSOR_PINS[0].echo) == HIGH) {
-    t_rise[0] = micros();
-    have_rise[0] = true;
-  } else if (have_rise[0]) {
-    t_fall[0] = micros();
-    have_pulse[0] = true;
-    have_rise[0] = false;
+// Событие захвата эха: ISR -> sensors_task через очередь
+struct EchoEvent {
+  uint8_t sensor;
+  uint32_t width_us;
+  int64_t rise_us; // esp_timer_get_time() в момент фронта, для окна относительно триггера
+};
+
+QueueHandle_t xEchoQueue = NULL;
+
+// Состояние захвата датчика, меняется в ISR. armed - ждём эхо после своего триггера.
+struct EchoCaptureState {
+  volatile bool armed;
+  volatile bool have_rise;
+  volatile uint32_t rise_ticks;
+  volatile int64_t rise_us;
+};
+EchoCaptureState echoState[NUM_SENSORS];
+uint32_t captureTicksPerUs = 1;
+
+DistanceFilterState filterState[NUM_SENSORS];
+DistanceFilterConfig filterConfig = distance_filter_default_config();
+
+static void IRAM_ATTR onEchoEdge(int idx, bool rising, uint32_t ticks, BaseType_t *woken) {
+  EchoCaptureState &st = echoState[idx];
+  if (!st.armed) {
+    return;
+  }
+  if (rising) {
+    st.rise_ticks = ticks;
+    st.rise_us = esp_timer_get_time();
+    st.have_rise = true;
+    return;
+  }
+  if (!st.have_rise) {
+    return;
+  }
+  st.armed = false;
+  st.have_rise = false;
+  EchoEvent ev = {(uint8_t)idx, (ticks - st.rise_ticks) / captureTicksPerUs, st.rise_us};
+  xQueueSendFromISR(xEchoQueue, &ev, woken);
+}
+
+#if SOC_MCPWM_SUPPORTED
+// Фронты защёлкивает таймер захвата MCPWM (такты APB): длительность точна,
+// даже если сам обработчик задержан прерываниями Wi-Fi.
+static bool IRAM_ATTR onEchoCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                                    const cap_event_data_t *edata, void *user_data) {
+  BaseType_t woken = pdFALSE;
+  onEchoEdge((int)(intptr_t)user_data, edata->cap_edge == MCPWM_POS_EDGE, edata->cap_value, &woken);
+  return woken == pdTRUE;
+}
+
+static bool initEchoCapture() {
+  static_assert(NUM_SENSORS <= SOC_MCPWM_CAPTURE_CHANNELS_PER_TIMER, "one MCPWM capture channel per sensor");
+  captureTicksPerUs = getApbFrequency() / 1000000;
+  for (int i = 0; i < NUM_SENSORS; ++i) {
+    mcpwm_capture_config_t conf = {};
+    conf.cap_edge = MCPWM_BOTH_EDGE;
+    conf.cap_prescale = 1;
+    conf.capture_cb = onEchoCapture;
+    conf.user_data = (void *)(intptr_t)i;
+    if (mcpwm_gpio_init(MCPWM_UNIT_0, (mcpwm_io_signals_t)(MCPWM_CAP_0 + i), SENSOR_PINS[i].echo) != ESP_OK ||
+        mcpwm_capture_enable_channel(MCPWM_UNIT_0, (mcpwm_capture_channel_id_t)(MCPWM_SELECT_CAP0 + i), &conf) != ESP_OK) {
+      return false;
+    }
   }
+  return true;
 }
-void IRAM_ATTR echoChange1() {
-  if (digitalRead(SENSOR_PINS[1].echo) == HIGH) {
-    t_rise[1] = micros();
-    have_rise[1] = true;
-  } else if (have_rise[1]) {
-    t_fall[1] = micros();
-    have_pulse[1] = true;
-    have_rise[1] = false;
+#else
+// Без MCPWM: обработчик на каждый датчик генерируется шаблоном, время фронта берётся в ISR.
+template <int I>
+void IRAM_ATTR echoIsr() {
+  BaseType_t woken = pdFALSE;
+  onEchoEdge(I, digitalRead(SENSOR_PINS[I].echo) == HIGH, (uint32_t)esp_timer_get_time(), &woken);
+  if (woken == pdTRUE) {
+    portYIELD_FROM_ISR();
   }
 }
-void IRAM_ATTR echoChange2() {
-  if (digitalRead(SENSOR_PINS[2].echo) == HIGH) {
-    t_rise[2] = micros();
-    have_rise[2] = true;
-  } else if (have_rise[2]) {
-    t_fall[2] = micros();
-    have_pulse[2] = true;
-    have_rise[2] = false;
+
+static void (*const ECHO_ISRS[])() = {echoIsr<0>, echoIsr<1>, echoIsr<2>};
+static_assert(sizeof(ECHO_ISRS) / sizeof(ECHO_ISRS[0]) == NUM_SENSORS, "one echo ISR per sensor");
+
+static bool initEchoCapture() {
+  captureTicksPerUs = 1;
+  for (int i = 0; i < NUM_SENSORS; ++i) {
+    attachInterrupt(digitalPinToInterrupt(SENSOR_PINS[i].echo), ECHO_ISRS[i], CHANGE);
   }
+  return true;
 }
+#endif
 
 void sendTriggerPin(uint8_t trigPin) {
   digitalWrite(trigPin, LOW);
@@ -56,24 +117,67 @@ float microsToCm(unsigned long us) {
   return (float)us / 58.0f;
 }
 
-float getSmoothedValue(int idx, float newValue) {
-    if (!initialFilled[idx]) {
-        for (int i = 0; i < SMOOTH_LEN; ++i) {
-            smoothBuf[idx][i] = newValue;
-        }
-        initialFilled[idx] = true;
+// Настройки фильтра меняются через веб-интерфейс. Если xStateMutex занят, работаем со старыми.
+// При смене настроек состояние фильтров сбрасывается.
+void refreshFilterConfig() {
+  if (xSemaphoreTake(xStateMutex, 0) != pdTRUE) {
+    return;
+  }
+  DistanceFilterConfig cfg;
+  cfg.type = (uint8_t)g_app_state.settings.filter_type;
+  cfg.median_len = (uint8_t)g_app_state.settings.filter_median;
+  cfg.alpha = g_app_state.settings.filter_alpha;
+  cfg.beta = g_app_state.settings.filter_beta;
+  xSemaphoreGive(xStateMutex);
+
+  if (!distance_filter_config_valid(cfg)) {
+    return;
+  }
+  if (cfg.type != filterConfig.type || cfg.median_len != filterConfig.median_len ||
+      cfg.alpha != filterConfig.alpha || cfg.beta != filterConfig.beta) {
+    filterConfig = cfg;
+    for (int i = 0; i < NUM_SENSORS; ++i) {
+      distance_filter_reset(&filterState[i]);
     }
+    Serial.printf("[Sensors] filter type %u, median %u, alpha %.2f, beta %.2f\n",
+                  cfg.type, cfg.median_len, cfg.alpha, cfg.beta);
+  }
+}
 
-    smoothBuf[idx][smoothIdx[idx]] = newValue;
-    smoothIdx[idx] = (smoothIdx[idx] + 1) % SMOOTH_LEN;
 
-    float sum = 0;
-    for (int i = 0; i < SMOOTH_LEN; ++i) {
-        sum += smoothBuf[idx][i];
-    }
-    return sum / (float)SMOOTH_LEN;
+// Группы одновременного запуска: несмежные датчики (левый и правый) стреляют вместе, центр - отдельно.
+const int FIRING_GROUPS[][2] = {{0, 2}, {1, -1}};
+const int NUM_FIRING_GROUPS = sizeof(FIRING_GROUPS) / sizeof(FIRING_GROUPS[0]);
+
+const unsigned long ECHO_TIMEOUT_US = 30000; // 400 см = 23.2 мс + сдвиг второго датчика
+const unsigned long ECHO_RISE_MAX_US = 2000; // Фронт эха после своего триггера не позже
+const int STAGGER_MS = 3;                    // Сдвиг второго датчика группы в нечётных циклах
+const int ECHO_DECAY_MS = 10;                // Пауза между группами: затухание отражений
+const float MAX_RANGE_CM = 400.0;
+
+int64_t t_trig[NUM_SENSORS] = {0};
+CrosstalkState crosstalkState[NUM_SENSORS];
+
+void fireSensor(int idx) {
+  echoState[idx].have_rise = false;
+  echoState[idx].armed = true;
+  sendTriggerPin(SENSOR_PINS[idx].trig);
+  t_trig[idx] = esp_timer_get_time();
 }
 
+// Сырое значение датчика или MAX_RANGE_CM, если эха нет или оно вне окна.
+float readEcho(int idx, const EchoEvent *ev) {
+  if (!ev) {
+    return MAX_RANGE_CM;
+  }
+  // Фронт должен прийти вскоре после своего триггера, иначе это хвост чужого измерения
+  if (ev->rise_us - t_trig[idx] > (int64_t)ECHO_RISE_MAX_US) {
+    return MAX_RANGE_CM;
+  }
+  float dist_cm = microsToCm(ev->width_us);
+  if (dist_cm > MAX_RANGE_CM) dist_cm = MAX_RANGE_CM;
+  return dist_cm;
+}
 
 void sensors_task(void *pvParameters) {
   (void)pvParameters;
@@ -83,57 +187,109 @@ void sensors_task(void *pvParameters) {
     digitalWrite(SENSOR_PINS[i].trig, LOW);
     pinMode(SENSOR_PINS[i].echo, INPUT);
   }
-  attachInterrupt(digitalPinToInterrupt(SENSOR_PINS[0].echo), echoChange0, CHANGE);
-  attachInterrupt(digitalPinToInterrupt(SENSOR_PINS[1].echo), echoChange1, CHANGE);
-  attachInterrupt(digitalPinToInterrupt(SENSOR_PINS[2].echo), echoChange2, CHANGE);
-  
+  xEchoQueue = xQueueCreate(NUM_SENSORS * 2, sizeof(EchoEvent));
+  if (!xEchoQueue || !initEchoCapture()) {
+    Serial.println("CRITICAL: Echo capture init failed!");
+    vTaskDelete(NULL);
+  }
   Serial.println("Sensors task started");
 
+  uint32_t cycle = 0;
+
   for (;;) {
     xEventGroupWaitBits(xAppEventGroup, PARKTRONIC_ACTIVE_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
 
+    uint32_t statCycles = 0;
+    unsigned long statStart = millis();
+    int64_t lastCycleUs = 0;
+    // История прошлого включения не подтверждает новые значения и не публикуется
+    for (int i = 0; i < NUM_SENSORS; ++i) {
+      distance_filter_reset(&filterState[i]);
+      crosstalk_reset(&crosstalkState[i], MAX_RANGE_CM);
+    }
+
     while (xEventGroupGetBits(xAppEventGroup) & PARKTRONIC_ACTIVE_BIT) {
       float measuredDistances[NUM_SENSORS];
+      bool stagger = (cycle & 1) != 0;
+      refreshFilterConfig();
+      // Период опроса каждого датчика равен периоду цикла
+      int64_t cycleUs = esp_timer_get_time();
+      float dt_s = lastCycleUs ? (cycleUs - lastCycleUs) / 1e6f : 0.0f;
+      if (lastCycleUs) {
+        histogram_record(g_metric_sweep_period_us, (uint32_t)(cycleUs - lastCycleUs));
+      }
+      lastCycleUs = cycleUs;
+      int64_t echoEndUs[NUM_SENSORS] = {0};
 
-      for (int i = 0; i < NUM_SENSORS; ++i) {
-        have_pulse[i] = false;
-        have_rise[i] = false;
+      for (int g = 0; g < NUM_FIRING_GROUPS; ++g) {
+        const int *group = FIRING_GROUPS[g];
 
-        sendTriggerPin(SENSOR_PINS[i].trig);
+        // Запись клипа во flash ждёт конца окна эха: при отключённом кэше фронт опоздает
+        flash_guard_take();
+        xQueueReset(xEchoQueue);
+        fireSensor(group[0]);
+        if (group[1] >= 0) {
+          if (stagger) {
+            vTaskDelay(pdMS_TO_TICKS(STAGGER_MS));
+          }
+          fireSensor(group[1]);
+        }
 
-        unsigned long startMs = millis();
-        bool pulse_received = false;
-        while (millis() - startMs < 50) { 
-          if (have_pulse[i]) {
-            pulse_received = true;
+        // Задача спит до события захвата или таймаута
+        EchoEvent echoes[NUM_SENSORS];
+        bool received[NUM_SENSORS] = {false};
+        int pending = (group[1] >= 0) ? 2 : 1;
+        int64_t deadline = esp_timer_get_time() + ECHO_TIMEOUT_US;
+        while (pending > 0) {
+          int64_t left_us = deadline - esp_timer_get_time();
+          EchoEvent ev;
+          if (left_us <= 0 || xQueueReceive(xEchoQueue, &ev, pdMS_TO_TICKS(left_us / 1000) + 1) != pdTRUE) {
             break;
           }
-          vTaskDelay(pdMS_TO_TICKS(1));
+          if (ev.sensor < NUM_SENSORS && !received[ev.sensor]) {
+            echoes[ev.sensor] = ev;
+            received[ev.sensor] = true;
+            pending--;
+          }
         }
+        flash_guard_give();
 
-        if (pulse_received) {
-          unsigned long duration = (t_fall[i] > t_rise[i]) ? (t_fall[i] - t_rise[i]) : 0;
-          float dist_cm = microsToCm(duration);
-          
-          if (dist_cm > 400.0) dist_cm = 400.0; 
-          
-          measuredDistances[i] = getSmoothedValue(i, dist_cm);
-
-        } else {
-          measuredDistances[i] = getSmoothedValue(i, 400.0); 
+        for (int k = 0; k < 2 && group[k] >= 0; ++k) {
+          int idx = group[k];
+          echoState[idx].armed = false;
+          if (received[idx]) {
+            echoEndUs[idx] = echoes[idx].rise_us + echoes[idx].width_us;
+          }
+          float raw = readEcho(idx, received[idx] ? &echoes[idx] : NULL);
+          // Датчик без пары в группе не слышит чужой запуск: подтверждение дало бы лишний цикл задержки
+          float accepted = (group[1] >= 0) ? crosstalk_accept(&crosstalkState[idx], raw, stagger ? 1 : 0) : raw;
+          measuredDistances[idx] = distance_filter_update(&filterState[idx], filterConfig, accepted, dt_s);
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(30));
+
+        vTaskDelay(pdMS_TO_TICKS(ECHO_DECAY_MS));
       }
 
-      if (xSemaphoreTake(xStateMutex, portMAX_DELAY) == pdTRUE) {
-        for(int i = 0; i < NUM_SENSORS; ++i) {
-          g_app_state.sensor_distances[i] = measuredDistances[i];
+      sensor_snapshot_publish(measuredDistances);
+      diagnostics_boot_mark(BOOT_FIRST_MEASUREMENT);
+      int64_t publishedUs = esp_timer_get_time();
+      for (int i = 0; i < NUM_SENSORS; ++i) {
+        if (echoEndUs[i]) {
+          histogram_record(g_metric_echo_latency_us[i], (uint32_t)(publishedUs - echoEndUs[i]));
         }
-        xSemaphoreGive(xStateMutex);
       }
+      cycle++;
 
-      vTaskDelay(pdMS_TO_TICKS(50));
+      statCycles++;
+      unsigned long elapsed = millis() - statStart;
+      if (elapsed >= 10000) {
+        // printf с %f берёт около 1 КБ стека - запас виден здесь и в /api/diagnostics
+        Serial.printf("[Sensors] cycle %lu ms (%.1f Hz), rejected L/C/R: %u/%u/%u, stack free %u B\n",
+                      elapsed / statCycles, statCycles * 1000.0f / elapsed,
+                      crosstalkState[0].rejected, crosstalkState[1].rejected, crosstalkState[2].rejected,
+                      (unsigned)uxTaskGetStackHighWaterMark(NULL));
+        statCycles = 0;
+        statStart = millis();
+      }
     }
   }
-}
\ No newline at end of file
+}
@@ -1,57 +1,53 @@
 #include "stream_task.h"
 #include <Arduino.h>
 #include "state.h"
-#include "esp_camera.h"
+#include "frame_pool.h"
+#include "stream_controller.h"
 #include "web/websocket_manager.h"
-
-extern SemaphoreHandle_t xCameraMutex;
-
-const size_t MAX_FRAME_SIZE_BYTES = 100 * 1024;
+#include "metrics.h"
+#include "esp_timer.h"
 
 void stream_task(void *pvParameters) {
     (void)pvParameters;
 
+    frame_pool_subscribe();
+    uint32_t last_seq = 0;
+
     for (;;) {
         xEventGroupWaitBits(xAppEventGroup, CAM_INITIALIZED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
 
         while (xEventGroupGetBits(xAppEventGroup) & CAM_INITIALIZED_BIT) {
-            
-            if (get_stream_clients_count() == 0) {
-                vTaskDelay(pdMS_TO_TICKS(100));
+            // Ждём публикации нового кадра от frame_grab_task
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+            frame_t *frame = frame_pool_acquire_latest();
+            if (!frame) {
                 continue;
             }
-
-            if (!is_stream_writable()) {
-                vTaskDelay(pdMS_TO_TICKS(10)); 
+            if (frame->seq == last_seq) {
+                frame_release(frame);
                 continue;
             }
+            last_seq = frame->seq;
 
-            camera_fb_t *fb = NULL;
-
-            if (xSemaphoreTake(xCameraMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-                fb = esp_camera_fb_get();
-                xSemaphoreGive(xCameraMutex);
+            // Регулятор видит каждый кадр камеры, кто бы его ни смотрел: /ws_stream или /stream.mjpg
+            stream_controller_on_frame(frame->fb->len);
+            if (get_stream_clients_count() == 0) {
+                frame_release(frame);
+                continue;
             }
-
-            if (fb) {
-                if (fb->len > MAX_FRAME_SIZE_BYTES) {
-                    Serial.printf("[StreamTask] Frame too large (%u bytes > %u), dropping.\n", fb->len, MAX_FRAME_SIZE_BYTES);
-                } else {
-                    broadcast_ws_stream(fb->buf, fb->len);
-                }
-
-                if (xSemaphoreTake(xCameraMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-                    esp_camera_fb_return(fb);
-                    xSemaphoreGive(xCameraMutex);
-                }
+            if (frame->fb->len > MAX_FRAME_SIZE_BYTES) {
+                Serial.printf("[StreamTask] Frame too large (%u bytes > %u), dropping.\n", (unsigned)frame->fb->len, (unsigned)MAX_FRAME_SIZE_BYTES);
+                counter_add(g_metric_frames_dropped_oversize);
             } else {
-                vTaskDelay(pdMS_TO_TICKS(10));
-                continue;
+                int64_t start_us = esp_timer_get_time();
+                broadcast_ws_stream(frame->fb, frame->seq);
+                histogram_record(g_metric_ws_stream_broadcast_us, (uint32_t)(esp_timer_get_time() - start_us));
             }
-            
-            vTaskDelay(pdMS_TO_TICKS(1)); 
+
+            frame_release(frame);
         }
 
         vTaskDelay(pdMS_TO_TICKS(100));
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,79 @@
+#include "connection_wake.h"
+#include <Arduino.h>
+#include "AsyncTCP.h"
+#include "lwip/tcpip.h"
+
+struct WakeSlot
+{
+    AsyncClient *client; // NULL - слот свободен
+    WakeGroup group;
+};
+
+static WakeSlot s_slots[MAX_WAKE_CONNECTIONS];
+static SemaphoreHandle_t s_wake_mutex = xSemaphoreCreateMutex();
+
+int connection_wake_add(AsyncClient *client, WakeGroup group)
+{
+    int slot = -1;
+    xSemaphoreTake(s_wake_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_WAKE_CONNECTIONS; ++i)
+    {
+        if (!s_slots[i].client)
+        {
+            s_slots[i].client = client;
+            s_slots[i].group = group;
+            slot = i;
+            break;
+        }
+    }
+    xSemaphoreGive(s_wake_mutex);
+    return slot;
+}
+
+void connection_wake_remove(int slot)
+{
+    if (slot < 0)
+    {
+        return;
+    }
+    xSemaphoreTake(s_wake_mutex, portMAX_DELAY);
+    s_slots[slot].client = NULL;
+    xSemaphoreGive(s_wake_mutex);
+}
+
+// Поток tcpip: PCB читается здесь, где его не может освободить закрытие соединения,
+// а слот - под мьютексом, пока onDisconnect не снял регистрацию.
+static void poll_connection(void *ctx)
+{
+    int slot = (int)(intptr_t)ctx;
+    xSemaphoreTake(s_wake_mutex, portMAX_DELAY);
+    tcp_pcb *pcb = s_slots[slot].client ? s_slots[slot].client->pcb() : NULL;
+    if (pcb && pcb->poll)
+    {
+        pcb->poll(pcb->callback_arg, pcb);
+    }
+    xSemaphoreGive(s_wake_mutex);
+}
+
+void connection_wake(int slot)
+{
+    if (slot >= 0)
+    {
+        // Очередь tcpip полна - соединение дождётся опроса AsyncTCP
+        tcpip_try_callback(poll_connection, (void *)(intptr_t)slot);
+    }
+}
+
+void connection_wake_group(WakeGroup group)
+{
+    for (int i = 0; i < MAX_WAKE_CONNECTIONS; ++i)
+    {
+        xSemaphoreTake(s_wake_mutex, portMAX_DELAY);
+        bool wake = s_slots[i].client && s_slots[i].group == group;
+        xSemaphoreGive(s_wake_mutex);
+        if (wake)
+        {
+            connection_wake(i);
+        }
+    }
+}
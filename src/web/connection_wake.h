@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+class AsyncClient;
+
+// Досрочный опрос соединения AsyncTCP из любой задачи. Ответ, вернувший RESPONSE_TRY_AGAIN,
+// библиотека заполняет снова только по ACK или опросу соединения раз в 500 мс. Опрос отсюда
+// проходит через поток tcpip в задачу async_tcp, как опрос по таймеру lwIP.
+const int MAX_WAKE_CONNECTIONS = 8;
+
+enum WakeGroup : uint8_t
+{
+    WAKE_MJPEG,
+    WAKE_SNAPSHOT,
+};
+
+// Регистрация на время ответа, из async_tcp. -1 - слотов нет: соединение обходится опросом AsyncTCP.
+int connection_wake_add(AsyncClient *client, WakeGroup group);
+void connection_wake_remove(int slot);
+
+// Не блокируются; лишний опрос безвреден.
+void connection_wake(int slot);
+void connection_wake_group(WakeGroup group);
@@ -0,0 +1,261 @@
+#include "mjpeg_stream.h"
+#include <Arduino.h>
+#include "ESPAsyncWebServer.h"
+#include "state.h"
+#include "frame_pool.h"
+#include "stream_controller.h"
+#include "websocket_manager.h"
+#include "esp_heap_caps.h"
+#include "connection_wake.h"
+#include "metrics.h"
+
+#define MJPEG_BOUNDARY "frame"
+
+// Состояние соединения. Слот занят, пока соединение открыто; освобождается в onDisconnect,
+// после которого библиотека больше не вызывает заполнение ответа.
+// Кадр копируется в буфер соединения (PSRAM): медленный клиент не держит буферы драйвера
+// камеры и не задерживает её остановку.
+struct MjpegClient
+{
+    uint32_t id; // 0 - слот свободен
+    int wake; // Слот connection_wake
+    bool waiting; // Последнее заполнение вернуло RESPONSE_TRY_AGAIN, под s_mjpeg_mutex
+    uint8_t *jpeg; // MAX_FRAME_SIZE_BYTES
+    size_t jpeg_len; // 0 - части в отправке нет
+    char part_header[112];
+    size_t header_len;
+    size_t part_len; // Заголовок части + JPEG + "\r\n"
+    size_t part_sent;
+    uint32_t last_seq;
+    uint32_t frames;
+    uint32_t dropped;
+    unsigned long start_ms;
+};
+
+static MjpegClient s_clients[MAX_MJPEG_CLIENTS];
+static uint32_t s_next_id = 0;
+static SemaphoreHandle_t s_mjpeg_mutex = xSemaphoreCreateMutex();
+
+int get_mjpeg_clients_count()
+{
+    int n = 0;
+    xSemaphoreTake(s_mjpeg_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_MJPEG_CLIENTS; ++i)
+    {
+        n += s_clients[i].id ? 1 : 0;
+    }
+    xSemaphoreGive(s_mjpeg_mutex);
+    return n;
+}
+
+int get_mjpeg_client_stats(MjpegClientStats *out, int max_count)
+{
+    int n = 0;
+    unsigned long now = millis();
+    xSemaphoreTake(s_mjpeg_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_MJPEG_CLIENTS && n < max_count; ++i)
+    {
+        const MjpegClient &c = s_clients[i];
+        if (c.id)
+        {
+            out[n].id = c.id;
+            out[n].frames = c.frames;
+            out[n].dropped = c.dropped;
+            out[n].duration_ms = now - c.start_ms;
+            n++;
+        }
+    }
+    xSemaphoreGive(s_mjpeg_mutex);
+    return n;
+}
+
+// Следующая часть: самый свежий кадр пула, если он новее отправленного
+static bool begin_part(MjpegClient *c)
+{
+    if (!(xEventGroupGetBits(xAppEventGroup) & CAM_INITIALIZED_BIT) || frame_pool_last_seq() == c->last_seq)
+    {
+        return false;
+    }
+    frame_t *frame = frame_pool_acquire_latest();
+    if (!frame)
+    {
+        return false;
+    }
+    if (frame->seq == c->last_seq)
+    {
+        frame_release(frame);
+        return false;
+    }
+    uint32_t skipped = c->last_seq ? frame->seq - c->last_seq - 1 : 0;
+    c->last_seq = frame->seq;
+    bool fits = frame->fb->len <= MAX_FRAME_SIZE_BYTES;
+    if (fits)
+    {
+        c->jpeg_len = frame->fb->len;
+        memcpy(c->jpeg, frame->fb->buf, c->jpeg_len);
+    }
+    int64_t captured_us = (int64_t)frame->fb->timestamp.tv_sec * 1000000 + frame->fb->timestamp.tv_usec;
+    frame_release(frame);
+
+    xSemaphoreTake(s_mjpeg_mutex, portMAX_DELAY);
+    c->dropped += skipped + (fits ? 0 : 1);
+    xSemaphoreGive(s_mjpeg_mutex);
+    if (!fits)
+    {
+        counter_add(g_metric_frames_dropped_oversize);
+        return false;
+    }
+    counter_add(g_metric_frames_sent);
+
+    c->header_len = snprintf(c->part_header, sizeof(c->part_header),
+                             "--" MJPEG_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n"
+                             "X-Timestamp: %lld\r\n\r\n",
+                             (unsigned)c->jpeg_len, (long long)captured_us);
+    c->part_len = c->header_len + c->jpeg_len + 2;
+    c->part_sent = 0;
+    return true;
+}
+
+static void set_waiting(MjpegClient *c, bool waiting)
+{
+    xSemaphoreTake(s_mjpeg_mutex, portMAX_DELAY);
+    c->waiting = waiting;
+    xSemaphoreGive(s_mjpeg_mutex);
+}
+
+// frame_grab_task: новый кадр будит соединения, ждущие его. Без этого RESPONSE_TRY_AGAIN
+// повторяется только по опросу AsyncTCP раз в 500 мс - около 2 кадров/с на свободном канале.
+static void on_frame_published()
+{
+    for (int i = 0; i < MAX_MJPEG_CLIENTS; ++i)
+    {
+        MjpegClient *c = &s_clients[i];
+        xSemaphoreTake(s_mjpeg_mutex, portMAX_DELAY);
+        bool wake = c->id && c->waiting;
+        c->waiting = false;
+        xSemaphoreGive(s_mjpeg_mutex);
+        if (wake)
+        {
+            connection_wake(c->wake);
+        }
+    }
+}
+
+// Заполнение ответа вызывается из задачи async_tcp при каждом ACK и опросе соединения.
+// Нового кадра нет - RESPONSE_TRY_AGAIN, следующую попытку вызовет публикация кадра.
+static size_t fill_stream(MjpegClient *c, uint8_t *buffer, size_t max_len)
+{
+    if (!c->jpeg_len)
+    {
+        // Отметка до проверки пула: кадр, опубликованный после неё, разбудит соединение
+        set_waiting(c, true);
+        if (!begin_part(c))
+        {
+            return RESPONSE_TRY_AGAIN;
+        }
+        set_waiting(c, false);
+    }
+
+    size_t n = 0;
+    while (n < max_len && c->part_sent < c->part_len)
+    {
+        const uint8_t *src;
+        size_t avail;
+        if (c->part_sent < c->header_len)
+        {
+            src = (const uint8_t *)c->part_header + c->part_sent;
+            avail = c->header_len - c->part_sent;
+        }
+        else if (c->part_sent < c->header_len + c->jpeg_len)
+        {
+            size_t off = c->part_sent - c->header_len;
+            src = c->jpeg + off;
+            avail = c->jpeg_len - off;
+        }
+        else
+        {
+            size_t off = c->part_sent - c->header_len - c->jpeg_len;
+            src = (const uint8_t *)"\r\n" + off;
+            avail = 2 - off;
+        }
+        size_t len = min(avail, max_len - n);
+        memcpy(buffer + n, src, len);
+        n += len;
+        c->part_sent += len;
+    }
+
+    if (c->part_sent == c->part_len)
+    {
+        c->jpeg_len = 0;
+        xSemaphoreTake(s_mjpeg_mutex, portMAX_DELAY);
+        c->frames++;
+        xSemaphoreGive(s_mjpeg_mutex);
+    }
+    return n;
+}
+
+static void handle_mjpeg_stream(AsyncWebServerRequest *request)
+{
+    uint8_t *jpeg = (uint8_t *)heap_caps_malloc(MAX_FRAME_SIZE_BYTES, MALLOC_CAP_SPIRAM);
+    if (!jpeg)
+    {
+        request->send(503, "text/plain", "Out of memory");
+        return;
+    }
+    MjpegClient *c = NULL;
+    xSemaphoreTake(s_mjpeg_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_MJPEG_CLIENTS; ++i)
+    {
+        if (s_clients[i].id == 0)
+        {
+            c = &s_clients[i];
+            memset(c, 0, sizeof(*c));
+            c->id = ++s_next_id;
+            c->jpeg = jpeg;
+            c->start_ms = millis();
+            break;
+        }
+    }
+    xSemaphoreGive(s_mjpeg_mutex);
+    if (!c)
+    {
+        heap_caps_free(jpeg);
+        request->send(503, "text/plain", "Too many MJPEG clients");
+        return;
+    }
+
+    // Кадр до подключения не отправляется: поток начинается с ближайшего нового
+    c->last_seq = frame_pool_last_seq();
+    c->wake = connection_wake_add(request->client(), WAKE_MJPEG);
+    Serial.printf("MJPEG client #%u connected\n", c->id);
+    update_stream_request();
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "multipart/x-mixed-replace; boundary=" MJPEG_BOUNDARY,
+        [c](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+        {
+            (void)index;
+            return fill_stream(c, buffer, maxLen);
+        });
+    response->addHeader("Cache-Control", "no-store");
+    request->onDisconnect([c]()
+    {
+        heap_caps_free(c->jpeg);
+        c->jpeg = NULL;
+        unsigned long duration_ms = millis() - c->start_ms;
+        Serial.printf("MJPEG client #%u disconnected (frames %u, dropped %u, %.1f fps)\n", c->id, c->frames,
+                      c->dropped, duration_ms ? c->frames * 1000.0f / duration_ms : 0.0f);
+        xSemaphoreTake(s_mjpeg_mutex, portMAX_DELAY);
+        c->id = 0;
+        xSemaphoreGive(s_mjpeg_mutex);
+        connection_wake_remove(c->wake);
+        update_stream_request();
+    });
+    request->send(response);
+}
+
+void init_mjpeg_stream(AsyncWebServer &server)
+{
+    server.on("/stream.mjpg", HTTP_GET, handle_mjpeg_stream);
+    frame_pool_on_publish(on_frame_published);
+}
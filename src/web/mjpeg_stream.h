@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+
+class AsyncWebServer;
+
+// GET /stream.mjpg: multipart/x-mixed-replace для клиентов без JavaScript (головные
+// устройства, встроенные браузеры, ffmpeg). Кадры берутся из пула, как у stream_task;
+// каждому соединению уходит только самый свежий кадр, пропущенные считаются.
+const int MAX_MJPEG_CLIENTS = 4;
+
+void init_mjpeg_stream(AsyncWebServer &server);
+
+int get_mjpeg_clients_count();
+
+// Счётчики соединения: frames - отправлено целиком, dropped - кадры пула, опубликованные
+// пока соединение отправляло предыдущий.
+struct MjpegClientStats
+{
+    uint32_t id;
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t duration_ms;
+};
+int get_mjpeg_client_stats(MjpegClientStats *out, int max_count);
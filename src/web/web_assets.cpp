@@ -0,0 +1,107 @@
+#include "web_assets.h"
+#include <Arduino.h>
+#include "ESPAsyncWebServer.h"
+
+#if __has_include("web_bundle_data.h")
+#include "web_bundle_data.h"
+#else
+// Сборка без scripts/web_bundle.py: весь UI из LittleFS
+#define WEB_BUNDLE_HASH "none"
+static const WebAsset WEB_BUNDLE[] = {{NULL, NULL, NULL, 0, NULL, false, false}};
+static const size_t WEB_BUNDLE_COUNT = 0;
+#endif
+
+static const WebAsset *find_asset(const String &url)
+{
+    const char *path = url == "/" ? "/index.html" : url.c_str();
+    for (size_t i = 0; i < WEB_BUNDLE_COUNT; ++i)
+    {
+        if (strcmp(WEB_BUNDLE[i].path, path) == 0)
+        {
+            return &WEB_BUNDLE[i];
+        }
+    }
+    return NULL;
+}
+
+static bool accepts_gzip(AsyncWebServerRequest *request)
+{
+    AsyncWebHeader *accept = request->getHeader("Accept-Encoding");
+    return accept && accept->value().indexOf("gzip") >= 0;
+}
+
+class WebBundleHandler : public AsyncWebHandler
+{
+public:
+    bool canHandle(AsyncWebServerRequest *request) override
+    {
+        const WebAsset *asset = request->method() == HTTP_GET ? find_asset(request->url()) : NULL;
+        if (!asset)
+        {
+            return false;
+        }
+        // Клиент без gzip получает UI из LittleFS (serveStatic), как до бандла. Страницы тоже:
+        // в бандле они ссылаются на сжатые файлы с хэшем, в LittleFS - на исходные имена.
+        if ((asset->gzip || !asset->immutable) && !accepts_gzip(request))
+        {
+            return false;
+        }
+        request->addInterestingHeader("If-None-Match");
+        request->addInterestingHeader("Accept-Encoding");
+        return true;
+    }
+
+    void handleRequest(AsyncWebServerRequest *request) override
+    {
+        const WebAsset *asset = find_asset(request->url());
+        if (!asset)
+        {
+            request->send(404);
+            return;
+        }
+        const char *cache_control = asset->immutable ? "public, max-age=31536000, immutable" : "no-cache";
+
+        AsyncWebHeader *if_none_match = request->getHeader("If-None-Match");
+        if (if_none_match && if_none_match->value() == asset->etag)
+        {
+            AsyncWebServerResponse *response = request->beginResponse(304);
+            response->addHeader("ETag", asset->etag);
+            response->addHeader("Cache-Control", cache_control);
+            request->send(response);
+            return;
+        }
+
+        // Отдача прямо из flash: без LittleFS и без копии файла в RAM
+        AsyncWebServerResponse *response = request->beginResponse_P(200, asset->content_type, asset->data, asset->len);
+        if (asset->gzip)
+        {
+            response->addHeader("Content-Encoding", "gzip");
+        }
+        response->addHeader("ETag", asset->etag);
+        response->addHeader("Cache-Control", cache_control);
+        response->addHeader("Vary", "Accept-Encoding");
+        request->send(response);
+    }
+
+    bool isRequestHandlerTrivial() override
+    {
+        return true;
+    }
+};
+
+void init_web_assets(AsyncWebServer &server)
+{
+    if (WEB_BUNDLE_COUNT == 0)
+    {
+        Serial.println("[Web] No UI bundle in firmware, serving UI from LittleFS");
+        return;
+    }
+    size_t bytes = 0;
+    for (size_t i = 0; i < WEB_BUNDLE_COUNT; ++i)
+    {
+        bytes += WEB_BUNDLE[i].immutable ? 0 : WEB_BUNDLE[i].len;
+    }
+    server.addHandler(new WebBundleHandler());
+    Serial.printf("[Web] UI bundle %s: %u routes, %u bytes in flash\n", WEB_BUNDLE_HASH, (unsigned)WEB_BUNDLE_COUNT,
+                  (unsigned)bytes);
+}
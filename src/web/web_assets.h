@@ -0,0 +1,20 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+class AsyncWebServer;
+
+// Файл UI из бандла прошивки (scripts/web_bundle.py). Данные лежат во flash.
+struct WebAsset {
+    const char *path;         // "/index.html" или "/app.3f2a9c1e.js"
+    const char *content_type;
+    const uint8_t *data;
+    size_t len;
+    const char *etag;         // В кавычках, как в заголовке
+    bool gzip;                // data сжаты, отдаются с Content-Encoding: gzip
+    bool immutable;           // Имя с хэшем содержимого - кэшируется навсегда
+};
+
+// Обработчик бандла регистрируется раньше serveStatic: файлы, которых нет в бандле
+// (или сборка без бандла), по-прежнему отдаются из LittleFS.
+void init_web_assets(AsyncWebServer &server);
@@ -1,16 +1,26 @@
 #include "web_server.h"
 #include "ESPAsyncWebServer.h"
 #include <LittleFS.h>
-#include <ArduinoJson.h>
 #include "state.h"
 #include "config.h"
 #include "settings_manager.h"
+#include "settings_schema.h"
 #include "tasks/camera_task.h"
+#include "tasks/parktronic_manager_task.h"
 #include "websocket_manager.h"
+#include "web_assets.h"
+#include "mjpeg_stream.h"
+#include "connection_wake.h"
 #include "esp_camera.h"
+#include "frame_pool.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "diagnostics.h"
+#include "power_manager.h"
+#include "recorder.h"
+#include "clip_store.h"
 
 AsyncWebServer server(80);
-extern SemaphoreHandle_t xCameraMutex;
 
 void onNotFound(AsyncWebServerRequest *request)
 {
@@ -19,34 +29,12 @@ void onNotFound(AsyncWebServerRequest *request)
 
 void handle_get_settings(AsyncWebServerRequest *request)
 {
-    AsyncResponseStream *response = request->beginResponseStream("application/json");
-    DynamicJsonDocument doc(2048);
-
+    AppSettings settings;
+    bool is_muted;
     if (xSemaphoreTake(xStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
     {
-        doc["thresh_yellow"] = g_app_state.settings.thresh_yellow;
-        doc["thresh_orange"] = g_app_state.settings.thresh_orange;
-        doc["thresh_red"] = g_app_state.settings.thresh_red;
-        doc["bpm_min"] = g_app_state.settings.bpm_min;
-        doc["bpm_max"] = g_app_state.settings.bpm_max;
-        doc["auto_start"] = g_app_state.settings.auto_start;
-        doc["show_grid"] = g_app_state.settings.show_grid;
-        doc["cam_angle"] = g_app_state.settings.cam_angle;
-        doc["grid_opacity"] = g_app_state.settings.grid_opacity;
-        doc["grid_offset_x"] = g_app_state.settings.grid_offset_x;
-        doc["grid_offset_y"] = g_app_state.settings.grid_offset_y;
-        doc["grid_offset_z"] = g_app_state.settings.grid_offset_z;
-        doc["resolution"] = g_app_state.settings.resolution;
-        doc["jpeg_quality"] = g_app_state.settings.jpeg_quality;
-        doc["flip_h"] = g_app_state.settings.flip_h;
-        doc["flip_v"] = g_app_state.settings.flip_v;
-        doc["is_muted"] = g_app_state.is_muted;
-        doc["volume"] = g_app_state.settings.volume;
-        doc["beep_freq"] = g_app_state.settings.beep_freq;
-        doc["rotation"] = g_app_state.settings.rotation;
-        doc["xclk_freq"] = g_app_state.settings.xclk_freq;
-        doc["wifi_ssid"] = g_app_state.settings.wifi_ssid;
-        doc["wifi_pass"] = g_app_state.settings.wifi_pass;
+        settings = g_app_state.settings;
+        is_muted = g_app_state.is_muted;
         xSemaphoreGive(xStateMutex);
     }
     else
@@ -55,147 +43,59 @@ void handle_get_settings(AsyncWebServerRequest *request)
         return;
     }
 
-    Serial.println("Sending settings JSON:");
-    serializeJsonPretty(doc, Serial);
-    Serial.println();
-
-    serializeJson(doc, *response);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->write('{');
+    settings_write_json_fields(*response, settings);
+    response->write(is_muted ? ",\"is_muted\":true}" : ",\"is_muted\":false}");
     request->send(response);
 }
 
 void handle_settings_reset(AsyncWebServerRequest *request) {
     settings_reset_to_default();
+    parktronic_manager_notify_settings();
     request->send(200, "text/plain", "OK. Settings have been reset.");
 }
 
-void handle_post_settings(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+// Тело разбирается по мере поступления кусками; состояние разбора - в _tempObject запроса
+// (освобождается сервером вместе с запросом).
+void handle_post_settings_body(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
 {
-    if (index + len != total)
-        return;
-
-    Serial.print("Received JSON: ");
-    Serial.write(data, len);
-    Serial.println();
-
-    DynamicJsonDocument doc(2048);
-    DeserializationError error = deserializeJson(doc, data, len);
-
-    if (error)
+    SettingsParser *parser = (SettingsParser *)request->_tempObject;
+    if (index == 0 && !parser)
     {
-        request->send(400, "text/plain", "Invalid JSON");
-        return;
-    }
-
-    if (doc.containsKey("wifi_ssid"))
-    {
-        const char *ssid = doc["wifi_ssid"];
-        if (!ssid || strlen(ssid) == 0 || strlen(ssid) > 31)
+        parser = (SettingsParser *)malloc(sizeof(SettingsParser));
+        if (!parser)
         {
-            request->send(400, "text/plain", "Invalid wifi_ssid: must be 1-31 chars long and not null.");
             return;
         }
+        settings_parser_begin(parser);
+        request->_tempObject = parser;
     }
-
-    if (doc.containsKey("wifi_pass"))
+    if (parser)
     {
-        const char *pass = doc["wifi_pass"];
-        if (pass && strlen(pass) > 0 && strlen(pass) < 8)
-        {
-            request->send(400, "text/plain", "Invalid wifi_pass: must be null or >= 8 chars long.");
-            return;
-        }
+        settings_parser_feed(parser, (const char *)data, len);
     }
+}
 
-    if (doc.containsKey("jpeg_quality"))
+void handle_post_settings(AsyncWebServerRequest *request)
+{
+    SettingsParser *parser = (SettingsParser *)request->_tempObject;
+    if (!parser)
     {
-        int quality = doc["jpeg_quality"];
-        if (quality < 0 || quality > 63)
-        {
-            request->send(400, "text/plain", "Invalid jpeg_quality: must be between 0 and 63.");
-            return;
-        }
+        request->send(400, "text/plain", "Invalid JSON");
+        return;
     }
-
-    if (doc.containsKey("xclk_freq"))
+    if (!settings_parser_finish(parser))
     {
-        int freq = doc["xclk_freq"];
-        if (freq < 10 || freq > 24)
-        {
-            request->send(400, "text/plain", "Invalid xclk_freq: must be between 10 and 24.");
-            return;
-        }
+        request->send(400, "text/plain", parser->error);
+        return;
     }
 
+    char err[96];
+    bool applied;
     if (xSemaphoreTake(xStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
     {
-        if (doc.containsKey("thresh_yellow"))
-            g_app_state.settings.thresh_yellow = doc["thresh_yellow"];
-        if (doc.containsKey("thresh_orange"))
-            g_app_state.settings.thresh_orange = doc["thresh_orange"];
-        if (doc.containsKey("thresh_red"))
-            g_app_state.settings.thresh_red = doc["thresh_red"];
-        if (doc.containsKey("bpm_min"))
-            g_app_state.settings.bpm_min = doc["bpm_min"];
-        if (doc.containsKey("bpm_max"))
-            g_app_state.settings.bpm_max = doc["bpm_max"];
-        if (doc.containsKey("auto_start"))
-            g_app_state.settings.auto_start = doc["auto_start"];
-        if (doc.containsKey("show_grid"))
-            g_app_state.settings.show_grid = doc["show_grid"];
-        if (doc.containsKey("cam_angle"))
-            g_app_state.settings.cam_angle = doc["cam_angle"];
-        if (doc.containsKey("grid_opacity"))
-            g_app_state.settings.grid_opacity = doc["grid_opacity"];
-        if (doc.containsKey("grid_offset_x"))
-            g_app_state.settings.grid_offset_x = doc["grid_offset_x"];
-        if (doc.containsKey("grid_offset_y"))
-            g_app_state.settings.grid_offset_y = doc["grid_offset_y"];
-        if (doc.containsKey("grid_offset_z"))
-            g_app_state.settings.grid_offset_z = doc["grid_offset_z"];
-        if (doc.containsKey("jpeg_quality"))
-            g_app_state.settings.jpeg_quality = doc["jpeg_quality"];
-        if (doc.containsKey("flip_h"))
-            g_app_state.settings.flip_h = doc["flip_h"];
-        if (doc.containsKey("flip_v"))
-            g_app_state.settings.flip_v = doc["flip_v"];
-        if (doc.containsKey("volume"))
-            g_app_state.settings.volume = doc["volume"];
-        if (doc.containsKey("beep_freq"))
-            g_app_state.settings.beep_freq = doc["beep_freq"];
-        if (doc.containsKey("rotation"))
-            g_app_state.settings.rotation = doc["rotation"];
-        if (doc.containsKey("xclk_freq"))
-            g_app_state.settings.xclk_freq = doc["xclk_freq"];
-
-        if (doc.containsKey("resolution"))
-        {
-            const char *res_str = doc["resolution"];
-            if (res_str)
-            {
-                strlcpy(g_app_state.settings.resolution, res_str, sizeof(g_app_state.settings.resolution));
-            }
-        }
-        if (doc.containsKey("wifi_ssid"))
-        {
-            const char *ssid_str = doc["wifi_ssid"];
-            if (ssid_str)
-            {
-                strlcpy(g_app_state.settings.wifi_ssid, ssid_str, sizeof(g_app_state.settings.wifi_ssid));
-            }
-        }
-        if (doc.containsKey("wifi_pass"))
-        {
-            const char *pass_str = doc["wifi_pass"];
-            if (pass_str)
-            {
-                strlcpy(g_app_state.settings.wifi_pass, pass_str, sizeof(g_app_state.settings.wifi_pass));
-            }
-            else
-            {
-                g_app_state.settings.wifi_pass[0] = '\0';
-            }
-        }
-
+        applied = settings_apply(parser, &g_app_state.settings, err, sizeof(err));
         xSemaphoreGive(xStateMutex);
     }
     else
@@ -203,15 +103,30 @@ void handle_post_settings(AsyncWebServerRequest *request, uint8_t *data, size_t
         request->send(503, "text/plain", "Service Unavailable");
         return;
     }
-
-    if (settings_save())
+    if (!applied)
     {
-        request->send(200, "text/plain", "OK");
+        request->send(400, "text/plain", err);
+        return;
     }
-    else
+
+    parktronic_manager_notify_settings();
+
+    if (!settings_save())
     {
         request->send(500, "text/plain", "Failed to save settings");
+        return;
+    }
+
+    // Работающая камера перенастраивается в camera_task; ответ не ждёт её (async_tcp не блокируется),
+    // способ и длительность паузы стрима - в GET /api/camera
+    if (settings_parser_has_flag(parser, SETTING_APPLY_CAMERA) && (xEventGroupGetBits(xAppEventGroup) & CAM_INITIALIZED_BIT))
+    {
+        xEventGroupSetBits(xAppEventGroup, CAM_RECONFIG_BIT);
+        request->send(200, "text/plain", "OK. Camera settings are being applied, see /api/camera");
+        return;
     }
+
+    request->send(200, "text/plain", "OK");
 }
 
 void handle_mute_toggle(AsyncWebServerRequest *request) {
@@ -222,81 +137,252 @@ void handle_mute_toggle(AsyncWebServerRequest *request) {
     request->send(200, "text/plain", "OK");
 }
 
+// Одиночный снимок в ожидании кадра от camera_task
+struct SnapshotWait
+{
+    SnapshotTicket ticket;
+    frame_t *frame;
+    bool done; // Ожидание закончено: кадр получен или камера не ответила
+    int wake; // Слот connection_wake
+};
+
+static void wake_snapshot_waiters()
+{
+    connection_wake_group(WAKE_SNAPSHOT);
+}
+
 void handle_snapshot(AsyncWebServerRequest *request)
 {
-    camera_fb_t *fb = NULL;
-    bool stream_was_active = (xEventGroupGetBits(xAppEventGroup) & CAM_INITIALIZED_BIT) != 0;
+    // Работающая камера - кадр из пула; спящая - одиночный снимок без запуска стрима
+    SnapshotTicket ticket;
+    frame_t *frame = NULL;
+    if (camera_snapshot_start(&ticket, &frame) == SNAPSHOT_READY)
+    {
+        // Отдаём кадр без копирования; ссылка живёт до закрытия соединения
+        AsyncWebServerResponse *response = request->beginResponse("image/jpeg", frame->fb->len,
+            [frame](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+            {
+                size_t len = min(maxLen, frame->fb->len - index);
+                memcpy(buffer, frame->fb->buf + index, len);
+                return len;
+            });
+        int64_t captured_us = (int64_t)frame->fb->timestamp.tv_sec * 1000000 + frame->fb->timestamp.tv_usec;
+        response->addHeader("Cache-Control", "no-store");
+        response->addHeader("X-Frame-Source", "cache");
+        response->addHeader("X-Frame-Age-Ms", String((long)((esp_timer_get_time() - captured_us) / 1000)));
+        request->onDisconnect([frame]() { frame_release(frame); });
+        request->send(response);
+        return;
+    }
 
-    // Шаг 1: Включаем камеру, если она выключена
-    if (!stream_was_active)
+    // Камера спит: снимок занимает 100-650 мс, и async_tcp его не ждёт. Заголовки уходят сразу,
+    // тело - chunked: RESPONSE_TRY_AGAIN, пока camera_task не передаст кадр (и не разбудит соединение).
+    // Камера не ответила - соединение закрывается без тела.
+    SnapshotWait *wait = new SnapshotWait{ticket, NULL, false, connection_wake_add(request->client(), WAKE_SNAPSHOT)};
+    AsyncWebServerResponse *response = request->beginChunkedResponse("image/jpeg",
+        [wait, request](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+        {
+            if (!wait->done)
+            {
+                if (camera_snapshot_poll(&wait->ticket, &wait->frame) == SNAPSHOT_PENDING)
+                {
+                    return RESPONSE_TRY_AGAIN;
+                }
+                wait->done = true;
+            }
+            if (!wait->frame)
+            {
+                request->client()->close();
+                return 0;
+            }
+            size_t len = min(maxLen, wait->frame->fb->len - index);
+            memcpy(buffer, wait->frame->fb->buf + index, len);
+            return len;
+        });
+    response->addHeader("Cache-Control", "no-store");
+    response->addHeader("X-Frame-Source", "capture");
+    request->onDisconnect([wait]()
     {
-        xEventGroupSetBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
-        EventBits_t bits = xEventGroupWaitBits(xAppEventGroup, CAM_INITIALIZED_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(2000));
-        if ((bits & CAM_INITIALIZED_BIT) == 0)
+        connection_wake_remove(wait->wake);
+        if (!wait->done)
         {
-            xEventGroupClearBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
-            request->send(503, "text/plain", "Camera snapshot timeout");
-            return;
+            camera_snapshot_cancel();
         }
-    }
+        frame_release(wait->frame);
+        delete wait;
+    });
+    request->send(response);
+}
 
-    // Шаг 2: Безопасно получаем кадр с помощью мьютекса
-    if (xSemaphoreTake(xCameraMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
+void handle_metrics(AsyncWebServerRequest *request)
+{
+    // По умолчанию - текстовый формат Prometheus, ?format=json - для UI и отладки
+    bool json = request->hasParam("format") && request->getParam("format")->value() == "json";
+    AsyncResponseStream *response =
+        request->beginResponseStream(json ? "application/json" : "text/plain; version=0.0.4");
+    response->addHeader("Cache-Control", "no-store");
+    if (json)
     {
-        fb = esp_camera_fb_get();
-        xSemaphoreGive(xCameraMutex);
+        metrics_write_json(*response);
     }
     else
     {
-        // Не удалось получить доступ к камере, она может быть занята
-        request->send(503, "text/plain", "Camera is busy, try again");
-        // Выключаем камеру, если мы ее включили
-        if (!stream_was_active && get_stream_clients_count() == 0)
-        {
-            xEventGroupClearBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
-        }
-        return;
+        metrics_write_prometheus(*response);
     }
+    request->send(response);
+}
+
+void handle_diagnostics(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-store");
+    diagnostics_write_json(*response);
+    request->send(response);
+}
+
+void handle_power(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-store");
+    power_write_json(*response);
+    request->send(response);
+}
+
+void handle_camera(AsyncWebServerRequest *request)
+{
+    EventBits_t bits = xEventGroupGetBits(xAppEventGroup);
+    CameraActivationStats activation = camera_get_activation_stats();
+    CameraReconfigStats reconfig = camera_get_reconfig_stats();
+    CameraSnapshotStats snapshot = camera_get_snapshot_stats();
 
-    // Шаг 3: Выключаем камеру, если мы ее включили и больше нет "зрителей"
-    if (!stream_was_active)
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-store");
+    response->printf("{\"running\":%s,\"activation\":{\"count\":%u,\"last_ttff_ms\":%u,\"last_warm\":%s},",
+                     (bits & CAM_INITIALIZED_BIT) ? "true" : "false", (unsigned)activation.activations,
+                     (unsigned)activation.last_ttff_ms, activation.last_warm ? "true" : "false");
+    response->printf("\"reconfig\":{\"count\":%u,\"pending\":%s,\"last_live\":%s,\"last_ok\":%s,"
+                     "\"last_interruption_ms\":%u},",
+                     (unsigned)reconfig.reconfigs,
+                     (reconfig.in_progress || (bits & CAM_RECONFIG_BIT)) ? "true" : "false",
+                     reconfig.last_live ? "true" : "false", reconfig.last_ok ? "true" : "false",
+                     (unsigned)reconfig.last_interruption_ms);
+    response->printf("\"snapshot\":{\"cached\":%u,\"captured\":%u,\"failed\":%u,\"last_capture_ms\":%u,"
+                     "\"max_capture_ms\":%u}}",
+                     (unsigned)snapshot.cached, (unsigned)snapshot.captured, (unsigned)snapshot.failed,
+                     (unsigned)snapshot.last_capture_ms, (unsigned)snapshot.max_capture_ms);
+    request->send(response);
+}
+
+void handle_stream_stats(AsyncWebServerRequest *request)
+{
+    StreamClientStats ws_stats[MAX_STREAM_CLIENTS];
+    MjpegClientStats mjpeg_stats[MAX_MJPEG_CLIENTS];
+    int ws_count = get_stream_client_stats(ws_stats, MAX_STREAM_CLIENTS);
+    int mjpeg_count = get_mjpeg_client_stats(mjpeg_stats, MAX_MJPEG_CLIENTS);
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-store");
+    response->print("{\"ws\":[");
+    for (int i = 0; i < ws_count; ++i)
     {
-        if (get_stream_clients_count() == 0)
-        {
-            xEventGroupClearBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
-        }
+        response->printf("%s{\"id\":%u,\"delivered\":%u,\"dropped\":%u,\"pending\":%u}", i ? "," : "",
+                         (unsigned)ws_stats[i].id, (unsigned)ws_stats[i].delivered, (unsigned)ws_stats[i].dropped,
+                         (unsigned)ws_stats[i].pending);
+    }
+    response->print("],\"mjpeg\":[");
+    for (int i = 0; i < mjpeg_count; ++i)
+    {
+        const MjpegClientStats &m = mjpeg_stats[i];
+        float fps = m.duration_ms ? m.frames * 1000.0f / m.duration_ms : 0.0f;
+        response->printf("%s{\"id\":%u,\"frames\":%u,\"dropped\":%u,\"fps\":%.1f}", i ? "," : "",
+                         (unsigned)m.id, (unsigned)m.frames, (unsigned)m.dropped, fps);
     }
+    response->print("]}");
+    request->send(response);
+}
+
+void handle_recorder(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-store");
+    recorder_write_json(*response);
+    request->send(response);
+}
 
-    // Шаг 4: Отправляем кадр и безопасно возвращаем буфер
-    if (!fb)
+void handle_recorder_trigger(AsyncWebServerRequest *request)
+{
+    switch (recorder_trigger())
     {
-        request->send(503, "text/plain", "Failed to get frame");
+    case RECORDER_TRIGGERED:
+        request->send(200, "text/plain", "OK");
+        break;
+    case RECORDER_BUSY:
+        request->send(409, "text/plain", "Recording in progress");
+        break;
+    default:
+        request->send(503, "text/plain", "Recorder disabled");
+        break;
     }
-    else
+}
+
+void handle_recorder_clip(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("id"))
+    {
+        request->send(400, "text/plain", "Missing id");
+        return;
+    }
+    ClipReader *reader = new ClipReader;
+    if (!clip_reader_open(reader, request->getParam("id")->value().toInt()))
     {
-        request->send_P(200, "image/jpeg", (const uint8_t *)fb->buf, fb->len);
+        delete reader;
+        request->send(404, "text/plain", "Clip not found");
+        return;
+    }
 
-        // Безопасно возвращаем буфер
-        if (xSemaphoreTake(xCameraMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
+    // Клип читается с flash по индексу порциями под размер TCP-окна. Затёртый во время
+    // выгрузки клип обрывается закрытием соединения: ответ с Content-Length, вернувший 0
+    // раньше конца, иначе висит до таймаута клиента, а тот не узнаёт, что файл неполный.
+    AsyncWebServerResponse *response = request->beginResponse("application/octet-stream", reader->clip.bytes,
+        [request, reader](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
         {
-            esp_camera_fb_return(fb);
-            xSemaphoreGive(xCameraMutex);
-        }
-    }
+            size_t n = clip_reader_read(reader, index, buffer, maxLen);
+            if (n == 0 && index < reader->clip.bytes)
+            {
+                Serial.printf("[Rec] Clip #%u overwritten during download at %u of %u bytes\n",
+                              (unsigned)reader->clip.id, (unsigned)index, (unsigned)reader->clip.bytes);
+                request->client()->close();
+            }
+            return n;
+        });
+    char disposition[64];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"clip_%u.bin\"", (unsigned)reader->clip.id);
+    response->addHeader("Content-Disposition", disposition);
+    response->addHeader("Cache-Control", "no-store");
+    request->onDisconnect([reader]() { delete reader; });
+    request->send(response);
 }
 
 void init_web_server() {
     init_websockets(server);
+    camera_snapshot_on_ready(wake_snapshot_waiters);
 
     server.on("/api/settings", HTTP_GET, handle_get_settings);
-    server.on(
-        "/api/settings", HTTP_POST, 
-        [](AsyncWebServerRequest *request){ request->send(200); }, NULL, handle_post_settings
-    );
+    server.on("/api/settings", HTTP_POST, handle_post_settings, NULL, handle_post_settings_body);
     server.on("/api/settings/reset", HTTP_POST, handle_settings_reset);
     server.on("/api/mute/toggle", HTTP_POST, handle_mute_toggle);
     server.on("/api/snapshot", HTTP_GET, handle_snapshot);
+    server.on("/api/metrics", HTTP_GET, handle_metrics);
+    server.on("/api/diagnostics", HTTP_GET, handle_diagnostics);
+    server.on("/api/power", HTTP_GET, handle_power);
+    server.on("/api/stream/stats", HTTP_GET, handle_stream_stats);
+    server.on("/api/camera", HTTP_GET, handle_camera);
+    server.on("/api/recorder/trigger", HTTP_POST, handle_recorder_trigger);
+    server.on("/api/recorder/clip", HTTP_GET, handle_recorder_clip);
+    server.on("/api/recorder", HTTP_GET, handle_recorder);
+    init_mjpeg_stream(server);
 
+    init_web_assets(server);
     server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html").setCacheControl("max-age=600");
     server.onNotFound(onNotFound);
 
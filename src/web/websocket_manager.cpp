@@ -1,17 +1,160 @@
 #include "websocket_manager.h"
+#include <atomic>
 #include <vector>
 #include "state.h"
+#include "sensor_snapshot.h"
+#include "ws_protocol.h"
+#include "metrics.h"
+#include "esp_timer.h"
+#include "mjpeg_stream.h"
+#include "tasks/parktronic_manager_task.h"
 
 static AsyncWebSocket ws("/ws");
 static AsyncWebSocket ws_stream("/ws_stream");
 
 SemaphoreHandle_t xWsMutex = xSemaphoreCreateMutex();
 
+// Не больше кадров в очереди клиента: один в отправке и один следующий.
+// Остальные кадры для этого клиента отбрасываются - он получит самый свежий, когда освободится.
+const size_t STREAM_CLIENT_QUEUE_DEPTH = 2;
+
+// Журнал очереди клиента: по биту на каждое поставленное нами сообщение, младший - самое старое,
+// 1 - кадр, 0 - ответ (pong). Клиент отправляет очередь по порядку, поэтому ушедшие из очереди
+// сообщения снимаются с головы журнала и кадры среди них считаются доставленными.
+struct StreamClientSlot {
+    uint32_t id; // 0 - слот свободен
+    uint32_t delivered;
+    uint32_t dropped;
+    uint32_t log; // WS_MAX_QUEUED_MESSAGES бит
+    uint8_t log_len;
+    bool header; // Кадры с WsFrameHeader
+};
+
+static StreamClientSlot stream_slots[MAX_STREAM_CLIENTS];
+
+static StreamClientSlot* find_stream_slot(uint32_t id) {
+    for (int i = 0; i < MAX_STREAM_CLIENTS; ++i) {
+        if (stream_slots[i].id == id) {
+            return &stream_slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Под xWsMutex
+static void sync_stream_log(StreamClientSlot *slot, size_t queue_len) {
+    while (slot->log_len > queue_len) {
+        slot->delivered += slot->log & 1;
+        slot->log >>= 1;
+        slot->log_len--;
+    }
+}
+
+// Сразу после постановки сообщения в очередь клиента
+static void push_stream_log(StreamClientSlot *slot, AsyncWebSocketClient *client, bool frame) {
+    size_t queue_len = client->queueLen();
+    sync_stream_log(slot, queue_len ? queue_len - 1 : 0);
+    slot->log |= (uint32_t)frame << slot->log_len;
+    slot->log_len++;
+}
+
+// Без изменений расстояния отправляются не чаще этого периода
+const uint32_t SENSORS_HEARTBEAT_MS = 1000;
+
+// Формат телеметрии каждого клиента /ws, под xWsMutex
+const int MAX_WS_CLIENTS = 8;
+
+struct WsClientSlot {
+    uint32_t id; // 0 - слот свободен
+    bool binary;
+};
+
+static WsClientSlot ws_slots[MAX_WS_CLIENTS];
+
+static WsClientSlot* find_ws_slot(uint32_t id) {
+    for (int i = 0; i < MAX_WS_CLIENTS; ++i) {
+        if (ws_slots[i].id == id) {
+            return &ws_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static uint16_t to_ws_distance(const SensorSample &sample, int i) {
+    float mm = sample.distances[i] * 10.0f;
+    return (sample.seq == 0 || mm < 0 || mm >= WS_DISTANCE_NONE) ? WS_DISTANCE_NONE : (uint16_t)mm;
+}
+
+// Текстовое сообщение клиента: JSON не длиннее 64 байт, иначе false
+static bool parse_ws_text(void *arg, uint8_t *data, size_t len, JsonDocument &doc) {
+    AwsFrameInfo *info = (AwsFrameInfo*)arg;
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+        return false;
+    }
+    return !deserializeJson(doc, data, len);
+}
+
+// Ответ на {"ping":t0} для синхронизации часов клиента (см. ws_protocol.h)
+static bool handle_clock_ping(AsyncWebSocketClient *client, JsonDocument &doc) {
+    JsonVariant ping = doc["ping"];
+    if (ping.isNull()) {
+        return false;
+    }
+    char pong[64];
+    snprintf(pong, sizeof(pong), "{\"pong\":%.3f,\"t\":%lld}", ping.as<double>(), (long long)esp_timer_get_time());
+    client->text(pong);
+    return true;
+}
+
+static TaskHandle_t s_sensors_task = NULL;
+static std::atomic<bool> s_force_sensors(false);
+
 void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
     if (type == WS_EVT_CONNECT) {
         Serial.printf("WS client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
+        if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
+            WsClientSlot *slot = find_ws_slot(0);
+            if (slot) {
+                slot->id = client->id();
+                slot->binary = false;
+            }
+            xSemaphoreGive(xWsMutex);
+        }
+        // Новый клиент получает текущие расстояния сразу, не дожидаясь изменения
+        s_force_sensors = true;
+        if (s_sensors_task) {
+            xTaskNotifyGive(s_sensors_task);
+        }
+        parktronic_manager_notify_clients();
     } else if (type == WS_EVT_DISCONNECT) {
         Serial.printf("WS client #%u disconnected\n", client->id());
+        if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
+            WsClientSlot *slot = find_ws_slot(client->id());
+            if (slot) slot->id = 0;
+            xSemaphoreGive(xWsMutex);
+        }
+        parktronic_manager_notify_clients();
+    } else if (type == WS_EVT_DATA) {
+        // Выбор формата: {"proto":"bin","v":1} или {"proto":"json"}
+        StaticJsonDocument<64> doc;
+        if (!parse_ws_text(arg, data, len, doc) || handle_clock_ping(client, doc)) {
+            return;
+        }
+        const char *proto = doc["proto"];
+        if (!proto) {
+            return;
+        }
+        bool binary = strcmp(proto, "bin") == 0 && (doc["v"] | 1) == WS_BIN_VERSION;
+        if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
+            WsClientSlot *slot = find_ws_slot(client->id());
+            if (slot) slot->binary = binary;
+            xSemaphoreGive(xWsMutex);
+        }
+        Serial.printf("WS client #%u switched to %s telemetry\n", client->id(), binary ? "binary" : "JSON");
+        s_force_sensors = true;
+        if (s_sensors_task) {
+            xTaskNotifyGive(s_sensors_task);
+        }
     }
 }
 
@@ -19,19 +162,60 @@ void onWsStreamEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEv
     if (type == WS_EVT_CONNECT) {
         Serial.printf("Stream client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
         if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
-            if (ws_stream.count() == 1) {
-                xEventGroupSetBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
+            StreamClientSlot *slot = find_stream_slot(0);
+            if (slot) {
+                slot->id = client->id();
+                slot->delivered = 0;
+                slot->dropped = 0;
+                slot->log = 0;
+                slot->log_len = 0;
+                slot->header = false;
             }
             xSemaphoreGive(xWsMutex);
         }
+        update_stream_request();
     } else if (type == WS_EVT_DISCONNECT) {
-        Serial.printf("Stream client #%u disconnected\n", client->id());
         if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
-            if (ws_stream.count() == 0) {
-                xEventGroupClearBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
+            StreamClientSlot *slot = find_stream_slot(client->id());
+            if (slot) {
+                sync_stream_log(slot, client->queueLen());
+                Serial.printf("Stream client #%u disconnected (frames delivered %u, dropped %u)\n",
+                              client->id(), slot->delivered, slot->dropped);
+                slot->id = 0;
+            } else {
+                Serial.printf("Stream client #%u disconnected\n", client->id());
+            }
+            xSemaphoreGive(xWsMutex);
+        }
+        update_stream_request();
+    } else if (type == WS_EVT_DATA) {
+        // Заголовок кадров: {"proto":"hdr","v":1} или {"proto":"raw"}
+        StaticJsonDocument<64> doc;
+        if (!parse_ws_text(arg, data, len, doc)) {
+            return;
+        }
+        // Ответ на ping попадает в очередь вперемешку с кадрами - отмечаем его в журнале
+        if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
+            bool can_send = client->canSend();
+            bool ping = handle_clock_ping(client, doc);
+            StreamClientSlot *slot = find_stream_slot(client->id());
+            if (ping && can_send && slot) push_stream_log(slot, client, false);
+            xSemaphoreGive(xWsMutex);
+            if (ping) {
+                return;
             }
+        }
+        const char *proto = doc["proto"];
+        if (!proto) {
+            return;
+        }
+        bool header = strcmp(proto, "hdr") == 0 && (doc["v"] | 1) == WS_FRAME_VERSION;
+        if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
+            StreamClientSlot *slot = find_stream_slot(client->id());
+            if (slot) slot->header = header;
             xSemaphoreGive(xWsMutex);
         }
+        Serial.printf("Stream client #%u switched to %s frames\n", client->id(), header ? "headered" : "raw");
     }
 }
 
@@ -51,38 +235,214 @@ int get_stream_clients_count() {
     return ws_stream.count();
 }
 
-void broadcast_ws_json(JsonDocument& doc) {
-    String buffer;
-    serializeJson(doc, buffer);
-    ws.textAll(buffer);
+void update_stream_request() {
+    // Камеру держат включённой зрители /ws_stream и /stream.mjpg
+    if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
+        if (ws_stream.count() + get_mjpeg_clients_count() > 0) {
+            xEventGroupSetBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
+        } else {
+            xEventGroupClearBits(xAppEventGroup, CAM_STREAM_REQUEST_BIT);
+        }
+        xSemaphoreGive(xWsMutex);
+    }
+    // Видео держит CPU на полной частоте
+    parktronic_manager_notify_clients();
 }
 
-bool is_stream_writable() {
-    return ws_stream.availableForWriteAll();
+// Каждый формат кодируется один раз в общий буфер, клиентам уходят ссылки на него
+static void broadcast_ws_sensors(const SensorSample &sample, uint8_t flags) {
+    static WsSensorsPacket packet;
+    static char json[96];
+    static DynamicJsonDocument doc(128);
+    AsyncWebSocketMessageBuffer *bin_buffer = NULL;
+    AsyncWebSocketMessageBuffer *json_buffer = NULL;
+
+    if (xSemaphoreTake(xWsMutex, portMAX_DELAY) != pdTRUE) {
+        return;
+    }
+    for (AsyncWebSocketClient *client : ws.getClients()) {
+        if (client->status() != WS_CONNECTED) {
+            continue;
+        }
+        WsClientSlot *slot = find_ws_slot(client->id());
+        if (slot && slot->binary) {
+            if (!bin_buffer) {
+                packet.magic = WS_BIN_MAGIC;
+                packet.version = WS_BIN_VERSION;
+                packet.flags = flags;
+                packet.count = NUM_SENSORS;
+                packet.seq = sample.seq;
+                packet.timestamp_ms = sample.timestamp_ms;
+                for (int i = 0; i < NUM_SENSORS; ++i) {
+                    packet.distances_mm[i] = to_ws_distance(sample, i);
+                }
+                bin_buffer = ws.makeBuffer((uint8_t*)&packet, sizeof(packet));
+                if (!bin_buffer) continue;
+                bin_buffer->lock();
+            }
+            client->binary(bin_buffer);
+        } else {
+            if (!json_buffer) {
+                JsonArray sensors = doc.createNestedArray("sensors");
+                for (int i = 0; i < NUM_SENSORS; ++i) {
+                    sensors.add(sample.distances[i]);
+                }
+                size_t n = serializeJson(doc, json, sizeof(json));
+                doc.clear();
+                json_buffer = ws.makeBuffer((uint8_t*)json, n);
+                if (!json_buffer) continue;
+                json_buffer->lock();
+            }
+            client->text(json_buffer);
+        }
+    }
+    xSemaphoreGive(xWsMutex);
+
+    if (bin_buffer) bin_buffer->unlock();
+    if (json_buffer) json_buffer->unlock();
+    ws._cleanBuffers();
 }
 
-void broadcast_ws_stream(const uint8_t* data, size_t len) {
-    ws_stream.binaryAll(reinterpret_cast<const char*>(data), len);
+// Кадр с заголовком: WsFrameHeader и JPEG одним сообщением
+static AsyncWebSocketMessageBuffer* make_headered_frame(const camera_fb_t *fb, uint32_t seq) {
+    AsyncWebSocketMessageBuffer *buffer = ws_stream.makeBuffer(sizeof(WsFrameHeader) + fb->len);
+    if (!buffer) {
+        return NULL;
+    }
+    WsFrameHeader header;
+    header.magic = WS_FRAME_MAGIC;
+    header.version = WS_FRAME_VERSION;
+    header.header_len = sizeof(WsFrameHeader);
+    header.count = NUM_SENSORS;
+    header.frame_seq = seq;
+    header.capture_us = (uint64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+
+    SensorSample sample;
+    sensor_snapshot_read_at((uint32_t)(header.capture_us / 1000), &sample);
+    header.sensor_seq = sample.seq;
+    header.timestamp_ms = sample.timestamp_ms;
+    for (int i = 0; i < NUM_SENSORS; ++i) {
+        header.distances_mm[i] = to_ws_distance(sample, i);
+    }
+    header.send_us = esp_timer_get_time();
+
+    memcpy(buffer->get(), &header, sizeof(header));
+    memcpy(buffer->get() + sizeof(header), fb->buf, fb->len);
+    return buffer;
+}
+
+void broadcast_ws_stream(const camera_fb_t *fb, uint32_t seq) {
+    // Одна общая копия кадра на каждый формат; очередь каждого клиента ограничена отдельно,
+    // поэтому медленный клиент не тормозит остальных. Копии создаются, только если есть
+    // клиент соответствующего формата.
+    AsyncWebSocketMessageBuffer *raw_buffer = NULL;
+    AsyncWebSocketMessageBuffer *hdr_buffer = NULL;
+
+    if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
+        for (AsyncWebSocketClient *client : ws_stream.getClients()) {
+            if (client->status() != WS_CONNECTED) {
+                continue;
+            }
+            StreamClientSlot *slot = find_stream_slot(client->id());
+            if (client->queueLen() >= STREAM_CLIENT_QUEUE_DEPTH) {
+                if (slot) slot->dropped++;
+                counter_add(g_metric_frames_dropped_queue);
+                continue;
+            }
+            bool header = slot && slot->header;
+            if (header && !hdr_buffer) {
+                hdr_buffer = make_headered_frame(fb, seq);
+                if (!hdr_buffer) continue;
+                hdr_buffer->lock();
+            } else if (!header && !raw_buffer) {
+                raw_buffer = ws_stream.makeBuffer(fb->buf, fb->len);
+                if (!raw_buffer) continue;
+                raw_buffer->lock();
+            }
+            client->binary(header ? hdr_buffer : raw_buffer);
+            if (slot) push_stream_log(slot, client, true);
+            counter_add(g_metric_frames_sent);
+        }
+        xSemaphoreGive(xWsMutex);
+    }
+
+    if (raw_buffer) raw_buffer->unlock();
+    if (hdr_buffer) hdr_buffer->unlock();
+    ws_stream._cleanBuffers();
+}
+
+int get_stream_client_stats(StreamClientStats *out, int max_count) {
+    int n = 0;
+    if (xSemaphoreTake(xWsMutex, portMAX_DELAY) == pdTRUE) {
+        for (AsyncWebSocketClient *client : ws_stream.getClients()) {
+            StreamClientSlot *slot = find_stream_slot(client->id());
+            if (!slot || n >= max_count) {
+                continue;
+            }
+            sync_stream_log(slot, client->queueLen());
+            out[n].id = slot->id;
+            out[n].delivered = slot->delivered;
+            out[n].dropped = slot->dropped;
+            out[n].pending = __builtin_popcount(slot->log);
+            n++;
+        }
+        xSemaphoreGive(xWsMutex);
+    }
+    return n;
 }
 
 void broadcast_sensors_task(void *pvParameters) {
     (void)pvParameters;
-    DynamicJsonDocument doc(128);
+    float last_sent[NUM_SENSORS];
+    uint32_t last_sent_ms = 0;
+    bool have_sent = false;
+    float deadband_cm = 1.0f;
+    bool is_muted = false;
+    uint8_t last_flags = 0;
+
+    s_sensors_task = xTaskGetCurrentTaskHandle();
+    sensor_snapshot_subscribe();
 
     for (;;) {
-        vTaskDelay(pdMS_TO_TICKS(100));
+        // Просыпаемся по новому измерению, подключению клиента или для heartbeat
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SENSORS_HEARTBEAT_MS));
 
-        if (get_ws_clients_count() == 0) continue;
+        if (get_ws_clients_count() == 0) {
+            have_sent = false;
+            continue;
+        }
 
-        if (xSemaphoreTake(xStateMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-            JsonArray sensors = doc.createNestedArray("sensors");
-            for (int i = 0; i < NUM_SENSORS; ++i) {
-                sensors.add(g_app_state.sensor_distances[i]);
-            }
+        if (xSemaphoreTake(xStateMutex, 0) == pdTRUE) {
+            deadband_cm = g_app_state.settings.ws_deadband_cm;
+            is_muted = g_app_state.is_muted;
             xSemaphoreGive(xStateMutex);
+        }
+
+        SensorSample sample;
+        sensor_snapshot_read(&sample);
 
-            broadcast_ws_json(doc);
-            doc.clear();
+        EventBits_t bits = xEventGroupGetBits(xAppEventGroup);
+        uint8_t flags = 0;
+        if (bits & PARKTRONIC_ACTIVE_BIT) flags |= WS_FLAG_ACTIVE;
+        if (bits & CAM_INITIALIZED_BIT) flags |= WS_FLAG_CAMERA_READY;
+        if (is_muted) flags |= WS_FLAG_MUTED;
+
+        // Изменение меньше зоны нечувствительности не отправляем, но не реже heartbeat
+        bool changed = !have_sent || s_force_sensors.exchange(false) || flags != last_flags;
+        for (int i = 0; i < NUM_SENSORS && !changed; ++i) {
+            changed = fabsf(sample.distances[i] - last_sent[i]) > deadband_cm;
+        }
+        if (!changed && millis() - last_sent_ms < SENSORS_HEARTBEAT_MS) {
+            continue;
         }
+
+        for (int i = 0; i < NUM_SENSORS; ++i) {
+            last_sent[i] = sample.distances[i];
+        }
+        last_flags = flags;
+        last_sent_ms = millis();
+        have_sent = true;
+
+        broadcast_ws_sensors(sample, flags);
     }
 }
\ No newline at end of file
@@ -1,14 +1,30 @@
 #pragma once
 #include "ESPAsyncWebServer.h"
 #include <ArduinoJson.h>
+#include "esp_camera.h"
+
+// Клиенты /ws_stream со счётчиками кадров; остальные получают кадры без учёта
+const int MAX_STREAM_CLIENTS = 8;
 
 void init_websockets(AsyncWebServer& server);
 
 int get_ws_clients_count();
 int get_stream_clients_count();
-bool is_stream_writable();
 
-void broadcast_ws_json(JsonDocument& doc);
-void broadcast_ws_stream(const uint8_t* data, size_t len);
+// Поднимает или снимает CAM_STREAM_REQUEST_BIT по числу зрителей видео (WebSocket и MJPEG).
+void update_stream_request();
+
+// Счётчики кадров клиента /ws_stream: delivered - переданы в TCP (ушли из очереди клиента), dropped - пропущены из-за полной очереди,
+// pending - сейчас в очереди клиента.
+struct StreamClientStats {
+    uint32_t id;
+    uint32_t delivered;
+    uint32_t dropped;
+    uint32_t pending;
+};
+int get_stream_client_stats(StreamClientStats *out, int max_count);
+
+// Кадр пула всем клиентам /ws_stream: голый JPEG или с WsFrameHeader, по выбору клиента.
+void broadcast_ws_stream(const camera_fb_t *fb, uint32_t seq);
 
 void broadcast_sensors_task(void *pvParameters);
\ No newline at end of file
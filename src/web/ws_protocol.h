@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+// Бинарный формат телеметрии /ws. По умолчанию клиент получает JSON {"sensors":[...]};
+// бинарные сообщения включаются текстовым сообщением клиента {"proto":"bin","v":1},
+// обратно - {"proto":"json"}. Все поля little-endian.
+
+const uint8_t WS_BIN_MAGIC = 0x50; // 'P'
+const uint8_t WS_BIN_VERSION = 1;
+
+// Флаги состояния
+const uint8_t WS_FLAG_ACTIVE = 1 << 0;     // Парктроник включен
+const uint8_t WS_FLAG_MUTED = 1 << 1;      // Звук выключен
+const uint8_t WS_FLAG_CAMERA_READY = 1 << 2;
+
+// Расстояние неизвестно или вне диапазона
+const uint16_t WS_DISTANCE_NONE = 0xFFFF;
+
+struct __attribute__((packed)) WsSensorsPacket
+{
+    uint8_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint8_t count;         // Число датчиков
+    uint32_t seq;          // Номер измерения
+    uint32_t timestamp_ms; // millis() измерения
+    uint16_t distances_mm[NUM_SENSORS];
+};
+
+// Заголовок кадра /ws_stream. По умолчанию кадр - голый JPEG; клиент включает заголовок
+// текстовым сообщением {"proto":"hdr","v":1} (обратно - {"proto":"raw"}), после чего
+// каждое бинарное сообщение - WsFrameHeader и сразу за ним JPEG (с байта header_len).
+//
+// capture_us/send_us - esp_timer_get_time() устройства, timestamp_ms измерения - millis(),
+// та же шкала в миллисекундах. Синхронизация часов: клиент шлёт на /ws или /ws_stream
+// {"ping":t0} (t0 - его время в мс), ответ - {"pong":t0,"t":<мкс устройства>}. При получении
+// ответа в t1: offset_ms = t / 1000 - (t0 + t1) / 2; кадр, показанный в момент t2, снят за
+// t2 - (capture_us / 1000 - offset_ms) мс до этого.
+const uint8_t WS_FRAME_MAGIC = 0x46; // 'F', JPEG начинается с 0xFF
+const uint8_t WS_FRAME_VERSION = 1;
+
+struct __attribute__((packed)) WsFrameHeader
+{
+    uint8_t magic;
+    uint8_t version;
+    uint8_t header_len;    // sizeof(WsFrameHeader) этой версии, JPEG - сразу после
+    uint8_t count;         // Число датчиков
+    uint32_t frame_seq;    // Номер кадра пула
+    uint64_t capture_us;   // Метка драйвера камеры (fb->timestamp)
+    uint64_t send_us;      // Постановка в очередь клиентов
+    uint32_t sensor_seq;   // Измерение, действовавшее в момент съёмки; 0 - нет
+    uint32_t timestamp_ms; // millis() этого измерения
+    uint16_t distances_mm[NUM_SENSORS];
+};
@@ -0,0 +1,243 @@
+// Автомат включения парктроника (activation_fsm) и антидребезг задней передачи на
+// программном таймере. Запуск: pio test -e native
+#include <unity.h>
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "activation_fsm.h"
+
+static ActivationFsm fsm;
+
+static ActivationActions feed(bool reverse, bool clients, bool auto_start = true)
+{
+    ActivationInputs in = {reverse, clients, auto_start};
+    return activation_fsm_update(&fsm, in);
+}
+
+static bool no_actions(const ActivationActions &a)
+{
+    return !a.activate && !a.deactivate && !a.prewarm && !a.unprewarm && !a.start_grace && !a.stop_grace;
+}
+
+void setUp(void)
+{
+    activation_fsm_init(&fsm);
+}
+
+void tearDown(void)
+{
+}
+
+void test_starts_idle(void)
+{
+    TEST_ASSERT_EQUAL(ACT_IDLE, fsm.state);
+    TEST_ASSERT_TRUE(no_actions(feed(false, false)));
+    TEST_ASSERT_EQUAL(ACT_IDLE, fsm.state);
+}
+
+void test_reverse_activates_and_prewarms(void)
+{
+    ActivationActions a = feed(true, false);
+    TEST_ASSERT_EQUAL(ACT_REVERSE, fsm.state);
+    TEST_ASSERT_TRUE(a.activate);
+    TEST_ASSERT_TRUE(a.prewarm);
+    TEST_ASSERT_FALSE(a.deactivate);
+    TEST_ASSERT_FALSE(a.unprewarm);
+}
+
+void test_reverse_ignored_without_auto_start(void)
+{
+    TEST_ASSERT_TRUE(no_actions(feed(true, false, false)));
+    TEST_ASSERT_EQUAL(ACT_IDLE, fsm.state);
+}
+
+// Таймер антидребезга уведомляет задачу после каждого успокоения контакта, в том числе
+// когда уровень не изменился (дребезг без переключения): повтор входов - без действий
+void test_debounce_repeated_settle_has_no_actions(void)
+{
+    TEST_ASSERT_TRUE(no_actions(feed(false, false)));
+    feed(true, false);
+    for (int i = 0; i < 5; ++i)
+    {
+        TEST_ASSERT_TRUE(no_actions(feed(true, false)));
+        TEST_ASSERT_EQUAL(ACT_REVERSE, fsm.state);
+    }
+    feed(false, false);
+    for (int i = 0; i < 5; ++i)
+    {
+        TEST_ASSERT_TRUE(no_actions(feed(false, false)));
+        TEST_ASSERT_EQUAL(ACT_GRACE, fsm.state);
+    }
+}
+
+static std::atomic<int> s_fired(0);
+static std::atomic<uint32_t> s_fired_ms(0);
+
+static void debounce_cb(TimerHandle_t timer)
+{
+    (void)timer;
+    s_fired_ms = millis();
+    s_fired++;
+}
+
+// Схема parktronic_manager_task: каждый фронт перезапускает однократный таймер 20 мс,
+// уровень читается только по его истечении. Серия фронтов - одно срабатывание через
+// 20 мс после последнего.
+void test_debounce_timer_restarts_on_every_edge(void)
+{
+    s_fired = 0;
+    TimerHandle_t timer = xTimerCreate("db", pdMS_TO_TICKS(20), pdFALSE, NULL, debounce_cb);
+    TEST_ASSERT_NOT_NULL(timer);
+    uint32_t last_edge = 0;
+    for (int i = 0; i < 6; ++i)
+    {
+        last_edge = millis();
+        xTimerReset(timer, 0);
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    TEST_ASSERT_EQUAL(0, s_fired.load());
+    vTaskDelay(pdMS_TO_TICKS(60));
+    TEST_ASSERT_EQUAL(1, s_fired.load());
+    TEST_ASSERT_GREATER_OR_EQUAL(last_edge + 20, s_fired_ms.load());
+    xTimerStop(timer, 0);
+}
+
+// Снятие передачи - пауза; прогрев камеры снимается сразу, парктроник продолжает работать
+void test_release_enters_grace_and_clears_prewarm(void)
+{
+    feed(true, false);
+    ActivationActions a = feed(false, false);
+    TEST_ASSERT_EQUAL(ACT_GRACE, fsm.state);
+    TEST_ASSERT_TRUE(a.start_grace);
+    TEST_ASSERT_TRUE(a.unprewarm);
+    TEST_ASSERT_FALSE(a.deactivate);
+    TEST_ASSERT_FALSE(a.activate);
+}
+
+void test_auto_start_disabled_while_reversing_enters_grace(void)
+{
+    feed(true, false);
+    ActivationActions a = feed(true, false, false);
+    TEST_ASSERT_EQUAL(ACT_GRACE, fsm.state);
+    TEST_ASSERT_TRUE(a.start_grace);
+    TEST_ASSERT_TRUE(a.unprewarm);
+}
+
+void test_grace_expiry_without_clients_deactivates(void)
+{
+    feed(true, false);
+    feed(false, false);
+    ActivationActions a = activation_fsm_grace_expired(&fsm);
+    TEST_ASSERT_EQUAL(ACT_IDLE, fsm.state);
+    TEST_ASSERT_TRUE(a.deactivate);
+    TEST_ASSERT_FALSE(a.unprewarm);
+}
+
+void test_grace_expiry_with_clients_stays_active(void)
+{
+    feed(true, true);
+    feed(false, true);
+    ActivationActions a = activation_fsm_grace_expired(&fsm);
+    TEST_ASSERT_EQUAL(ACT_CLIENT, fsm.state);
+    TEST_ASSERT_TRUE(no_actions(a));
+}
+
+// Устаревшее срабатывание таймера (пауза уже прервана) игнорируется
+void test_grace_expiry_outside_grace_ignored(void)
+{
+    TEST_ASSERT_TRUE(no_actions(activation_fsm_grace_expired(&fsm)));
+    TEST_ASSERT_EQUAL(ACT_IDLE, fsm.state);
+    feed(true, false);
+    TEST_ASSERT_TRUE(no_actions(activation_fsm_grace_expired(&fsm)));
+    TEST_ASSERT_EQUAL(ACT_REVERSE, fsm.state);
+}
+
+void test_reengage_during_grace_stops_timer_and_prewarms(void)
+{
+    feed(true, false);
+    feed(false, false);
+    ActivationActions a = feed(true, false);
+    TEST_ASSERT_EQUAL(ACT_REVERSE, fsm.state);
+    TEST_ASSERT_TRUE(a.stop_grace);
+    TEST_ASSERT_TRUE(a.prewarm);
+    TEST_ASSERT_FALSE(a.activate);
+    TEST_ASSERT_FALSE(a.start_grace);
+    // Повторное снятие - новая пауза
+    a = feed(false, false);
+    TEST_ASSERT_EQUAL(ACT_GRACE, fsm.state);
+    TEST_ASSERT_TRUE(a.start_grace);
+}
+
+void test_client_in_idle(void)
+{
+    ActivationActions a = feed(false, true);
+    TEST_ASSERT_EQUAL(ACT_CLIENT, fsm.state);
+    TEST_ASSERT_TRUE(a.activate);
+    TEST_ASSERT_FALSE(a.prewarm);
+    a = feed(false, false);
+    TEST_ASSERT_EQUAL(ACT_IDLE, fsm.state);
+    TEST_ASSERT_TRUE(a.deactivate);
+}
+
+void test_client_in_reverse(void)
+{
+    feed(true, false);
+    TEST_ASSERT_TRUE(no_actions(feed(true, true)));
+    TEST_ASSERT_EQUAL(ACT_REVERSE, fsm.state);
+    TEST_ASSERT_TRUE(no_actions(feed(true, false)));
+    TEST_ASSERT_EQUAL(ACT_REVERSE, fsm.state);
+}
+
+void test_client_in_grace(void)
+{
+    feed(true, false);
+    feed(false, false);
+    TEST_ASSERT_TRUE(no_actions(feed(false, true)));
+    TEST_ASSERT_EQUAL(ACT_GRACE, fsm.state);
+    TEST_ASSERT_TRUE(no_actions(feed(false, false)));
+    TEST_ASSERT_EQUAL(ACT_GRACE, fsm.state);
+    // Клиент подключился во время паузы - после неё остаётся CLIENT
+    feed(false, true);
+    TEST_ASSERT_TRUE(no_actions(activation_fsm_grace_expired(&fsm)));
+    TEST_ASSERT_EQUAL(ACT_CLIENT, fsm.state);
+}
+
+void test_client_in_client(void)
+{
+    feed(false, true);
+    ActivationActions a = feed(true, true);
+    TEST_ASSERT_EQUAL(ACT_REVERSE, fsm.state);
+    TEST_ASSERT_TRUE(a.prewarm);
+    TEST_ASSERT_FALSE(a.activate);
+    // REVERSE -> GRACE -> CLIENT с клиентом на /ws: прогрев снят, парктроник не выключался
+    a = feed(false, true);
+    TEST_ASSERT_TRUE(a.unprewarm);
+    a = activation_fsm_grace_expired(&fsm);
+    TEST_ASSERT_EQUAL(ACT_CLIENT, fsm.state);
+    TEST_ASSERT_FALSE(a.deactivate);
+    a = feed(false, false);
+    TEST_ASSERT_EQUAL(ACT_IDLE, fsm.state);
+    TEST_ASSERT_TRUE(a.deactivate);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_idle);
+    RUN_TEST(test_reverse_activates_and_prewarms);
+    RUN_TEST(test_reverse_ignored_without_auto_start);
+    RUN_TEST(test_debounce_repeated_settle_has_no_actions);
+    RUN_TEST(test_debounce_timer_restarts_on_every_edge);
+    RUN_TEST(test_release_enters_grace_and_clears_prewarm);
+    RUN_TEST(test_auto_start_disabled_while_reversing_enters_grace);
+    RUN_TEST(test_grace_expiry_without_clients_deactivates);
+    RUN_TEST(test_grace_expiry_with_clients_stays_active);
+    RUN_TEST(test_grace_expiry_outside_grace_ignored);
+    RUN_TEST(test_reengage_during_grace_stops_timer_and_prewarms);
+    RUN_TEST(test_client_in_idle);
+    RUN_TEST(test_client_in_reverse);
+    RUN_TEST(test_client_in_grace);
+    RUN_TEST(test_client_in_client);
+    return UNITY_END();
+}
@@ -0,0 +1,272 @@
+// Кольцо клипов регистратора (clip_store) на разделе "rec" симулятора: восстановление списка
+// после перезагрузки, переход записи через конец кольца, вытеснение старых клипов и обрыв
+// выгрузки затёртого клипа. Раздел - файл во временном каталоге, минимальный размер
+// (16 секторов), задержки flash отключены. Запуск: pio test -e native
+#include <unity.h>
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "esp_partition.h"
+#include "clip_store.h"
+
+static const int MAX_WRITES = 40;
+
+static uint8_t pattern(uint32_t clip_id, int entry, uint32_t i)
+{
+    return (uint8_t)(clip_id * 29 + entry * 7 + i);
+}
+
+// Клип из entries кадров разной длины (не кратной 4) начиная с len
+static uint32_t write_clip(int entries, uint32_t len)
+{
+    uint32_t id;
+    TEST_ASSERT_TRUE(clip_store_begin(CLIP_TRIGGER_MANUAL, 1000, &id));
+    std::vector<uint8_t> data;
+    for (int e = 0; e < entries; ++e)
+    {
+        data.resize(len + e * 37);
+        for (uint32_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = pattern(id, e, i);
+        }
+        TEST_ASSERT_TRUE(clip_store_append(CLIP_REC_FRAME, 1000 + e * 200, data.data(), data.size()));
+    }
+    TEST_ASSERT_TRUE(clip_store_finish(500, 2000));
+    return id;
+}
+
+static std::vector<ClipInfo> list()
+{
+    ClipInfo clips[CLIP_STORE_MAX_CLIPS];
+    int n = clip_store_list(clips, CLIP_STORE_MAX_CLIPS);
+    return std::vector<ClipInfo>(clips, clips + n);
+}
+
+static bool listed(uint32_t clip_id)
+{
+    for (const ClipInfo &c : list())
+    {
+        if (c.id == clip_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Выгрузка целиком кусками, не кратными записям: индекс, затем каждый кадр со своими данными
+static void check_download(const ClipInfo &clip)
+{
+    ClipReader r;
+    TEST_ASSERT_TRUE(clip_reader_open(&r, clip.id));
+    std::vector<uint8_t> out(clip.bytes);
+    size_t got = 0;
+    while (got < out.size())
+    {
+        size_t n = clip_reader_read(&r, got, out.data() + got, min((size_t)700, out.size() - got));
+        TEST_ASSERT_NOT_EQUAL(0, n);
+        got += n;
+    }
+    uint8_t tail[16];
+    TEST_ASSERT_EQUAL(0, clip_reader_read(&r, got, tail, sizeof(tail)));
+
+    ClipRecordHeader h;
+    ClipIndexHeader idx;
+    memcpy(&h, out.data(), sizeof(h));
+    memcpy(&idx, out.data() + sizeof(h), sizeof(idx));
+    TEST_ASSERT_EQUAL_UINT32(CLIP_RECORD_MAGIC, h.magic);
+    TEST_ASSERT_EQUAL_UINT8(CLIP_REC_INDEX, h.type);
+    TEST_ASSERT_EQUAL_UINT32(clip.id, idx.clip_id);
+    TEST_ASSERT_EQUAL_UINT16(clip.entry_count, idx.entry_count);
+
+    size_t pos = sizeof(h) + h.len;
+    for (int e = 0; e < idx.entry_count; ++e)
+    {
+        ClipIndexEntry entry;
+        memcpy(&entry, out.data() + sizeof(h) + sizeof(idx) + e * sizeof(entry), sizeof(entry));
+        memcpy(&h, out.data() + pos, sizeof(h));
+        TEST_ASSERT_EQUAL_UINT32(CLIP_RECORD_MAGIC, h.magic);
+        TEST_ASSERT_EQUAL_UINT32(clip.id, h.clip_id);
+        TEST_ASSERT_EQUAL_UINT32(entry.len, sizeof(h) + h.len);
+        std::vector<uint8_t> expected(h.len);
+        for (uint32_t i = 0; i < h.len; ++i)
+        {
+            expected[i] = pattern(clip.id, e, i);
+        }
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), out.data() + pos + sizeof(h), h.len);
+        pos += entry.len;
+    }
+    TEST_ASSERT_EQUAL(out.size(), pos);
+}
+
+static void check_same_list(const std::vector<ClipInfo> &before, const std::vector<ClipInfo> &after)
+{
+    TEST_ASSERT_EQUAL(before.size(), after.size());
+    for (size_t i = 0; i < before.size(); ++i)
+    {
+        TEST_ASSERT_EQUAL_UINT32(before[i].id, after[i].id);
+        TEST_ASSERT_EQUAL_UINT32(before[i].bytes, after[i].bytes);
+        TEST_ASSERT_EQUAL_UINT32(before[i].start_offset, after[i].start_offset);
+        TEST_ASSERT_EQUAL_UINT32(before[i].index_offset, after[i].index_offset);
+        TEST_ASSERT_EQUAL_UINT32(before[i].end_offset, after[i].end_offset);
+        TEST_ASSERT_EQUAL_UINT16(before[i].frames, after[i].frames);
+    }
+}
+
+// Каждый тест начинает с чистого раздела
+void setUp()
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "rec");
+    TEST_ASSERT_NOT_NULL(part);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_erase_range(part, 0, part->size));
+    TEST_ASSERT_TRUE(clip_store_init());
+}
+
+void tearDown()
+{
+}
+
+void test_empty_partition()
+{
+    TEST_ASSERT_EQUAL(0, (int)list().size());
+    TEST_ASSERT_GREATER_THAN(0, clip_store_capacity());
+    uint32_t id;
+    TEST_ASSERT_TRUE(clip_store_begin(CLIP_TRIGGER_MANUAL, 0, &id));
+    TEST_ASSERT_EQUAL_UINT32(1, id);
+    TEST_ASSERT_FALSE(clip_store_finish(0, 0)); // Пустой клип не сохраняется
+}
+
+void test_boot_scan_restores_clips()
+{
+    write_clip(3, 1500);
+    write_clip(5, 900);
+    uint32_t last = write_clip(2, 3000);
+    std::vector<ClipInfo> before = list();
+    TEST_ASSERT_EQUAL(3, (int)before.size());
+
+    TEST_ASSERT_TRUE(clip_store_init());
+    check_same_list(before, list());
+    for (const ClipInfo &c : list())
+    {
+        check_download(c);
+    }
+    // Номера продолжаются, новый клип пишется после восстановленных
+    uint32_t next = write_clip(2, 1000);
+    TEST_ASSERT_EQUAL_UINT32(last + 1, next);
+    TEST_ASSERT_EQUAL(4, (int)list().size());
+    check_download(list().back());
+}
+
+void test_unfinished_clip_dropped()
+{
+    uint32_t first = write_clip(2, 2000);
+    uint32_t id;
+    TEST_ASSERT_TRUE(clip_store_begin(CLIP_TRIGGER_DISTANCE, 3000, &id));
+    std::vector<uint8_t> data(2500, 0x5a);
+    TEST_ASSERT_TRUE(clip_store_append(CLIP_REC_FRAME, 3000, data.data(), data.size()));
+    TEST_ASSERT_TRUE(clip_store_append(CLIP_REC_FRAME, 3200, data.data(), data.size()));
+
+    // Сброс до записи индекса
+    TEST_ASSERT_TRUE(clip_store_init());
+    std::vector<ClipInfo> clips = list();
+    TEST_ASSERT_EQUAL(1, (int)clips.size());
+    TEST_ASSERT_EQUAL_UINT32(first, clips[0].id);
+    check_download(clips[0]);
+
+    // Недописанный хвост не мешает следующему клипу и следующей загрузке
+    uint32_t next = write_clip(3, 1200);
+    TEST_ASSERT_TRUE(clip_store_init());
+    clips = list();
+    TEST_ASSERT_EQUAL(2, (int)clips.size());
+    TEST_ASSERT_EQUAL_UINT32(next, clips[1].id);
+    check_download(clips[0]);
+    check_download(clips[1]);
+}
+
+void test_wrap_around_survives_reboot()
+{
+    // Пишем, пока последний клип не перейдёт через конец кольца
+    uint32_t last = 0;
+    bool wrapped = false;
+    for (int i = 0; i < MAX_WRITES && !wrapped; ++i)
+    {
+        last = write_clip(4, 2300);
+        ClipInfo c = list().back();
+        wrapped = c.end_offset < c.start_offset;
+    }
+    TEST_ASSERT_TRUE(wrapped);
+    TEST_ASSERT_FALSE(listed(1)); // Затёрт первым
+
+    std::vector<ClipInfo> before = list();
+    TEST_ASSERT_GREATER_THAN(1, (int)before.size());
+    TEST_ASSERT_EQUAL_UINT32(last, before.back().id);
+    uint32_t total = 0;
+    for (size_t i = 0; i < before.size(); ++i)
+    {
+        if (i)
+        {
+            TEST_ASSERT_EQUAL_UINT32(before[i - 1].id + 1, before[i].id);
+        }
+        total += before[i].bytes;
+        check_download(before[i]);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(clip_store_capacity(), total);
+
+    TEST_ASSERT_TRUE(clip_store_init());
+    check_same_list(before, list());
+    for (const ClipInfo &c : list())
+    {
+        check_download(c);
+    }
+
+    // Запись после перезагрузки продолжает кольцо и вытесняет самый старый клип
+    uint32_t next = write_clip(4, 2300);
+    TEST_ASSERT_EQUAL_UINT32(last + 1, next);
+    TEST_ASSERT_FALSE(listed(before.front().id));
+    for (const ClipInfo &c : list())
+    {
+        check_download(c);
+    }
+}
+
+void test_reader_stops_when_clip_overwritten()
+{
+    uint32_t id = write_clip(4, 2000);
+    ClipReader r;
+    TEST_ASSERT_TRUE(clip_reader_open(&r, id));
+    uint8_t buf[700];
+    size_t got = clip_reader_read(&r, 0, buf, sizeof(buf)); // Индекс
+    TEST_ASSERT_NOT_EQUAL(0, got);
+
+    for (int i = 0; i < MAX_WRITES && listed(id); ++i)
+    {
+        write_clip(4, 2000);
+    }
+    TEST_ASSERT_FALSE(listed(id));
+    TEST_ASSERT_LESS_THAN(r.clip.bytes, got);
+    TEST_ASSERT_EQUAL(0, clip_reader_read(&r, got, buf, sizeof(buf)));
+    TEST_ASSERT_FALSE(clip_reader_open(&r, id));
+}
+
+int main(int argc, char **argv)
+{
+    char dir[] = "/tmp/test_clip_store_XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        return 1;
+    }
+    setenv("SIM_FLASH_DIR", dir, 1);
+    setenv("SIM_REC_PARTITION_KB", "64", 1);
+    setenv("SIM_FLASH_ERASE_MS", "0", 1);
+    setenv("SIM_FLASH_PAGE_US", "0", 1);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_partition);
+    RUN_TEST(test_boot_scan_restores_clips);
+    RUN_TEST(test_unfinished_clip_dropped);
+    RUN_TEST(test_wrap_around_survives_reboot);
+    RUN_TEST(test_reader_stops_when_clip_overwritten);
+    return UNITY_END();
+}
@@ -0,0 +1,128 @@
+// Отбраковка перекрёстного эха (crosstalk_filter): подтверждение из другой фазы сдвига,
+// допуск CONFIRM_TOLERANCE_CM и принудительный приём после MAX_UNCONFIRMED отказов.
+// Запуск: pio test -e native
+#include <unity.h>
+#include "crosstalk_filter.h"
+
+const float NO_ECHO_CM = 400.0f;
+
+static CrosstalkState st;
+
+void setUp()
+{
+    crosstalk_reset(&st, NO_ECHO_CM);
+}
+
+void tearDown()
+{
+}
+
+// Значение из одной фазы не принимается, подтверждение из другой - принимается
+void test_opposite_phase_confirms()
+{
+    TEST_ASSERT_EQUAL_FLOAT(NO_ECHO_CM, crosstalk_accept(&st, 100.0f, 0));
+    TEST_ASSERT_EQUAL_FLOAT(105.0f, crosstalk_accept(&st, 105.0f, 1));
+    TEST_ASSERT_EQUAL_UINT32(1, st.rejected);
+    TEST_ASSERT_EQUAL_INT(0, st.unconfirmed);
+
+    // Дальше обе фазы подтверждают друг друга
+    TEST_ASSERT_EQUAL_FLOAT(98.0f, crosstalk_accept(&st, 98.0f, 0));
+    TEST_ASSERT_EQUAL_FLOAT(101.0f, crosstalk_accept(&st, 101.0f, 1));
+    TEST_ASSERT_EQUAL_UINT32(1, st.rejected);
+}
+
+// Перекрёстное эхо повторяется в своей фазе - повтор из той же фазы не подтверждение
+void test_same_phase_does_not_confirm()
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        TEST_ASSERT_EQUAL_FLOAT(NO_ECHO_CM, crosstalk_accept(&st, 100.0f, 0));
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, st.rejected);
+    TEST_ASSERT_EQUAL_INT(5, st.unconfirmed);
+}
+
+void test_tolerance_boundary()
+{
+    crosstalk_accept(&st, 100.0f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(100.0f + CONFIRM_TOLERANCE_CM, crosstalk_accept(&st, 100.0f + CONFIRM_TOLERANCE_CM, 1));
+
+    crosstalk_reset(&st, NO_ECHO_CM);
+    crosstalk_accept(&st, 100.0f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(NO_ECHO_CM, crosstalk_accept(&st, 100.0f + CONFIRM_TOLERANCE_CM + 0.5f, 1));
+
+    crosstalk_reset(&st, NO_ECHO_CM);
+    crosstalk_accept(&st, 100.0f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(NO_ECHO_CM, crosstalk_accept(&st, 100.0f - CONFIRM_TOLERANCE_CM - 0.5f, 1));
+}
+
+// Препятствие на месте, эхо соседа сдвигается на 50 см между фазами: выход не меняется
+void test_shifted_crosstalk_rejected()
+{
+    crosstalk_accept(&st, 150.0f, 0);
+    crosstalk_accept(&st, 150.0f, 1);
+    TEST_ASSERT_EQUAL_FLOAT(150.0f, crosstalk_accept(&st, 150.0f, 0));
+    uint32_t rejected = st.rejected;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        TEST_ASSERT_EQUAL_FLOAT(150.0f, crosstalk_accept(&st, 80.0f, 0));
+        TEST_ASSERT_EQUAL_FLOAT(150.0f, crosstalk_accept(&st, 130.0f, 1));
+    }
+    TEST_ASSERT_EQUAL_UINT32(rejected + 8, st.rejected);
+}
+
+// После MAX_UNCONFIRMED отказов подряд значение принимается без подтверждения
+void test_forced_after_max_unconfirmed()
+{
+    for (int i = 0; i < MAX_UNCONFIRMED; ++i)
+    {
+        TEST_ASSERT_EQUAL_FLOAT(NO_ECHO_CM, crosstalk_accept(&st, 200.0f, 0));
+    }
+    TEST_ASSERT_EQUAL_INT(MAX_UNCONFIRMED, st.unconfirmed);
+    TEST_ASSERT_EQUAL_FLOAT(200.0f, crosstalk_accept(&st, 200.0f, 0));
+    TEST_ASSERT_EQUAL_INT(0, st.unconfirmed);
+    TEST_ASSERT_EQUAL_UINT32(MAX_UNCONFIRMED, st.rejected);
+
+    // Счётчик начинается заново
+    TEST_ASSERT_EQUAL_FLOAT(200.0f, crosstalk_accept(&st, 250.0f, 0));
+    TEST_ASSERT_EQUAL_INT(1, st.unconfirmed);
+}
+
+// Подтверждают только последние CROSSTALK_HISTORY значений другой фазы
+void test_history_window()
+{
+    const float phase1[] = {100.0f, 200.0f, 300.0f, 350.0f};
+    for (float v : phase1)
+    {
+        crosstalk_accept(&st, v, 1);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(NO_ECHO_CM, crosstalk_accept(&st, 100.0f, 0)); // Вытеснено
+    TEST_ASSERT_EQUAL_FLOAT(200.0f, crosstalk_accept(&st, 200.0f, 0));
+    TEST_ASSERT_EQUAL_FLOAT(350.0f, crosstalk_accept(&st, 350.0f, 0));
+}
+
+// Новое включение (sensors_task сбрасывает состояние): старое значение не публикуется
+// и не подтверждает первое измерение
+void test_reset_forgets_previous_session()
+{
+    crosstalk_accept(&st, 40.0f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(42.0f, crosstalk_accept(&st, 42.0f, 1));
+
+    crosstalk_reset(&st, NO_ECHO_CM);
+    TEST_ASSERT_EQUAL_FLOAT(NO_ECHO_CM, crosstalk_accept(&st, 41.0f, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, st.rejected);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_opposite_phase_confirms);
+    RUN_TEST(test_same_phase_does_not_confirm);
+    RUN_TEST(test_tolerance_boundary);
+    RUN_TEST(test_shifted_crosstalk_rejected);
+    RUN_TEST(test_forced_after_max_unconfirmed);
+    RUN_TEST(test_history_window);
+    RUN_TEST(test_reset_forgets_previous_session);
+    return UNITY_END();
+}
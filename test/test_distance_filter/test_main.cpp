@@ -0,0 +1,283 @@
+// Фильтр расстояния (distance_filter) против прежнего скользящего среднего из 6 значений на
+// синтетических записях подъезда: гауссов шум датчика и пропуски эха (400 см).
+// Запуск: pio test -e native
+#include <unity.h>
+#include <math.h>
+#include <stdint.h>
+#include "distance_filter.h"
+
+const float DT_S = 0.05f; // Период опроса датчика (цикл 40-80 мс)
+const float DROPOUT_CM = 400.0f;
+const int TRACE_MAX = 400;
+
+// Прежний getSmoothedValue: среднее последних 6 значений
+struct Boxcar
+{
+    float v[6];
+    int n;
+    int head;
+};
+
+static float boxcar_update(Boxcar *b, float raw)
+{
+    b->v[b->head] = raw;
+    b->head = (b->head + 1) % 6;
+    if (b->n < 6)
+    {
+        b->n++;
+    }
+    float sum = 0;
+    for (int i = 0; i < b->n; ++i)
+    {
+        sum += b->v[i];
+    }
+    return sum / b->n;
+}
+
+enum Chain
+{
+    CHAIN_BOXCAR,
+    CHAIN_MEDIAN,
+    CHAIN_MEDIAN_AB,
+};
+
+// Детерминированный шум: LCG + Бокс-Мюллер
+static uint32_t s_rng;
+
+static float uniform()
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return ((s_rng >> 8) + 0.5f) / 16777216.0f;
+}
+
+static float gaussian(float sigma)
+{
+    return sigma * sqrtf(-2.0f * logf(uniform())) * cosf(6.2831853f * uniform());
+}
+
+struct Trace
+{
+    float truth[TRACE_MAX];
+    float raw[TRACE_MAX];
+    int len;
+};
+
+// Подъезд: стоим на start_cm, затем едем к препятствию со скоростью speed_cms до stop_cm
+static void make_approach(Trace *t, float start_cm, float stop_cm, float speed_cms, float sigma, float dropout_pct,
+                          uint32_t seed)
+{
+    s_rng = seed;
+    t->len = TRACE_MAX;
+    for (int i = 0; i < t->len; ++i)
+    {
+        float d = start_cm - (i < 40 ? 0 : speed_cms * DT_S * (i - 40));
+        if (d < stop_cm)
+        {
+            d = stop_cm;
+        }
+        t->truth[i] = d;
+        t->raw[i] = uniform() * 100.0f < dropout_pct ? DROPOUT_CM : d + gaussian(sigma);
+    }
+}
+
+static void run(Chain chain, const Trace &t, float *out)
+{
+    Boxcar box = {};
+    DistanceFilterState st;
+    distance_filter_reset(&st);
+    DistanceFilterConfig cfg = distance_filter_default_config();
+    cfg.type = chain == CHAIN_MEDIAN ? FILTER_MEDIAN : FILTER_MEDIAN_AB;
+    for (int i = 0; i < t.len; ++i)
+    {
+        out[i] = chain == CHAIN_BOXCAR ? boxcar_update(&box, t.raw[i]) : distance_filter_update(&st, cfg, t.raw[i], DT_S);
+    }
+}
+
+static float rms_error(const Trace &t, const float *out, int from, int to)
+{
+    double sum = 0;
+    for (int i = from; i < to; ++i)
+    {
+        sum += (out[i] - t.truth[i]) * (out[i] - t.truth[i]);
+    }
+    return sqrt(sum / (to - from));
+}
+
+static float max_error(const Trace &t, const float *out, int from, int to)
+{
+    float m = 0;
+    for (int i = from; i < to; ++i)
+    {
+        m = fmaxf(m, fabsf(out[i] - t.truth[i]));
+    }
+    return m;
+}
+
+// Отсчётов до входа в полосу tol_cm вокруг нового значения после скачка в step_at
+static int step_lag(const float *out, int step_at, int len, float target, float tol_cm)
+{
+    for (int i = step_at; i < len; ++i)
+    {
+        if (fabsf(out[i] - target) <= tol_cm)
+        {
+            return i - step_at;
+        }
+    }
+    return len;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// Новое препятствие: скачок 200 -> 100 см без шума
+void test_step_response_lag(void)
+{
+    Trace t;
+    t.len = 60;
+    for (int i = 0; i < t.len; ++i)
+    {
+        t.truth[i] = t.raw[i] = i < 20 ? 200.0f : 100.0f;
+    }
+    float box[TRACE_MAX], med[TRACE_MAX], ab[TRACE_MAX];
+    run(CHAIN_BOXCAR, t, box);
+    run(CHAIN_MEDIAN, t, med);
+    run(CHAIN_MEDIAN_AB, t, ab);
+    int lag_box = step_lag(box, 20, t.len, 100.0f, 5.0f);
+    int lag_med = step_lag(med, 20, t.len, 100.0f, 5.0f);
+    int lag_ab = step_lag(ab, 20, t.len, 100.0f, 5.0f);
+    // Медиана из 5 переключается на третьем новом значении, скачок > REACQUIRE_CM
+    // альфа-бета принимает сразу; среднее из 6 доходит только на шестом
+    TEST_ASSERT_EQUAL_INT(2, lag_med);
+    TEST_ASSERT_EQUAL_INT(2, lag_ab);
+    TEST_ASSERT_EQUAL_INT(5, lag_box);
+    TEST_ASSERT_LESS_THAN(lag_box, lag_ab);
+}
+
+// Равномерный подъезд 30 см/с: установившееся запаздывание на рампе
+void test_ramp_tracking_lag(void)
+{
+    Trace t;
+    make_approach(&t, 250.0f, 30.0f, 30.0f, 0.0f, 0.0f, 1);
+    float box[TRACE_MAX], med[TRACE_MAX], ab[TRACE_MAX];
+    run(CHAIN_BOXCAR, t, box);
+    run(CHAIN_MEDIAN, t, med);
+    run(CHAIN_MEDIAN_AB, t, ab);
+    // Середина рампы: 250 см -> 30 см за ~147 отсчётов после 40-го
+    float err_box = 0, err_med = 0, err_ab = 0;
+    for (int i = 100; i < 150; ++i)
+    {
+        err_box += (box[i] - t.truth[i]) / 50;
+        err_med += (med[i] - t.truth[i]) / 50;
+        err_ab += (ab[i] - t.truth[i]) / 50;
+    }
+    // Среднее из 6 отстаёт на 2.5 отсчёта (3.75 см), медиана из 5 - на 2 (3 см);
+    // альфа-бета после захвата скорости не добавляет своего запаздывания к медиане
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 3.75f, err_box);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 3.0f, err_med);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, err_med, err_ab);
+}
+
+// Стоянка на 150 см, шум 2 см и 5% пропусков эха
+void test_noise_and_dropouts_stationary(void)
+{
+    Trace t;
+    make_approach(&t, 150.0f, 150.0f, 0.0f, 2.0f, 5.0f, 7);
+    float box[TRACE_MAX], med[TRACE_MAX], ab[TRACE_MAX];
+    run(CHAIN_BOXCAR, t, box);
+    run(CHAIN_MEDIAN, t, med);
+    run(CHAIN_MEDIAN_AB, t, ab);
+    float rms_box = rms_error(t, box, 10, t.len);
+    float rms_med = rms_error(t, med, 10, t.len);
+    float rms_ab = rms_error(t, ab, 10, t.len);
+    // Каждый пропуск тянет среднее вверх на ~40 см на 6 циклов
+    TEST_ASSERT_GREATER_THAN_FLOAT(10.0f, rms_box);
+    TEST_ASSERT_LESS_THAN_FLOAT(2.0f, rms_med);
+    TEST_ASSERT_LESS_THAN_FLOAT(2.0f, rms_ab);
+    TEST_ASSERT_LESS_THAN_FLOAT(rms_med, rms_ab);
+    TEST_ASSERT_GREATER_THAN_FLOAT(30.0f, max_error(t, box, 10, t.len));
+    TEST_ASSERT_LESS_THAN_FLOAT(10.0f, max_error(t, ab, 10, t.len));
+}
+
+// Подъезд с шумом и пропусками: ошибка по всей записи
+void test_noise_and_dropouts_approach(void)
+{
+    Trace t;
+    make_approach(&t, 250.0f, 30.0f, 40.0f, 1.5f, 3.0f, 42);
+    float box[TRACE_MAX], med[TRACE_MAX], ab[TRACE_MAX];
+    run(CHAIN_BOXCAR, t, box);
+    run(CHAIN_MEDIAN, t, med);
+    run(CHAIN_MEDIAN_AB, t, ab);
+    float rms_box = rms_error(t, box, 10, t.len);
+    float rms_ab = rms_error(t, ab, 10, t.len);
+    TEST_ASSERT_LESS_THAN_FLOAT(4.0f, rms_ab);
+    TEST_ASSERT_LESS_THAN_FLOAT(rms_box / 3, rms_ab);
+    TEST_ASSERT_LESS_THAN_FLOAT(rms_box, rms_error(t, med, 10, t.len));
+    // Ни один одиночный пропуск не доходит до выхода медианы
+    TEST_ASSERT_LESS_THAN_FLOAT(15.0f, max_error(t, ab, 10, t.len));
+}
+
+// Скачок больше REACQUIRE_CM (50 см) после медианы - захват без сглаживания и со сбросом
+// скорости, меньший - обычная коррекция альфа-бета
+void test_reacquire_threshold(void)
+{
+    DistanceFilterConfig cfg = distance_filter_default_config();
+    cfg.median_len = 1;
+    DistanceFilterState st;
+    distance_filter_reset(&st);
+    for (int i = 0; i < 20; ++i)
+    {
+        distance_filter_update(&st, cfg, 100.0f, DT_S);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f, st.distance_cm);
+
+    float out = distance_filter_update(&st, cfg, 130.0f, DT_S);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 100.0f + cfg.alpha * 30.0f, out);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.0f, st.velocity_cms);
+
+    distance_filter_reset(&st);
+    for (int i = 0; i < 20; ++i)
+    {
+        distance_filter_update(&st, cfg, 100.0f, DT_S);
+    }
+    out = distance_filter_update(&st, cfg, 160.0f, DT_S);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 160.0f, out);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, st.velocity_cms);
+
+    // Скачок вниз тоже захватывается сразу
+    out = distance_filter_update(&st, cfg, 60.0f, DT_S);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 60.0f, out);
+}
+
+void test_config_validation(void)
+{
+    DistanceFilterConfig cfg = distance_filter_default_config();
+    TEST_ASSERT_TRUE(distance_filter_config_valid(cfg));
+    cfg.median_len = 4;
+    TEST_ASSERT_FALSE(distance_filter_config_valid(cfg));
+    cfg = distance_filter_default_config();
+    cfg.alpha = 0.0f;
+    TEST_ASSERT_FALSE(distance_filter_config_valid(cfg));
+    cfg = distance_filter_default_config();
+    cfg.beta = 1.0f;
+    TEST_ASSERT_FALSE(distance_filter_config_valid(cfg));
+    cfg = distance_filter_default_config();
+    cfg.type = FILTER_MEDIAN_AB + 1;
+    TEST_ASSERT_FALSE(distance_filter_config_valid(cfg));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_step_response_lag);
+    RUN_TEST(test_ramp_tracking_lag);
+    RUN_TEST(test_noise_and_dropouts_stationary);
+    RUN_TEST(test_noise_and_dropouts_approach);
+    RUN_TEST(test_reacquire_threshold);
+    RUN_TEST(test_config_validation);
+    return UNITY_END();
+}
@@ -0,0 +1,187 @@
+// Слоты A/B настроек (settings_manager): загружается новейшая целая запись, испорченная
+// или недописанная запись (обрыв питания) заменяется другим слотом; старый settings.json
+// переносится по полям. LittleFS и NVS - каталоги хоста во временном каталоге. Запуск: pio test -e native
+#include <unity.h>
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "state.h"
+#include "settings_manager.h"
+#include "settings_schema.h"
+
+static const char *const SLOTS[2] = {"/settings_a.bin", "/settings_b.bin"};
+static const size_t RECORD_SETTINGS_OFFSET = 12; // magic, version, size, generation
+
+static std::vector<uint8_t> read_file(const char *path)
+{
+    std::vector<uint8_t> data;
+    File file = LittleFS.open(path, "r");
+    if (file)
+    {
+        data.resize(file.size());
+        data.resize(file.read(data.data(), data.size()));
+        file.close();
+    }
+    return data;
+}
+
+static void write_file(const char *path, const std::vector<uint8_t> &data)
+{
+    File file = LittleFS.open(path, "w");
+    file.write(data.data(), data.size());
+    file.close();
+}
+
+// volume из записи слота, -1 - слота нет
+static int slot_volume(int slot)
+{
+    std::vector<uint8_t> data = read_file(SLOTS[slot]);
+    int volume;
+    size_t off = RECORD_SETTINGS_OFFSET + offsetof(AppSettings, volume);
+    if (data.size() < off + sizeof(volume))
+    {
+        return -1;
+    }
+    memcpy(&volume, &data[off], sizeof(volume));
+    return volume;
+}
+
+static int slot_with_volume(int volume)
+{
+    return slot_volume(0) == volume ? 0 : (slot_volume(1) == volume ? 1 : -1);
+}
+
+static void save_volume(int volume)
+{
+    g_app_state.settings.volume = volume;
+    TEST_ASSERT_TRUE(settings_flush());
+}
+
+static int load_volume()
+{
+    g_app_state.settings.volume = -1;
+    settings_init();
+    return g_app_state.settings.volume;
+}
+
+// Два целых слота: старый volume 10, новый 11
+void setUp()
+{
+    LittleFS.remove(SLOTS[0]);
+    LittleFS.remove(SLOTS[1]);
+    settings_init(); // Значения по умолчанию в один из слотов
+    save_volume(10);
+    save_volume(11);
+}
+
+void tearDown()
+{
+}
+
+void test_newest_slot_loaded()
+{
+    TEST_ASSERT_EQUAL_INT(1 - slot_with_volume(11), slot_with_volume(10));
+    TEST_ASSERT_EQUAL_INT(11, load_volume());
+}
+
+void test_corrupt_newest_falls_back()
+{
+    const char *path = SLOTS[slot_with_volume(11)];
+    std::vector<uint8_t> data = read_file(path);
+    data[data.size() / 2] ^= 0x01;
+    write_file(path, data);
+    TEST_ASSERT_EQUAL_INT(10, load_volume());
+}
+
+void test_corrupt_crc_falls_back()
+{
+    const char *path = SLOTS[slot_with_volume(11)];
+    std::vector<uint8_t> data = read_file(path);
+    data.back() ^= 0x80;
+    write_file(path, data);
+    TEST_ASSERT_EQUAL_INT(10, load_volume());
+}
+
+// Обрыв питания во время записи: файл короче записи
+void test_truncated_newest_falls_back()
+{
+    const char *path = SLOTS[slot_with_volume(11)];
+    std::vector<uint8_t> data = read_file(path);
+    data.resize(data.size() - 8);
+    write_file(path, data);
+    TEST_ASSERT_EQUAL_INT(10, load_volume());
+}
+
+// После отката запись идёт в испорченный слот, целый остаётся
+void test_write_after_fallback_replaces_corrupt_slot()
+{
+    int bad = slot_with_volume(11);
+    write_file(SLOTS[bad], std::vector<uint8_t>(16, 0xFF));
+    TEST_ASSERT_EQUAL_INT(10, load_volume());
+
+    save_volume(12);
+    TEST_ASSERT_EQUAL_INT(12, slot_volume(bad));
+    TEST_ASSERT_EQUAL_INT(10, slot_volume(1 - bad));
+    TEST_ASSERT_EQUAL_INT(12, load_volume());
+}
+
+void test_both_corrupt_loads_defaults()
+{
+    write_file(SLOTS[0], std::vector<uint8_t>(4, 0));
+    LittleFS.remove(SLOTS[1]);
+    AppSettings defaults;
+    settings_load_defaults(&defaults);
+    TEST_ASSERT_EQUAL_INT(defaults.volume, load_volume());
+    // Значения по умолчанию сразу записаны
+    TEST_ASSERT_TRUE(slot_with_volume(defaults.volume) >= 0);
+}
+
+// Старый settings.json с полями вне новых диапазонов: остальные поля, включая Wi-Fi, переносятся
+void test_legacy_json_migrated_field_by_field()
+{
+    LittleFS.remove(SLOTS[0]);
+    LittleFS.remove(SLOTS[1]);
+    const char *json = "{\"thresh_yellow\":250,\"thresh_orange\":100,\"thresh_red\":120,\"beep_freq\":50,"
+                       "\"cam_angle\":120,\"volume\":70,\"wifi_ssid\":\"MyCar\",\"wifi_pass\":\"secret123\"}";
+    write_file("/settings.json", std::vector<uint8_t>(json, json + strlen(json)));
+
+    settings_init();
+    const AppSettings &s = g_app_state.settings;
+    TEST_ASSERT_EQUAL_STRING("MyCar", s.wifi_ssid);
+    TEST_ASSERT_EQUAL_STRING("secret123", s.wifi_pass);
+    TEST_ASSERT_EQUAL_INT(70, s.volume);
+    TEST_ASSERT_EQUAL_INT(100, s.beep_freq);
+    TEST_ASSERT_EQUAL_INT(90, s.cam_angle);
+    TEST_ASSERT_EQUAL_INT(100, s.thresh_red);
+    TEST_ASSERT_EQUAL_INT(120, s.thresh_orange);
+    TEST_ASSERT_EQUAL_INT(250, s.thresh_yellow);
+    TEST_ASSERT_FALSE(LittleFS.exists("/settings.json"));
+    TEST_ASSERT_EQUAL_INT(70, load_volume()); // Перенесено в слот
+}
+
+int main(int argc, char **argv)
+{
+    char dir[] = "/tmp/test_settings_XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        return 1;
+    }
+    std::string root = dir;
+    setenv("SIM_FS_DIR", (root + "/fs").c_str(), 1);
+    setenv("SIM_NVS_DIR", (root + "/nvs").c_str(), 1);
+    LittleFS.begin(true);
+    xStateMutex = xSemaphoreCreateMutex();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_newest_slot_loaded);
+    RUN_TEST(test_corrupt_newest_falls_back);
+    RUN_TEST(test_corrupt_crc_falls_back);
+    RUN_TEST(test_truncated_newest_falls_back);
+    RUN_TEST(test_write_after_fallback_replaces_corrupt_slot);
+    RUN_TEST(test_both_corrupt_loads_defaults);
+    RUN_TEST(test_legacy_json_migrated_field_by_field);
+    return UNITY_END();
+}
@@ -0,0 +1,252 @@
+// Инкрементальный разбор POST /api/settings (settings_schema): тело любыми кусками,
+// проверка диапазонов, пропуск неизвестных ключей, escape-последовательности и \u-пары.
+// Запуск: pio test -e native
+#include <unity.h>
+#include <string.h>
+#include "settings_schema.h"
+
+static SettingsParser parser;
+
+void setUp()
+{
+    settings_parser_begin(&parser);
+}
+
+void tearDown()
+{
+}
+
+// Тело кусками по chunk байт, true - разобрано и объект закрыт
+static bool parse(const char *body, size_t chunk = 0)
+{
+    settings_parser_begin(&parser);
+    size_t len = strlen(body);
+    if (chunk == 0)
+    {
+        chunk = len;
+    }
+    for (size_t off = 0; off < len; off += chunk)
+    {
+        if (!settings_parser_feed(&parser, body + off, len - off < chunk ? len - off : chunk))
+        {
+            return false;
+        }
+    }
+    return settings_parser_finish(&parser);
+}
+
+static int field_index(const char *name)
+{
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; ++i)
+    {
+        if (strcmp(SETTINGS_SCHEMA[i].name, name) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool has_field(const char *name)
+{
+    int i = field_index(name);
+    return i >= 0 && (parser.present & (1UL << i));
+}
+
+// Разрезы посреди ключа, числа, литерала, escape и \u-пары дают тот же результат
+void test_chunked_body_split_anywhere()
+{
+    const char *body = " {\"volume\" : 42, \"filter_alpha\":0.25,\"flip_v\":true,"
+                       "\"unknown\":{\"a\":[1,\"}]\\\"\"]},"
+                       "\"wifi_ssid\":\"Car\\\"\\u00e9\\ud83d\\ude97\",\"grid_offset_x\":-12} ";
+    const char expected_ssid[] = "Car\"\xC3\xA9\xF0\x9F\x9A\x97";
+    for (size_t chunk = 1; chunk <= strlen(body); ++chunk)
+    {
+        TEST_ASSERT_TRUE(parse(body, chunk));
+        TEST_ASSERT_EQUAL_INT(42, parser.values.volume);
+        TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.25f, parser.values.filter_alpha);
+        TEST_ASSERT_TRUE(parser.values.flip_v);
+        TEST_ASSERT_EQUAL_STRING(expected_ssid, parser.values.wifi_ssid);
+        TEST_ASSERT_EQUAL_INT(-12, parser.values.grid_offset_x);
+        TEST_ASSERT_FALSE(has_field("flip_h"));
+    }
+}
+
+void test_unknown_keys_skipped()
+{
+    TEST_ASSERT_TRUE(parse("{\"foo\":1,\"bar\":{\"x\":[1,{\"y\":\"]}\"}]},\"baz\":\"\\u1234\",\"volume\":5,\"q\":null}"));
+    TEST_ASSERT_EQUAL_UINT32(1UL << field_index("volume"), parser.present);
+    TEST_ASSERT_EQUAL_INT(5, parser.values.volume);
+}
+
+void test_out_of_range_rejected()
+{
+    TEST_ASSERT_FALSE(parse("{\"volume\":101}"));
+    TEST_ASSERT_EQUAL_STRING("Invalid volume: must be between 0 and 100.", parser.error);
+    TEST_ASSERT_FALSE(parse("{\"jpeg_quality\":-1}"));
+    TEST_ASSERT_FALSE(parse("{\"filter_beta\":1.5}"));
+    TEST_ASSERT_FALSE(parse("{\"volume\":1.5}"));
+    TEST_ASSERT_EQUAL_STRING("Invalid volume: must be an integer.", parser.error);
+    TEST_ASSERT_FALSE(parse("{\"volume\":\"5\"}"));
+    TEST_ASSERT_FALSE(parse("{\"flip_h\":2}"));
+    TEST_ASSERT_FALSE(parse("{\"wifi_pass\":\"short\"}"));
+    TEST_ASSERT_EQUAL_STRING("Invalid wifi_pass: must be empty or 8-63 chars long.", parser.error);
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"\"}"));
+    TEST_ASSERT_FALSE(parse("{\"volume\":{\"a\":1}}"));
+
+    // Границы включительно, ошибка после корректных полей не оставляет тело принятым
+    TEST_ASSERT_TRUE(parse("{\"volume\":100,\"grid_offset_y\":-1000}"));
+    TEST_ASSERT_FALSE(parse("{\"volume\":50,\"cam_angle\":91}"));
+}
+
+void test_invalid_json_rejected()
+{
+    TEST_ASSERT_FALSE(parse("{\"volume\":5"));
+    TEST_ASSERT_FALSE(parse("{\"volume\":5}}"));
+    TEST_ASSERT_FALSE(parse("{\"volume\":nan}"));
+    TEST_ASSERT_FALSE(parse("{\"volume\" 5}"));
+    TEST_ASSERT_FALSE(parse("[1]"));
+    TEST_ASSERT_EQUAL_STRING("Invalid JSON", parser.error);
+}
+
+// Ошибка в середине тела: остальные куски игнорируются
+void test_error_stops_feed()
+{
+    TEST_ASSERT_FALSE(settings_parser_feed(&parser, "{\"volume\":x,", 12));
+    TEST_ASSERT_FALSE(settings_parser_feed(&parser, "}", 1));
+    TEST_ASSERT_FALSE(settings_parser_finish(&parser));
+}
+
+void test_escapes()
+{
+    TEST_ASSERT_TRUE(parse("{\"wifi_ssid\":\"a\\\"b\\\\c\\/d\\te\\u0041\\u20ac\"}"));
+    TEST_ASSERT_EQUAL_STRING("a\"b\\c/d\teA\xE2\x82\xAC", parser.values.wifi_ssid);
+
+    // Ключ тоже разбирается с escape
+    TEST_ASSERT_TRUE(parse("{\"vol\\u0075me\":7}"));
+    TEST_ASSERT_EQUAL_INT(7, parser.values.volume);
+
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"a\\xb\"}"));
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"a\\u00g1\"}"));
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"a\\u0000b\"}"));
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"a\nb\"}"));
+}
+
+// Символ вне BMP - пара \uD800-\uDBFF \uDC00-\uDFFF, собирается в 4 байта UTF-8
+void test_surrogate_pairs()
+{
+    TEST_ASSERT_TRUE(parse("{\"wifi_ssid\":\"\\uD83D\\uDE97 \\ud800\\udc00\\udbff\\udfff\"}"));
+    TEST_ASSERT_EQUAL_STRING("\xF0\x9F\x9A\x97 \xF0\x90\x80\x80\xF4\x8F\xBF\xBF", parser.values.wifi_ssid);
+
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"\\ud83d\"}"));       // Нет младшей половины
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"\\ud83dx\"}"));
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"\\ud83d\\n\"}"));
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"\\ud83d\\u0041\"}")); // Вторая - не младшая
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"\\ud83d\\ud83d\"}"));
+    TEST_ASSERT_FALSE(parse("{\"wifi_ssid\":\"\\ude97\"}"));       // Младшая без старшей
+    TEST_ASSERT_EQUAL_STRING("Invalid JSON", parser.error);
+}
+
+void test_apply_checks_cross_field()
+{
+    AppSettings settings;
+    settings_load_defaults(&settings);
+    char err[96];
+
+    TEST_ASSERT_TRUE(parse("{\"thresh_red\":300}"));
+    TEST_ASSERT_FALSE(settings_apply(&parser, &settings, err, sizeof(err)));
+    TEST_ASSERT_EQUAL_INT(50, settings.thresh_red);
+
+    TEST_ASSERT_TRUE(parse("{\"thresh_red\":30,\"volume\":60,\"resolution\":\"VGA\"}"));
+    TEST_ASSERT_TRUE(settings_parser_has_flag(&parser, SETTING_APPLY_CAMERA));
+    TEST_ASSERT_TRUE(settings_apply(&parser, &settings, err, sizeof(err)));
+    TEST_ASSERT_EQUAL_INT(30, settings.thresh_red);
+    TEST_ASSERT_EQUAL_INT(60, settings.volume);
+    TEST_ASSERT_EQUAL_STRING("VGA", settings.resolution);
+    TEST_ASSERT_EQUAL_INT(200, settings.thresh_yellow);
+}
+
+// Миграция settings.json: неверные поля приводятся или пропускаются, остальные сохраняются
+void test_lenient_keeps_valid_fields()
+{
+    const char *body = "{\"beep_freq\":50,\"cam_angle\":120.0,\"grid_offset_x\":-5000,\"volume\":2.5,"
+                       "\"flip_h\":\"yes\",\"wifi_pass\":\"short\",\"rotation\":{\"a\":1},"
+                       "\"wifi_ssid\":\"MyCar\",\"jpeg_quality\":12}";
+    settings_parser_begin_lenient(&parser);
+    TEST_ASSERT_TRUE(settings_parser_feed(&parser, body, strlen(body)));
+    TEST_ASSERT_TRUE(settings_parser_finish(&parser));
+
+    AppSettings settings;
+    settings_load_defaults(&settings);
+    settings_merge(&parser, &settings);
+    TEST_ASSERT_EQUAL_INT(100, settings.beep_freq);
+    TEST_ASSERT_EQUAL_INT(90, settings.cam_angle);
+    TEST_ASSERT_EQUAL_INT(-1000, settings.grid_offset_x);
+    TEST_ASSERT_EQUAL_INT(100, settings.volume); // Не целое - по умолчанию
+    TEST_ASSERT_TRUE(settings.flip_h);
+    TEST_ASSERT_EQUAL_STRING(WIFI_AP_PASS, settings.wifi_pass);
+    TEST_ASSERT_EQUAL_INT(90, settings.rotation);
+    TEST_ASSERT_EQUAL_STRING("MyCar", settings.wifi_ssid);
+    TEST_ASSERT_EQUAL_INT(12, settings.jpeg_quality);
+
+    const char *adjusted[] = {"beep_freq", "cam_angle", "grid_offset_x", "volume", "flip_h", "wifi_pass", "rotation"};
+    uint32_t expected = 0;
+    for (const char *name : adjusted)
+    {
+        expected |= 1UL << field_index(name);
+    }
+    TEST_ASSERT_EQUAL_UINT32(expected, parser.adjusted);
+
+    // Синтаксическая ошибка остаётся ошибкой
+    settings_parser_begin_lenient(&parser);
+    TEST_ASSERT_FALSE(settings_parser_feed(&parser, "{\"volume\":x,", 12));
+}
+
+void test_repair_cross_field()
+{
+    AppSettings settings;
+    settings_load_defaults(&settings);
+    TEST_ASSERT_EQUAL_UINT32(0, settings_repair(&settings));
+
+    settings.thresh_red = 120;
+    settings.thresh_orange = 100;
+    settings.thresh_yellow = 250;
+    settings.bpm_min = 400;
+    settings.bpm_max = 200;
+    settings.filter_median = 4;
+    settings.filter_alpha = 0.3f;
+    strcpy(settings.resolution, "UXGA");
+    uint32_t fixed = settings_repair(&settings);
+
+    TEST_ASSERT_EQUAL_INT(100, settings.thresh_red);
+    TEST_ASSERT_EQUAL_INT(120, settings.thresh_orange);
+    TEST_ASSERT_EQUAL_INT(250, settings.thresh_yellow);
+    TEST_ASSERT_EQUAL_INT(200, settings.bpm_min);
+    TEST_ASSERT_EQUAL_INT(400, settings.bpm_max);
+    TEST_ASSERT_EQUAL_INT(5, settings.filter_median);
+    TEST_ASSERT_EQUAL_FLOAT(0.3f, settings.filter_alpha); // Верный параметр фильтра сохраняется
+    TEST_ASSERT_EQUAL_STRING("XGA", settings.resolution);
+    TEST_ASSERT_TRUE(fixed & (1UL << field_index("thresh_red")));
+    TEST_ASSERT_FALSE(fixed & (1UL << field_index("thresh_yellow")));
+    TEST_ASSERT_FALSE(fixed & (1UL << field_index("filter_alpha")));
+
+    char err[96];
+    settings_parser_begin(&parser);
+    TEST_ASSERT_TRUE(settings_apply(&parser, &settings, err, sizeof(err)));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_chunked_body_split_anywhere);
+    RUN_TEST(test_unknown_keys_skipped);
+    RUN_TEST(test_out_of_range_rejected);
+    RUN_TEST(test_invalid_json_rejected);
+    RUN_TEST(test_error_stops_feed);
+    RUN_TEST(test_escapes);
+    RUN_TEST(test_surrogate_pairs);
+    RUN_TEST(test_apply_checks_cross_field);
+    RUN_TEST(test_lenient_keeps_valid_fields);
+    RUN_TEST(test_repair_cross_field);
+    return UNITY_END();
+}